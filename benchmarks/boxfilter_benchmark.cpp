@@ -0,0 +1,92 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <glowutils/AxisAlignedBoundingBox.h>
+
+#include "particles/particleboxfilter.h"
+#include "utils/ChronoTimer.h"
+
+namespace {
+
+const unsigned int numRepetitions = 20;
+
+/** the per point path the volume queries used before: AxisAlignedBoundingBox::inside on each vec3, no reserve */
+void perPointFilter(const std::vector<glm::vec3> & points, const glowutils::AxisAlignedBoundingBox & box,
+    std::vector<uint32_t> & insideIndices, glowutils::AxisAlignedBoundingBox & subbox)
+{
+    for (uint32_t i = 0; i < points.size(); ++i) {
+        if (!box.inside(points.at(i)))
+            continue;
+        insideIndices.push_back(i);
+        subbox.extend(points.at(i));
+    }
+}
+
+template <typename Filter>
+double millisecondsPerRun(Filter filter)
+{
+    ChronoTimer timer;
+    for (unsigned int i = 0; i < numRepetitions; ++i)
+        filter();
+    return static_cast<double>(timer.elapsed()) / 1.0e6 / numRepetitions;
+}
+
+void benchmark(uint32_t numParticles)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> distribution(0.0f, 100.0f);
+
+    std::vector<glm::vec3> points(numParticles);
+    std::vector<float> x(numParticles), y(numParticles), z(numParticles);
+    std::vector<uint16_t> valid(numParticles, 1);
+    for (uint32_t i = 0; i < numParticles; ++i) {
+        points.at(i) = glm::vec3(distribution(rng), distribution(rng), distribution(rng));
+        x.at(i) = points.at(i).x;
+        y.at(i) = points.at(i).y;
+        z.at(i) = points.at(i).z;
+    }
+
+    // roughly 10% of the particles are inside
+    const glowutils::AxisAlignedBoundingBox box(glm::vec3(20.0f, 20.0f, 20.0f), glm::vec3(66.4f, 66.4f, 66.4f));
+
+    std::vector<uint32_t> indices;
+    glowutils::AxisAlignedBoundingBox subbox;
+    size_t numInside = 0;
+
+    const double perPoint = millisecondsPerRun([&]() {
+        std::vector<uint32_t> freshIndices;
+        subbox = glowutils::AxisAlignedBoundingBox();
+        perPointFilter(points, box, freshIndices, subbox);
+        numInside = freshIndices.size();
+    });
+    const double scalar = millisecondsPerRun([&]() {
+        indices.clear();
+        subbox = glowutils::AxisAlignedBoundingBox();
+        filterPointsInBoxScalar(x.data(), y.data(), z.data(), valid.data(), numParticles, box, indices, subbox);
+    });
+    const double vectorized = millisecondsPerRun([&]() {
+        indices.clear();
+        subbox = glowutils::AxisAlignedBoundingBox();
+        filterPointsInBox(x.data(), y.data(), z.data(), valid.data(), numParticles, box, indices, subbox);
+    });
+
+    if (indices.size() != numInside)
+        std::printf("mismatch: %u points inside with the per point path, %u with the kernel\n",
+            static_cast<unsigned int>(numInside), static_cast<unsigned int>(indices.size()));
+
+    std::printf("%8u particles (%7u inside): per point %8.3f ms, scalar SoA %8.3f ms, SIMD SoA %8.3f ms (%.1fx)\n",
+        numParticles, static_cast<unsigned int>(numInside), perPoint, scalar, vectorized, perPoint / vectorized);
+}
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    for (uint32_t numParticles : { 10000u, 100000u, 1000000u })
+        benchmark(numParticles);
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "terrain/heatdiffusion.h"
+#include "utils/ChronoTimer.h"
+
+namespace {
+
+const unsigned int numRepetitions = 20;
+
+/** the default terrain's samples per axis */
+const unsigned int samplesPerAxis = 1025;
+
+typedef void (*RowKernel)(const float *, const float *, const float *, const float *, const float *, const float *,
+    const float *, const HeatRelaxation &, float *, uint32_t);
+
+/** one diffusion step on the inner samples of the grid, as TemperatureTile does it for dirty blocks */
+void step(RowKernel kernel, const std::vector<float> & temperatures, const std::vector<float> & heights,
+    const std::vector<float> & rates, const HeatRelaxation & relaxation, std::vector<float> & out)
+{
+    const unsigned int n = samplesPerAxis;
+    for (unsigned int row = 1; row < n - 1; ++row) {
+        const unsigned int offset = row * n + 1;
+        kernel(&temperatures.at(offset - n), &temperatures.at(offset), &temperatures.at(offset + n),
+            &heights.at(offset - n), &heights.at(offset), &heights.at(offset + n),
+            &rates.at(offset), relaxation, &out.at(offset), n - 2);
+    }
+}
+
+double millisecondsPerStep(RowKernel kernel, const std::vector<float> & temperatures, const std::vector<float> & heights,
+    const std::vector<float> & rates, const HeatRelaxation & relaxation, std::vector<float> & out)
+{
+    ChronoTimer timer;
+    for (unsigned int i = 0; i < numRepetitions; ++i)
+        step(kernel, temperatures, heights, rates, relaxation, out);
+    return static_cast<double>(timer.elapsed()) / 1.0e6 / numRepetitions;
+}
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    const unsigned int numSamples = samplesPerAxis * samplesPerAxis;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> heightDistribution(-10.0f, 30.0f);
+    std::uniform_real_distribution<float> temperatureDistribution(-20.0f, 600.0f);
+    std::uniform_real_distribution<float> rateDistribution(0.05f, 0.2f);
+
+    std::vector<float> temperatures(numSamples), heights(numSamples), rates(numSamples);
+    for (unsigned int i = 0; i < numSamples; ++i) {
+        temperatures.at(i) = temperatureDistribution(rng);
+        heights.at(i) = heightDistribution(rng);
+        rates.at(i) = rateDistribution(rng);
+    }
+
+    const HeatRelaxation relaxation = { 20.0f, -0.67f, 0.4f, 0.1f };
+
+    std::vector<float> scalarOut(numSamples, 0.0f), vectorizedOut(numSamples, 0.0f);
+
+    const double scalar = millisecondsPerStep(&diffuseHeatRowScalar, temperatures, heights, rates, relaxation, scalarOut);
+    const double vectorized = millisecondsPerStep(&diffuseHeatRow, temperatures, heights, rates, relaxation, vectorizedOut);
+
+    unsigned int numMismatches = 0;
+    float maxDifference = 0.0f;
+    for (unsigned int i = 0; i < numSamples; ++i) {
+        const float difference = std::abs(scalarOut.at(i) - vectorizedOut.at(i));
+        if (difference > 1e-4f)
+            ++numMismatches;
+        maxDifference = std::max(maxDifference, difference);
+    }
+
+    if (numMismatches > 0)
+        std::printf("mismatch: %u samples differ between the scalar and the SIMD kernel, by up to %f\n", numMismatches, maxDifference);
+
+    std::printf("%u x %u samples: scalar %8.3f ms, SIMD %8.3f ms per step (%.1fx)\n",
+        samplesPerAxis, samplesPerAxis, scalar, vectorized, scalar / vectorized);
+
+    return 0;
+}
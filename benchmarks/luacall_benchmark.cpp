@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "lua/luawrapper.h"
+#include "utils/ChronoTimer.h"
+
+namespace {
+
+const unsigned int numCalls = 1000000;
+
+const char * scriptFile = "luacall_benchmark.lua";
+
+/** a call with a contact volume as in the collision script, and Lua calling back into C++ */
+const char * script =
+    "function boxCollision(left, right, llf, urb)\n"
+    "    return left + right\n"
+    "end\n"
+    "function numberCollision(left, right, llfX, llfY, llfZ, urbX, urbY, urbZ)\n"
+    "    return left + right\n"
+    "end\n"
+    "function callErased(n)\n"
+    "    local sum = 0\n"
+    "    for i = 1, n do sum = sum + erased(i) end\n"
+    "    return sum\n"
+    "end\n"
+    "function callLambda(n)\n"
+    "    local sum = 0\n"
+    "    for i = 1, n do sum = sum + lambda(i) end\n"
+    "    return sum\n"
+    "end\n";
+
+class Benchmark : public LuaWrapper
+{
+public:
+    Benchmark()
+    {
+        std::ofstream(scriptFile) << script;
+        loadScript(scriptFile);
+        removeScript(scriptFile);
+        std::remove(scriptFile);
+
+        std::function<int(int)> erased = [](int i) { return i & 1; };
+        Register("erased", erased);
+        Register("lambda", [](int i) { return i & 1; });
+    }
+
+    double callsPerSecond(const std::function<void()> & function)
+    {
+        ChronoTimer timer;
+        for (unsigned int i = 0; i < numCalls; ++i)
+            function();
+        timer.update();
+        return numCalls / static_cast<double>(timer.elapsed()) * 1.0e9;
+    }
+
+    double callbacksPerSecond(const std::string & luaFunction)
+    {
+        ChronoTimer timer;
+        call<int>(luaFunction, numCalls);
+        timer.update();
+        return numCalls / static_cast<double>(timer.elapsed()) * 1.0e9;
+    }
+};
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    Benchmark lua;
+
+    const glm::vec3 llf(1.0f, 2.0f, 3.0f), urb(4.0f, 5.0f, 6.0f);
+
+    // previous path: global lookup by name and two tables per call
+    const double byName = lua.callsPerSecond([&]() {
+        lua.call<int>("boxCollision", 1, 2, llf, urb);
+    });
+
+    const LuaWrapper::FunctionRef boxCollision = lua.function("boxCollision");
+    const double byRef = lua.callsPerSecond([&]() {
+        lua.call<int>(boxCollision, 1, 2, llf, urb);
+    });
+
+    const double byNameNumbers = lua.callsPerSecond([&]() {
+        lua.call<int>("numberCollision", 1, 2, llf.x, llf.y, llf.z, urb.x, urb.y, urb.z);
+    });
+
+    const LuaWrapper::FunctionRef numberCollision = lua.function("numberCollision");
+    const double byRefNumbers = lua.callsPerSecond([&]() {
+        lua.call<int>(numberCollision, 1, 2, llf.x, llf.y, llf.z, urb.x, urb.y, urb.z);
+    });
+
+    std::printf("C++ -> Lua with vec3 tables: by name %5.2f M calls/s, by handle %5.2f M calls/s\n",
+        byName * 1.0e-6, byRef * 1.0e-6);
+    std::printf("C++ -> Lua with numbers: by name %5.2f M calls/s, by handle %5.2f M calls/s\n",
+        byNameNumbers * 1.0e-6, byRefNumbers * 1.0e-6);
+    std::printf("collision call, by name with vec3 tables -> by handle with numbers: %.1fx\n", byRefNumbers / byName);
+
+    const double erased = lua.callbacksPerSecond("callErased");
+    const double lambda = lua.callbacksPerSecond("callLambda");
+
+    std::printf("Lua -> C++: std::function %5.2f M calls/s, lambda %5.2f M calls/s (%.1fx)\n",
+        erased * 1.0e-6, lambda * 1.0e-6, lambda / erased);
+
+    return 0;
+}
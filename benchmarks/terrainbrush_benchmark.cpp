@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "terrain/terrainbrush.h"
+#include "utils/ChronoTimer.h"
+
+namespace {
+
+const unsigned int numStrokes = 20000;
+
+/** the default terrain's samples per axis and interaction standard deviation of the base level */
+const unsigned int samplesPerAxis = 1025;
+const float tileBorderLength = 400.0f;
+const float stddev = 7.0f;
+
+const float depth = 90.0f;
+
+float normalDist(float x, float mean, float stddev)
+{
+    return 1.0f / (stddev * std::sqrt(2.0f * 3.14159265f))
+        * std::exp(-(x - mean) * (x - mean) / (2.0f * stddev * stddev));
+}
+
+/** the brush before the falloff table: a gaussian through a std::function per sample */
+void strokeUncached(std::vector<float> & heights, unsigned int row, unsigned int column, float value)
+{
+    const float sampleInterval = tileBorderLength / (samplesPerAxis - 1);
+    const float effectRadiusWorld = stddev * 3;
+    const int effectRadius = static_cast<int>(std::ceil(effectRadiusWorld * samplesPerAxis / tileBorderLength));
+    const float norm0Inv = 1.0f / normalDist(0, 0, stddev);
+
+    std::function<float(float)> interactHeight = [norm0Inv, value](float x) {
+        return normalDist(x, 0, stddev) * norm0Inv * depth + value - depth;
+    };
+
+    for (int r = -effectRadius; r <= effectRadius; ++r) {
+        const float relWorldX = r * sampleInterval;
+        for (int c = -effectRadius; c <= effectRadius; ++c) {
+            const float relWorldZ = c * sampleInterval;
+            const float localRadius = std::sqrt(relWorldX * relWorldX + relWorldZ * relWorldZ);
+            if (localRadius > effectRadiusWorld)
+                continue;
+            float & height = heights.at((row + r) * samplesPerAxis + column + c);
+            const float newHeight = interactHeight(localRadius);
+            if (newHeight > height)
+                height = newHeight;
+        }
+    }
+}
+
+typedef void (*RowKernel)(float *, const float *, uint32_t, float, float, bool, uint8_t *);
+
+void stroke(RowKernel kernel, const TerrainBrush & brush, std::vector<float> & heights, unsigned int row, unsigned int column, float value)
+{
+    const int radius = static_cast<int>(brush.radius);
+    for (int r = -radius; r <= radius; ++r) {
+        const int halfWidth = brush.halfWidths.at(std::abs(r));
+        if (halfWidth < 0)
+            continue;
+        kernel(&heights.at((row + r) * samplesPerAxis + column - halfWidth), brush.row(r) - halfWidth, 2 * halfWidth + 1,
+            value - depth, depth, true, nullptr);
+    }
+}
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> heightDistribution(-10.0f, 30.0f);
+    std::uniform_int_distribution<unsigned int> centerDistribution(100, samplesPerAxis - 100);
+
+    std::vector<float> initial(samplesPerAxis * samplesPerAxis);
+    for (float & height : initial)
+        height = heightDistribution(rng);
+
+    std::vector<unsigned int> centers(2 * numStrokes);
+    for (unsigned int & center : centers)
+        center = centerDistribution(rng);
+
+    const TerrainBrush brush(stddev, tileBorderLength / (samplesPerAxis - 1), samplesPerAxis / tileBorderLength);
+
+    std::vector<float> uncachedHeights = initial, scalarHeights = initial, vectorizedHeights = initial;
+
+    ChronoTimer timer;
+    for (unsigned int i = 0; i < numStrokes; ++i)
+        strokeUncached(uncachedHeights, centers.at(2 * i), centers.at(2 * i + 1), 20.0f);
+    timer.update();
+    const double uncached = static_cast<double>(timer.elapsed()) / 1.0e3 / numStrokes;
+
+    timer.reset();
+    for (unsigned int i = 0; i < numStrokes; ++i)
+        stroke(&applyBrushRowScalar, brush, scalarHeights, centers.at(2 * i), centers.at(2 * i + 1), 20.0f);
+    timer.update();
+    const double scalar = static_cast<double>(timer.elapsed()) / 1.0e3 / numStrokes;
+
+    timer.reset();
+    for (unsigned int i = 0; i < numStrokes; ++i)
+        stroke(&applyBrushRow, brush, vectorizedHeights, centers.at(2 * i), centers.at(2 * i + 1), 20.0f);
+    timer.update();
+    const double vectorized = static_cast<double>(timer.elapsed()) / 1.0e3 / numStrokes;
+
+    float maxDifference = 0.0f;
+    for (size_t i = 0; i < initial.size(); ++i) {
+        maxDifference = std::max(maxDifference, std::abs(uncachedHeights.at(i) - scalarHeights.at(i)));
+        maxDifference = std::max(maxDifference, std::abs(scalarHeights.at(i) - vectorizedHeights.at(i)));
+    }
+    if (maxDifference > 1e-3f)
+        std::printf("mismatch: the brush kernels differ by up to %f\n", maxDifference);
+
+    std::printf("brush radius %u samples: uncached %8.3f us, table scalar %8.3f us, table SIMD %8.3f us per stroke (%.1fx)\n",
+        brush.radius, uncached, scalar, vectorized, uncached / vectorized);
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <cstdio>
+#include <thread>
+
+#include "terrain/terraingenerator.h"
+#include "utils/ChronoTimer.h"
+
+namespace {
+
+/** the tiles of a 3 x 3 world */
+const int tileRadius = 1;
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    TerrainSettings settings;
+    TerrainGenerator generator(settings);
+
+    const TileData reference = generator.generateTileData(0, 0);
+
+    unsigned int numTiles = 0;
+    bool deterministic = true;
+
+    ChronoTimer timer;
+    for (int xID = -tileRadius; xID <= tileRadius; ++xID)
+    for (int zID = -tileRadius; zID <= tileRadius; ++zID) {
+        const TileData data = generator.generateTileData(xID, zID);
+        if (xID == 0 && zID == 0)
+            deterministic = data.baseHeights == reference.baseHeights;
+        ++numTiles;
+    }
+    const double milliseconds = static_cast<double>(timer.elapsed()) / 1.0e6;
+
+    if (!deterministic)
+        std::printf("mismatch: tile (0, 0) differs between two runs\n");
+
+    std::printf("%u tiles of %u x %u samples on %u hardware threads: %8.3f ms per tile\n",
+        numTiles, settings.maxTileSamplesPerAxis, settings.maxTileSamplesPerAxis,
+        std::thread::hardware_concurrency(), milliseconds / numTiles);
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "terrain/terrainlod.h"
+#include "utils/ChronoTimer.h"
+
+namespace {
+
+const unsigned int numSelections = 10000;
+
+/** the default terrain's samples per axis and tile size, with 3 x 3 tiles around the camera */
+const unsigned int samplesPerAxis = 1025;
+const float tileBorderLength = 400.0f;
+const int tileRadius = 1;
+
+const glm::vec2 camera(10.0f, 20.0f);
+
+bool tileInViewRange(int x, int z, float viewRange)
+{
+    const float distanceX = std::abs(camera.x - tileBorderLength * x) - 0.5f * tileBorderLength;
+    const float distanceZ = std::abs(camera.y - tileBorderLength * z) - 0.5f * tileBorderLength;
+    return distanceX < viewRange && distanceZ < viewRange;
+}
+
+/** triangles of the grid centered at the camera, that was drawn for each tile in the view range before the LOD */
+unsigned int fullGridTriangles(float viewRange)
+{
+    const unsigned int diameter = 2 * static_cast<unsigned int>(std::ceil(viewRange * samplesPerAxis / tileBorderLength));
+    return 2 * (diameter - 1) * (diameter - 1);
+}
+
+glm::vec2 cameraRowColumn(int x, int z)
+{
+    const float sampleInterval = tileBorderLength / (samplesPerAxis - 1);
+    return glm::vec2(
+        (camera.x - tileBorderLength * (x - 0.5f)) / sampleInterval,
+        (camera.y - tileBorderLength * (z - 0.5f)) / sampleInterval);
+}
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    TerrainLod lod(samplesPerAxis - 1);
+    std::vector<TerrainLod::Node> nodes;
+
+    // 60 is the camera's default zfar
+    for (float viewRange : { 60.0f, 150.0f, 400.0f }) {
+        lod.setViewRange(viewRange * (samplesPerAxis - 1) / tileBorderLength);
+
+        unsigned int numTiles = 0, gridTriangles = 0, lodTriangles = 0, coarseTriangles = 0, numNodes = 0;
+        for (int x = -tileRadius; x <= tileRadius; ++x) {
+            for (int z = -tileRadius; z <= tileRadius; ++z) {
+                if (!tileInViewRange(x, z, viewRange))
+                    continue;
+                ++numTiles;
+                gridTriangles += fullGridTriangles(viewRange);
+
+                nodes.clear();
+                lod.select(cameraRowColumn(x, z), 0, nullptr, nodes);
+                lodTriangles += lod.numTriangles(nodes);
+                numNodes += static_cast<unsigned int>(nodes.size());
+
+                // the light's depth map
+                nodes.clear();
+                lod.select(cameraRowColumn(x, z), 1, nullptr, nodes);
+                coarseTriangles += lod.numTriangles(nodes);
+            }
+        }
+
+        ChronoTimer timer;
+        for (unsigned int i = 0; i < numSelections; ++i) {
+            nodes.clear();
+            lod.select(cameraRowColumn(0, 0), 0, nullptr, nodes);
+        }
+        timer.update();
+        const double selection = static_cast<double>(timer.elapsed()) / 1.0e3 / numSelections;
+
+        std::printf("view range %5.0f, %u tiles: full grid %9u triangles, LOD %7u triangles in %3u nodes (%.1fx), depth map LOD %7u triangles, "
+            "selection %6.2f us per tile\n",
+            viewRange, numTiles, gridTriangles, lodTriangles, numNodes, static_cast<double>(gridTriangles) / lodTriangles, coarseTriangles, selection);
+    }
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <glow/logging.h>
+
+#include "headlesssimulation.h"
+#include "utils/profiler.h"
+
+/** Runs the simulation without window and OpenGL for a number of ticks and prints the subsystem timings.
+  * usage: elemate_headless [numTicks] [scenario script] [--profile]
+  * --profile writes the profiler trace, if the build records profiler zones (ELEMATE_PROFILING). */
+int main(int argc, char * argv[])
+{
+    const std::string checkFile = "scripts/collision.lua";
+    if (!std::ifstream(checkFile).good()) {
+        glow::fatal("Seems that Elemate is running in a wrong working directory.");
+        glow::fatal("(Cannot find %;)", checkFile);
+        return -1;
+    }
+
+    const int numTicks = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const std::string scenario = argc > 2 ? argv[2] : "scripts/headless_scenario.lua";
+    const bool writeProfile = argc > 3 && std::string(argv[3]) == "--profile";
+
+    if (numTicks <= 0) {
+        glow::fatal("Invalid number of ticks: %;", argv[1]);
+        return -1;
+    }
+    if (!std::ifstream(scenario).good()) {
+        glow::fatal("Cannot find scenario script %;", scenario);
+        return -1;
+    }
+
+    HeadlessSimulation * simulation = new HeadlessSimulation(scenario);
+
+    simulation->run(static_cast<unsigned int>(numTicks));
+    simulation->printTimings();
+
+    delete simulation;
+
+    if (writeProfile)
+        Profiler::dump();
+
+    return 0;
+}
@@ -14,6 +14,7 @@ bool Elements::s_isInitialized = false;
 
 std::unordered_map<std::string, physx::PxMaterial*>	* Elements::s_pxMaterials = nullptr;
 std::unordered_map<std::string, glm::mat4>          * Elements::s_shadingMatrices = nullptr;
+std::unordered_map<std::string, float>              * Elements::s_thermalDiffusivities = nullptr;
 
 const std::string Elements::s_elementUniformPrefix = "element_";
 
@@ -23,6 +24,7 @@ void Elements::initialize()
     {
         Elements::s_pxMaterials = new std::unordered_map<std::string, physx::PxMaterial*>;
         Elements::s_shadingMatrices = new std::unordered_map<std::string, glm::mat4>;
+        Elements::s_thermalDiffusivities = new std::unordered_map<std::string, float>;
     }
     assert(!s_isInitialized);
 
@@ -64,6 +66,12 @@ void Elements::initialize()
         0.2f, 0.7f, 0.3f, 1.0f,    //specular
         0.0f, 0.0f, 0.0f, 0.0f));  //emission
 
+    // rock conducts heat better than loose sand and soil
+    s_thermalDiffusivities->emplace("default", 0.15f);
+    s_thermalDiffusivities->emplace("bedrock", 0.25f);
+    s_thermalDiffusivities->emplace("sand", 0.1f);
+    s_thermalDiffusivities->emplace("grassland", 0.08f);
+
     for (const auto & pair : *s_pxMaterials) {
         assert(pair.second);
         if (!pair.second)
@@ -80,6 +88,7 @@ void Elements::clear()
 
     s_pxMaterials->clear();
     s_shadingMatrices->clear();
+    s_thermalDiffusivities->clear();
 }
 
 void Elements::setAllUniforms(glow::Program & program)
@@ -102,3 +111,14 @@ physx::PxMaterial * Elements::pxMaterial(const std::string & elementName)
 
     return it->second;
 }
+
+float Elements::thermalDiffusivity(const std::string & elementName)
+{
+    assert(s_isInitialized);
+
+    const auto & it = s_thermalDiffusivities->find(elementName);
+    if (it == s_thermalDiffusivities->end())
+        return s_thermalDiffusivities->at("default");
+
+    return it->second;
+}
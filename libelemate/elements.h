@@ -25,6 +25,9 @@ struct Elements {
     /** get a physx material definition for the named element */
     static physx::PxMaterial * pxMaterial(const std::string & physxMaterial);
 
+    /** thermal diffusivity of the named terrain element, in square world units per second */
+    static float thermalDiffusivity(const std::string & elementName);
+
     /** uniform name prefix used for lighting matrices */
     static const std::string s_elementUniformPrefix;
 
@@ -33,4 +36,5 @@ private:
 
     static std::unordered_map<std::string, physx::PxMaterial*>	     * s_pxMaterials;
     static std::unordered_map<std::string, glm::mat4>                * s_shadingMatrices;
+    static std::unordered_map<std::string, float>                    * s_thermalDiffusivities;
 };
@@ -0,0 +1,106 @@
+#include "headlesssimulation.h"
+
+#include <cassert>
+
+#include <glow/logging.h>
+
+#include "utils/ChronoTimer.h"
+#include "physicswrapper.h"
+#include "world.h"
+#include "terrain/terraininteraction.h"
+#include "particles/particlegrouptycoon.h"
+#include "particles/particlescriptaccess.h"
+#include "particles/particlegroup.h"
+
+namespace {
+
+double secondsSince(const ChronoTimer & timer, long double & lastElapsed)
+{
+    timer.update();
+    const long double elapsed = timer.elapsed();
+    const double seconds = static_cast<double>(elapsed - lastElapsed) * 1e-9;
+    lastElapsed = elapsed;
+    return seconds;
+}
+
+}
+
+HeadlessSimulation::HeadlessSimulation(const std::string & scenarioScript)
+: m_physicsWrapper(new PhysicsWrapper)
+, m_world(new World(*m_physicsWrapper, true))
+, m_terrainInteraction(std::make_shared<TerrainInteraction>("bedrock"))
+, m_lua(new LuaWrapper())
+, m_numTicks(0)
+, m_simulatedTime(0.0)
+, m_scenarioTime(0.0)
+, m_particleTransferTime(0.0)
+, m_totalTime(0.0)
+{
+    ParticleScriptAccess::instance().registerLuaFunctions(*m_lua);
+    m_terrainInteraction->registerLuaFunctions(*m_lua);
+    m_world->registerLuaFunctions(m_lua);
+
+    m_lua->loadScript(scenarioScript);
+    m_lua->call("setup");
+    m_tick = m_lua->function("tick");
+}
+
+HeadlessSimulation::~HeadlessSimulation()
+{
+    delete m_lua;
+    m_terrainInteraction.reset();
+    delete m_world;
+    delete m_physicsWrapper;
+}
+
+void HeadlessSimulation::run(unsigned int numTicks, double delta)
+{
+    assert(delta > 0.0);
+
+    ChronoTimer timer;
+    long double lastElapsed = 0.0L;
+
+    for (unsigned int i = 0; i < numTicks; ++i) {
+        m_lua->call(m_tick, m_numTicks, m_simulatedTime);
+        m_scenarioTime += secondsSince(timer, lastElapsed);
+
+        m_world->stepPhysics(delta);
+        secondsSince(timer, lastElapsed);
+
+        // moves particles that hit the ground from the emitters to the down groups
+        ParticleGroupTycoon::instance().updateVisuals();
+        m_particleTransferTime += secondsSince(timer, lastElapsed);
+
+        ++m_numTicks;
+        m_simulatedTime += delta;
+    }
+
+    m_totalTime += static_cast<double>(lastElapsed) * 1e-9;
+}
+
+void HeadlessSimulation::printTimings() const
+{
+    if (m_numTicks == 0) {
+        glow::info("HeadlessSimulation: no ticks run");
+        return;
+    }
+
+    uint32_t numParticles = 0;
+    for (const auto & pair : ParticleGroupTycoon::instance().particleGroups())
+        numParticles += pair.second->numParticles();
+
+    const World::PhysicsTimings & physics = m_world->physicsTimings();
+    const double toMsPerTick = 1000.0 / m_numTicks;
+
+    glow::info("HeadlessSimulation: %; ticks, %;s simulated, %;s wall time, %; ticks/s",
+        m_numTicks, m_simulatedTime, m_totalTime, m_numTicks / m_totalTime);
+    glow::info("    %; particles in %; groups at the end",
+        numParticles, ParticleGroupTycoon::instance().particleGroups().size());
+    glow::info("    per tick: scenario %;ms, terrain %;ms, particle groups %;ms, physx %;ms, snapshots %;ms, particle transfer %;ms",
+        m_scenarioTime * toMsPerTick,
+        physics.terrain * toMsPerTick,
+        physics.particles * toMsPerTick,
+        physics.physx * toMsPerTick,
+        physics.snapshots * toMsPerTick,
+        m_particleTransferTime * toMsPerTick);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "lua/luawrapper.h"
+
+class PhysicsWrapper;
+class World;
+class TerrainInteraction;
+
+/** @brief Runs the simulation without window and OpenGL context, driven by a Lua scenario script.
+  * The scenario may define setup() and tick(tickIndex, time), using the particle (psa_*) and terrain (terrain_*) functions. */
+class HeadlessSimulation
+{
+public:
+    HeadlessSimulation(const std::string & scenarioScript);
+    ~HeadlessSimulation();
+
+    /** Run numTicks simulation steps with fixed time step delta (seconds). */
+    void run(unsigned int numTicks, double delta = 1.0 / 100.0);
+
+    /** Log the time spent in each subsystem, over all ticks run so far. */
+    void printTimings() const;
+
+protected:
+    PhysicsWrapper * m_physicsWrapper;
+    World * m_world;
+
+    std::shared_ptr<TerrainInteraction> m_terrainInteraction;
+    LuaWrapper * m_lua;
+    LuaWrapper::FunctionRef m_tick;
+
+    unsigned int m_numTicks;
+    double m_simulatedTime;
+
+    /** accumulated seconds */
+    double m_scenarioTime;
+    double m_particleTransferTime;
+    double m_totalTime;
+
+public:
+    HeadlessSimulation() = delete;
+    void operator=(HeadlessSimulation &) = delete;
+};
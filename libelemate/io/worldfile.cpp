@@ -0,0 +1,311 @@
+#include "worldfile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+
+#include <glow/logging.h>
+
+namespace {
+
+const char fileMagic[4] = { 'E', 'W', 'L', 'D' };
+const uint32_t fileVersion = 1;
+
+const char timeSection[4] = { 'T', 'I', 'M', 'E' };
+const char climateSection[4] = { 'C', 'L', 'I', 'M' };
+const char achievementSection[4] = { 'A', 'C', 'H', 'V' };
+/** one section per particle group */
+const char particleGroupSection[4] = { 'P', 'G', 'R', 'P' };
+
+static_assert(sizeof(ImmutableParticleProperties) == 5 * sizeof(float) && sizeof(MutableParticleProperties) == 10 * sizeof(float),
+    "the particle properties are written as raw floats");
+
+template <typename T>
+void writeValue(std::ostream & stream, const T & value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void writeString(std::ostream & stream, const std::string & value)
+{
+    writeValue(stream, static_cast<uint32_t>(value.size()));
+    stream.write(value.data(), value.size());
+}
+
+template <typename T>
+void writeArray(std::ostream & stream, const std::vector<T> & values)
+{
+    writeValue(stream, static_cast<uint32_t>(values.size()));
+    stream.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+/** @brief Reads values of one section, failing instead of reading past its end. */
+class SectionReader
+{
+public:
+    SectionReader(std::istream & stream, uint64_t size)
+    : m_stream(stream)
+    , m_remaining(size)
+    {
+    }
+
+    template <typename T>
+    bool read(T & value)
+    {
+        return readBytes(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    bool readString(std::string & value)
+    {
+        uint32_t size = 0;
+        if (!read(size) || size > m_remaining)
+            return false;
+        value.resize(size);
+        return readBytes(&value[0], size);
+    }
+
+    template <typename T>
+    bool readArray(std::vector<T> & values)
+    {
+        uint32_t size = 0;
+        if (!read(size) || size > m_remaining / sizeof(T))
+            return false;
+        values.resize(size);
+        return readBytes(reinterpret_cast<char *>(values.data()), size * sizeof(T));
+    }
+
+protected:
+    bool readBytes(char * data, uint64_t size)
+    {
+        if (size > m_remaining)
+            return false;
+        m_stream.read(data, size);
+        m_remaining -= size;
+        return m_stream.good();
+    }
+
+    std::istream & m_stream;
+    uint64_t m_remaining;
+};
+
+/** Write the tag and a placeholder for the size of the section, endSection() sets the size. */
+std::streamoff beginSection(std::ostream & stream, const char tag[4])
+{
+    stream.write(tag, 4);
+    writeValue(stream, uint64_t(0));
+    return stream.tellp();
+}
+
+void endSection(std::ostream & stream, std::streamoff begin)
+{
+    const std::streamoff end = stream.tellp();
+    stream.seekp(begin - static_cast<std::streamoff>(sizeof(uint64_t)));
+    writeValue(stream, static_cast<uint64_t>(end - begin));
+    stream.seekp(end);
+}
+
+void writeParticleGroup(std::ostream & stream, const ParticleGroupState & group)
+{
+    writeValue(stream, static_cast<uint32_t>(group.id));
+    writeValue(stream, static_cast<uint8_t>(group.isEmitter));
+    writeString(stream, group.elementName);
+    writeValue(stream, group.maxParticleCount);
+    writeValue(stream, group.temperature);
+    writeValue(stream, group.immutableProperties);
+    writeValue(stream, group.mutableProperties);
+
+    writeValue(stream, static_cast<uint8_t>(group.emitting));
+    writeValue(stream, group.emitRatio);
+    writeValue(stream, group.emitPosition);
+    writeValue(stream, group.emitDirection);
+    writeValue(stream, group.timeSinceLastEmit);
+
+    if (!group.snapshot) {
+        writeArray(stream, group.positionX);
+        writeArray(stream, group.positionY);
+        writeArray(stream, group.positionZ);
+        writeArray(stream, group.velocityX);
+        writeArray(stream, group.velocityY);
+        writeArray(stream, group.velocityZ);
+        return;
+    }
+
+    // a saved group shares its snapshot, its released particles are skipped here
+    const ParticleSnapshot & snapshot = *group.snapshot;
+    const std::vector<float> * snapshotArrays[] = { &snapshot.positionX, &snapshot.positionY, &snapshot.positionZ,
+        &snapshot.velocityX, &snapshot.velocityY, &snapshot.velocityZ };
+
+    std::vector<float> values;
+    values.reserve(snapshot.size());
+    for (const std::vector<float> * snapshotValues : snapshotArrays) {
+        values.clear();
+        for (uint32_t i = 0; i < snapshot.size(); ++i)
+            if (snapshot.isValid(i))
+                values.push_back((*snapshotValues)[i]);
+        writeArray(stream, values);
+    }
+}
+
+bool readParticleGroup(SectionReader & reader, ParticleGroupState & group)
+{
+    uint32_t id = 0;
+    uint8_t isEmitter = 0, emitting = 0;
+    const bool valid = reader.read(id)
+        && reader.read(isEmitter)
+        && reader.readString(group.elementName)
+        && reader.read(group.maxParticleCount)
+        && reader.read(group.temperature)
+        && reader.read(group.immutableProperties)
+        && reader.read(group.mutableProperties)
+        && reader.read(emitting)
+        && reader.read(group.emitRatio)
+        && reader.read(group.emitPosition)
+        && reader.read(group.emitDirection)
+        && reader.read(group.timeSinceLastEmit)
+        && reader.readArray(group.positionX)
+        && reader.readArray(group.positionY)
+        && reader.readArray(group.positionZ)
+        && reader.readArray(group.velocityX)
+        && reader.readArray(group.velocityY)
+        && reader.readArray(group.velocityZ);
+
+    group.id = id;
+    group.isEmitter = isEmitter != 0;
+    group.emitting = emitting != 0;
+
+    const size_t numParticles = group.positionX.size();
+    return valid && group.positionY.size() == numParticles && group.positionZ.size() == numParticles
+        && group.velocityX.size() == numParticles && group.velocityY.size() == numParticles && group.velocityZ.size() == numParticles;
+}
+
+}
+
+std::string WorldFile::terrainPath(const std::string & path)
+{
+    return path + ".tiles";
+}
+
+bool WorldFile::write(const std::string & path, const WorldState & state)
+{
+    // the world file is only replaced if its terrain could be written
+    if (!state.terrain.write(terrainPath(path))) {
+        glow::warning("WorldFile: could not write the terrain of %;", path);
+        return false;
+    }
+
+    const std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios_base::binary | std::ios_base::trunc | std::ios_base::out);
+    if (!file.good())
+        return false;
+
+    file.write(fileMagic, sizeof(fileMagic));
+    writeValue(file, fileVersion);
+
+    std::streamoff section = beginSection(file, timeSection);
+    writeValue(file, state.dayTime);
+    writeValue(file, static_cast<uint8_t>(state.timeRunning));
+    endSection(file, section);
+
+    section = beginSection(file, climateSection);
+    writeValue(file, static_cast<uint32_t>(state.airHumidity));
+    writeValue(file, state.humidityFactor);
+    writeValue(file, state.rainStrength);
+    writeValue(file, static_cast<uint8_t>(state.isRaining));
+    endSection(file, section);
+
+    section = beginSection(file, achievementSection);
+    writeValue(file, static_cast<uint32_t>(state.achievementProperties.size()));
+    for (const auto & property : state.achievementProperties) {
+        writeString(file, property.first);
+        writeValue(file, property.second);
+    }
+    endSection(file, section);
+
+    for (const ParticleGroupState & group : state.particleGroups) {
+        section = beginSection(file, particleGroupSection);
+        writeParticleGroup(file, group);
+        endSection(file, section);
+    }
+
+    const bool written = file.good();
+    file.close();
+    if (!written) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // rename does not replace existing files on all platforms
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WorldFile::read(const std::string & path, WorldState & state)
+{
+    std::ifstream file(path, std::ios_base::binary | std::ios_base::in);
+    if (!file.good())
+        return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    if (!file.good() || !std::equal(magic, magic + sizeof(magic), fileMagic) || version != fileVersion) {
+        glow::warning("WorldFile: %; is not a world file of version %;", path, fileVersion);
+        return false;
+    }
+
+    state.particleGroups.clear();
+    state.achievementProperties.clear();
+
+    char tag[4];
+    uint64_t size = 0;
+    while (file.read(tag, sizeof(tag)) && file.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+        const std::streamoff sectionEnd = static_cast<std::streamoff>(file.tellg()) + static_cast<std::streamoff>(size);
+        SectionReader reader(file, size);
+        bool valid = true;
+
+        if (std::equal(tag, tag + 4, timeSection)) {
+            uint8_t running = 0;
+            valid = reader.read(state.dayTime) && reader.read(running);
+            state.timeRunning = running != 0;
+        }
+        else if (std::equal(tag, tag + 4, climateSection)) {
+            uint32_t airHumidity = 0;
+            uint8_t raining = 0;
+            valid = reader.read(airHumidity) && reader.read(state.humidityFactor) && reader.read(state.rainStrength) && reader.read(raining);
+            state.airHumidity = airHumidity;
+            state.isRaining = raining != 0;
+        }
+        else if (std::equal(tag, tag + 4, achievementSection)) {
+            uint32_t numProperties = 0;
+            valid = reader.read(numProperties);
+            for (uint32_t i = 0; valid && i < numProperties; ++i) {
+                std::string name;
+                float value = 0.0f;
+                valid = reader.readString(name) && reader.read(value);
+                state.achievementProperties[name] = value;
+            }
+        }
+        else if (std::equal(tag, tag + 4, particleGroupSection)) {
+            state.particleGroups.push_back(ParticleGroupState());
+            valid = readParticleGroup(reader, state.particleGroups.back());
+        }
+
+        if (!valid) {
+            glow::warning("WorldFile: %; is damaged", path);
+            return false;
+        }
+
+        // skips unknown sections and unread values of known sections
+        file.seekg(sectionEnd);
+    }
+
+    return file.eof();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "particles/particlegroup.h"
+#include "terrain/tilefile.h"
+
+/** @brief Copy of everything that is needed to continue a simulation, taken from the world between two simulation steps. */
+struct WorldState
+{
+    /** time of day in [0;1] */
+    double dayTime = 0.0;
+    bool timeRunning = false;
+
+    unsigned int airHumidity = 0;
+    float humidityFactor = 0.0f;
+    float rainStrength = 0.0f;
+    bool isRaining = false;
+
+    std::unordered_map<std::string, float> achievementProperties;
+    std::vector<ParticleGroupState> particleGroups;
+
+    /** only used for writing, the terrain is read from WorldFile::terrainPath() */
+    TerrainSnapshot terrain;
+};
+
+/** @brief Binary file of a WorldState: a header followed by tagged sections, each with its size, so that readers skip sections they don't know.
+  * The particles of each group are written as raw structure of arrays blocks. The terrain is written to a tile file next to the world file. */
+class WorldFile
+{
+public:
+    /** Write the terrain, then the world file. Both replace the old files when they are complete. Can be called on any thread. */
+    static bool write(const std::string & path, const WorldState & state);
+    /** Read everything but the terrain. */
+    static bool read(const std::string & path, WorldState & state);
+
+    /** tile file with the terrain of the world file at path */
+    static std::string terrainPath(const std::string & path);
+
+private:
+    WorldFile() = delete;
+};
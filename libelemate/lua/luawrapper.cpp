@@ -7,7 +7,21 @@
 #include "lua.hpp"
 
 
+namespace
+{
+    /** Push the global name for a registry slot. Undefined globals are stored as false, as nil would free the slot. */
+    void pushGlobalForRef(lua_State * state, const std::string & name)
+    {
+        lua_getglobal(state, name.c_str());
+        if (lua_isnil(state, -1)) {
+            lua_pop(state, 1);
+            lua_pushboolean(state, 0);
+        }
+    }
+}
+
 std::list<LuaWrapper *> LuaWrapper::s_instances;
+unsigned int LuaWrapper::s_reloadCount = 0;
 
 LuaWrapper::LuaWrapper()
 : m_state(luaL_newstate())
@@ -40,6 +54,7 @@ void LuaWrapper::loadScript(const std::string & script)
     m_err = luaL_dofile(m_state, script.c_str());
     luaError();
     m_scripts.push_back(script);
+    updateFunctionRefs();
 }
 
 void LuaWrapper::removeScript(const std::string & script)
@@ -61,12 +76,47 @@ void LuaWrapper::reloadScripts()
         m_err = luaL_dofile(m_state, script.c_str());
         luaError();
     }
+    updateFunctionRefs();
 }
 
 void LuaWrapper::reloadAll()
 {
     for (auto & instance : s_instances)
         instance->reloadScripts();
+    ++s_reloadCount;
+}
+
+unsigned int LuaWrapper::reloadCount()
+{
+    return s_reloadCount;
+}
+
+bool LuaWrapper::hasFunction(const std::string & func) const
+{
+    lua_getglobal(m_state, func.c_str());
+    const bool isFunction = lua_isfunction(m_state, -1);
+    lua_pop(m_state, 1);
+    return isFunction;
+}
+
+LuaWrapper::FunctionRef LuaWrapper::function(const std::string & func)
+{
+    auto it = m_functionRefs.find(func);
+    if (it != m_functionRefs.end())
+        return FunctionRef{ it->second };
+
+    pushGlobalForRef(m_state, func);
+    const int ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+    m_functionRefs.insert(std::make_pair(func, ref));
+    return FunctionRef{ ref };
+}
+
+void LuaWrapper::updateFunctionRefs()
+{
+    for (const auto & functionRef : m_functionRefs) {
+        pushGlobalForRef(m_state, functionRef.first);
+        lua_rawseti(m_state, LUA_REGISTRYINDEX, functionRef.second);
+    }
 }
 
 void LuaWrapper::pushFunc(const std::string & func) const
@@ -74,6 +124,11 @@ void LuaWrapper::pushFunc(const std::string & func) const
     lua_getglobal(m_state, func.c_str());
 }
 
+void LuaWrapper::pushFunc(const FunctionRef & func) const
+{
+    lua_rawgeti(m_state, LUA_REGISTRYINDEX, func.ref);
+}
+
 void LuaWrapper::callFunc(const int numArgs, const int numRet)
 {
     m_err = lua_pcall(m_state, numArgs, numRet, 0);
@@ -164,6 +219,26 @@ void LuaWrapper::push(const glm::vec3 & value) const
     }
 }
 
+void LuaWrapper::push(const std::vector<glm::vec3> & values) const
+{
+    lua_createtable(m_state, static_cast<int>(values.size()), 0);
+    int table = lua_gettop(m_state);
+    for (size_t i = 0; i < values.size(); ++i) {
+        push(values.at(i));
+        lua_rawseti(m_state, table, static_cast<int>(i + 1));
+    }
+}
+
+void LuaWrapper::push(const std::vector<uint32_t> & values) const
+{
+    lua_createtable(m_state, static_cast<int>(values.size()), 0);
+    int table = lua_gettop(m_state);
+    for (size_t i = 0; i < values.size(); ++i) {
+        push(values.at(i));
+        lua_rawseti(m_state, table, static_cast<int>(i + 1));
+    }
+}
+
 
 template<>
 std::string LuaWrapper::fetch<std::string>(const int index) const
@@ -10,6 +10,7 @@
 #include <glm/glm.hpp>
 
 #include "luawrapperfunction.h"
+#include "utils/profiler.h"
 
 
 struct lua_State;
@@ -30,6 +31,21 @@ public:
 
     /** Reload all current loaded Lua script within all LuaWrapper instances. */
     static void reloadAll();
+    /** Number of reloadAll calls, for caches of values computed by scripts. */
+    static unsigned int reloadCount();
+
+    /** @return whether the global func is a function */
+    bool hasFunction(const std::string & func) const;
+
+    /** @brief Handle of a global Lua function, stored in the Lua registry.
+      * Calls through a handle skip the lookup of the global by name. Loading or reloading scripts updates the handles. */
+    struct FunctionRef
+    {
+        int ref;
+    };
+
+    /** Get the handle of the global function func. It may be defined later by a script, calling it before logs a Lua error. */
+    FunctionRef function(const std::string & func);
 
 
 protected:
@@ -37,6 +53,10 @@ protected:
     void luaError();
     /** Pushes a function onto the lua stack. Encapsulaiton for lua_getglobal. */ 
     void pushFunc(const std::string & func) const;
+    /** Pushes the function of a handle onto the lua stack. Encapsulation for lua_rawgeti on the registry */
+    void pushFunc(const FunctionRef & func) const;
+    /** Stores the current value of each referenced global in its registry slot. */
+    void updateFunctionRefs();
     /** Calls a lua function in protected mode. Encapsulation for lua_pcall */ 
     void callFunc(const int numArgs, const int numRet);
 
@@ -66,6 +86,10 @@ protected:
     void push(const double value) const;
     void push(const bool value) const;
     void push(const glm::vec3 & value) const;
+    /** Pushes a table of vec3 tables, indexed from 1. */
+    void push(const std::vector<glm::vec3> & values) const;
+    /** Pushes a table of numbers, indexed from 1. */
+    void push(const std::vector<uint32_t> & values) const;
 
     /** Fetches a index return values from the lua stack. */
     template <typename T> T fetch(const int index) const;
@@ -129,6 +153,8 @@ public:
     template <typename... Ret, typename... Args>
     typename _pop<sizeof...(Ret), Ret...>::type call(const std::string &fun, const Args&... args)
     {
+        ELEMATE_PROFILE_ZONE("LuaWrapper::call");
+
         pushFunc(fun.c_str());
         push(args...);
 
@@ -140,37 +166,39 @@ public:
         return pop<Ret...>();
     }
 
-    /** Registers a function to the Lua environment. */ 
-    template <typename Return, typename... Args>
-    void Register(const std::string & name, std::function<Return(Args...)> function)
+    /** Calls a function of the current Lua environment through its handle. */ 
+    template <typename... Ret, typename... Args>
+    typename _pop<sizeof...(Ret), Ret...>::type call(const FunctionRef & fun, const Args&... args)
     {
-        auto tmp = std::unique_ptr<BaseLuaFunction>(new LuaFunction<1, Return, Args...>{m_state, name, function});
-        m_functions.insert(std::make_pair(name, std::move(tmp)));
-    }
+        ELEMATE_PROFILE_ZONE("LuaWrapper::call");
 
-    /** Registers a function to the Lua environment. */ 
-    template <typename Return, typename... Args>
-    void Register(const std::string & name, Return (*function)(Args...))
-    {
-        auto tmp = std::unique_ptr<BaseLuaFunction>(new LuaFunction<1, Return, Args...>{m_state, name, function});
-        m_functions.insert(std::make_pair(name, std::move(tmp)));
+        pushFunc(fun);
+        push(args...);
+
+        const int numArgs = sizeof...(Args);
+        const int numRet = sizeof...(Ret);
+
+        callFunc(numArgs, numRet);
+
+        return pop<Ret...>();
     }
 
-    /** Registers a function to the Lua environment. */ 
-    template <typename... Return, typename... Args>
-    void Register(const std::string & name, std::function<std::tuple<Return...>(Args...)> function)
+    /** Registers a function object (lambda or std::function) to the Lua environment.
+      * Lambdas are stored and called as they are, so pass them directly instead of wrapping them into a std::function. */ 
+    template <typename Function>
+    void Register(const std::string & name, Function function)
     {
-        const int num_return = sizeof...(Return);
-        auto tmp = std::unique_ptr<BaseLuaFunction>(new LuaFunction<num_return, std::tuple<Return...>, Args...>{m_state, name, function});
+        typedef typename Luaw::_lua_function<Function>::type LuaFunctionType;
+        auto tmp = std::unique_ptr<BaseLuaFunction>(new LuaFunctionType{m_state, name, function});
         m_functions.insert(std::make_pair(name, std::move(tmp)));
     }
 
     /** Registers a function to the Lua environment. */ 
-    template <typename... Return, typename... Args>
-    void Register(const std::string & name, std::tuple<Return...> (*function)(Args...))
+    template <typename Return, typename... Args>
+    void Register(const std::string & name, Return (*function)(Args...))
     {
-        const int num_return = sizeof...(Return);
-        auto tmp = std::unique_ptr<BaseLuaFunction>(new LuaFunction<num_return, std::tuple<Return...>, Args...>{m_state, name, function});
+        typedef LuaFunction<Luaw::_num_returns<Return>::value, Return (*)(Args...), Return, Args...> LuaFunctionType;
+        auto tmp = std::unique_ptr<BaseLuaFunction>(new LuaFunctionType{m_state, name, function});
         m_functions.insert(std::make_pair(name, std::move(tmp)));
     }
 
@@ -188,8 +216,11 @@ protected:
     int m_err;
 
     std::map<std::string, std::unique_ptr<BaseLuaFunction>> m_functions;
+    /** global name -> registry slot of the function handles */
+    std::map<std::string, int> m_functionRefs;
 
     static std::list<LuaWrapper *> s_instances;
+    static unsigned int s_reloadCount;
 
 
 public:
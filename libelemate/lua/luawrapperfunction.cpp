@@ -33,16 +33,15 @@ namespace Lua
     {
         lua_pushnil(state);
     }
-}
 
-namespace Luaw
-{
-    int _lua_dispatcher(lua_State * state)
+    void * upvalue(lua_State * state, int index)
     {
-        BaseLuaFunction * function = (BaseLuaFunction *) lua_touserdata(state, lua_upvalueindex(1));
-        return function->apply(state);
+        return lua_touserdata(state, lua_upvalueindex(index));
     }
+}
 
+namespace Luaw
+{
     template <>
     int _check_get<int>(lua_State * state, const int index) {
         return luaL_checkint(state, index);
@@ -146,7 +145,7 @@ namespace Luaw
 
     void _push(lua_State * state, glm::vec3 && value)
     {
-        lua_newtable(state);
+        lua_createtable(state, 0, 3);
         lua_pushnumber(state, value.x);
         lua_setfield(state, -2, "x");
         lua_pushnumber(state, value.y);
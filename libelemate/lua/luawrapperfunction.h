@@ -7,6 +7,7 @@
 #include <string>
 #include <tuple>
 #include <functional>
+#include <type_traits>
 
 #include <glm/glm.hpp>
 
@@ -16,7 +17,6 @@ struct lua_State;
 struct BaseLuaFunction
 {
     virtual ~BaseLuaFunction() {}
-    virtual int apply(lua_State * state) = 0;
 };
 
 namespace Lua
@@ -28,12 +28,12 @@ namespace Lua
     void pushcclosure(lua_State * state, lua_CFunction fn, int n);
     void setglobal(lua_State * state, const char * name);
     void pushnil(lua_State * state);
+    /** @return the light userdata in the upvalue index of the running C closure */
+    void * upvalue(lua_State * state, int index);
 }
 
 namespace Luaw
 {
-    int _lua_dispatcher(lua_State * state);
-
     template <std::size_t... Is>
     struct _indices {};
 
@@ -58,31 +58,6 @@ namespace Luaw
     void _push(lua_State * state, std::string &&value);
     void _push(lua_State * state, glm::vec3 &&value);
 
-    template <typename Return, typename... Args, std::size_t... N>
-    Return _lift(std::function<Return(Args...)> function, std::tuple<Args...> args, _indices<N...>)
-    {
-        return function(std::get<N>(args)...);
-    }
-
-    template <typename Return, typename... Args>
-    Return _lift(std::function<Return(Args...)> function, std::tuple<Args...> args)
-    {
-        return _lift(function, args, typename _indices_builder<sizeof...(Args)>::type());
-    }
-
-    template <typename... T, std::size_t... N>
-    std::tuple<T...> _get_args(lua_State * state, _indices<N...>)
-    {
-        return std::make_tuple(_check_get<T>(state, N+1)...);
-    }
-
-    template <typename... T>
-    std::tuple<T...> _get_args(lua_State * state)
-    {
-        const std::size_t num_args = sizeof...(T);
-        return _get_args<T...>(state, typename _indices_builder<num_args>::type());
-    }
-
     inline void _push_n(lua_State *) {}
 
     template <typename T, typename... Rest>
@@ -108,23 +83,23 @@ namespace Luaw
 }
 
 
-/** @brief Helper class that represents a cpp function that can be called within Lua. */
-template <int N, typename Return, typename... Args>
+/** @brief Helper class that represents a cpp function that can be called within Lua.
+  * Lua calls the static dispatch function of each instantiation directly, which reads the arguments from the stack
+  * and calls the stored function object without type erasure, if it is not a std::function itself. */
+template <int N, typename Function, typename Return, typename... Args>
 class LuaFunction : public BaseLuaFunction
 {
 protected:
-    std::function<Return(Args...)> m_function;
+    Function m_function;
     std::string m_name;
     lua_State ** m_state;
 
 public:
-    LuaFunction(lua_State * &state, const std::string & name, Return(*function)(Args...)) : LuaFunction(state, name, std::function<Return(Args...)>{function}) {}
-
-    LuaFunction(lua_State * &state, const std::string & name, std::function<Return(Args...)> function) : m_function(function), m_name(name), m_state(&state)
+    LuaFunction(lua_State * &state, const std::string & name, Function function) : m_function(function), m_name(name), m_state(&state)
     {
-        Lua::pushlightuserdata(state, (void *)static_cast<BaseLuaFunction *>(this));
+        Lua::pushlightuserdata(state, (void *)this);
 
-        Lua::pushcclosure(state, &Luaw::_lua_dispatcher, 1);
+        Lua::pushcclosure(state, &LuaFunction::dispatch, 1);
 
         Lua::setglobal(state, name.c_str());
     }
@@ -138,11 +113,17 @@ public:
         }
     }
 
-    int apply(lua_State * state)
+    static int dispatch(lua_State * state)
     {
-        std::tuple<Args...> args = Luaw::_get_args<Args...>(state);
-        Return value = Luaw::_lift(m_function, args);
-        Luaw::_push(state, std::forward<Return>(value));
+        LuaFunction * function = static_cast<LuaFunction *>(Lua::upvalue(state, 1));
+        return function->apply(state, typename Luaw::_indices_builder<sizeof...(Args)>::type());
+    }
+
+protected:
+    template <std::size_t... I>
+    int apply(lua_State * state, Luaw::_indices<I...>)
+    {
+        Luaw::_push(state, Return(m_function(Luaw::_check_get<typename std::decay<Args>::type>(state, I + 1)...)));
         return N;
     }
 
@@ -150,6 +131,38 @@ public:
     void operator=(LuaFunction &) = delete;
 };
 
+namespace Luaw
+{
+    /** number of values a function returning T pushes onto the lua stack */
+    template <typename T>
+    struct _num_returns
+    {
+        static const int value = 1;
+    };
+
+    template <typename... T>
+    struct _num_returns<std::tuple<T...>>
+    {
+        static const int value = sizeof...(T);
+    };
+
+    /** LuaFunction type for a function object, deduced from its call operator */
+    template <typename Function, typename Signature = decltype(&Function::operator())>
+    struct _lua_function;
+
+    template <typename Function, typename Class, typename Return, typename... Args>
+    struct _lua_function<Function, Return (Class::*)(Args...) const>
+    {
+        typedef LuaFunction<_num_returns<Return>::value, Function, Return, Args...> type;
+    };
+
+    template <typename Function, typename Class, typename Return, typename... Args>
+    struct _lua_function<Function, Return (Class::*)(Args...)>
+    {
+        typedef LuaFunction<_num_returns<Return>::value, Function, Return, Args...> type;
+    };
+}
+
 #if defined(MSVC)
 #pragma warning (default : 4100)
 #endif
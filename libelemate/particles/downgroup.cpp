@@ -78,16 +78,10 @@ void DownGroup::updateVisuals()
 {
     ParticleGroup::updateVisuals();
 
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
-
-    m_particleDrawable->updateParticles(readData);
+    m_particleDrawable->updateParticles(*m_snapshot);
 
     // Get drained Particles
     std::vector<uint32_t> particlesToDelete;
-    PxStrideIterator<const PxParticleFlags> flagsIt(readData->flagsBuffer);
-    PxStrideIterator<const PxVec3> positionIt = readData->positionBuffer;
-
 
     TerrainInteraction terrain("water");
     std::vector<unsigned int> lavaToSteam;
@@ -96,41 +90,43 @@ void DownGroup::updateVisuals()
 
     const TerrainSettings & terrainSettings = terrain.terrain().settings;
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++flagsIt, ++positionIt) {
+    ++s_numSnapshotQueries;
+    for (uint32_t i = 0; i < m_snapshot->size(); ++i) {
         // check range
-        if (!(*flagsIt & PxParticleFlag::eVALID)) {
+        if (!m_snapshot->isValid(i)) {
             continue;
         }
 
-        if (positionIt->y > terrainSettings.maxHeight * 0.75f) {
-            particlesToDelete.push_back(i);
+        const PxParticleFlags flags(m_snapshot->flags[i]);
+        const glm::vec3 position = m_snapshot->position(i);
+        const uint32_t particleIndex = m_snapshot->indices[i];
+
+        if (position.y > terrainSettings.maxHeight * 0.75f) {
+            particlesToDelete.push_back(particleIndex);
             continue;
         }
 
-        if (*flagsIt & PxParticleFlag::eCOLLISION_WITH_STATIC) {
-            if (positionIt->y < m_particleSize + 0.1)   // collision with water plane
+        if (flags & PxParticleFlag::eCOLLISION_WITH_STATIC) {
+            if (position.y < m_particleSize + 0.1)   // collision with water plane
             {
                 if (m_elementName == "lava")
                 {
-                    lavaToSteam.push_back(i);
-                    steamBbox.extend(reinterpret_cast<const glm::vec3&>(*positionIt));
-                    steamPositions.push_back(reinterpret_cast<const glm::vec3&>(*positionIt));
+                    lavaToSteam.push_back(particleIndex);
+                    steamBbox.extend(position);
+                    steamPositions.push_back(position);
                     continue;
                 } else {
-                    particlesToDelete.push_back(i);
+                    particlesToDelete.push_back(particleIndex);
                     continue;
                 }
             }
-            if (terrain.topmostElementAt(positionIt->x, positionIt->z) == m_elementName)
+            if (terrain.topmostElementAt(position.x, position.z) == m_elementName)
             {
-                particlesToDelete.push_back(i);
+                particlesToDelete.push_back(particleIndex);
             }
         }
     }
 
-    assert(m_numParticles == readData->nbValidParticles);
-    readData->unlock();
-
     if (!particlesToDelete.empty())
         releaseParticles(particlesToDelete);
 
@@ -57,6 +57,28 @@ void EmitterGroup::stopEmit()
     m_timeSinceLastEmit = 0.0;
 }
 
+void EmitterGroup::saveState(ParticleGroupState & state) const
+{
+    ParticleGroup::saveState(state);
+
+    state.emitting = m_emitting;
+    state.emitRatio = m_emitRatio;
+    state.emitPosition = m_emitPosition;
+    state.emitDirection = m_emitDirection;
+    state.timeSinceLastEmit = m_timeSinceLastEmit;
+}
+
+void EmitterGroup::restoreState(const ParticleGroupState & state)
+{
+    ParticleGroup::restoreState(state);
+
+    m_emitting = state.emitting;
+    m_emitRatio = state.emitRatio;
+    m_emitPosition = state.emitPosition;
+    m_emitDirection = state.emitDirection;
+    m_timeSinceLastEmit = state.timeSinceLastEmit;
+}
+
 void EmitterGroup::updatePhysics(double delta)
 {
     ParticleGroup::updatePhysics(delta);
@@ -70,8 +92,12 @@ void EmitterGroup::updatePhysics(double delta)
 
     if (particlesToEmit > 0)
     {
+        m_emitPositions.assign(particlesToEmit, m_emitPosition);
+        m_emitVelocities.clear();
         for (unsigned int i = 0; i < particlesToEmit; ++i)
-            createParticle(m_emitPosition, glm::vec3((m_emitDirection.x + scatterFactor()), (m_emitDirection.y + scatterFactor()), (m_emitDirection.z + scatterFactor())) * 100.f);
+            m_emitVelocities.push_back(glm::vec3((m_emitDirection.x + scatterFactor()), (m_emitDirection.y + scatterFactor()), (m_emitDirection.z + scatterFactor())) * 100.f);
+
+        createParticles(m_emitPositions, &m_emitVelocities);
 
         m_timeSinceLastEmit = 0.0;
     }
@@ -91,44 +117,34 @@ void EmitterGroup::updateVisuals()
 {
     ParticleGroup::updateVisuals();
 
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
-
-    m_particleDrawable->updateParticles(readData);
+    m_particleDrawable->updateParticles(*m_snapshot);
 
     m_particlesToDelete.clear();
     m_downPositions.clear();
     m_downVelocities.clear();
 
     // Get drained Particles
-    PxStrideIterator<const PxParticleFlags> flagsIt(readData->flagsBuffer);
-    PxStrideIterator<const PxVec3> positionIt = readData->positionBuffer;
-    PxStrideIterator<const PxVec3> pxVelocityIt = readData->velocityBuffer;
-    
-    TerrainInteraction terrain("water");
-
     glowutils::AxisAlignedBoundingBox downBox;
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++flagsIt, ++positionIt, ++pxVelocityIt) {
-        if (*flagsIt & PxParticleFlag::eCOLLISION_WITH_STATIC) {
-            const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*positionIt.ptr());
-            const glm::vec3 & vel = reinterpret_cast<const glm::vec3&>(*pxVelocityIt.ptr());
+    ++s_numSnapshotQueries;
+    for (uint32_t i = 0; i < m_snapshot->size(); ++i) {
+        if (!m_snapshot->isValid(i))
+            continue;
+        if (PxParticleFlags(m_snapshot->flags[i]) & PxParticleFlag::eCOLLISION_WITH_STATIC) {
+            const glm::vec3 pos = m_snapshot->position(i);
             m_downPositions.push_back(pos);
-            m_downVelocities.push_back(vel);
-            m_particlesToDelete.push_back(i);
+            m_downVelocities.push_back(m_snapshot->velocity(i));
+            m_particlesToDelete.push_back(m_snapshot->indices[i]);
 
             downBox.extend(pos);
         }
     }
-    
-    assert(m_numParticles == readData->nbValidParticles);
-    readData->unlock();
 
     if (!m_particlesToDelete.empty()) {
         releaseParticles(m_particlesToDelete);
 
         DownGroup * group = ParticleGroupTycoon::instance().getNearestGroup(m_elementName, downBox.center());
         group->createParticles(m_downPositions, &m_downVelocities);
-        group->setTemperature((m_numParticles * m_temperature + group->numParticles() * group->temperature()) / (m_numParticles + group->numParticles()));
+        group->setTemperature((numParticles() * m_temperature + group->numParticles() * group->temperature()) / (numParticles() + group->numParticles()));
     }
 }
@@ -20,6 +20,9 @@ public:
     /** Stops particle emitting. */
     void stopEmit();
 
+    virtual void saveState(ParticleGroupState & state) const override;
+    virtual void restoreState(const ParticleGroupState & state) override;
+
     /** Update physics of contained particles. */
     virtual void updatePhysics(double delta) override;
 
@@ -29,6 +32,9 @@ public:
 protected:
     std::vector<glm::vec3> m_downPositions;
     std::vector<glm::vec3> m_downVelocities;
+    /** particles emitted in one update, created at once */
+    std::vector<glm::vec3> m_emitPositions;
+    std::vector<glm::vec3> m_emitVelocities;
 
     float m_emitRatio;
     glm::vec3 m_emitPosition;
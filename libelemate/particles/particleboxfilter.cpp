@@ -0,0 +1,169 @@
+#include "particleboxfilter.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include <glowutils/AxisAlignedBoundingBox.h>
+
+#if defined(__AVX__)
+#define BOXFILTER_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOXFILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+inline uint32_t lowestSetBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+/** The points are tested for the box already, only check the mask and collect them. */
+struct Collector
+{
+    const float * x;
+    const float * y;
+    const float * z;
+    const uint16_t * validMask;
+    std::vector<uint32_t> & insideIndices;
+    glm::vec3 llf;
+    glm::vec3 urb;
+
+    void append(uint32_t i)
+    {
+        if (validMask && validMask[i] == 0)
+            return;
+        insideIndices.push_back(i);
+        const glm::vec3 point(x[i], y[i], z[i]);
+        llf = glm::min(llf, point);
+        urb = glm::max(urb, point);
+    }
+
+    /** test the points [begin, end) one by one */
+    void scalarRange(uint32_t begin, uint32_t end, const glm::vec3 & boxLlf, const glm::vec3 & boxUrb)
+    {
+        for (uint32_t i = begin; i < end; ++i) {
+            if (x[i] >= boxLlf.x && x[i] <= boxUrb.x
+                && y[i] >= boxLlf.y && y[i] <= boxUrb.y
+                && z[i] >= boxLlf.z && z[i] <= boxUrb.z)
+                append(i);
+        }
+    }
+
+    /** append all points with a set bit in the mask, the lowest bit refers to index base */
+    void appendMask(uint32_t base, uint32_t mask)
+    {
+        while (mask) {
+            append(base + lowestSetBit(mask));
+            mask &= mask - 1;
+        }
+    }
+};
+
+/** make sure that all points fit into the output without reallocation, but keep the geometric growth for appending calls */
+void reserveFor(std::vector<uint32_t> & insideIndices, uint32_t count)
+{
+    const size_t required = insideIndices.size() + count;
+    if (insideIndices.capacity() < required)
+        insideIndices.reserve(std::max(required, 2 * insideIndices.capacity()));
+}
+
+uint32_t finish(const Collector & collector, size_t sizeBefore, glowutils::AxisAlignedBoundingBox & subbox)
+{
+    const size_t found = collector.insideIndices.size() - sizeBefore;
+    if (found > 0) {
+        subbox.extend(collector.llf);
+        subbox.extend(collector.urb);
+    }
+    return static_cast<uint32_t>(found);
+}
+
+}
+
+uint32_t filterPointsInBoxScalar(const float * x, const float * y, const float * z, const uint16_t * validMask, uint32_t count,
+    const glowutils::AxisAlignedBoundingBox & box, std::vector<uint32_t> & insideIndices, glowutils::AxisAlignedBoundingBox & subbox)
+{
+    const size_t sizeBefore = insideIndices.size();
+    reserveFor(insideIndices, count);
+
+    Collector collector{ x, y, z, validMask, insideIndices, glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()) };
+    collector.scalarRange(0, count, box.llf(), box.urb());
+
+    return finish(collector, sizeBefore, subbox);
+}
+
+uint32_t filterPointsInBox(const float * x, const float * y, const float * z, const uint16_t * validMask, uint32_t count,
+    const glowutils::AxisAlignedBoundingBox & box, std::vector<uint32_t> & insideIndices, glowutils::AxisAlignedBoundingBox & subbox)
+{
+#if defined(BOXFILTER_AVX) || defined(BOXFILTER_SSE2)
+    const size_t sizeBefore = insideIndices.size();
+    reserveFor(insideIndices, count);
+
+    const glm::vec3 & boxLlf = box.llf();
+    const glm::vec3 & boxUrb = box.urb();
+
+    Collector collector{ x, y, z, validMask, insideIndices, glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()) };
+
+    uint32_t i = 0;
+
+#if defined(BOXFILTER_AVX)
+    const __m256 llfX = _mm256_set1_ps(boxLlf.x);
+    const __m256 llfY = _mm256_set1_ps(boxLlf.y);
+    const __m256 llfZ = _mm256_set1_ps(boxLlf.z);
+    const __m256 urbX = _mm256_set1_ps(boxUrb.x);
+    const __m256 urbY = _mm256_set1_ps(boxUrb.y);
+    const __m256 urbZ = _mm256_set1_ps(boxUrb.z);
+
+    for (; i + 8 <= count; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i);
+        const __m256 py = _mm256_loadu_ps(y + i);
+        const __m256 pz = _mm256_loadu_ps(z + i);
+
+        __m256 inside = _mm256_and_ps(_mm256_cmp_ps(px, llfX, _CMP_GE_OQ), _mm256_cmp_ps(px, urbX, _CMP_LE_OQ));
+        inside = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(py, llfY, _CMP_GE_OQ), _mm256_cmp_ps(py, urbY, _CMP_LE_OQ)));
+        inside = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(pz, llfZ, _CMP_GE_OQ), _mm256_cmp_ps(pz, urbZ, _CMP_LE_OQ)));
+
+        collector.appendMask(i, static_cast<uint32_t>(_mm256_movemask_ps(inside)));
+    }
+#else
+    const __m128 llfX = _mm_set1_ps(boxLlf.x);
+    const __m128 llfY = _mm_set1_ps(boxLlf.y);
+    const __m128 llfZ = _mm_set1_ps(boxLlf.z);
+    const __m128 urbX = _mm_set1_ps(boxUrb.x);
+    const __m128 urbY = _mm_set1_ps(boxUrb.y);
+    const __m128 urbZ = _mm_set1_ps(boxUrb.z);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+
+        __m128 inside = _mm_and_ps(_mm_cmpge_ps(px, llfX), _mm_cmple_ps(px, urbX));
+        inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(py, llfY), _mm_cmple_ps(py, urbY)));
+        inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(pz, llfZ), _mm_cmple_ps(pz, urbZ)));
+
+        collector.appendMask(i, static_cast<uint32_t>(_mm_movemask_ps(inside)));
+    }
+#endif
+
+    collector.scalarRange(i, count, boxLlf, boxUrb);
+
+    return finish(collector, sizeBefore, subbox);
+#else
+    return filterPointsInBoxScalar(x, y, z, validMask, count, box, insideIndices, subbox);
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace glowutils { class AxisAlignedBoundingBox; }
+
+/** Append the indices of all points inside of the box (borders included) to insideIndices and extend subbox by these points.
+  * The points are given as structure of arrays. Points with a zero entry in validMask are skipped, validMask may be nullptr.
+  * Uses AVX or SSE2 if the compiler targets them, and a scalar loop otherwise.
+  * @return the number of appended indices */
+uint32_t filterPointsInBox(const float * x, const float * y, const float * z, const uint16_t * validMask, uint32_t count,
+    const glowutils::AxisAlignedBoundingBox & box, std::vector<uint32_t> & insideIndices, glowutils::AxisAlignedBoundingBox & subbox);
+
+/** Scalar reference implementation of filterPointsInBox. */
+uint32_t filterPointsInBoxScalar(const float * x, const float * y, const float * z, const uint16_t * validMask, uint32_t count,
+    const glowutils::AxisAlignedBoundingBox & box, std::vector<uint32_t> & insideIndices, glowutils::AxisAlignedBoundingBox & subbox);
@@ -1,14 +1,14 @@
 #include "particlecollision.h"
 
 #include <algorithm>
+#include <cassert>
 
 #include <glow/logging.h>
 
 #include "particlegrouptycoon.h"
 #include "particlescriptaccess.h"
 #include "downgroup.h"
-#include "particlehelper.h"
-#include "lua/luawrapper.h"
+#include "utils/profiler.h"
 #include "terrain/terraininteraction.h"
 
 #include "ui/achievementmanager.h"
@@ -18,22 +18,6 @@ std::list<ParticleCollision::IntersectionBox> ParticleCollision::debug_intersect
 using namespace glowutils;
 using namespace glm;
 
-namespace {
-
-void extractPointsInside(const std::vector<vec3> & points, const AxisAlignedBoundingBox & box,
-    std::vector<vec3> & extractedPoints, AxisAlignedBoundingBox & extractedBox)
-{
-    for (const vec3 & point : points) {
-        if (!box.inside(point))
-            continue;
-
-        extractedBox.extend(point);
-        extractedPoints.push_back(point);
-    }
-}
-
-}
-
 ParticleCollision::ParticleCollision()
 : m_lua(new LuaWrapper())
 , m_terrainInteraction(new TerrainInteraction("bedrock"))
@@ -44,6 +28,8 @@ ParticleCollision::ParticleCollision()
     m_terrainInteraction->registerLuaFunctions(*m_lua);
 
     registerLuaFunctions();
+
+    m_collisionBatch = m_lua->function("collisionBatch");
 }
 
 ParticleCollision::~ParticleCollision()
@@ -54,85 +40,89 @@ ParticleCollision::~ParticleCollision()
 
 void ParticleCollision::registerLuaFunctions()
 {
-    std::function<int(int, int, glm::vec3, glm::vec3)> func0 = [=](int leftGroup, int rightGroup, glm::vec3 intersectLlf, glm::vec3 intersectUrb)
-    { checkCollidedParticles(leftGroup, rightGroup, glowutils::AxisAlignedBoundingBox(intersectLlf, intersectUrb)); return 0; };
-    std::function<unsigned int()> func1 = std::bind(&ParticleCollision::forgetOldParticles, this);
-    std::function<unsigned int(int, glm::vec3, glm::vec3)> func2 = [=](int groupId, glm::vec3 collisionLlf, glm::vec3 collisionUrb)
+    auto func1 = [=]()
+    { return forgetOldParticles(); };
+    auto func2 = [=](int groupId, const glm::vec3 & collisionLlf, const glm::vec3 & collisionUrb)
     { return releaseRemeberParticles(groupId, AxisAlignedBoundingBox(collisionLlf, collisionUrb)); };
-    std::function<unsigned int(int, glm::vec3, glm::vec3)> func3 = [=](int groupId, glm::vec3 collisionLlf, glm::vec3 collisionUrb)
+    auto func3 = [=](int groupId, const glm::vec3 & collisionLlf, const glm::vec3 & collisionUrb)
     { return releaseForgetParticles(groupId, AxisAlignedBoundingBox(collisionLlf, collisionUrb)); };
-    std::function<unsigned int(std::string)> func4 = std::bind(&ParticleCollision::createFromRemembered, this, std::placeholders::_1);
-    
-    m_lua->Register("pc_checkCollidedParticles", func0);
+    auto func4 = [=](const std::string & elementName)
+    { return createFromRemembered(elementName); };
+    auto func5 = [=](int groupId, const glm::vec3 & collisionLlf, const glm::vec3 & collisionUrb)
+    { return queueRelease(groupId, AxisAlignedBoundingBox(collisionLlf, collisionUrb), false); };
+    auto func6 = [=](int groupId, const glm::vec3 & collisionLlf, const glm::vec3 & collisionUrb)
+    { return queueRelease(groupId, AxisAlignedBoundingBox(collisionLlf, collisionUrb), true); };
+    auto func7 = [=]()
+    { return applyQueuedReleases(); };
+    auto func8 = [=](unsigned int handle)
+    { return releasedCount(handle); };
+
     m_lua->Register("pc_forgetOldParticles", func1);
     m_lua->Register("pc_releaseRememberParticles", func2);
     m_lua->Register("pc_releaseForgetParticles", func3);
     m_lua->Register("pc_createFromRemembered", func4);
+    m_lua->Register("pc_queueReleaseForget", func5);
+    m_lua->Register("pc_queueReleaseRemember", func6);
+    m_lua->Register("pc_applyReleases", func7);
+    m_lua->Register("pc_releasedCount", func8);
 }
 
 void ParticleCollision::performCheck()
 {
+    ELEMATE_PROFILE_ZONE("ParticleCollision::performCheck");
+
     const auto & particleGroups = ParticleGroupTycoon::instance().particleGroups();
 
-    for (auto pair = particleGroups.cbegin(); pair != particleGroups.cend(); ++pair) {
-        if (!pair->second->isDown)
+    for (const auto & pair : particleGroups) {
+        if (!pair.second->isDown)
             continue;
 
-        const vec3 & center = pair->second->boundingBox().center();
-        m_lua->call("temperatureCheck", pair->first, pair->second->elementName(), center, pair->second->numParticles());
+        const ParticleSnapshot & snapshot = pair.second->snapshot();
+        float temperature = pair.second->temperature();
+        m_terrainInteraction->exchangeHeat(snapshot.positionX.data(), snapshot.positionZ.data(), snapshot.flags.data(), snapshot.size(), temperature);
+        pair.second->setTemperature(temperature);
     }
 
-    if (particleGroups.size() < 2)
-        return;
-
-    auto lastLeftHand = particleGroups.cend();
-    auto lastRightHand = particleGroups.cend();
-
-    glowutils::AxisAlignedBoundingBox intersectVolume;
+    // rehash the particles, this only touches cells that groups entered or left since the last check
+    m_spatialHash.removeStaleGroups(particleGroups);
+    for (const auto & pair : particleGroups) {
+        if (pair.second->numParticles() == 0)
+            m_spatialHash.removeGroup(pair.first);
+        else
+            m_spatialHash.updateGroup(pair.first, *pair.second);
+    }
 
     debug_intersectionBoxes.clear();
 
-    for (auto leftHand = particleGroups.cbegin(); leftHand != lastLeftHand; ++leftHand) {
-        auto rightHand = leftHand;
-        ++rightHand;
-        for (; rightHand != lastRightHand; ++rightHand) {
-            // first: check if the bounding boxes intersect (it's fast, as we already have the boxes)
-            if (!checkBoundingBoxCollision(leftHand->second->boundingBox(), rightHand->second->boundingBox(), &intersectVolume))
-                continue; // not interested if the groups don't intersect
-
-            // now let the script decide what to do next
-            m_lua->call("boundingBoxCollision", leftHand->first, rightHand->first, intersectVolume.llf(), intersectVolume.urb());
-        }
+    m_contacts.clear();
+    m_spatialHash.findContacts(m_contacts);
+
+    std::sort(m_contacts.begin(), m_contacts.end(), [](const ParticleSpatialHash::Contact & lhs, const ParticleSpatialHash::Contact & rhs) {
+        if (lhs.leftGroup != rhs.leftGroup)
+            return lhs.leftGroup < rhs.leftGroup;
+        return lhs.rightGroup < rhs.rightGroup;
+    });
+
+    // the contact cells of all group pairs, the boxes of a pair stay consecutive
+    m_batchBoxes.clear();
+    m_batchGroups.clear();
+    for (const ParticleSpatialHash::Contact & contact : m_contacts) {
+        const AxisAlignedBoundingBox bounds = m_spatialHash.contactBounds(contact);
+        m_batchBoxes.push_back(bounds.llf());
+        m_batchBoxes.push_back(bounds.urb());
+        m_batchGroups.push_back(contact.leftGroup);
+        m_batchGroups.push_back(contact.rightGroup);
+
+        debug_intersectionBoxes.push_back({ bounds.llf(), bounds.urb() });
     }
-}
-
-void ParticleCollision::checkCollidedParticles(int leftGroup, int rightGroup, const glowutils::AxisAlignedBoundingBox & intersectVolume)
-{
-    std::vector<vec3> leftParticleSubset;      // the subset of particles that is inside of the intersection box
-    std::vector<vec3> rightParticleSubset;
-    AxisAlignedBoundingBox leftSubbox;   // the bounding box of these particles
-    AxisAlignedBoundingBox rightSubbox;
-    std::vector<vec3> leftMinimalParticleSubset;   // particles in the intersection box that are also inside the bounding box of the interacting group
-    std::vector<vec3> rightMinimalParticleSubset;  // this are the particles we will touch while reacting/interacting
-    AxisAlignedBoundingBox leftMinimalSubbox;   // the bounding box of these particles
-    AxisAlignedBoundingBox rightMinimalSubbox;
-
-    AxisAlignedBoundingBox commonSubbox;
-
-    // get some more information out of the bounding boxes: this requires iteration over the particles groups
-    ParticleGroupTycoon::instance().particleGroupById(leftGroup)->particlesInVolume(intersectVolume, leftParticleSubset, leftSubbox);
-    if (leftParticleSubset.empty())
-        return;   // particles of one box flow into the other, where the other doesn't have particles
-    ParticleGroupTycoon::instance().particleGroupById(rightGroup)->particlesInVolume(intersectVolume, rightParticleSubset, rightSubbox);
-    if (rightParticleSubset.empty())
-        return;
+    m_contacts.clear();
 
-    // do the next steps with particles we really need to look at
-    if (!extractCommonPositionBox(leftParticleSubset, rightParticleSubset, leftSubbox, rightSubbox, leftMinimalParticleSubset, rightMinimalParticleSubset, commonSubbox))
+    if (m_batchBoxes.empty())
         return;
 
-    // now do the more complex work: tree based collision check, to detect collisions at multiple independent positions
-    treeCheck(commonSubbox, leftMinimalParticleSubset, rightMinimalParticleSubset, 20);
+    // one script call per check, the script queues the releases of all boxes and applies them at once
+    m_queuedReleases.clear();
+    m_lua->call(m_collisionBatch, m_batchBoxes, m_batchGroups);
 }
 
 bool ParticleCollision::checkBoundingBoxCollision(const AxisAlignedBoundingBox & box1, const AxisAlignedBoundingBox & box2, AxisAlignedBoundingBox * intersectVolume)
@@ -167,116 +157,12 @@ bool ParticleCollision::checkBoundingBoxCollision(const AxisAlignedBoundingBox &
     return true;
 }
 
-bool ParticleCollision::extractCommonPositionBox(const std::vector<vec3> & leftHandPositions, const std::vector<vec3> & rightHandPositions,
-    const AxisAlignedBoundingBox & leftBBox, const AxisAlignedBoundingBox & rightBBox,
-    std::vector<vec3> & leftHandExtracted, std::vector<vec3> & rightHandExtracted,
-    glowutils::AxisAlignedBoundingBox & commonBBox)
+void ParticleCollision::clearParticleGroups()
 {
-    // not interested at all if the boxes don't collide
-    if (!checkBoundingBoxCollision(leftBBox, rightBBox))
-        return false;
-
-    AxisAlignedBoundingBox leftSubbox;
-    AxisAlignedBoundingBox rightSubbox;
-
-    // get the points of one group that are inside the bounding box of the other group
-
-    extractPointsInside(leftHandPositions, rightBBox, leftHandExtracted, leftSubbox);
-    if (leftHandExtracted.empty())
-        return false;
-
-    extractPointsInside(rightHandPositions, leftBBox, rightHandExtracted, rightSubbox);
-    if (rightHandExtracted.empty())
-        return false;
-
-    // get the bounding box containing these minimal position subsets
-    commonBBox.extend(glm::min(leftSubbox.llf(), rightSubbox.llf()));
-    commonBBox.extend(glm::max(leftSubbox.urb(), rightSubbox.urb()));
-
-    return true;
-}
-
-void ParticleCollision::treeCheck(const AxisAlignedBoundingBox & volume, const std::vector<vec3> & leftHandPositions, const std::vector<vec3> & rightHandPositions, int depth)
-{
-    // recursion end
-
-    if (leftHandPositions.empty() || rightHandPositions.empty()) {
-        // nothing to do here, having only particles of one kind (or none)
-        return;
-    }
-
-    //!!! AxisAlignedBoundingBox center and radius don't do what we want here.. they seem.. wrong
-
-
-    vec3 dimensions = volume.urb() - volume.llf();
-
-    float maxLength = std::max(dimensions.x, std::max(dimensions.y, dimensions.z));
-
-    if (maxLength < 0.3f || depth <= 0) {   // magic number: minimal size of the box for tree based check
-        // call the script to handle this particle collision
-        m_lua->call("particleCollision", volume.llf(), volume.urb());
-
-        debug_intersectionBoxes.push_back({ volume.llf(), volume.urb() });
-
-        return;
-    }
-
-    // still particles in the current box, and box is too large -> recursive split
-
-    float splitValue = 0;
-    int splitAxis = longestAxis(volume, splitValue);
-
-    // split the left hand and right hand particle lists into two special groups
-    // group 1 for the smaller coordinates, group 2 for the greater ones
-    std::vector<vec3> group1LeftHand;
-    std::vector<vec3> group1RightHand;
-    std::vector<vec3> group2LeftHand;
-    std::vector<vec3> group2RightHand;
-
-    AxisAlignedBoundingBox bboxGroup1Left;
-    AxisAlignedBoundingBox bboxGroup1Right;
-    AxisAlignedBoundingBox bboxGroup2Left;
-    AxisAlignedBoundingBox bboxGroup2Right;
-
-    // spacial splitting of the particles along the splitting plane
-    for (int i = 0; i < leftHandPositions.size(); ++i) {
-        const vec3 & position = leftHandPositions.at(i);
-        if (position[splitAxis] < splitValue) {
-            group1LeftHand.push_back(position);
-            bboxGroup1Left.extend(position);
-        }
-        else {
-            group2LeftHand.push_back(position);
-            bboxGroup2Left.extend(position);
-        }
-    }
-    for (int i = 0; i < rightHandPositions.size(); ++i) {
-        const vec3 & position = rightHandPositions.at(i);
-        if (position[splitAxis] < splitValue) {
-            group1RightHand.push_back(position);
-            bboxGroup1Right.extend(position);
-        }
-        else {
-            group2RightHand.push_back(position);
-            bboxGroup2Right.extend(position);
-        }
-    }
-
-    std::vector<vec3> leftExtracted, rightExtracted;
-    AxisAlignedBoundingBox commonBoundingBox;
-    std::pair<int, int> a(1, 0), b(1, 0);
-    // for each created splitting subset: extract the particles that may interact with the other group
-    if (extractCommonPositionBox(group1LeftHand, group1RightHand, bboxGroup1Left, bboxGroup1Right, leftExtracted, rightExtracted, commonBoundingBox)) {
-        // and if so, try continuing with another spacial splitting
-        treeCheck(commonBoundingBox, leftExtracted, rightExtracted, depth - 1);
-    }
-    // same for the second splitting subset, reuse the container and bounding box objects
-    leftExtracted.clear();
-    rightExtracted.clear();
-    commonBoundingBox = AxisAlignedBoundingBox();
-    if (extractCommonPositionBox(group2LeftHand, group2RightHand, bboxGroup2Left, bboxGroup2Right, leftExtracted, rightExtracted, commonBoundingBox)) {
-        treeCheck(commonBoundingBox, leftExtracted, rightExtracted, depth - 1);
-    }
+    m_spatialHash.clear();
+    m_contacts.clear();
+    m_queuedReleases.clear();
+    forgetOldParticles();
 }
 
 unsigned int ParticleCollision::forgetOldParticles()
@@ -309,3 +195,93 @@ unsigned int ParticleCollision::createFromRemembered(const std::string & element
     group->createParticles(m_remeberedParticles);
     return static_cast<unsigned int>(m_remeberedParticles.size());
 }
+
+unsigned int ParticleCollision::queueRelease(int groupId, const AxisAlignedBoundingBox & volume, bool remember)
+{
+    m_queuedReleases.push_back({ static_cast<unsigned int>(groupId), volume, remember, 0u });
+    return static_cast<unsigned int>(m_queuedReleases.size());
+}
+
+unsigned int ParticleCollision::applyQueuedReleases()
+{
+    // process the queue group by group, keeping the queue order stable for the handles
+    std::vector<size_t> order(m_queuedReleases.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order.at(i) = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs) {
+        return m_queuedReleases.at(lhs).groupId < m_queuedReleases.at(rhs).groupId;
+    });
+
+    // cell -> queued volumes intersecting this cell, so each particle is only tested against nearby volumes
+    std::unordered_map<uint64_t, std::vector<size_t>> volumesByCell;
+    std::vector<uint64_t> volumeCells;
+    std::vector<uint32_t> releaseIndices;
+    unsigned int numReleased = 0;
+
+    const auto & particleGroups = ParticleGroupTycoon::instance().particleGroups();
+
+    size_t runBegin = 0;
+    while (runBegin < order.size()) {
+        const unsigned int groupId = m_queuedReleases.at(order.at(runBegin)).groupId;
+
+        volumesByCell.clear();
+        size_t runEnd = runBegin;
+        for (; runEnd < order.size() && m_queuedReleases.at(order.at(runEnd)).groupId == groupId; ++runEnd) {
+            volumeCells.clear();
+            m_spatialHash.cellsInVolume(m_queuedReleases.at(order.at(runEnd)).volume, volumeCells);
+            for (uint64_t cell : volumeCells)
+                volumesByCell[cell].push_back(order.at(runEnd));
+        }
+
+        // the script may have queued a group that doesn't exist (anymore), its releases count zero particles
+        auto groupIt = particleGroups.find(groupId);
+        if (groupIt == particleGroups.end()) {
+            glow::warning("ParticleCollision::applyQueuedReleases: skipping the releases of the unknown particle group %;", groupId);
+            runBegin = runEnd;
+            continue;
+        }
+        ParticleGroup * group = groupIt->second;
+
+        releaseIndices.clear();
+
+        const ParticleSnapshot & snapshot = group->snapshot();
+        for (uint32_t i = 0; i < snapshot.size(); ++i) {
+            if (!snapshot.isValid(i))
+                continue;
+            const vec3 pos = snapshot.position(i);
+
+            auto candidates = volumesByCell.find(m_spatialHash.cellAt(pos));
+            if (candidates == volumesByCell.end())
+                continue;
+
+            for (size_t queueIndex : candidates->second) {
+                QueuedRelease & release = m_queuedReleases.at(queueIndex);
+                if (!release.volume.inside(pos))
+                    continue;
+                ++release.numReleased;
+                if (release.remember) {
+                    m_remeberedParticles.push_back(pos);
+                    m_rememberedBounds.extend(pos);
+                }
+                releaseIndices.push_back(snapshot.indices[i]);
+                break;
+            }
+        }
+
+        group->releaseParticles(releaseIndices);
+        numReleased += static_cast<unsigned int>(releaseIndices.size());
+
+        runBegin = runEnd;
+    }
+
+    return numReleased;
+}
+
+unsigned int ParticleCollision::releasedCount(unsigned int handle) const
+{
+    if (handle == 0 || handle > m_queuedReleases.size()) {
+        glow::warning("ParticleCollision::releasedCount: invalid handle %;", handle);
+        return 0;
+    }
+    return m_queuedReleases[handle - 1].numReleased;
+}
@@ -10,8 +10,10 @@
 
 #include <glowutils/AxisAlignedBoundingBox.h>
 
+#include "particlespatialhash.h"
+#include "lua/luawrapper.h"
+
 class ParticleGroup;
-class LuaWrapper;
 class TerrainInteraction;
 
 class ParticleCollision
@@ -20,19 +22,23 @@ public:
     ParticleCollision();
     ~ParticleCollision();
 
-    /** check collision between the particle group bounding boxes and call the scripts for further steps */
+    /** update the spatial hash, find cells shared by particles of different elements and pass them to the script in one collisionBatch call */
     void performCheck();
 
     /** @return whether the input axis aligned bounding boxes intersect
       * @param intersectVolume will be set to the intersection volume, if the boxes intersect and the parameter is not set to nullptr */
     static bool checkBoundingBoxCollision(const glowutils::AxisAlignedBoundingBox & box1, const glowutils::AxisAlignedBoundingBox & box2, glowutils::AxisAlignedBoundingBox * intersectVolume = nullptr);
 
+    /** Forget the hashed particles and the pending releases of all groups, call this when the groups are replaced. */
     void clearParticleGroups();
 
 protected:
     LuaWrapper * m_lua;
     TerrainInteraction * m_terrainInteraction;
 
+    /** handle of the script function called once per check */
+    LuaWrapper::FunctionRef m_collisionBatch;
+
     /** Register my functions that can be called from lua.
       * If a relevant collision occurs, this class will call elementReaction() in lua. Lua functions called on this class
       * have effect in the context of the currently processed collision, that's why the registered functions shouldn't be
@@ -45,8 +51,15 @@ protected:
     };
 
 
-    void checkCollidedParticles(int leftGroup, int rightGroup, const glowutils::AxisAlignedBoundingBox & intersectVolume);
-    void treeCheck(const glowutils::AxisAlignedBoundingBox & volume, const std::vector<glm::vec3> & leftHandPositions, const std::vector<glm::vec3> & rightHandPositions, int depth);
+    /** all particles, hashed into a uniform grid per element */
+    ParticleSpatialHash m_spatialHash;
+    /** contact cells of the current check, sorted by group pair */
+    std::vector<ParticleSpatialHash::Contact> m_contacts;
+
+    /** llf and urb of each box of the current batch, reused between checks */
+    std::vector<glm::vec3> m_batchBoxes;
+    /** left and right group of each box of the current batch */
+    std::vector<uint32_t> m_batchGroups;
     /** this list contains particles released by the script, but which i will remember to create new particles at the same positions, if requested. */
     std::vector<glm::vec3> m_remeberedParticles;
     glowutils::AxisAlignedBoundingBox m_rememberedBounds;
@@ -55,12 +68,22 @@ protected:
     unsigned int releaseForgetParticles(int groupId, const glowutils::AxisAlignedBoundingBox & volume);
     unsigned int createFromRemembered(const std::string & elementName);
 
-    /** reduce the point sets to positions that are inside the bounding box of the comparing set
-      * @return true, if there are particles in a common sub box, false otherwise */
-    static bool extractCommonPositionBox(const std::vector<glm::vec3> & leftHandPositions, const std::vector<glm::vec3> & rightHandPositions,
-        const glowutils::AxisAlignedBoundingBox & leftBBox, const glowutils::AxisAlignedBoundingBox & rightBBox,
-        std::vector<glm::vec3> & leftHandExtracted, std::vector<glm::vec3> & rightHandExtracted,
-        glowutils::AxisAlignedBoundingBox & commonBBox);
+    /** Releases requested by the script for all boxes of a batch. They are applied with a single pass over each group. */
+    struct QueuedRelease {
+        unsigned int groupId;
+        glowutils::AxisAlignedBoundingBox volume;
+        bool remember;
+        unsigned int numReleased;
+    };
+    std::vector<QueuedRelease> m_queuedReleases;
+    /** @return a handle for releasedCount() */
+    unsigned int queueRelease(int groupId, const glowutils::AxisAlignedBoundingBox & volume, bool remember);
+    /** Release the particles of all queued volumes, remembering the positions where requested.
+      * A particle inside of multiple volumes is only counted for the first one.
+      * @return the number of released particles */
+    unsigned int applyQueuedReleases();
+    /** @return the number of particles released for the queued volume with this handle, valid until the next batch. 0 for invalid handles. */
+    unsigned int releasedCount(unsigned int handle) const;
 
     /** for graphical debugging: the current list of intersection volumes **/
     static std::list<IntersectionBox> debug_intersectionBoxes;
@@ -1,9 +1,9 @@
 #include "particlegroup.h"
 
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <type_traits>
-#include <fstream>
 
 #include <glow/logging.h>
 
@@ -11,12 +11,16 @@
 #include <PxScene.h>
 #include <PxSceneLock.h>
 
+#include "particlesystempool.h"
 #include "rendering/particledrawable.h"
 #include "io/soundmanager.h"
 #include "world.h"
 
 using namespace physx;
 
+uint64_t ParticleGroup::s_numSnapshotUpdates = 0;
+uint64_t ParticleGroup::s_numSnapshotQueries = 0;
+
 ParticleGroup::ParticleGroup(
     const std::string & elementName,
     const unsigned int id,
@@ -32,13 +36,12 @@ ParticleGroup::ParticleGroup(
 , m_elementName(elementName)
 , m_temperature(0.0f)
 , isDown(isDown)
-, m_particleDrawable(std::make_shared<ParticleDrawable>(elementName, maxParticleCount, isDown))
+, m_particleDrawable(nullptr)
 , m_maxParticleCount(maxParticleCount)
-, m_numParticles(0)
-, m_indices(new PxU32[maxParticleCount]())
-, m_nextFreeIndex(0)
-, m_lastFreeIndex(maxParticleCount-1)
+, m_indexAllocator(maxParticleCount)
 , m_gpuParticles(enableGpuParticles)
+, m_snapshot(std::make_shared<ParticleSnapshot>(maxParticleCount))
+, m_snapshotOutdated(false)
 {
     static_assert(sizeof(glm::vec3) == sizeof(physx::PxVec3), "size of physx vec3 does not match the size of glm::vec3.");
 
@@ -52,12 +55,12 @@ ParticleGroup::~ParticleGroup()
         SoundManager::instance()->deleteChannel(m_soundChannel);
     }
 
-    PxSceneWriteLock scopedLock(* m_scene);
+    ParticleSystemPool::Entry poolEntry;
+    poolEntry.particleSystem = m_particleSystem;
+    poolEntry.drawable = m_particleDrawable;
+    ParticleSystemPool::instance().giveBack(m_maxParticleCount, m_gpuParticles, poolEntry);
 
-    m_particleSystem->releaseParticles();
-    m_scene->removeActor(*m_particleSystem);
     m_particleSystem = nullptr;
-    delete m_indices;
 }
 
 ParticleGroup::ParticleGroup(const ParticleGroup & lhs, unsigned int id)
@@ -67,47 +70,64 @@ ParticleGroup::ParticleGroup(const ParticleGroup & lhs, unsigned int id)
 , m_elementName(lhs.m_elementName)
 , m_temperature(lhs.m_temperature)
 , isDown(true)
-, m_particleDrawable(std::make_shared<ParticleDrawable>(lhs.m_elementName, lhs.m_maxParticleCount, isDown))
+, m_particleDrawable(nullptr)
 , m_maxParticleCount(lhs.m_maxParticleCount)
-, m_numParticles(0)
-, m_indices(new PxU32[lhs.m_maxParticleCount]())
-, m_nextFreeIndex(0)
-, m_lastFreeIndex(lhs.m_maxParticleCount - 1)
+, m_indexAllocator(lhs.m_maxParticleCount)
 , m_gpuParticles(lhs.m_gpuParticles)
+, m_snapshot(std::make_shared<ParticleSnapshot>(lhs.m_maxParticleCount))
+, m_snapshotOutdated(false)
 {
     initialize(lhs.m_immutableProperties, lhs.m_mutableProperties);
 }
 
 void ParticleGroup::initialize(const ImmutableParticleProperties & immutableProperties, const MutableParticleProperties & mutableProperties)
 {
-    std::string soundFileName = "data/sounds/elements/" + m_elementName + ".wav";
-    std::ifstream soundFile(soundFileName);
-    m_hasSound = soundFile.good();
-    if (m_hasSound) {
-        m_soundChannel = SoundManager::instance()->createNewChannel(soundFileName, true, true, true);
-        SoundManager::instance()->setVolume(m_soundChannel, 0.15f);
-    }
-
-    for (PxU32 i = 0; i < m_maxParticleCount; ++i) m_indices[i] = i;
+    initializeSound();
 
     assert(PxGetPhysics().getNbScenes() == 1);
     PxScene * pxScenePtrs[1];
     PxGetPhysics().getScenes(pxScenePtrs, 1);
     m_scene = pxScenePtrs[0];
 
-    PxSceneWriteLock scopedLock(*m_scene);
-
-    m_particleSystem = PxGetPhysics().createParticleFluid(m_maxParticleCount, false);
-    assert(m_particleSystem);
-    m_particleSystem->setParticleBaseFlag(physx::PxParticleBaseFlag::eGPU, m_gpuParticles);
-    m_particleSystem->setParticleReadDataFlag(PxParticleReadDataFlag::eVELOCITY_BUFFER, true);
-
-    m_scene->addActor(*m_particleSystem);
+    const ParticleSystemPool::Entry poolEntry = ParticleSystemPool::instance().acquire(m_maxParticleCount, m_gpuParticles, m_elementName, isDown);
+    m_particleSystem = poolEntry.particleSystem;
+    m_particleDrawable = poolEntry.drawable;
 
     setImmutableProperties(immutableProperties);
     setMutableProperties(mutableProperties);
 }
 
+void ParticleGroup::initializeSound()
+{
+    const std::string & soundFileName = ParticleSystemPool::instance().soundFileName(m_elementName);
+    m_hasSound = !soundFileName.empty();
+    if (m_hasSound) {
+        m_soundChannel = SoundManager::instance()->createNewChannel(soundFileName, true, true, true);
+        SoundManager::instance()->setVolume(m_soundChannel, 0.15f);
+    }
+}
+
+void ParticleGroup::releaseAllParticles()
+{
+    stopSound();
+
+    {
+        PxSceneWriteLock scopedLock(*m_scene);
+        m_particleSystem->releaseParticles();
+    }
+
+    m_indexAllocator.clear();
+
+    clearSnapshot();
+    m_snapshotOutdated = false;
+    m_particleDrawable->clear();
+}
+
+uint32_t ParticleGroup::maxParticleCount() const
+{
+    return m_maxParticleCount;
+}
+
 const std::string & ParticleGroup::elementName() const
 {
     return m_elementName;
@@ -115,7 +135,7 @@ const std::string & ParticleGroup::elementName() const
 
 uint32_t ParticleGroup::numParticles() const
 {
-    return m_numParticles;
+    return m_indexAllocator.numUsed();
 }
 
 const glowutils::AxisAlignedBoundingBox & ParticleGroup::boundingBox() const
@@ -150,77 +170,173 @@ physx::PxParticleFluid * ParticleGroup::particleSystem()
     return m_particleSystem;
 }
 
-void ParticleGroup::createParticles(const std::vector<glm::vec3> & pos, const std::vector<glm::vec3> * vel)
+void ParticleGroup::updateSnapshot()
 {
-    if (m_elementName == "steam") {
-        World::instance()->changeAirHumidity(static_cast<int>(pos.size()));
+    static_assert(sizeof(PxParticleFlags) == sizeof(uint16_t), "size of physx particle flags does not match the snapshot flags.");
+
+    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
+    assert(readData);
+    ++s_numSnapshotUpdates;
+    m_snapshotOutdated = false;
+
+    // keep the snapshot and its revision if no particle changed, e.g. when all particles are at rest
+    bool changed = false;
+    uint32_t slot = 0;
+    {
+        PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
+        PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
+        PxStrideIterator<const PxVec3> pxVelocityIt = readData->velocityBuffer;
+
+        for (unsigned i = 0; i < readData->validParticleRange && !changed; ++i, ++pxPositionIt, ++pxFlagIt, ++pxVelocityIt) {
+            if (!(*pxFlagIt & PxParticleFlag::eVALID))
+                continue;
+            const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
+            const glm::vec3 & vel = reinterpret_cast<const glm::vec3&>(*pxVelocityIt.ptr());
+            changed = slot >= m_snapshot->size() || !m_snapshot->equals(slot, i, pos, vel, static_cast<uint16_t>(*pxFlagIt));
+            ++slot;
+        }
+    }
+
+    if (!changed && slot == m_snapshot->size()) {
+        readData->unlock();
+        return;
     }
 
-    PxU32 numParticles = static_cast<PxU32>(pos.size());
-    PxU32 * indices = new PxU32[numParticles];
+    clearSnapshot();
+
+    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
+    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
+    PxStrideIterator<const PxVec3> pxVelocityIt = readData->velocityBuffer;
+
+    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt, ++pxVelocityIt) {
+        assert(pxPositionIt.ptr());
+        if (!(*pxFlagIt & PxParticleFlag::eVALID))
+            continue;
+        const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
+        const glm::vec3 & vel = reinterpret_cast<const glm::vec3&>(*pxVelocityIt.ptr());
+        m_snapshot->append(i, pos, vel, static_cast<uint16_t>(*pxFlagIt));
+    }
+
+    readData->unlock();
+}
+
+void ParticleGroup::refreshSnapshot()
+{
+    if (m_snapshotOutdated)
+        updateSnapshot();
+}
+
+const ParticleSnapshot & ParticleGroup::snapshot() const
+{
+    return *m_snapshot;
+}
+
+ParticleSnapshot & ParticleGroup::editSnapshot()
+{
+    if (snapshotShared())
+        m_snapshot = std::make_shared<ParticleSnapshot>(*m_snapshot);
+    return *m_snapshot;
+}
+
+void ParticleGroup::clearSnapshot()
+{
+    if (snapshotShared())
+        m_snapshot = std::make_shared<ParticleSnapshot>(m_maxParticleCount);
+    else
+        m_snapshot->clear();
+}
+
+bool ParticleGroup::snapshotShared() const
+{
+    if (m_snapshot.use_count() > 1)
+        return true;
+    // the last saved state may have been written and released on another thread, its reads happen before our writes
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return false;
+}
+
+uint64_t ParticleGroup::numSnapshotUpdates()
+{
+    return s_numSnapshotUpdates;
+}
+
+uint64_t ParticleGroup::numSnapshotQueries()
+{
+    return s_numSnapshotQueries;
+}
+
+void ParticleGroup::createParticles(const std::vector<glm::vec3> & pos, const std::vector<glm::vec3> * vel)
+{
     if (vel) {
-        assert(vel->size() == numParticles);
+        assert(vel->size() == pos.size());
     }
 
-    glowutils::AxisAlignedBoundingBox & bbox = m_particleDrawable->m_bbox;
-    for (PxU32 i = 0; i < numParticles; ++i)
-    {
-        bbox.extend(pos.at(i));
-        if (m_freeIndices.size() > 0)
-        {
-            indices[i] = m_freeIndices.back();
-            m_freeIndices.pop_back();
-        } else {
-            indices[i] = m_nextFreeIndex;
-            if (m_nextFreeIndex == m_lastFreeIndex) releaseOldParticles(numParticles);
-            if (++m_nextFreeIndex == m_maxParticleCount) m_nextFreeIndex = 0;
-        }
+    createParticles(pos.data(), vel ? vel->data() : nullptr, static_cast<uint32_t>(pos.size()));
+}
+
+void ParticleGroup::createParticles(const glm::vec3 * pos, const glm::vec3 * vel, uint32_t numParticles)
+{
+    if (numParticles == 0)
+        return;
+
+    if (numParticles > m_maxParticleCount) {
+        glow::warning("ParticleGroup::createParticles: cannot create %; particles in a group with a maximum of %;", numParticles, m_maxParticleCount);
+        numParticles = m_maxParticleCount;
     }
 
+    if (m_elementName == "steam") {
+        World::instance()->changeAirHumidity(static_cast<int>(numParticles));
+    }
+
+    // make room for the new particles by releasing the oldest ones
+    if (m_indexAllocator.numFree() < numParticles)
+        releaseOldParticles(numParticles - m_indexAllocator.numFree());
+
+    m_createIndices.clear();
+    m_indexAllocator.acquire(numParticles, m_createIndices);
+    assert(m_createIndices.size() == numParticles);
+
+    glowutils::AxisAlignedBoundingBox & bbox = m_particleDrawable->m_bbox;
+    for (uint32_t i = 0; i < numParticles; ++i)
+        bbox.extend(pos[i]);
+
     PxParticleCreationData particleCreationData;
     particleCreationData.numParticles = numParticles;
-    particleCreationData.indexBuffer = PxStrideIterator<const PxU32>(indices);
-    particleCreationData.positionBuffer = PxStrideIterator<const PxVec3>(reinterpret_cast<const PxVec3*>(pos.data()));
+    particleCreationData.indexBuffer = PxStrideIterator<const PxU32>(m_createIndices.data());
+    particleCreationData.positionBuffer = PxStrideIterator<const PxVec3>(reinterpret_cast<const PxVec3*>(pos));
     if (vel)
-        particleCreationData.velocityBuffer = PxStrideIterator<const PxVec3>(reinterpret_cast<const PxVec3*>(vel->data()), 0);
+        particleCreationData.velocityBuffer = PxStrideIterator<const PxVec3>(reinterpret_cast<const PxVec3*>(vel));
 
     bool success = m_particleSystem->createParticles(particleCreationData);
-    m_numParticles += numParticles;
+    m_snapshotOutdated = true;
 
     if (!success)
         glow::warning("ParticleGroup::createParticles creation of %; physx particles failed", numParticles);
-
-    delete[] indices;
 }
 
 void ParticleGroup::releaseOldParticles(const uint32_t numParticles)
 {
-    std::vector<uint32_t> indices;
-    for (uint32_t i = 0; i < numParticles; ++i)
-    {
-        if (++m_lastFreeIndex == m_maxParticleCount)
-            m_lastFreeIndex = 0;
-        indices.push_back(m_lastFreeIndex);
-    }
-    PxStrideIterator<const PxU32> indexBuffer(indices.data());
+    m_evictIndices.clear();
+    m_indexAllocator.releaseOldest(numParticles, m_evictIndices);
+
+    ParticleSnapshot & snapshot = editSnapshot();
+    for (uint32_t index : m_evictIndices)
+        snapshot.release(index);
 
-    m_particleSystem->releaseParticles(numParticles, indexBuffer);
-    m_numParticles -= numParticles;
+    PxStrideIterator<const PxU32> indexBuffer(m_evictIndices.data());
+    m_particleSystem->releaseParticles(static_cast<PxU32>(m_evictIndices.size()), indexBuffer);
 }
 
 void ParticleGroup::releaseParticles(const std::vector<uint32_t> & indices)
 {
-    PxU32 numParticles = static_cast<PxU32>(indices.size());
+    ParticleSnapshot & snapshot = editSnapshot();
+    for (uint32_t index : indices)
+        snapshot.release(index);
 
-    for (PxU32 i = 0; i < numParticles; ++i)
-    {
-        m_freeIndices.push_back(indices.at(i));
-    }
+    m_indexAllocator.release(indices);
 
     PxStrideIterator<const PxU32> indexBuffer(indices.data());
-
-    m_particleSystem->releaseParticles(numParticles, indexBuffer);
-    m_numParticles -= numParticles;
+    m_particleSystem->releaseParticles(static_cast<PxU32>(indices.size()), indexBuffer);
 }
 
 uint32_t ParticleGroup::releaseParticles(const glowutils::AxisAlignedBoundingBox & boundingBox)
@@ -239,33 +355,22 @@ void ParticleGroup::releaseParticlesGetPositions(const glowutils::AxisAlignedBou
 {
     std::vector<uint32_t> releaseIndices;
 
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
-
-    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
-    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
+    ++s_numSnapshotQueries;
+    m_queriedSlots.clear();
+    m_snapshot->particlesInBox(boundingBox, m_queriedSlots, releasedBounds);
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt) {
-        assert(pxPositionIt.ptr());
-        if (!(*pxFlagIt & PxParticleFlag::eVALID))
-            continue;
-        const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
-        if (!boundingBox.inside(pos))
-            continue;
-        releasedPositions.push_back(pos);
-        releaseIndices.push_back(i);
-        releasedBounds.extend(pos);
+    releaseIndices.reserve(m_queriedSlots.size());
+    for (uint32_t slot : m_queriedSlots) {
+        releasedPositions.push_back(m_snapshot->position(slot));
+        releaseIndices.push_back(m_snapshot->indices[slot]);
     }
 
-    readData->unlock();
-
     releaseParticles(releaseIndices);
 }
 
 void ParticleGroup::createParticle(const glm::vec3 & position, const glm::vec3 & velocity)
 {
-    std::vector<glm::vec3> vel({ velocity });
-    createParticles({ position }, &vel);
+    createParticles(&position, &velocity, 1);
 }
 
 void ParticleGroup::setImmutableProperties(const ImmutableParticleProperties & properties)
@@ -291,6 +396,18 @@ void ParticleGroup::setImmutableProperties(const physx::PxReal maxMotionDistance
 
     PxSceneWriteLock scopedLock(* m_scene);
 
+    // particle systems from the pool often have these properties already, spare removing and re-adding them to the scene
+    if (m_particleSystem->getMaxMotionDistance() == maxMotionDistance
+        && m_particleSystem->getGridSize() == gridSize
+        && m_particleSystem->getRestOffset() == restOffset
+        && m_particleSystem->getContactOffset() == contactOffset
+        && m_particleSystem->getRestParticleDistance() == restParticleDistance)
+    {
+        m_particleSize = restParticleDistance;
+        m_particleDrawable->setParticleSize(restParticleDistance);
+        return;
+    }
+
     m_scene->removeActor(*m_particleSystem);
 
     m_particleSystem->setMaxMotionDistance(maxMotionDistance);
@@ -347,7 +464,7 @@ bool ParticleGroup::useGpuParticles() const
 
 void ParticleGroup::updatePhysics(double /*delta*/)
 {
-    if (m_numParticles == 0) {
+    if (numParticles() == 0) {
         stopSound();
     }
     else {
@@ -357,107 +474,115 @@ void ParticleGroup::updatePhysics(double /*delta*/)
 
 void ParticleGroup::updateVisuals()
 {
-    if (m_hasSound && m_numParticles > 0)
+    if (m_hasSound && numParticles() > 0)
         SoundManager::instance()->setSoundPosition(m_soundChannel, m_particleDrawable->boundingBox().center());
 }
 
-void ParticleGroup::moveParticlesTo(ParticleGroup & other)
+void ParticleGroup::saveState(ParticleGroupState & state) const
+{
+    state.id = m_id;
+    state.isEmitter = !isDown;
+    state.elementName = m_elementName;
+    state.maxParticleCount = m_maxParticleCount;
+    state.temperature = m_temperature;
+    state.immutableProperties = m_immutableProperties;
+    state.mutableProperties = m_mutableProperties;
+
+    // the valid particles are picked when writing the state, which may run on another thread
+    state.snapshot = m_snapshot;
+}
+
+void ParticleGroup::restoreState(const ParticleGroupState & state)
 {
+    assert(state.elementName == m_elementName && state.maxParticleCount == m_maxParticleCount);
+    assert(state.positionX.size() == state.velocityZ.size());
+
+    releaseAllParticles();
+
+    m_temperature = state.temperature;
+    setImmutableProperties(state.immutableProperties);
+    setMutableProperties(state.mutableProperties);
+
     std::vector<glm::vec3> positions;
     std::vector<glm::vec3> velocities;
+    if (state.snapshot) {
+        // a saved state that was not written
+        for (uint32_t i = 0; i < state.snapshot->size(); ++i) {
+            if (!state.snapshot->isValid(i))
+                continue;
+            positions.push_back(state.snapshot->position(i));
+            velocities.push_back(state.snapshot->velocity(i));
+        }
+    }
+    positions.reserve(positions.size() + state.positionX.size());
+    velocities.reserve(velocities.size() + state.positionX.size());
+    for (size_t i = 0; i < state.positionX.size(); ++i) {
+        positions.push_back(glm::vec3(state.positionX[i], state.positionY[i], state.positionZ[i]));
+        velocities.push_back(glm::vec3(state.velocityX[i], state.velocityY[i], state.velocityZ[i]));
+    }
+    createParticles(positions, &velocities);
+}
 
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
+void ParticleGroup::moveParticlesTo(ParticleGroup & other)
+{
+    refreshSnapshot();
 
-    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
-    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
-    PxStrideIterator<const PxVec3> pxVelocityIt = readData->velocityBuffer;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt, ++pxVelocityIt) {
-        assert(pxPositionIt.ptr());
-        if (!(*pxFlagIt & PxParticleFlag::eVALID))
+    positions.reserve(m_snapshot->size());
+    velocities.reserve(m_snapshot->size());
+
+    ++s_numSnapshotQueries;
+    for (uint32_t i = 0; i < m_snapshot->size(); ++i) {
+        if (!m_snapshot->isValid(i))
             continue;
-        const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
-        const glm::vec3 & vel = reinterpret_cast<const glm::vec3&>(*pxVelocityIt.ptr());
-        positions.push_back(pos);
-        velocities.push_back(vel);
+        positions.push_back(m_snapshot->position(i));
+        velocities.push_back(m_snapshot->velocity(i));
     }
 
-    readData->unlock();
-
     other.createParticles(positions, &velocities);
     
-    other.setTemperature((m_temperature * m_numParticles + other.m_temperature * other.m_numParticles) / (m_numParticles + other.m_numParticles));
+    other.setTemperature((m_temperature * numParticles() + other.m_temperature * other.numParticles()) / (numParticles() + other.numParticles()));
 }
 
 void ParticleGroup::particlesInVolume(const glowutils::AxisAlignedBoundingBox & boundingBox, std::vector<glm::vec3> & particles, glowutils::AxisAlignedBoundingBox & subbox) const
 {
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
-
-    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
-    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
-
     subbox = glowutils::AxisAlignedBoundingBox();
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt) {
-        assert(pxPositionIt.ptr());
-        if (!(*pxFlagIt & PxParticleFlag::eVALID))
-            continue;
-        const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
-        if (!boundingBox.inside(pos))
-            continue;
-        particles.push_back(pos);
-        subbox.extend(pos);
-    }
+    ++s_numSnapshotQueries;
+    m_queriedSlots.clear();
+    m_snapshot->particlesInBox(boundingBox, m_queriedSlots, subbox);
 
-    readData->unlock();
+    for (uint32_t slot : m_queriedSlots)
+        particles.push_back(m_snapshot->position(slot));
 }
 
 void ParticleGroup::particleIndicesInVolume(const glowutils::AxisAlignedBoundingBox & boundingBox, std::vector<uint32_t> & particleIndices) const
 {
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
+    glowutils::AxisAlignedBoundingBox subbox;
 
-    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
-    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
-
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt) {
-        assert(pxPositionIt.ptr());
-        if (!(*pxFlagIt & PxParticleFlag::eVALID))
-            continue;
-        const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
-        if (!boundingBox.inside(pos))
-            continue;
-        particleIndices.push_back(i);
-    }
+    ++s_numSnapshotQueries;
+    m_queriedSlots.clear();
+    m_snapshot->particlesInBox(boundingBox, m_queriedSlots, subbox);
 
-    readData->unlock();
+    for (uint32_t slot : m_queriedSlots)
+        particleIndices.push_back(m_snapshot->indices[slot]);
 }
 
 void ParticleGroup::particlePositionsIndicesVelocitiesInVolume(const glowutils::AxisAlignedBoundingBox & boundingBox, std::vector<glm::vec3> & positions, std::vector<uint32_t> & particleIndices, std::vector<glm::vec3> & velocities) const
 {
-    PxParticleReadData * readData = m_particleSystem->lockParticleReadData();
-    assert(readData);
+    glowutils::AxisAlignedBoundingBox subbox;
 
-    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
-    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
-    PxStrideIterator<const PxVec3> pxVelocityIt = readData->velocityBuffer;
+    ++s_numSnapshotQueries;
+    m_queriedSlots.clear();
+    m_snapshot->particlesInBox(boundingBox, m_queriedSlots, subbox);
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt, ++pxVelocityIt) {
-        assert(pxPositionIt.ptr());
-        if (!(*pxFlagIt & PxParticleFlag::eVALID))
-            continue;
-        const glm::vec3 & pos = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
-        if (!boundingBox.inside(pos))
-            continue;
-        const glm::vec3 & vel = reinterpret_cast<const glm::vec3&>(*pxVelocityIt.ptr());
-        positions.push_back(pos);
-        particleIndices.push_back(i);
-        velocities.push_back(vel);
+    for (uint32_t slot : m_queriedSlots) {
+        positions.push_back(m_snapshot->position(slot));
+        particleIndices.push_back(m_snapshot->indices[slot]);
+        velocities.push_back(m_snapshot->velocity(slot));
     }
-
-    readData->unlock();
 }
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "utils/pxcompilerfix.h"
@@ -8,6 +9,9 @@
 
 #include <glm/glm.hpp>
 
+#include "particleindexallocator.h"
+#include "particlesnapshot.h"
+
 namespace physx {
     class PxParticleFluid;
     class PxScene;
@@ -39,6 +43,35 @@ struct MutableParticleProperties
     physx::PxReal stiffness = 8.134f;
 };
 
+/** @brief State of a particle group, to save and load the world. The particles are stored as structure of arrays.
+  * When saving, the group only shares its snapshot, the particles are taken from it when the state is written. */
+struct ParticleGroupState
+{
+    unsigned int id = 0;
+    bool isEmitter = false;
+    std::string elementName;
+    uint32_t maxParticleCount = 0;
+    float temperature = 0.0f;
+    ImmutableParticleProperties immutableProperties;
+    MutableParticleProperties mutableProperties;
+
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+    /** snapshot of the group when saving, instead of the arrays */
+    std::shared_ptr<const ParticleSnapshot> snapshot;
+
+    /** emitter groups only */
+    bool emitting = false;
+    float emitRatio = 0.0f;
+    glm::vec3 emitPosition;
+    glm::vec3 emitDirection;
+    double timeSinceLastEmit = 0.0;
+};
+
 /** @brief Baseclass that contains a variable number of particles with the same physical properties. */
 class ParticleGroup
 {
@@ -57,6 +90,11 @@ public:
     /** copy all attributes of the particle group (but not the particles) */
     ParticleGroup(const ParticleGroup & lhs, unsigned int id);
 
+    /** Release all particles at once and reset the index bookkeeping. */
+    void releaseAllParticles();
+
+    uint32_t maxParticleCount() const;
+
     const std::string & elementName() const;
     uint32_t numParticles() const;
     
@@ -71,6 +109,18 @@ public:
 
     physx::PxParticleFluid * particleSystem();
 
+    /** Copy the valid particles out of the PhysX read data. Call this once after each simulation step. */
+    void updateSnapshot();
+    /** Update the snapshot only if particles were created since the last update. Call this before reading all particles of the group from the snapshot. */
+    void refreshSnapshot();
+    /** Particles as of the last snapshot update. Particles released since then are marked invalid, created particles are not contained. */
+    const ParticleSnapshot & snapshot() const;
+
+    /** number of snapshot updates, which are the only remaining PhysX read data locks */
+    static uint64_t numSnapshotUpdates();
+    /** number of particle queries served from a snapshot, each of these saved a PhysX read data lock and scan */
+    static uint64_t numSnapshotQueries();
+
     /** If specifying velocities, make sure that its size matches the positions size */
     void createParticles(const std::vector<glm::vec3> & positions, const std::vector<glm::vec3> * velocities = nullptr);
     /** Create a single particle at given position with given velocity. */
@@ -122,6 +172,12 @@ public:
     void setUseGpuParticles(const bool enable);
     bool useGpuParticles() const;
 
+    /** Copy the attributes and share the snapshot, call refreshSnapshot() before to include recently created particles.
+      * The group continues with a new snapshot on its next change, the shared one stays as it is. */
+    virtual void saveState(ParticleGroupState & state) const;
+    /** Replace the attributes and all particles by the state, which must have the same element and maximum particle count. */
+    virtual void restoreState(const ParticleGroupState & state);
+
     /** Transfers all particles to other ParticleGroup. */
     void moveParticlesTo(ParticleGroup & other);
 
@@ -132,11 +188,21 @@ public:
 private:
     /** initialization done in constructor and copy constructor of this particle group base class */
     void initialize(const ImmutableParticleProperties & immutableProperties, const MutableParticleProperties & mutableProperties);
+    /** create the sound channel, if there is a sound file for the element */
+    void initializeSound();
 
 protected:
+    void createParticles(const glm::vec3 * positions, const glm::vec3 * velocities, uint32_t numParticles);
+    /** release the numParticles particles that were created first */
     void releaseOldParticles(const uint32_t numParticles);
+    /** @return the snapshot for writing, copied first if a saved state still uses it */
+    ParticleSnapshot & editSnapshot();
+    /** empty the snapshot, or start a new one if a saved state still uses it */
+    void clearSnapshot();
+    /** @return whether a saved state still uses the snapshot */
+    bool snapshotShared() const;
 
-    const unsigned int m_id;
+    unsigned int m_id;
 
     ImmutableParticleProperties m_immutableProperties;
     MutableParticleProperties m_mutableProperties;
@@ -151,11 +217,10 @@ protected:
     std::shared_ptr<ParticleDrawable> m_particleDrawable;
 
     const uint32_t m_maxParticleCount;
-    uint32_t m_numParticles;
-    physx::PxU32 * m_indices;
-    std::vector<physx::PxU32> m_freeIndices;
-    uint32_t m_nextFreeIndex;
-    uint32_t m_lastFreeIndex;
+    ParticleIndexAllocator m_indexAllocator;
+    /** scratch buffers, reused between calls */
+    std::vector<uint32_t> m_createIndices;
+    std::vector<uint32_t> m_evictIndices;
 
     bool m_gpuParticles;
 
@@ -163,6 +228,15 @@ protected:
     unsigned int m_soundChannel;
     std::vector<uint32_t> m_particlesToDelete;
 
+    /** never null, shared with saved states */
+    std::shared_ptr<ParticleSnapshot> m_snapshot;
+    /** particles were created since the last snapshot update */
+    bool m_snapshotOutdated;
+    /** snapshot slots found by the last volume query, reused between queries */
+    mutable std::vector<uint32_t> m_queriedSlots;
+    static uint64_t s_numSnapshotUpdates;
+    static uint64_t s_numSnapshotQueries;
+
 public:
     void operator=(ParticleGroup&) = delete;
 };
@@ -1,5 +1,6 @@
 #include "particlegrouptycoon.h"
 
+#include <algorithm>
 #include <cassert>
 #include <list>
 
@@ -11,10 +12,25 @@
 #include "particlegroup.h"
 #include "downgroup.h"
 #include "particlehelper.h"
+#include "particlesystempool.h"
 
 ParticleGroupTycoon * ParticleGroupTycoon::s_instance = nullptr;
 
+namespace {
+
 const float gridSize = 4.0f;
+/** groups are only split/merged again if a corner of their bounding box moved further than this */
+const float reevaluationDistance = 0.5f;
+
+bool boundsChanged(const glowutils::AxisAlignedBoundingBox & lhs, const glowutils::AxisAlignedBoundingBox & rhs)
+{
+    const glm::vec3 llfDelta = glm::abs(lhs.llf() - rhs.llf());
+    const glm::vec3 urbDelta = glm::abs(lhs.urb() - rhs.urb());
+    const float maxDelta = std::max(std::max(std::max(llfDelta.x, llfDelta.y), llfDelta.z), std::max(std::max(urbDelta.x, urbDelta.y), urbDelta.z));
+    return maxDelta > reevaluationDistance;
+}
+
+}
 
 void ParticleGroupTycoon::initialize()
 {
@@ -40,6 +56,7 @@ ParticleGroupTycoon::ParticleGroupTycoon()
 , m_collisions(nullptr)
 , m_collisionCheckDelta(0.0)
 {
+    ParticleSystemPool::initialize();
     ParticleScriptAccess::initialize(m_particleGroups);
     m_collisions = std::make_shared<ParticleCollision>();
 }
@@ -51,6 +68,10 @@ ParticleGroupTycoon::~ParticleGroupTycoon()
 
     ParticleScriptAccess::release();
     m_particleGroups.clear();
+    ParticleSystemPool::release();
+
+    glow::debug("ParticleGroupTycoon: %; particle snapshot updates served %; queries without locking the PhysX read data",
+        ParticleGroup::numSnapshotUpdates(), ParticleGroup::numSnapshotQueries());
 }
 
 void ParticleGroupTycoon::updatePhysics(double delta)
@@ -67,14 +88,12 @@ void ParticleGroupTycoon::updatePhysics(double delta)
             group->updatePhysics(delta);
     }
     for (unsigned int index : groupsToDelete) {
-        ParticleScriptAccess::instance().removeParticleGroup(index);
+        releaseGroup(index);
     }
 
     m_timeSinceSplit += delta;
     if (m_timeSinceSplit > 0.34) {
-
-        splitGroups();
-        mergeGroups();
+        updatePartitioning();
         m_timeSinceSplit = 0.0;
     }
 }
@@ -85,11 +104,56 @@ void ParticleGroupTycoon::updateVisuals()
         pair.second->updateVisuals();
 }
 
+void ParticleGroupTycoon::updateSnapshots()
+{
+    for (auto pair : m_particleGroups)
+        pair.second->updateSnapshot();
+}
+
 const std::unordered_map<unsigned int, ParticleGroup *> & ParticleGroupTycoon::particleGroups() const
 {
     return m_particleGroups;
 }
 
+void ParticleGroupTycoon::saveState(std::vector<ParticleGroupState> & states) const
+{
+    states.resize(m_particleGroups.size());
+    auto state = states.begin();
+    for (const auto & pair : m_particleGroups) {
+        pair.second->refreshSnapshot();
+        pair.second->saveState(*state++);
+    }
+}
+
+void ParticleGroupTycoon::restoreState(const std::vector<ParticleGroupState> & states)
+{
+    // remove the groups the same way as during the game, so that the pools and the partitioning forget them
+    std::vector<unsigned int> ids;
+    ids.reserve(m_particleGroups.size());
+    for (const auto & pair : m_particleGroups)
+        ids.push_back(pair.first);
+
+    for (unsigned int id : ids) {
+        if (m_particleGroups.at(id)->isDown)
+            releaseGroup(id);
+        else
+            ParticleScriptAccess::instance().removeParticleGroup(id);
+    }
+    assert(m_particleGroups.empty());
+    // states of groups that were removed by the scripts since the last partitioning
+    m_partitionStates.clear();
+    m_grid.clear();
+
+    // the restored groups reuse the ids
+    m_collisions->clearParticleGroups();
+
+    for (const ParticleGroupState & state : states)
+        ParticleScriptAccess::instance().restoreParticleGroup(state);
+
+    m_collisionCheckDelta = 0.0;
+    m_timeSinceSplit = 0.0;
+}
+
 DownGroup * ParticleGroupTycoon::getNearestGroup(const std::string & elementName, const glm::vec3 & position)
 {
     DownGroup * group = nullptr;
@@ -137,115 +201,169 @@ void ParticleGroupTycoon::checkCollisions(double deltaTime)
     }
 }
 
-void ParticleGroupTycoon::splitGroups()
+void ParticleGroupTycoon::updatePartitioning()
 {
-    std::vector<glm::vec3> extractPositions;
-    std::vector<glm::vec3> extractVelocities;
-    std::vector<uint32_t> extractIndices;
+    // forget about groups that were removed since the last update
+    for (auto it = m_partitionStates.begin(); it != m_partitionStates.end();) {
+        if (m_particleGroups.find(it->first) != m_particleGroups.end()) {
+            ++it;
+            continue;
+        }
+        removeFromGrid(it->first, it->second);
+        it = m_partitionStates.erase(it);
+    }
 
-    std::list<ParticleGroup*> newGroups;
+    std::list<DownGroup*> newGroups;
+    std::vector<unsigned int> mergedGroups;
 
     for (auto pair : m_particleGroups) {
-        if (pair.second->numParticles() == 0 || !pair.second->isDown)
+        ParticleGroup * group = pair.second;
+        if (group->numParticles() == 0 || !group->isDown)
             continue;
 
-        const glowutils::AxisAlignedBoundingBox & bounds = pair.second->boundingBox();
-
-        float splitValue;
-        int splitAxis = longestAxis(bounds, splitValue);
-
-        float longestLength = std::abs(bounds.urb()[splitAxis] - bounds.llf()[splitAxis]);
-        
-        assert(isfinite(longestLength));
+        // splitting and merging release or move all particles of the snapshot, it must contain the recently created ones
+        group->refreshSnapshot();
+        if (group->snapshot().size() == 0)
+            continue;
 
-        if (longestLength > gridSize) {
-            // extract the upper right back box
-            glm::vec3 extractLlf = bounds.llf();
-            extractLlf[splitAxis] = splitValue;
-            glm::vec3 extractUrb = bounds.urb();
+        const glowutils::AxisAlignedBoundingBox & bounds = group->snapshot().bounds;
 
-            glowutils::AxisAlignedBoundingBox extractBox(extractLlf, extractUrb);
+        PartitionState & state = m_partitionStates[pair.first];
+        if (state.evaluated && state.elementName == group->elementName() && !boundsChanged(state.bounds, bounds))
+            continue;
 
-            extractPositions.clear();
-            extractIndices.clear();
-            extractVelocities.clear();
-            pair.second->particlePositionsIndicesVelocitiesInVolume(extractBox, extractPositions, extractIndices, extractVelocities);
+        state.bounds = bounds;
+        state.evaluated = true;
 
-            pair.second->releaseParticles(extractIndices);
+        DownGroup * downGroup = static_cast<DownGroup*>(group);
 
-            const unsigned int id = ParticleScriptAccess::instance().m_id + static_cast<int>(newGroups.size());
-            DownGroup * newGroup = new DownGroup(*pair.second, id);
-            newGroup->createParticles(extractPositions, &extractVelocities);
+        const unsigned int newGroupId = ParticleScriptAccess::instance().m_id + static_cast<int>(newGroups.size());
+        DownGroup * newGroup = splitGroup(*downGroup, newGroupId);
+        if (newGroup) {
+            // the bounds of the split group will change with the next snapshot, it will be evaluated again then
             newGroups.push_back(newGroup);
+            continue;
         }
+
+        if (mergeGroup(pair.first, *downGroup))
+            mergedGroups.push_back(pair.first);
     }
 
+    for (unsigned int id : mergedGroups)
+        releaseGroup(id);
+
     for (ParticleGroup * newGroup : newGroups) {
         ParticleScriptAccess::instance().addParticleGroup(newGroup);
     }
-
 }
 
-void ParticleGroupTycoon::mergeGroups()
+DownGroup * ParticleGroupTycoon::splitGroup(DownGroup & group, unsigned int newGroupId)
 {
-    m_grid.clear();
+    const glowutils::AxisAlignedBoundingBox & bounds = group.snapshot().bounds;
 
-    std::vector<unsigned int> groupsToRemove;
-    groupsToRemove.reserve(10);
-    for (auto pair : m_particleGroups) {
-        if (pair.second->numParticles() == 0 || !pair.second->isDown)
-            continue;
+    float splitValue;
+    int splitAxis = surfaceAreaSplit(group.snapshot(), bounds, splitValue);
 
-        const glowutils::AxisAlignedBoundingBox & bounds = pair.second->boundingBox();
+    float longestLength = std::abs(bounds.urb()[splitAxis] - bounds.llf()[splitAxis]);
 
-        uint64_t gridIndex = gridIndexFromPosition(bounds.center());
+    assert(isfinite(longestLength));
 
-        DownGroup * gridGroup = particleGroupAtGridIndex(gridIndex, pair.second->elementName());
+    if (longestLength <= gridSize)
+        return nullptr;
 
-        if (gridGroup == nullptr)
-        {
-            insertGroupIntoGrid(static_cast<DownGroup*>(pair.second), gridIndex);
-            continue;
-        }
+    // extract the upper right back box
+    glm::vec3 extractLlf = bounds.llf();
+    extractLlf[splitAxis] = splitValue;
+    glm::vec3 extractUrb = bounds.urb();
 
-        if (gridGroup == pair.second)
-            continue;
+    glowutils::AxisAlignedBoundingBox extractBox(extractLlf, extractUrb);
+
+    std::vector<glm::vec3> extractPositions;
+    std::vector<glm::vec3> extractVelocities;
+    std::vector<uint32_t> extractIndices;
+    group.particlePositionsIndicesVelocitiesInVolume(extractBox, extractPositions, extractIndices, extractVelocities);
 
-        pair.second->moveParticlesTo(*gridGroup);
+    if (extractIndices.empty() || extractIndices.size() == group.numParticles())
+        return nullptr;
 
-        groupsToRemove.push_back(pair.first);
-    }
+    group.releaseParticles(extractIndices);
 
-    for (unsigned int index : groupsToRemove)
-        ParticleScriptAccess::instance().removeParticleGroup(index);
+    DownGroup * newGroup = new DownGroup(group, newGroupId);
+    newGroup->createParticles(extractPositions, &extractVelocities);
+
+    return newGroup;
 }
 
-uint64_t ParticleGroupTycoon::gridIndexFromPosition(const glm::vec3 & position)
+bool ParticleGroupTycoon::mergeGroup(unsigned int id, DownGroup & group)
 {
-    uint64_t posX = static_cast<uint64_t>(position.x / gridSize);
-    uint64_t posZ = static_cast<uint64_t>(position.z / gridSize);
+    PartitionState & state = m_partitionStates.at(id);
 
-    return (posX << 32) + posZ;
+    const uint64_t gridIndex = gridIndexFromPosition(state.bounds.center());
+
+    if (state.inGrid && (state.gridIndex != gridIndex || state.elementName != group.elementName()))
+        removeFromGrid(id, state);
+
+    state.elementName = group.elementName();
+
+    std::unordered_map<uint64_t, unsigned int> & elementGrid = m_grid[state.elementName];
+    auto gridGroup = elementGrid.find(gridIndex);
+
+    // the registered group may have changed its element since it was evaluated
+    if (gridGroup != elementGrid.end() && m_particleGroups.at(gridGroup->second)->elementName() != state.elementName) {
+        m_partitionStates.at(gridGroup->second).inGrid = false;
+        elementGrid.erase(gridGroup);
+        gridGroup = elementGrid.end();
+    }
+
+    if (gridGroup == elementGrid.end() || gridGroup->second == id) {
+        elementGrid[gridIndex] = id;
+        state.gridIndex = gridIndex;
+        state.inGrid = true;
+        return false;
+    }
+
+    ParticleGroup * target = m_particleGroups.at(gridGroup->second);
+    group.moveParticlesTo(*target);
+
+    return true;
 }
 
-DownGroup * ParticleGroupTycoon::particleGroupAtGridIndex(uint64_t index, const std::string elementName)
+void ParticleGroupTycoon::removeFromGrid(unsigned int id, PartitionState & state)
 {
-    auto it = m_grid.find(elementName);
-    if (it == m_grid.end())
-        return nullptr;
+    if (!state.inGrid)
+        return;
 
-    auto it2 = it->second.find(index);
-    if (it2 == it->second.end())
-        return nullptr;
+    auto elementGrid = m_grid.find(state.elementName);
+    assert(elementGrid != m_grid.end());
+    auto gridGroup = elementGrid->second.find(state.gridIndex);
+    if (gridGroup != elementGrid->second.end() && gridGroup->second == id)
+        elementGrid->second.erase(gridGroup);
+
+    state.inGrid = false;
+}
+
+void ParticleGroupTycoon::releaseGroup(unsigned int id)
+{
+    auto it = m_particleGroups.find(id);
+    assert(it != m_particleGroups.end());
+    assert(it->second->isDown);
+    DownGroup * group = static_cast<DownGroup*>(it->second);
+    m_particleGroups.erase(it);
+
+    auto state = m_partitionStates.find(id);
+    if (state != m_partitionStates.end()) {
+        removeFromGrid(id, state->second);
+        m_partitionStates.erase(state);
+    }
 
-    return it2->second;
+    // the particle system and the drawable go back to the ParticleSystemPool
+    delete group;
 }
 
-void ParticleGroupTycoon::insertGroupIntoGrid(DownGroup * group, uint64_t index)
+uint64_t ParticleGroupTycoon::gridIndexFromPosition(const glm::vec3 & position)
 {
-    const std::string & elementName = group->elementName();
-    auto it = m_grid.emplace(elementName, std::unordered_map<uint64_t, DownGroup*>());
+    uint64_t posX = static_cast<uint64_t>(position.x / gridSize);
+    uint64_t posZ = static_cast<uint64_t>(position.z / gridSize);
 
-    auto it2 = it.first->second.emplace(index, group);
-    assert(it2.second);
+    return (posX << 32) + posZ;
 }
@@ -3,10 +3,15 @@
 #include <unordered_map>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include <glowutils/AxisAlignedBoundingBox.h>
+
 class ParticleGroup;
+struct ParticleGroupState;
 class DownGroup;
 class ParticleCollision;
 
@@ -23,6 +28,13 @@ public:
     void updatePhysics(double delta);
     /** Update visuals of all particle of all ParticleGroups. */
     void updateVisuals();
+    /** Refresh the particle snapshots of all ParticleGroups, call this after each simulation step. */
+    void updateSnapshots();
+
+    /** Copy the state of all ParticleGroups, including the particles created since the last simulation step. */
+    void saveState(std::vector<ParticleGroupState> & states) const;
+    /** Replace all ParticleGroups by groups created from the states, keeping their ids. */
+    void restoreState(const std::vector<ParticleGroupState> & states);
 
     /** Locate and return the nearest DownGroup of a given element. */
     DownGroup * getNearestGroup(const std::string & elementName, const glm::vec3 & position);
@@ -41,21 +53,38 @@ private:
     std::shared_ptr<ParticleCollision> m_collisions;
     double m_collisionCheckDelta;
 
-    /** Splits ParticleGroups which particles are too widely spread. */
-    void splitGroups();
-    /** Merges ParticleGroups which overlap too much. */
-    void mergeGroups();
+    /** Splits and merges DownGroups, but only those whose bounds changed noticeably since they were evaluated the last time. */
+    void updatePartitioning();
     double m_timeSinceSplit;
 
+    /** Splits the group if its particles are too widely spread, using a split plane chosen from the particle distribution.
+      * @return the new group containing the split off particles, or nullptr */
+    DownGroup * splitGroup(DownGroup & group, unsigned int newGroupId);
+    /** Merges the group into another group of the same element at its grid index, or registers it at this grid index.
+      * @return whether the particles were moved to another group */
+    bool mergeGroup(unsigned int id, DownGroup & group);
+
+    /** Remove a DownGroup from the active groups and the partitioning and delete it. */
+    void releaseGroup(unsigned int id);
+
     /** Calculates the gridIndex of given position (relevant for merging). */
     uint64_t gridIndexFromPosition(const glm::vec3 & position);
-    /** Returns pointer to the ParticleGroup of type elementName which is currently at gridIndex index. returns nullptr if no ParticleGroup of given type is at gridIndex index. */
-    DownGroup * particleGroupAtGridIndex(uint64_t index, const std::string elementName);
-    /** Assigns a ParticleGroup to a grid index(for merge-checking). */
-    void insertGroupIntoGrid(DownGroup * group, uint64_t index);
+
+    /** What we know about a DownGroup from its last evaluation. */
+    struct PartitionState
+    {
+        glowutils::AxisAlignedBoundingBox bounds;
+        std::string elementName;
+        uint64_t gridIndex = 0;
+        bool inGrid = false;
+        bool evaluated = false;
+    };
+    std::unordered_map<unsigned int, PartitionState> m_partitionStates;
+    void removeFromGrid(unsigned int id, PartitionState & state);
 
     static ParticleGroupTycoon * s_instance;
 
     std::unordered_map<unsigned int, ParticleGroup *> m_particleGroups;
-    std::unordered_map<std::string, std::unordered_map<uint64_t, DownGroup *> > m_grid;
+    /** element name -> grid index -> id of the group registered at this grid index. Persistent, updated for evaluated groups only. */
+    std::unordered_map<std::string, std::unordered_map<uint64_t, unsigned int> > m_grid;
 };
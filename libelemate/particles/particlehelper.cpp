@@ -1,7 +1,48 @@
 #include "particlehelper.h"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+
 #include <glowutils/AxisAlignedBoundingBox.h>
 
+#include "particlesnapshot.h"
+
+namespace {
+
+const unsigned int numSplitBins = 16;
+
+struct Bin
+{
+    uint32_t count = 0;
+    glm::vec3 llf = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 urb = glm::vec3(-std::numeric_limits<float>::max());
+
+    void extend(const glm::vec3 & position)
+    {
+        ++count;
+        llf = glm::min(llf, position);
+        urb = glm::max(urb, position);
+    }
+
+    void extend(const Bin & other)
+    {
+        count += other.count;
+        llf = glm::min(llf, other.llf);
+        urb = glm::max(urb, other.urb);
+    }
+
+    float surfaceArea() const
+    {
+        if (count == 0)
+            return 0.0f;
+        const glm::vec3 size = urb - llf;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+}
+
 
 uint8_t longestAxis(const glowutils::AxisAlignedBoundingBox & bounds, float & splitValue)
 {
@@ -22,4 +63,56 @@ uint8_t longestAxis(const glowutils::AxisAlignedBoundingBox & bounds, float & sp
     // z-split
     splitValue = (bounds.urb().z - bounds.llf().z) * 0.5f + bounds.llf().z;
     return 2;
-}
\ No newline at end of file
+}
+
+uint8_t surfaceAreaSplit(const ParticleSnapshot & particles, const glowutils::AxisAlignedBoundingBox & bounds, float & splitValue)
+{
+    const uint8_t axis = longestAxis(bounds, splitValue);
+
+    const float axisMin = bounds.llf()[axis];
+    const float axisLength = bounds.urb()[axis] - axisMin;
+    if (!(axisLength > 0.0f))
+        return axis;
+
+    const std::vector<float> & axisPositions = axis == 0 ? particles.positionX : (axis == 1 ? particles.positionY : particles.positionZ);
+    const float binsPerLength = numSplitBins / axisLength;
+
+    std::array<Bin, numSplitBins> bins;
+    uint32_t numValid = 0;
+    for (uint32_t i = 0; i < particles.size(); ++i) {
+        if (!particles.isValid(i))
+            continue;
+        int bin = static_cast<int>((axisPositions[i] - axisMin) * binsPerLength);
+        bin = std::max(0, std::min(static_cast<int>(numSplitBins) - 1, bin));
+        bins[bin].extend(particles.position(i));
+        ++numValid;
+    }
+
+    // sweep from the upper end to get the costs of all right hand sides
+    std::array<float, numSplitBins> rightCosts;
+    Bin right;
+    for (unsigned int i = numSplitBins - 1; i > 0; --i) {
+        right.extend(bins[i]);
+        rightCosts[i] = right.count * right.surfaceArea();
+    }
+
+    Bin left;
+    float bestCost = std::numeric_limits<float>::max();
+    unsigned int bestSplit = 0;
+    for (unsigned int i = 1; i < numSplitBins; ++i) {
+        left.extend(bins[i - 1]);
+        // splitting with all particles on one side would not change anything
+        if (left.count == 0 || left.count == numValid)
+            continue;
+        const float cost = left.count * left.surfaceArea() + rightCosts[i];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = i;
+        }
+    }
+
+    if (bestSplit > 0)
+        splitValue = axisMin + bestSplit * axisLength / numSplitBins;
+
+    return axis;
+}
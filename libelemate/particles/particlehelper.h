@@ -6,7 +6,13 @@ namespace glowutils
 {
     class AxisAlignedBoundingBox;
 }
+class ParticleSnapshot;
 
 /** Returns longest axis of a given bounding box and stores the value at which position of the axis the ParticleGroup should be splitted into splitValue. */
 uint8_t longestAxis(const glowutils::AxisAlignedBoundingBox & bounds, float & splitValue);
 
+
+/** Returns the longest axis of the bounding box and stores a split value on this axis into splitValue, chosen from the particle distribution.
+  * The particles are binned along the axis and the split minimizes the surface area heuristic: number of particles times the surface of their bounding box, summed for both sides.
+  * Falls back to the midpoint, if there are no valid particles in the snapshot. */
+uint8_t surfaceAreaSplit(const ParticleSnapshot & particles, const glowutils::AxisAlignedBoundingBox & bounds, float & splitValue);
@@ -0,0 +1,191 @@
+#include "particleindexallocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+/** rebuild the free range list from the bitset if releasing fragmented it into more ranges than this */
+const size_t maxFreeRanges = 256;
+/** the batch list is compacted once it grew beyond twice its size after the last compaction, but not below this */
+const size_t minCompactedBatches = 256;
+
+}
+
+ParticleIndexAllocator::ParticleIndexAllocator(uint32_t capacity)
+: m_capacity(capacity)
+, m_numUsed(0)
+, m_usedBits((capacity + 63) / 64, 0)
+, m_stamps(capacity, 0)
+, m_stamp(0)
+, m_maxBatches(minCompactedBatches)
+{
+    clear();
+}
+
+uint32_t ParticleIndexAllocator::capacity() const
+{
+    return m_capacity;
+}
+
+uint32_t ParticleIndexAllocator::numUsed() const
+{
+    return m_numUsed;
+}
+
+uint32_t ParticleIndexAllocator::numFree() const
+{
+    return m_capacity - m_numUsed;
+}
+
+bool ParticleIndexAllocator::isUsed(uint32_t index) const
+{
+    assert(index < m_capacity);
+    return (m_usedBits[index / 64] & (uint64_t(1) << (index % 64))) != 0;
+}
+
+uint32_t ParticleIndexAllocator::acquire(uint32_t count, std::vector<uint32_t> & indices)
+{
+    uint32_t acquired = 0;
+    ++m_stamp;
+
+    while (acquired < count && !m_freeRanges.empty()) {
+        Range & range = m_freeRanges.back();
+        const uint32_t take = std::min(count - acquired, range.end - range.begin);
+
+        for (uint32_t i = range.begin; i < range.begin + take; ++i) {
+            indices.push_back(i);
+            m_stamps[i] = m_stamp;
+        }
+        setUsed(range.begin, range.begin + take);
+        m_batches.push_back({ range.begin, range.begin + take, m_stamp });
+
+        range.begin += take;
+        if (range.begin == range.end)
+            m_freeRanges.pop_back();
+
+        acquired += take;
+    }
+
+    m_numUsed += acquired;
+
+    if (m_batches.size() > m_maxBatches)
+        compactBatches();
+
+    return acquired;
+}
+
+void ParticleIndexAllocator::release(const uint32_t * indices, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t index = indices[i];
+        if (!isUsed(index))
+            continue;
+
+        m_usedBits[index / 64] &= ~(uint64_t(1) << (index % 64));
+        --m_numUsed;
+
+        // indices are mostly released in ascending or descending runs, extend the last range if possible
+        if (!m_freeRanges.empty()) {
+            Range & last = m_freeRanges.back();
+            if (last.end == index) {
+                ++last.end;
+                continue;
+            }
+            if (last.begin == index + 1) {
+                --last.begin;
+                continue;
+            }
+        }
+        m_freeRanges.push_back({ index, index + 1 });
+    }
+
+    if (m_freeRanges.size() > maxFreeRanges)
+        rebuildFreeRanges();
+}
+
+void ParticleIndexAllocator::release(const std::vector<uint32_t> & indices)
+{
+    release(indices.data(), static_cast<uint32_t>(indices.size()));
+}
+
+void ParticleIndexAllocator::clear()
+{
+    std::fill(m_usedBits.begin(), m_usedBits.end(), 0);
+    m_numUsed = 0;
+
+    m_freeRanges.clear();
+    if (m_capacity > 0)
+        m_freeRanges.push_back({ 0, m_capacity });
+
+    m_batches.clear();
+    m_maxBatches = minCompactedBatches;
+}
+
+uint32_t ParticleIndexAllocator::releaseOldest(uint32_t count, std::vector<uint32_t> & indices)
+{
+    const size_t first = indices.size();
+    uint32_t found = 0;
+
+    while (found < count && !m_batches.empty()) {
+        Batch & batch = m_batches.front();
+        for (; batch.begin < batch.end && found < count; ++batch.begin) {
+            if (!belongsTo(batch.begin, batch))
+                continue;
+            indices.push_back(batch.begin);
+            ++found;
+        }
+        if (batch.begin == batch.end)
+            m_batches.pop_front();
+    }
+
+    release(indices.data() + first, found);
+
+    return found;
+}
+
+bool ParticleIndexAllocator::belongsTo(uint32_t index, const Batch & batch) const
+{
+    return isUsed(index) && m_stamps[index] == batch.stamp;
+}
+
+void ParticleIndexAllocator::setUsed(uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; ++i)
+        m_usedBits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+void ParticleIndexAllocator::rebuildFreeRanges()
+{
+    m_freeRanges.clear();
+
+    uint32_t index = m_capacity;
+    while (index > 0) {
+        --index;
+        if (isUsed(index))
+            continue;
+
+        Range range = { index, index + 1 };
+        while (range.begin > 0 && !isUsed(range.begin - 1))
+            --range.begin;
+        m_freeRanges.push_back(range);
+
+        index = range.begin;
+    }
+}
+
+void ParticleIndexAllocator::compactBatches()
+{
+    auto kept = m_batches.begin();
+    for (Batch batch : m_batches) {
+        while (batch.begin < batch.end && !belongsTo(batch.begin, batch))
+            ++batch.begin;
+        while (batch.end > batch.begin && !belongsTo(batch.end - 1, batch))
+            --batch.end;
+        if (batch.begin < batch.end)
+            *kept++ = batch;
+    }
+    m_batches.erase(kept, m_batches.end());
+
+    m_maxBatches = std::max(minCompactedBatches, 2 * m_batches.size());
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/** @brief Hands out PhysX particle indices of a particle system with fixed capacity.
+  * Used indices are tracked in a bitset, free indices as a list of ranges, so that acquiring and releasing
+  * many particles at once doesn't touch each free index separately. The acquired ranges are kept in order,
+  * so that the oldest particles can be released when the particle system is full. */
+class ParticleIndexAllocator
+{
+public:
+    ParticleIndexAllocator(uint32_t capacity);
+
+    uint32_t capacity() const;
+    uint32_t numUsed() const;
+    uint32_t numFree() const;
+
+    bool isUsed(uint32_t index) const;
+
+    /** Append up to count free indices to indices, preferring recently released ones.
+      * @return the number of acquired indices, which is less than count if there are not enough free indices. */
+    uint32_t acquire(uint32_t count, std::vector<uint32_t> & indices);
+    /** Mark the indices as free. Indices that are not in use are ignored. */
+    void release(const uint32_t * indices, uint32_t count);
+    void release(const std::vector<uint32_t> & indices);
+    /** Mark all indices as free. */
+    void clear();
+
+    /** Release up to count used indices, the earliest acquired first, and append them to indices.
+      * @return the number of released indices */
+    uint32_t releaseOldest(uint32_t count, std::vector<uint32_t> & indices);
+
+protected:
+    struct Range {
+        uint32_t begin;
+        uint32_t end;   // exclusive
+    };
+
+    /** Indices acquired by one acquire call, they were given the stamp of the call. */
+    struct Batch {
+        uint32_t begin;
+        uint32_t end;   // exclusive
+        uint32_t stamp;
+    };
+
+    /** @return whether index is still in use since the acquire call of batch */
+    bool belongsTo(uint32_t index, const Batch & batch) const;
+
+    void setUsed(uint32_t begin, uint32_t end);
+    /** Rebuild the free ranges from the bitset, merging neighboring ranges. */
+    void rebuildFreeRanges();
+    /** Drop batches without used indices and shrink the others to their first and last used index. */
+    void compactBatches();
+
+    const uint32_t m_capacity;
+    uint32_t m_numUsed;
+
+    std::vector<uint64_t> m_usedBits;
+    /** Taken from the back. Sorted descending after each rebuild, so that low indices are handed out first. */
+    std::vector<Range> m_freeRanges;
+
+    /** In acquisition order. Released indices stay in their batch until it is compacted or reaches the front. */
+    std::deque<Batch> m_batches;
+    /** stamp of the acquire call per index, tells apart reacquired indices from the ones in older batches */
+    std::vector<uint32_t> m_stamps;
+    uint32_t m_stamp;
+    /** compact the batches when there are more than this */
+    size_t m_maxBatches;
+
+public:
+    void operator=(ParticleIndexAllocator&) = delete;
+};
@@ -1,5 +1,6 @@
 #include "particlescriptaccess.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include <glow/logging.h>
@@ -15,6 +16,19 @@
 #include "lua/luawrapper.h"
 
 
+struct ParticleScriptAccess::ElementParameters
+{
+    ImmutableParticleProperties immutableProperties;
+    MutableParticleProperties mutableProperties;
+    /** whether the script sets a temperature, otherwise the group keeps its temperature */
+    bool hasTemperature = false;
+    float temperature = 0.0f;
+
+    /** Script of elements with dynamic behaviour, which define setUpParticleGroup(index). Nullptr for the other elements. */
+    std::unique_ptr<LuaWrapper> lua;
+    LuaWrapper::FunctionRef setUp;
+};
+
 ParticleScriptAccess * ParticleScriptAccess::s_instance = nullptr;
 
 void ParticleScriptAccess::initialize(std::unordered_map<unsigned int, ParticleGroup*> & particleGroups)
@@ -34,22 +48,17 @@ ParticleScriptAccess::ParticleScriptAccess(std::unordered_map<unsigned int, Part
 : m_particleGroups(particleGroups)
 , m_id(0)
 , m_gpuParticles(false)
-, m_lua(nullptr)
+, m_elementParametersReloadCount(0)
 , m_pxScene(nullptr)
 {
     assert(PxGetPhysics().getNbScenes() == 1);
     physx::PxScene * pxScenePtrs[1];
     PxGetPhysics().getScenes(pxScenePtrs, 1);
     m_pxScene = pxScenePtrs[0];
-
-    m_lua = new LuaWrapper();
-
-    registerLuaFunctions(*m_lua);
 }
 
 ParticleScriptAccess::~ParticleScriptAccess()
 {
-    delete m_lua;
 }
 
 ParticleScriptAccess& ParticleScriptAccess::instance()
@@ -66,15 +75,17 @@ ParticleGroup * ParticleScriptAccess::particleGroup(const int id)
 
 int ParticleScriptAccess::createParticleGroup(bool emittingGroup, const std::string & elementType, uint32_t maxParticleCount)
 {
+    const ElementParameters & parameters = elementParameters(elementType);
+
     ParticleGroup * particleGroup = nullptr;
     if (emittingGroup)
-        particleGroup = new EmitterGroup(elementType, m_id, m_gpuParticles, maxParticleCount);
+        particleGroup = new EmitterGroup(elementType, m_id, m_gpuParticles, maxParticleCount, parameters.immutableProperties, parameters.mutableProperties);
     else
-        particleGroup = new DownGroup(elementType, m_id, m_gpuParticles, maxParticleCount);
+        particleGroup = new DownGroup(elementType, m_id, m_gpuParticles, maxParticleCount, parameters.immutableProperties, parameters.mutableProperties);
 
     m_particleGroups.emplace(m_id, particleGroup);
 
-    setUpParticleGroup(m_id, elementType);
+    finishParticleGroupSetUp(m_id, parameters);
 
     return m_id++;
 }
@@ -86,6 +97,22 @@ int ParticleScriptAccess::addParticleGroup(ParticleGroup * group)
     return m_id++;
 }
 
+void ParticleScriptAccess::restoreParticleGroup(const ParticleGroupState & state)
+{
+    assert(m_particleGroups.find(state.id) == m_particleGroups.end());
+
+    ParticleGroup * particleGroup = nullptr;
+    if (state.isEmitter)
+        particleGroup = new EmitterGroup(state.elementName, state.id, m_gpuParticles, state.maxParticleCount);
+    else
+        particleGroup = new DownGroup(state.elementName, state.id, m_gpuParticles, state.maxParticleCount);
+
+    particleGroup->restoreState(state);
+    m_particleGroups.emplace(state.id, particleGroup);
+
+    m_id = std::max(m_id, state.id + 1);
+}
+
 void ParticleScriptAccess::removeParticleGroup(const int id)
 {
     ParticleGroup * group = m_particleGroups.at(id);
@@ -105,12 +132,106 @@ void ParticleScriptAccess::clearParticleGroups()
 
 void ParticleScriptAccess::setUpParticleGroup(const int id, const std::string & elementType)
 {
-    std::string script = "scripts/elements/" + elementType + ".lua";
-    m_lua->loadScript(script);
-    m_lua->call("setImmutableProperties", id);
-    m_lua->call("setMutableProperties", id);
-    m_lua->call("setTemperature", id);
-    m_lua->removeScript(script);
+    const ElementParameters & parameters = elementParameters(elementType);
+
+    ParticleGroup * group = particleGroup(id);
+    group->setImmutableProperties(parameters.immutableProperties);
+    group->setMutableProperties(parameters.mutableProperties);
+
+    finishParticleGroupSetUp(id, parameters);
+}
+
+void ParticleScriptAccess::finishParticleGroupSetUp(const int id, const ElementParameters & parameters)
+{
+    if (parameters.hasTemperature)
+        particleGroup(id)->setTemperature(parameters.temperature);
+
+    if (parameters.lua)
+        parameters.lua->call(parameters.setUp, id);
+}
+
+const ParticleScriptAccess::ElementParameters & ParticleScriptAccess::elementParameters(const std::string & elementType)
+{
+    if (m_elementParametersReloadCount != LuaWrapper::reloadCount()) {
+        m_elementParameters.clear();
+        m_elementParametersReloadCount = LuaWrapper::reloadCount();
+    }
+
+    std::unique_ptr<ElementParameters> & parameters = m_elementParameters[elementType];
+    if (!parameters) {
+        parameters.reset(new ElementParameters());
+        evaluateElementScript(elementType, *parameters);
+    }
+
+    return *parameters;
+}
+
+void ParticleScriptAccess::evaluateElementScript(const std::string & elementType, ElementParameters & parameters)
+{
+    const std::string script = "scripts/elements/" + elementType + ".lua";
+
+    // there is no group yet: only the setters are available, accessing a group results in a Lua error instead of an invalid id
+    bool hasSetUp;
+    {
+        LuaWrapper lua;
+        registerRecordingLuaFunctions(lua, parameters);
+        lua.loadScript(script);
+        for (const char * function : { "setImmutableProperties", "setMutableProperties", "setTemperature" }) {
+            if (lua.hasFunction(function))
+                lua.call(function, -1);
+        }
+        hasSetUp = lua.hasFunction("setUpParticleGroup");
+    }
+
+    if (!hasSetUp)
+        return;
+
+    // a new Lua state for each element, so that functions of other element scripts are not called instead of missing ones
+    parameters.lua.reset(new LuaWrapper());
+    registerLuaFunctions(*parameters.lua);
+    parameters.lua->loadScript(script);
+    parameters.setUp = parameters.lua->function("setUpParticleGroup");
+}
+
+void ParticleScriptAccess::registerRecordingLuaFunctions(LuaWrapper & lua, ElementParameters & parameters)
+{
+    ElementParameters * recorded = &parameters;
+
+    auto func0 = [=] (int /*id*/, float maxMotionDistance, float gridSize, float restOffset, float contactOffset, float restParticleDistance)
+    {
+        ImmutableParticleProperties & properties = recorded->immutableProperties;
+        properties.maxMotionDistance = maxMotionDistance;
+        properties.gridSize = gridSize;
+        properties.restOffset = restOffset;
+        properties.contactOffset = contactOffset;
+        properties.restParticleDistance = restParticleDistance;
+        return 0;
+    };
+
+    auto func1 = [=] (int /*id*/, float restitution, float dynamicFriction, float staticFriction, float damping, glm::vec3 externalAcceleration, float particleMass, float viscosity, float stiffness)
+    {
+        MutableParticleProperties & properties = recorded->mutableProperties;
+        properties.restitution = restitution;
+        properties.dynamicFriction = dynamicFriction;
+        properties.staticFriction = staticFriction;
+        properties.damping = damping;
+        properties.externalAcceleration = externalAcceleration;
+        properties.particleMass = particleMass;
+        properties.viscosity = viscosity;
+        properties.stiffness = stiffness;
+        return 0;
+    };
+
+    auto func2 = [=] (int /*id*/, float temperature)
+    {
+        recorded->hasTemperature = true;
+        recorded->temperature = temperature;
+        return 0;
+    };
+
+    lua.Register("psa_setImmutableProperties", func0);
+    lua.Register("psa_setMutableProperties", func1);
+    lua.Register("psa_setTemperature", func2);
 }
 
 void ParticleScriptAccess::setUseGpuParticles(bool enable)
@@ -150,31 +271,31 @@ void ParticleScriptAccess::restoreGPUAccelerated()
 
 void ParticleScriptAccess::registerLuaFunctions(LuaWrapper & lua)
 {
-    std::function<int(bool, std::string, unsigned int)> func0 = [=] (bool emittingGroup, std::string elementType, unsigned int maxParticles)
+    auto func0 = [=] (bool emittingGroup, std::string elementType, unsigned int maxParticles)
     { return createParticleGroup(emittingGroup, elementType, maxParticles); };
 
-    std::function<int(int)> func0a = [=] (int id)
+    auto func0a = [=] (int id)
     { removeParticleGroup(id); return 0; };
 
-    std::function<int()> func0b = [=] ()
+    auto func0b = [=] ()
     { clearParticleGroups(); return 0; };
 
-    std::function<int(int, float, float, float, float, float, float)> func1 = [=] (int id, float posx, float posy, float posz, float velx, float vely, float velz)
+    auto func1 = [=] (int id, float posx, float posy, float posz, float velx, float vely, float velz)
     { createParticle(id, posx, posy, posz, velx, vely, velz); return 0; };
 
-    std::function<int(int, float, float, float, float, float, float, float)> func2 = [=] (int id, float ratio, float posx, float posy, float posz, float dirx, float diry, float dirz)
+    auto func2 = [=] (int id, float ratio, float posx, float posy, float posz, float dirx, float diry, float dirz)
     { emit(id, ratio, posx, posy, posz, dirx, diry, dirz); return 0; };
 
-    std::function<int(int)> func3 = [=] (int id)
+    auto func3 = [=] (int id)
     { stopEmit(id); return 0; };
 
-    std::function<int()> func4 = [=] ()
+    auto func4 = [=] ()
     { return numParticleGroups(); };
 
-    std::function<std::string(int)> func5 = [=] (int id)
+    auto func5 = [=] (int id)
     { return elementAtId(id); };
 
-    std::function<int(int)> func5a = [=] (int id)
+    auto func5a = [=] (int id)
     { return nextParticleGroup(id); };
 
     lua.Register("psa_createParticleGroup", func0);
@@ -187,32 +308,32 @@ void ParticleScriptAccess::registerLuaFunctions(LuaWrapper & lua)
     lua.Register("psa_elementAtId", func5);
     lua.Register("psa_nextParticleGroup", func5a);
 
-    std::function<int(int, float)> func6 = [=] (int id, float maxMotionDistance)
+    auto func6 = [=] (int id, float maxMotionDistance)
     { setMaxMotionDistance(id, maxMotionDistance); return 0; };
-    std::function<int(int, float)> func7 = [=] (int id, float gridSize)
+    auto func7 = [=] (int id, float gridSize)
     { setGridSize(id, gridSize); return 0; };
-    std::function<int(int, float)> func8 = [=] (int id, float restOffset)
+    auto func8 = [=] (int id, float restOffset)
     { setRestOffset(id, restOffset); return 0; };
-    std::function<int(int, float)> func9 = [=] (int id, float contactOffset)
+    auto func9 = [=] (int id, float contactOffset)
     { setContactOffset(id, contactOffset); return 0; };
-    std::function<int(int, float)> func10 = [=] (int id, float restParticleDistance)
+    auto func10 = [=] (int id, float restParticleDistance)
     { setRestParticleDistance(id, restParticleDistance); return 0; };
 
-    std::function<int(int, float)> func11 = [=] (int id, float restitution)
+    auto func11 = [=] (int id, float restitution)
     { setRestitution(id, restitution); return 0; };
-    std::function<int(int, float)> func12 = [=] (int id, float dynamicFriction)
+    auto func12 = [=] (int id, float dynamicFriction)
     { setDynamicFriction(id, dynamicFriction); return 0; };
-    std::function<int(int, float)> func13 = [=] (int id, float staticFriction)
+    auto func13 = [=] (int id, float staticFriction)
     { setStaticFriction(id, staticFriction); return 0; };
-    std::function<int(int, float)> func14 = [=] (int id, float damping)
+    auto func14 = [=] (int id, float damping)
     { setDamping(id, damping); return 0; };
-    std::function<int(int, float)> func15 = [=] (int id, float particleMass)
+    auto func15 = [=] (int id, float particleMass)
     { setParticleMass(id, particleMass); return 0; };
-    std::function<int(int, float)> func16 = [=] (int id, float viscosity)
+    auto func16 = [=] (int id, float viscosity)
     { setViscosity(id, viscosity); return 0; };
-    std::function<int(int, float)> func17 = [=](int id, float stiffness)
+    auto func17 = [=](int id, float stiffness)
     { setStiffness(id, stiffness); return 0; };
-    std::function<int(int, glm::vec3)> func17_5 = [=](int id, glm::vec3 externalAcceleration)
+    auto func17_5 = [=](int id, glm::vec3 externalAcceleration)
     { setExternalAcceleration(id, externalAcceleration); return 0; };
 
     lua.Register("psa_setMaxMotionDistance", func6);
@@ -229,31 +350,31 @@ void ParticleScriptAccess::registerLuaFunctions(LuaWrapper & lua)
     lua.Register("psa_setStiffness", func17);
     lua.Register("psa_setExternalAcceleration", func17_5);
 
-    std::function<float(int)> func18 = [=] (int id)
+    auto func18 = [=] (int id)
     { return maxMotionDistance(id); };
-    std::function<float(int)> func19 = [=] (int id)
+    auto func19 = [=] (int id)
     { return gridSize(id); };
-    std::function<float(int)> func20 = [=] (int id)
+    auto func20 = [=] (int id)
     { return restOffset(id); };
-    std::function<float(int)> func21 = [=] (int id)
+    auto func21 = [=] (int id)
     { return contactOffset(id); };
-    std::function<float(int)> func22 = [=] (int id)
+    auto func22 = [=] (int id)
     { return restParticleDistance(id); };
-    std::function<float(int)> func23 = [=] (int id)
+    auto func23 = [=] (int id)
     { return restitution(id); };
-    std::function<float(int)> func24 = [=] (int id)
+    auto func24 = [=] (int id)
     { return dynamicFriction(id); };
-    std::function<float(int)> func25 = [=] (int id)
+    auto func25 = [=] (int id)
     { return staticFriction(id); };
-    std::function<float(int)> func26 = [=] (int id)
+    auto func26 = [=] (int id)
     { return damping(id); };
-    std::function<float(int)> func27 = [=] (int id)
+    auto func27 = [=] (int id)
     { return particleMass(id); };
-    std::function<float(int)> func28 = [=] (int id)
+    auto func28 = [=] (int id)
     { return viscosity(id); };
-    std::function<float(int)> func29 = [=](int id)
+    auto func29 = [=](int id)
     { return stiffness(id); };
-    std::function<glm::vec3(int)> func29_5 = [=](int id)
+    auto func29_5 = [=](int id)
     { return externalAcceleration(id); };
 
     lua.Register("psa_maxMotionDistance", func18);
@@ -271,19 +392,19 @@ void ParticleScriptAccess::registerLuaFunctions(LuaWrapper & lua)
     lua.Register("psa_externalAcceleration", func29_5);
 
 
-    std::function<int(int, float, float, float, float, float)> func30 = [=](int id, float a, float b, float c, float d, float e)
-    { particleGroup(id)->setImmutableProperties(a, b, c, d, e); return 0; };
+    auto func30 = [=](int id, float a, float b, float c, float d, float e)
+    { setImmutableProperties(id, a, b, c, d, e); return 0; };
 
-    std::function<int(int, float, float, float, float, glm::vec3, float, float, float)> func31 = [=](int id, float a, float b, float c, float d, glm::vec3 d5, float e, float f, float g)
-    { particleGroup(id)->setMutableProperties(a, b, c, d, d5, e, f, g); return 0; };
+    auto func31 = [=](int id, float a, float b, float c, float d, glm::vec3 d5, float e, float f, float g)
+    { setMutableProperties(id, a, b, c, d, d5, e, f, g); return 0; };
 
     lua.Register("psa_setImmutableProperties", func30);
     lua.Register("psa_setMutableProperties", func31);
 
-    std::function<float(int)> func32 = [=](int id)
+    auto func32 = [=](int id)
     { return particleGroup(id)->temperature(); };
 
-    std::function<int(int, float)> func33 = [=](int id, float temperature)
+    auto func33 = [=](int id, float temperature)
     { particleGroup(id)->setTemperature(temperature); return 0; };
 
     lua.Register("psa_temperature", func32);
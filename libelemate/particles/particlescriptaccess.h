@@ -10,6 +10,7 @@
 
 namespace physx { class PxScene; }
 class ParticleGroup;
+struct ParticleGroupState;
 class LuaWrapper;
 
 
@@ -19,17 +20,20 @@ class LuaWrapper;
 class ParticleScriptAccess
 {
 public:
-    /** Must be called from outside to initialize the global instance and its LuaWrapper. */
+    /** Must be called from outside to initialize the global instance. */
     static void initialize(std::unordered_map<unsigned int, ParticleGroup*> & particleGroups);
     static void release();
     static ParticleScriptAccess& instance();
 
     /** Creates an instance of ParticleGroup and registers it, returning the access id */
     int createParticleGroup(bool emittingGroup, const std::string & elementType = "default", uint32_t maxParticleCount = 10000U);
-    /** configures physical parameters of a ParticleGroup with lua script of given elementType. */
+    /** Configures physical parameters of a ParticleGroup with the parameters of given elementType.
+      * Element scripts are evaluated once, and again after LuaWrapper::reloadAll. */
     void setUpParticleGroup(const int id, const std::string & elementType);
 
     int addParticleGroup(ParticleGroup * group);
+    /** Creates a ParticleGroup with the id, attributes and particles of the state, without running the element script. */
+    void restoreParticleGroup(const ParticleGroupState & state);
     void removeParticleGroup(const int id);
     void clearParticleGroups();
 
@@ -53,6 +57,17 @@ protected:
 
     ParticleGroup * particleGroup(const int id);
 
+    /** @brief Properties and temperature of an element, as set by scripts/elements/<element>.lua. */
+    struct ElementParameters;
+    /** @return the cached parameters of the element, evaluating its script if needed */
+    const ElementParameters & elementParameters(const std::string & elementType);
+    /** Run the functions of the element script, recording the properties they set instead of applying them to a group. */
+    void evaluateElementScript(const std::string & elementType, ElementParameters & parameters);
+    /** Registers only the property setters, writing into parameters. The other functions need a particle group. */
+    void registerRecordingLuaFunctions(LuaWrapper & lua, ElementParameters & parameters);
+    /** Set the temperature and run the script of elements with dynamic behaviour, after the properties are set. */
+    void finishParticleGroupSetUp(const int id, const ElementParameters & parameters);
+
 
     /** Callable from within lua scripts. */
     void createParticle(const int id, const float positionX, const float positionY, const float positionZ, const float velocityX, const float velocityY, const float velocityZ);
@@ -130,7 +145,9 @@ protected:
     bool m_gpuParticles;
     uint8_t m_gpuParticlesPauseFlags;
 
-    LuaWrapper * m_lua;
+    std::unordered_map<std::string, std::unique_ptr<ElementParameters>> m_elementParameters;
+    /** LuaWrapper::reloadCount() when the cached parameters were evaluated */
+    unsigned int m_elementParametersReloadCount;
 
     physx::PxScene * m_pxScene;
 
@@ -0,0 +1,115 @@
+#include "particlesnapshot.h"
+
+#include <cassert>
+#include <limits>
+
+#include "particleboxfilter.h"
+
+namespace {
+
+const uint32_t noSlot = std::numeric_limits<uint32_t>::max();
+
+}
+
+uint64_t ParticleSnapshot::s_nextRevision = 0;
+
+ParticleSnapshot::ParticleSnapshot(uint32_t maxParticleCount)
+: m_slots(maxParticleCount, noSlot)
+, m_revision(s_nextRevision++)
+{
+    positionX.reserve(maxParticleCount);
+    positionY.reserve(maxParticleCount);
+    positionZ.reserve(maxParticleCount);
+    velocityX.reserve(maxParticleCount);
+    velocityY.reserve(maxParticleCount);
+    velocityZ.reserve(maxParticleCount);
+    flags.reserve(maxParticleCount);
+    indices.reserve(maxParticleCount);
+}
+
+void ParticleSnapshot::clear()
+{
+    for (uint32_t particleIndex : indices)
+        m_slots.at(particleIndex) = noSlot;
+
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    velocityX.clear();
+    velocityY.clear();
+    velocityZ.clear();
+    flags.clear();
+    indices.clear();
+    bounds = glowutils::AxisAlignedBoundingBox();
+
+    m_revision = s_nextRevision++;
+}
+
+void ParticleSnapshot::append(uint32_t particleIndex, const glm::vec3 & position, const glm::vec3 & velocity, uint16_t particleFlags)
+{
+    assert(particleIndex < m_slots.size());
+    assert(particleFlags != 0);
+
+    m_slots.at(particleIndex) = static_cast<uint32_t>(indices.size());
+
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    velocityZ.push_back(velocity.z);
+    flags.push_back(particleFlags);
+    indices.push_back(particleIndex);
+    bounds.extend(position);
+}
+
+void ParticleSnapshot::release(uint32_t particleIndex)
+{
+    assert(particleIndex < m_slots.size());
+
+    const uint32_t slot = m_slots.at(particleIndex);
+    if (slot == noSlot)
+        return; // created after the last update
+
+    flags.at(slot) = 0;
+    m_slots.at(particleIndex) = noSlot;
+
+    m_revision = s_nextRevision++;
+}
+
+bool ParticleSnapshot::equals(uint32_t i, uint32_t particleIndex, const glm::vec3 & position, const glm::vec3 & velocity, uint16_t particleFlags) const
+{
+    return indices[i] == particleIndex && flags[i] == particleFlags
+        && positionX[i] == position.x && positionY[i] == position.y && positionZ[i] == position.z
+        && velocityX[i] == velocity.x && velocityY[i] == velocity.y && velocityZ[i] == velocity.z;
+}
+
+uint64_t ParticleSnapshot::revision() const
+{
+    return m_revision;
+}
+
+uint32_t ParticleSnapshot::size() const
+{
+    return static_cast<uint32_t>(indices.size());
+}
+
+bool ParticleSnapshot::isValid(uint32_t i) const
+{
+    return flags[i] != 0;
+}
+
+glm::vec3 ParticleSnapshot::position(uint32_t i) const
+{
+    return glm::vec3(positionX[i], positionY[i], positionZ[i]);
+}
+
+glm::vec3 ParticleSnapshot::velocity(uint32_t i) const
+{
+    return glm::vec3(velocityX[i], velocityY[i], velocityZ[i]);
+}
+
+uint32_t ParticleSnapshot::particlesInBox(const glowutils::AxisAlignedBoundingBox & box, std::vector<uint32_t> & slots, glowutils::AxisAlignedBoundingBox & subbox) const
+{
+    return filterPointsInBox(positionX.data(), positionY.data(), positionZ.data(), flags.data(), size(), box, slots, subbox);
+}
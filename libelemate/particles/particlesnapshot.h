@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <glowutils/AxisAlignedBoundingBox.h>
+
+/** @brief Compacted structure of arrays copy of the valid particles of a ParticleGroup.
+  * ParticleGroup fills it once per physics step, all per particle queries read from here instead of locking the PhysX read data. */
+class ParticleSnapshot
+{
+public:
+    ParticleSnapshot(uint32_t maxParticleCount);
+
+    void clear();
+    void append(uint32_t particleIndex, const glm::vec3 & position, const glm::vec3 & velocity, uint16_t flags);
+
+    /** Marks the particle as released. Its entry stays in the arrays, but isValid() will return false. */
+    void release(uint32_t particleIndex);
+
+    /** @return whether the particle at the snapshot position i has exactly these attributes */
+    bool equals(uint32_t i, uint32_t particleIndex, const glm::vec3 & position, const glm::vec3 & velocity, uint16_t flags) const;
+
+    /** Changes with every clear() and release(), unique over all snapshots. */
+    uint64_t revision() const;
+
+    uint32_t size() const;
+    /** @return false if the particle at the snapshot position was released since the last update */
+    bool isValid(uint32_t i) const;
+
+    glm::vec3 position(uint32_t i) const;
+    glm::vec3 velocity(uint32_t i) const;
+
+    /** Append the snapshot positions of all valid particles inside of the box to slots and extend subbox by them, see filterPointsInBox().
+      * @return the number of appended slots */
+    uint32_t particlesInBox(const glowutils::AxisAlignedBoundingBox & box, std::vector<uint32_t> & slots, glowutils::AxisAlignedBoundingBox & subbox) const;
+
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> velocityX;
+    std::vector<float> velocityY;
+    std::vector<float> velocityZ;
+    /** PxParticleFlags of each particle, zero for released particles */
+    std::vector<uint16_t> flags;
+    /** PhysX index of each particle */
+    std::vector<uint32_t> indices;
+    /** tight bounding box of all particles in the snapshot */
+    glowutils::AxisAlignedBoundingBox bounds;
+
+protected:
+    /** PhysX index -> position in the snapshot arrays */
+    std::vector<uint32_t> m_slots;
+
+    uint64_t m_revision;
+    static uint64_t s_nextRevision;
+};
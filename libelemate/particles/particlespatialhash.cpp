@@ -0,0 +1,232 @@
+#include "particlespatialhash.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "particlegroup.h"
+
+namespace {
+
+// 21 bits per axis, biased to allow negative cell coordinates
+const int32_t cellBias = 1 << 20;
+const uint64_t cellMask = (uint64_t(1) << 21) - 1;
+
+}
+
+ParticleSpatialHash::ParticleSpatialHash(float cellSize)
+: m_cellSize(cellSize)
+, m_inverseCellSize(1.0f / cellSize)
+{
+    assert(cellSize > 0.0f);
+}
+
+float ParticleSpatialHash::cellSize() const
+{
+    return m_cellSize;
+}
+
+glm::ivec3 ParticleSpatialHash::cellCoordinates(const glm::vec3 & position) const
+{
+    return glm::ivec3(
+        static_cast<int32_t>(std::floor(position.x * m_inverseCellSize)),
+        static_cast<int32_t>(std::floor(position.y * m_inverseCellSize)),
+        static_cast<int32_t>(std::floor(position.z * m_inverseCellSize)));
+}
+
+uint64_t ParticleSpatialHash::cellKey(const glm::ivec3 & coordinates)
+{
+    const uint64_t x = static_cast<uint64_t>(coordinates.x + cellBias) & cellMask;
+    const uint64_t y = static_cast<uint64_t>(coordinates.y + cellBias) & cellMask;
+    const uint64_t z = static_cast<uint64_t>(coordinates.z + cellBias) & cellMask;
+
+    return (x << 42) | (y << 21) | z;
+}
+
+glm::ivec3 ParticleSpatialHash::cellCoordinates(uint64_t cell)
+{
+    return glm::ivec3(
+        static_cast<int32_t>((cell >> 42) & cellMask) - cellBias,
+        static_cast<int32_t>((cell >> 21) & cellMask) - cellBias,
+        static_cast<int32_t>(cell & cellMask) - cellBias);
+}
+
+uint64_t ParticleSpatialHash::cellAt(const glm::vec3 & position) const
+{
+    return cellKey(cellCoordinates(position));
+}
+
+void ParticleSpatialHash::cellsInVolume(const glowutils::AxisAlignedBoundingBox & volume, std::vector<uint64_t> & cells) const
+{
+    const glm::ivec3 first = cellCoordinates(volume.llf());
+    const glm::ivec3 last = cellCoordinates(volume.urb());
+
+    glm::ivec3 cell;
+    for (cell.x = first.x; cell.x <= last.x; ++cell.x)
+        for (cell.y = first.y; cell.y <= last.y; ++cell.y)
+            for (cell.z = first.z; cell.z <= last.z; ++cell.z)
+                cells.push_back(cellKey(cell));
+}
+
+glowutils::AxisAlignedBoundingBox ParticleSpatialHash::cellBounds(uint64_t cell) const
+{
+    const glm::vec3 llf(cellCoordinates(cell));
+
+    return glowutils::AxisAlignedBoundingBox(llf * m_cellSize, (llf + glm::vec3(1.0f)) * m_cellSize);
+}
+
+glowutils::AxisAlignedBoundingBox ParticleSpatialHash::contactBounds(const Contact & contact) const
+{
+    glowutils::AxisAlignedBoundingBox bounds = cellBounds(contact.leftCell);
+    if (contact.rightCell != contact.leftCell) {
+        const glowutils::AxisAlignedBoundingBox rightBounds = cellBounds(contact.rightCell);
+        bounds.extend(rightBounds.llf());
+        bounds.extend(rightBounds.urb());
+    }
+    return bounds;
+}
+
+void ParticleSpatialHash::updateGroup(unsigned int groupId, ParticleGroup & group)
+{
+    updateGroup(groupId, group.elementName(), group.snapshot());
+}
+
+void ParticleSpatialHash::updateGroup(unsigned int groupId, const std::string & elementName, const ParticleSnapshot & snapshot)
+{
+    auto existing = m_groups.find(groupId);
+    if (existing != m_groups.end() && existing->second.elementName == elementName && existing->second.snapshotRevision == snapshot.revision())
+        return;
+
+    m_scratchCells.clear();
+
+    for (uint32_t i = 0; i < snapshot.size(); ++i) {
+        if (snapshot.isValid(i))
+            m_scratchCells.push_back(cellAt(snapshot.position(i)));
+    }
+
+    std::sort(m_scratchCells.begin(), m_scratchCells.end());
+    m_scratchCells.erase(std::unique(m_scratchCells.begin(), m_scratchCells.end()), m_scratchCells.end());
+
+    GroupCells & groupCells = m_groups[groupId];
+
+    // the group changed its element (e.g. lava to bedrock): rehash it completely
+    if (groupCells.elementName != elementName) {
+        if (!groupCells.elementName.empty()) {
+            CellMap & oldCells = m_elementCells[groupCells.elementName];
+            for (uint64_t cell : groupCells.cells)
+                eraseCell(oldCells, cell, groupId);
+        }
+        groupCells.cells.clear();
+        groupCells.elementName = elementName;
+    }
+
+    CellMap & cellMap = m_elementCells[groupCells.elementName];
+
+    // both lists are sorted: only touch the cells that the group left or entered
+    auto oldIt = groupCells.cells.cbegin();
+    auto newIt = m_scratchCells.cbegin();
+    while (oldIt != groupCells.cells.cend() || newIt != m_scratchCells.cend()) {
+        if (newIt == m_scratchCells.cend() || (oldIt != groupCells.cells.cend() && *oldIt < *newIt)) {
+            eraseCell(cellMap, *oldIt, groupId);
+            ++oldIt;
+        }
+        else if (oldIt == groupCells.cells.cend() || *newIt < *oldIt) {
+            insertCell(cellMap, *newIt, groupId);
+            ++newIt;
+        }
+        else {
+            ++oldIt;
+            ++newIt;
+        }
+    }
+
+    groupCells.cells.swap(m_scratchCells);
+    groupCells.snapshotRevision = snapshot.revision();
+}
+
+void ParticleSpatialHash::removeGroup(unsigned int groupId)
+{
+    auto it = m_groups.find(groupId);
+    if (it == m_groups.end())
+        return;
+
+    CellMap & cellMap = m_elementCells[it->second.elementName];
+    for (uint64_t cell : it->second.cells)
+        eraseCell(cellMap, cell, groupId);
+
+    m_groups.erase(it);
+}
+
+void ParticleSpatialHash::removeStaleGroups(const std::unordered_map<unsigned int, ParticleGroup *> & particleGroups)
+{
+    std::vector<unsigned int> staleGroups;
+    for (const auto & pair : m_groups) {
+        if (particleGroups.find(pair.first) == particleGroups.end())
+            staleGroups.push_back(pair.first);
+    }
+
+    for (unsigned int groupId : staleGroups)
+        removeGroup(groupId);
+}
+
+void ParticleSpatialHash::clear()
+{
+    m_elementCells.clear();
+    m_groups.clear();
+}
+
+void ParticleSpatialHash::findContacts(std::vector<Contact> & contacts) const
+{
+    for (auto leftElement = m_elementCells.cbegin(); leftElement != m_elementCells.cend(); ++leftElement) {
+        auto rightElement = leftElement;
+        for (++rightElement; rightElement != m_elementCells.cend(); ++rightElement) {
+            // iterate over the smaller cell set and look up the cells in the other one
+            const bool leftIsSmaller = leftElement->second.size() < rightElement->second.size();
+            const CellMap & iterated = leftIsSmaller ? leftElement->second : rightElement->second;
+            const CellMap & lookedUp = leftIsSmaller ? rightElement->second : leftElement->second;
+
+            for (const auto & cell : iterated) {
+                const glm::ivec3 coordinates = cellCoordinates(cell.first);
+
+                // particles closer than the cell size are in the same or in neighbouring cells
+                glm::ivec3 offset;
+                for (offset.x = -1; offset.x <= 1; ++offset.x)
+                    for (offset.y = -1; offset.y <= 1; ++offset.y)
+                        for (offset.z = -1; offset.z <= 1; ++offset.z) {
+                            auto other = lookedUp.find(cellKey(coordinates + offset));
+                            if (other == lookedUp.end())
+                                continue;
+
+                            for (unsigned int groupA : cell.second) {
+                                for (unsigned int groupB : other->second) {
+                                    if (groupA < groupB)
+                                        contacts.push_back({ groupA, groupB, cell.first, other->first });
+                                    else
+                                        contacts.push_back({ groupB, groupA, other->first, cell.first });
+                                }
+                            }
+                        }
+            }
+        }
+    }
+}
+
+void ParticleSpatialHash::insertCell(CellMap & cellMap, uint64_t cell, unsigned int groupId)
+{
+    cellMap[cell].push_back(groupId);
+}
+
+void ParticleSpatialHash::eraseCell(CellMap & cellMap, uint64_t cell, unsigned int groupId)
+{
+    auto it = cellMap.find(cell);
+    assert(it != cellMap.end());
+
+    std::vector<unsigned int> & groups = it->second;
+    auto groupIt = std::find(groups.begin(), groups.end(), groupId);
+    assert(groupIt != groups.end());
+    *groupIt = groups.back();
+    groups.pop_back();
+
+    if (groups.empty())
+        cellMap.erase(it);
+}
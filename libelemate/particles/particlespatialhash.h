@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <glowutils/AxisAlignedBoundingBox.h>
+
+#include "particlesnapshot.h"
+
+class ParticleGroup;
+
+/** @brief Uniform grid over all particles, keyed by element name.
+  * Each cell knows which particle groups have particles inside of it. The grid persists between collision checks,
+  * updating a group only touches the cells that the group entered or left since its last update, and groups whose
+  * snapshot didn't change since then are skipped. */
+class ParticleSpatialHash
+{
+public:
+    /** Groups of two different elements occupying the same or neighbouring cells. */
+    struct Contact {
+        unsigned int leftGroup;
+        unsigned int rightGroup;
+        /** cells with particles of the left and the right group */
+        uint64_t leftCell;
+        uint64_t rightCell;
+    };
+
+    /** @param cellSize contact distance: particles of different elements closer than this are always in neighbouring cells */
+    ParticleSpatialHash(float cellSize = 0.3f);
+
+    float cellSize() const;
+
+    /** Re-hash all particles of the group, reading them from the group's snapshot. Nothing is done if the snapshot's revision didn't change. */
+    void updateGroup(unsigned int groupId, ParticleGroup & group);
+    void updateGroup(unsigned int groupId, const std::string & elementName, const ParticleSnapshot & snapshot);
+    void removeGroup(unsigned int groupId);
+    /** Remove all groups that are not contained in the particleGroups map anymore. */
+    void removeStaleGroups(const std::unordered_map<unsigned int, ParticleGroup *> & particleGroups);
+    void clear();
+
+    /** Append the contacts of all pairs of cells that are the same or neighbours and contain particles of two different elements.
+      * For each pair of groups in such a pair of cells, one contact is added. leftGroup < rightGroup in each contact. */
+    void findContacts(std::vector<Contact> & contacts) const;
+
+    glowutils::AxisAlignedBoundingBox cellBounds(uint64_t cell) const;
+    /** bounding box of both cells of the contact */
+    glowutils::AxisAlignedBoundingBox contactBounds(const Contact & contact) const;
+    uint64_t cellAt(const glm::vec3 & position) const;
+    /** Append all cells that intersect the volume. */
+    void cellsInVolume(const glowutils::AxisAlignedBoundingBox & volume, std::vector<uint64_t> & cells) const;
+
+protected:
+    const float m_cellSize;
+    const float m_inverseCellSize;
+
+    struct GroupCells {
+        std::string elementName;
+        std::vector<uint64_t> cells;    // sorted, unique
+        uint64_t snapshotRevision;
+    };
+
+    using CellMap = std::unordered_map<uint64_t, std::vector<unsigned int>>;
+
+    /** element name -> cell -> ids of the groups with particles in this cell */
+    std::map<std::string, CellMap> m_elementCells;
+    std::unordered_map<unsigned int, GroupCells> m_groups;
+
+    /** reused for each group update, to avoid allocations */
+    std::vector<uint64_t> m_scratchCells;
+
+    glm::ivec3 cellCoordinates(const glm::vec3 & position) const;
+    static uint64_t cellKey(const glm::ivec3 & coordinates);
+    static glm::ivec3 cellCoordinates(uint64_t cell);
+
+    void insertCell(CellMap & cellMap, uint64_t cell, unsigned int groupId);
+    void eraseCell(CellMap & cellMap, uint64_t cell, unsigned int groupId);
+
+public:
+    void operator=(ParticleSpatialHash&) = delete;
+};
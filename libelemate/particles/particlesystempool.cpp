@@ -0,0 +1,149 @@
+#include "particlesystempool.h"
+
+#include <cassert>
+#include <fstream>
+
+#include <glow/logging.h>
+#include <glowutils/AxisAlignedBoundingBox.h>
+
+#include "utils/pxcompilerfix.h"
+#include <PxPhysics.h>
+#include <PxScene.h>
+#include <PxSceneLock.h>
+
+#include "rendering/particledrawable.h"
+
+using namespace physx;
+
+namespace {
+
+/** unused entries kept per capacity and gpu flag */
+const size_t maxEntriesPerKey = 16;
+
+}
+
+ParticleSystemPool * ParticleSystemPool::s_instance = nullptr;
+
+void ParticleSystemPool::initialize()
+{
+    assert(s_instance == nullptr);
+    s_instance = new ParticleSystemPool();
+}
+
+void ParticleSystemPool::release()
+{
+    assert(s_instance);
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+ParticleSystemPool & ParticleSystemPool::instance()
+{
+    assert(s_instance);
+    return *s_instance;
+}
+
+ParticleSystemPool::ParticleSystemPool()
+: m_scene(nullptr)
+, m_numCreated(0)
+, m_numReused(0)
+{
+    assert(PxGetPhysics().getNbScenes() == 1);
+    PxScene * pxScenePtrs[1];
+    PxGetPhysics().getScenes(pxScenePtrs, 1);
+    m_scene = pxScenePtrs[0];
+}
+
+ParticleSystemPool::~ParticleSystemPool()
+{
+    for (auto & pair : m_entries) {
+        for (const Entry & entry : pair.second)
+            destroy(entry);
+    }
+
+    glow::debug("ParticleSystemPool: %; particle systems created, %; reused", m_numCreated, m_numReused);
+}
+
+ParticleSystemPool::Entry ParticleSystemPool::acquire(uint32_t maxParticleCount, bool gpuParticles, const std::string & elementName, bool isDown)
+{
+    std::vector<Entry> & entries = m_entries[std::make_pair(maxParticleCount, gpuParticles)];
+
+    if (!entries.empty()) {
+        Entry entry = entries.back();
+        entries.pop_back();
+        ++m_numReused;
+
+        entry.drawable->setElement(elementName);
+        entry.drawable->isDown = isDown;
+        return entry;
+    }
+
+    ++m_numCreated;
+
+    Entry entry;
+    entry.drawable = std::make_shared<ParticleDrawable>(elementName, maxParticleCount, isDown);
+
+    PxSceneWriteLock scopedLock(*m_scene);
+
+    entry.particleSystem = PxGetPhysics().createParticleFluid(maxParticleCount, false);
+    assert(entry.particleSystem);
+    entry.particleSystem->setParticleBaseFlag(PxParticleBaseFlag::eGPU, gpuParticles);
+    entry.particleSystem->setParticleReadDataFlag(PxParticleReadDataFlag::eVELOCITY_BUFFER, true);
+
+    m_scene->addActor(*entry.particleSystem);
+
+    return entry;
+}
+
+void ParticleSystemPool::giveBack(uint32_t maxParticleCount, bool gpuParticles, const Entry & entry)
+{
+    assert(entry.particleSystem && entry.drawable);
+
+    std::vector<Entry> & entries = m_entries[std::make_pair(maxParticleCount, gpuParticles)];
+    if (entries.size() >= maxEntriesPerKey) {
+        destroy(entry);
+        return;
+    }
+
+    {
+        PxSceneWriteLock scopedLock(*m_scene);
+        entry.particleSystem->releaseParticles();
+    }
+
+    entry.drawable->clear();
+
+    entries.push_back(entry);
+}
+
+void ParticleSystemPool::destroy(const Entry & entry)
+{
+    PxSceneWriteLock scopedLock(*m_scene);
+
+    entry.particleSystem->releaseParticles();
+    m_scene->removeActor(*entry.particleSystem);
+    entry.particleSystem->release();
+}
+
+const std::string & ParticleSystemPool::soundFileName(const std::string & elementName)
+{
+    auto it = m_soundFileNames.find(elementName);
+    if (it != m_soundFileNames.end())
+        return it->second;
+
+    std::string fileName = "data/sounds/elements/" + elementName + ".wav";
+    std::ifstream soundFile(fileName);
+    if (!soundFile.good())
+        fileName.clear();
+
+    return m_soundFileNames.emplace(elementName, fileName).first->second;
+}
+
+uint64_t ParticleSystemPool::numCreated() const
+{
+    return m_numCreated;
+}
+
+uint64_t ParticleSystemPool::numReused() const
+{
+    return m_numReused;
+}
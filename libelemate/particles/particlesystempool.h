@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace physx {
+    class PxParticleFluid;
+    class PxScene;
+}
+class ParticleDrawable;
+
+/** @brief Keeps the PhysX particle systems and drawables of destroyed ParticleGroups for reuse.
+  * Creating a particle fluid, adding it to the scene and allocating the drawable's vertices is expensive,
+  * so ParticleGroups acquire these from the pool and hand them back on destruction. */
+class ParticleSystemPool
+{
+public:
+    static void initialize();
+    static void release();
+    static ParticleSystemPool & instance();
+
+    struct Entry {
+        physx::PxParticleFluid * particleSystem;
+        std::shared_ptr<ParticleDrawable> drawable;
+    };
+
+    /** Return a particle system with given capacity and gpu flag that is part of the scene and has no particles,
+      * and a drawable set up for the element. Both are newly created if the pool has no matching entry. */
+    Entry acquire(uint32_t maxParticleCount, bool gpuParticles, const std::string & elementName, bool isDown);
+    /** Release all particles of the entry and keep it for reuse, or destroy it if the pool is full. */
+    void giveBack(uint32_t maxParticleCount, bool gpuParticles, const Entry & entry);
+
+    /** File name of the element's sound, or an empty string if there is none. The file system is only probed once per element. */
+    const std::string & soundFileName(const std::string & elementName);
+
+    /** number of acquired entries that were created from scratch / taken from the pool */
+    uint64_t numCreated() const;
+    uint64_t numReused() const;
+
+protected:
+    ParticleSystemPool();
+    ~ParticleSystemPool();
+
+    static ParticleSystemPool * s_instance;
+
+    void destroy(const Entry & entry);
+
+    physx::PxScene * m_scene;
+
+    /** (max particle count, gpu particles) -> unused entries */
+    std::map<std::pair<uint32_t, bool>, std::vector<Entry>> m_entries;
+    std::unordered_map<std::string, std::string> m_soundFileNames;
+
+    uint64_t m_numCreated;
+    uint64_t m_numReused;
+
+public:
+    ParticleSystemPool(ParticleSystemPool&) = delete;
+    void operator=(ParticleSystemPool&) = delete;
+};
@@ -0,0 +1,72 @@
+#include "culling.h"
+
+#include <cassert>
+
+Frustum::Frustum(const glm::mat4 & viewProjection)
+{
+    // Gribb/Hartmann: the planes are sums and differences of the rows of the matrix
+    const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    m_planes[0] = row3 + row0;
+    m_planes[1] = row3 - row0;
+    m_planes[2] = row3 + row1;
+    m_planes[3] = row3 - row1;
+    m_planes[4] = row3 + row2;
+    m_planes[5] = row3 - row2;
+}
+
+bool Frustum::intersects(const glm::vec3 & llf, const glm::vec3 & urb) const
+{
+    for (const glm::vec4 & plane : m_planes) {
+        // the corner of the box that is farthest in the direction of the plane normal
+        const glm::vec3 corner(
+            plane.x >= 0.0f ? urb.x : llf.x,
+            plane.y >= 0.0f ? urb.y : llf.y,
+            plane.z >= 0.0f ? urb.z : llf.z);
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+std::array<CullingStatistics::Counts, CullingStatistics::numPasses> CullingStatistics::s_frame = {};
+std::array<CullingStatistics::Counts, CullingStatistics::numPasses> CullingStatistics::s_lastFrame = {};
+
+void CullingStatistics::count(CullingPass pass, bool drawn)
+{
+    Counts & counts = s_frame.at(static_cast<unsigned int>(pass));
+    if (drawn)
+        ++counts.drawn;
+    else
+        ++counts.culled;
+}
+
+void CullingStatistics::beginFrame()
+{
+    s_lastFrame = s_frame;
+    s_frame.fill(Counts());
+}
+
+const CullingStatistics::Counts & CullingStatistics::lastFrame(CullingPass pass)
+{
+    return s_lastFrame.at(static_cast<unsigned int>(pass));
+}
+
+const char * CullingStatistics::passName(CullingPass pass)
+{
+    switch (pass) {
+    case CullingPass::Particles:
+        return "particles";
+    case CullingPass::TerrainScene:
+        return "terrain";
+    case CullingPass::TerrainDepthMap:
+        return "terrain depth map";
+    case CullingPass::TerrainShadowMapping:
+        return "terrain shadow mapping";
+    }
+    assert(false);
+    return "";
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+/** @brief The six planes of a view frustum, extracted from a view projection matrix. */
+class Frustum
+{
+public:
+    Frustum(const glm::mat4 & viewProjection);
+
+    /** Conservative test: false only if the box is completely behind one of the planes.
+      * Boxes near the frustum corners may be reported as intersecting although they are outside. */
+    bool intersects(const glm::vec3 & llf, const glm::vec3 & urb) const;
+
+protected:
+    /** left, right, bottom, top, near, far: dot(xyz, p) + w >= 0 for points p inside */
+    std::array<glm::vec4, 6> m_planes;
+};
+
+/** draw passes that cull their objects */
+enum class CullingPass {
+    Particles,
+    TerrainScene,
+    TerrainDepthMap,
+    TerrainShadowMapping
+};
+
+/** @brief Counts the drawn and culled objects of each pass per frame, for the debug overlay. */
+class CullingStatistics
+{
+public:
+    struct Counts {
+        unsigned int drawn;
+        unsigned int culled;
+    };
+
+    static const unsigned int numPasses = 4;
+
+    static void count(CullingPass pass, bool drawn);
+    /** Start counting a new frame, call this once per frame before drawing. */
+    static void beginFrame();
+
+    static const Counts & lastFrame(CullingPass pass);
+    static const char * passName(CullingPass pass);
+
+protected:
+    static std::array<Counts, numPasses> s_frame;
+    static std::array<Counts, numPasses> s_lastFrame;
+};
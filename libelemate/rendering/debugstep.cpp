@@ -1,5 +1,6 @@
 #include "debugstep.h"
 
+#include <string>
 #include <vector>
 
 #include <glow/VertexArrayObject.h>
@@ -8,10 +9,12 @@
 #include <glow/Program.h>
 #include <glowutils/global.h>
 
+#include "culling.h"
 #include "drawable.h"
 #include "particledrawable.h"
 #include "world.h"
 #include "particles/particlecollision.h"
+#include "string_rendering/StringDrawer.h"
 #include "utils/cameraex.h"
 
 bool operator==(const glowutils::AxisAlignedBoundingBox & lhs, const glowutils::AxisAlignedBoundingBox & rhs)
@@ -77,6 +80,34 @@ void DebugStep::draw(const CameraEx & camera)
     glDisable(GL_CULL_FACE);
 }
 
+void DebugStep::drawStatistics(const ShadowMapCache::Counters & lightMapCache)
+{
+    static const CullingPass passes[] = { CullingPass::Particles, CullingPass::TerrainScene, CullingPass::TerrainDepthMap, CullingPass::TerrainShadowMapping };
+
+    TextObject text;
+    text.x = -0.98f;
+    text.y = 0.9f;
+    text.z = 0.0f;
+    text.scale = 0.2f;
+    text.red = text.green = text.blue = 1.0f;
+
+    for (CullingPass pass : passes) {
+        const CullingStatistics::Counts & counts = CullingStatistics::lastFrame(pass);
+        text.text = std::string(CullingStatistics::passName(pass)) + ": " + std::to_string(counts.drawn) + " drawn, "
+            + std::to_string(counts.culled) + " culled";
+        StringDrawer::instance()->paint(text);
+        text.y -= 0.05f;
+    }
+
+    text.text = "Light map: " + std::to_string(lightMapCache.fullUpdates) + " full (" + std::to_string(lightMapCache.viewChanges)
+        + " light moved), " + std::to_string(lightMapCache.partialUpdates) + " partial, " + std::to_string(lightMapCache.reuses) + " reused";
+    StringDrawer::instance()->paint(text);
+    text.y -= 0.05f;
+    text.text = "Light map regions: " + std::to_string(lightMapCache.terrainRegions) + " terrain, " + std::to_string(lightMapCache.handRegions)
+        + " hand, " + std::to_string(lightMapCache.ignoredRegions) + " outside, " + std::to_string(lightMapCache.updatedTexels / 1000000) + "M texels drawn";
+    StringDrawer::instance()->paint(text);
+}
+
 void DebugStep::initialize()
 {
     m_vao = new glow::VertexArrayObject;
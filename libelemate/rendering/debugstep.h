@@ -4,6 +4,8 @@
 
 #include <glow/ref_ptr.h>
 
+#include "shadowmapcache.h"
+
 namespace glow {
     class VertexArrayObject;
     class Buffer;
@@ -17,6 +19,9 @@ public:
     /** draw bounding boxes of Drawable subclasses and the particle collision volumes */
     virtual void draw(const CameraEx & camera) override;
 
+    /** write the drawn and culled objects of the last frame and the light map cache counters on the screen */
+    void drawStatistics(const ShadowMapCache::Counters & lightMapCache);
+
 protected:
     virtual void initialize();
 
@@ -0,0 +1,131 @@
+#include "glstreamingstorage.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <glow/logging.h>
+#include <glow/Buffer.h>
+
+namespace {
+    const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    /** wait in steps of 1 ms, so that a lost context doesn't block forever without a warning */
+    const GLuint64 fenceTimeout = 1000000;
+
+    /** wait until the GPU passed the fence and delete it */
+    void waitForFence(GLsync & fence, const char * storageName, unsigned int region)
+    {
+        if (!fence)
+            return;
+
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fence, 0, fenceTimeout);
+        if (result == GL_WAIT_FAILED)
+            glow::warning("%;: waiting for the region %; failed", storageName, region);
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    /** replace the fence of a region by one after the commands issued so far */
+    void resetFence(GLsync & fence)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void deleteFences(std::vector<GLsync> & fences)
+    {
+        for (GLsync & fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
+
+PersistentStreamingStorage::PersistentStreamingStorage(glow::Buffer & buffer, GLenum target, size_t regionSize, unsigned int numRegions)
+: m_buffer(buffer)
+, m_regionSize(regionSize)
+, m_data(nullptr)
+, m_fences(numRegions, nullptr)
+{
+    assert(isSupported());
+
+    m_buffer.bind();
+    glBufferStorage(target, regionSize * numRegions, nullptr, persistentFlags);
+    m_data = static_cast<char*>(m_buffer.mapRange(0, regionSize * numRegions, persistentFlags));
+    m_buffer.unbind();
+
+    assert(m_data);
+}
+
+PersistentStreamingStorage::~PersistentStreamingStorage()
+{
+    deleteFences(m_fences);
+    m_buffer.unmap();
+}
+
+bool PersistentStreamingStorage::isSupported()
+{
+    return glow::hasExtension("GL_ARB_buffer_storage");
+}
+
+void * PersistentStreamingStorage::beginWrite(unsigned int region)
+{
+    waitForFence(m_fences.at(region), "PersistentStreamingStorage", region);
+
+    return m_data + region * m_regionSize;
+}
+
+void PersistentStreamingStorage::endWrite(unsigned int /*region*/, size_t numBytes)
+{
+    // the mapping is coherent, writes are visible to following commands
+    assert(numBytes <= m_regionSize);
+}
+
+void PersistentStreamingStorage::retire(unsigned int region)
+{
+    resetFence(m_fences.at(region));
+}
+
+StagedStreamingStorage::StagedStreamingStorage(glow::Buffer & buffer, size_t regionSize, unsigned int numRegions)
+: m_buffer(buffer)
+, m_regionSize(regionSize)
+, m_staging(regionSize)
+, m_fences(numRegions, nullptr)
+{
+    m_buffer.setData(regionSize * numRegions, nullptr, GL_DYNAMIC_DRAW);
+}
+
+StagedStreamingStorage::~StagedStreamingStorage()
+{
+    deleteFences(m_fences);
+}
+
+void * StagedStreamingStorage::beginWrite(unsigned int /*region*/)
+{
+    return m_staging.data();
+}
+
+void StagedStreamingStorage::endWrite(unsigned int region, size_t numBytes)
+{
+    assert(numBytes <= m_regionSize);
+    if (numBytes == 0)
+        return;
+
+    // the unsynchronized map doesn't wait for draw calls still reading the region, the fence of its last retire() does
+    waitForFence(m_fences.at(region), "StagedStreamingStorage", region);
+
+    void * dest = m_buffer.mapRange(region * m_regionSize, numBytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    assert(dest);
+    std::memcpy(dest, m_staging.data(), numBytes);
+    m_buffer.unmap();
+}
+
+void StagedStreamingStorage::retire(unsigned int region)
+{
+    resetFence(m_fences.at(region));
+}
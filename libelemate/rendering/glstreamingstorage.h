@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include <glow/global.h>
+
+#include "streamingring.h"
+
+namespace glow {
+    class Buffer;
+}
+
+/** @brief Streaming storage in a persistently and coherently mapped buffer (ARB_buffer_storage).
+  * Written data is visible to the GPU without unmapping, regions are protected with a fence per retire(). */
+class PersistentStreamingStorage : public StreamingStorage
+{
+public:
+    /** allocates immutable storage of numRegions * regionSize bytes for the buffer and maps it
+      * @param target the buffer's binding target */
+    PersistentStreamingStorage(glow::Buffer & buffer, GLenum target, size_t regionSize, unsigned int numRegions);
+    virtual ~PersistentStreamingStorage() override;
+
+    virtual void * beginWrite(unsigned int region) override;
+    virtual void endWrite(unsigned int region, size_t numBytes) override;
+    virtual void retire(unsigned int region) override;
+
+    /** the OpenGL context supports buffer storage */
+    static bool isSupported();
+
+protected:
+    glow::Buffer & m_buffer;
+    const size_t m_regionSize;
+    char * m_data;
+    std::vector<GLsync> m_fences;
+
+public:
+    PersistentStreamingStorage(PersistentStreamingStorage&) = delete;
+    void operator=(PersistentStreamingStorage&) = delete;
+};
+
+/** @brief Streaming storage for contexts without ARB_buffer_storage: the data is written to client memory,
+  * endWrite() uploads the written bytes of the region with an unsynchronized map, after waiting for the fence of the region's last retire(). */
+class StagedStreamingStorage : public StreamingStorage
+{
+public:
+    /** allocates numRegions * regionSize bytes for the buffer */
+    StagedStreamingStorage(glow::Buffer & buffer, size_t regionSize, unsigned int numRegions);
+    virtual ~StagedStreamingStorage() override;
+
+    virtual void * beginWrite(unsigned int region) override;
+    virtual void endWrite(unsigned int region, size_t numBytes) override;
+    virtual void retire(unsigned int region) override;
+
+protected:
+    glow::Buffer & m_buffer;
+    const size_t m_regionSize;
+    std::vector<char> m_staging;
+    std::vector<GLsync> m_fences;
+
+public:
+    StagedStreamingStorage(StagedStreamingStorage&) = delete;
+    void operator=(StagedStreamingStorage&) = delete;
+};
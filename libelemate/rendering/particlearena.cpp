@@ -0,0 +1,148 @@
+#include "particlearena.h"
+
+#include <algorithm>
+#include <cassert>
+
+ParticleArena::ParticleArena(uint32_t initialCapacity)
+: m_capacity(initialCapacity)
+{
+    if (initialCapacity > 0)
+        m_freeRanges.emplace(0, initialCapacity);
+}
+
+uint32_t ParticleArena::allocate(uint32_t maxCount)
+{
+    auto range = std::find_if(m_freeRanges.begin(), m_freeRanges.end(),
+        [maxCount] (const std::pair<const uint32_t, uint32_t> & freeRange) { return freeRange.second - freeRange.first >= maxCount; });
+
+    if (range == m_freeRanges.end()) {
+        // a free range at the end is extended by the new vertices
+        uint32_t tailFree = 0;
+        if (!m_freeRanges.empty() && m_freeRanges.rbegin()->second == m_capacity)
+            tailFree = m_capacity - m_freeRanges.rbegin()->first;
+
+        const uint32_t oldCapacity = m_capacity;
+        m_capacity = std::max(2 * m_capacity, m_capacity + maxCount - tailFree);
+        addFreeRange(oldCapacity, m_capacity);
+
+        range = std::prev(m_freeRanges.end());
+        assert(range->second - range->first >= maxCount);
+    }
+
+    const uint32_t begin = range->first;
+    const uint32_t end = range->second;
+    m_freeRanges.erase(range);
+    if (begin + maxCount < end)
+        m_freeRanges.emplace(begin + maxCount, end);
+
+    uint32_t slot;
+    if (m_freeSlots.empty()) {
+        slot = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back(Slot());
+    }
+    else {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+
+    m_slots.at(slot) = { begin, maxCount, 0, true };
+    return slot;
+}
+
+void ParticleArena::release(uint32_t slot)
+{
+    Slot & released = m_slots.at(slot);
+    assert(released.used);
+
+    addFreeRange(released.offset, released.offset + released.maxCount);
+    released = { 0, 0, 0, false };
+    m_freeSlots.push_back(slot);
+}
+
+uint32_t ParticleArena::offset(uint32_t slot) const
+{
+    assert(m_slots.at(slot).used);
+    return m_slots.at(slot).offset;
+}
+
+uint32_t ParticleArena::maxCount(uint32_t slot) const
+{
+    assert(m_slots.at(slot).used);
+    return m_slots.at(slot).maxCount;
+}
+
+uint32_t ParticleArena::count(uint32_t slot) const
+{
+    assert(m_slots.at(slot).used);
+    return m_slots.at(slot).count;
+}
+
+void ParticleArena::setCount(uint32_t slot, uint32_t count)
+{
+    Slot & changed = m_slots.at(slot);
+    assert(changed.used);
+    assert(count <= changed.maxCount);
+    changed.count = std::min(count, changed.maxCount);
+}
+
+void ParticleArena::clearCounts()
+{
+    for (Slot & slot : m_slots)
+        slot.count = 0;
+}
+
+uint32_t ParticleArena::capacity() const
+{
+    return m_capacity;
+}
+
+uint32_t ParticleArena::liveEnd() const
+{
+    uint32_t end = 0;
+    for (const Slot & slot : m_slots) {
+        if (slot.count > 0)
+            end = std::max(end, slot.offset + slot.count);
+    }
+    return end;
+}
+
+void ParticleArena::drawLists(int32_t baseVertex, std::vector<int32_t> & firsts, std::vector<int32_t> & counts) const
+{
+    for (uint32_t slot = 0; slot < m_slots.size(); ++slot) {
+        if (m_slots[slot].used)
+            appendDraw(slot, baseVertex, firsts, counts);
+    }
+}
+
+bool ParticleArena::appendDraw(uint32_t slot, int32_t baseVertex, std::vector<int32_t> & firsts, std::vector<int32_t> & counts) const
+{
+    const Slot & drawn = m_slots.at(slot);
+    assert(drawn.used);
+    if (drawn.count == 0)
+        return false;
+
+    firsts.push_back(baseVertex + static_cast<int32_t>(drawn.offset));
+    counts.push_back(static_cast<int32_t>(drawn.count));
+    return true;
+}
+
+void ParticleArena::addFreeRange(uint32_t begin, uint32_t end)
+{
+    if (begin == end)
+        return;
+
+    auto next = m_freeRanges.lower_bound(begin);
+    if (next != m_freeRanges.end() && next->first == end) {
+        end = next->second;
+        next = m_freeRanges.erase(next);
+    }
+    if (next != m_freeRanges.begin()) {
+        auto previous = std::prev(next);
+        assert(previous->second <= begin);
+        if (previous->second == begin) {
+            previous->second = end;
+            return;
+        }
+    }
+    m_freeRanges.emplace_hint(next, begin, end);
+}
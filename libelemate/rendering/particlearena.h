@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/** @brief Places the vertices of all particle groups in one vertex buffer, so that they can be drawn with a single multi draw call.
+  * Each group gets a slot: a fixed range of its maximum particle count, and the number of particles it currently draws.
+  * The capacity grows if no free range is large enough, the offsets of existing slots don't change. */
+class ParticleArena
+{
+public:
+    ParticleArena(uint32_t initialCapacity);
+
+    /** reserve a range of maxCount vertices, growing the capacity if needed
+      * @return the slot, which is valid until it is released */
+    uint32_t allocate(uint32_t maxCount);
+    void release(uint32_t slot);
+
+    /** first vertex of the slot's range */
+    uint32_t offset(uint32_t slot) const;
+    uint32_t maxCount(uint32_t slot) const;
+
+    /** number of vertices to draw for the slot, at most maxCount */
+    uint32_t count(uint32_t slot) const;
+    void setCount(uint32_t slot, uint32_t count);
+    /** set the count of all slots to 0, before all groups write their vertices again */
+    void clearCounts();
+
+    uint32_t capacity() const;
+    /** number of vertices up to the last one that is drawn */
+    uint32_t liveEnd() const;
+
+    /** Append the first vertex and count of each slot with a count > 0, as used by glMultiDrawArrays.
+      * @param baseVertex added to the first vertices */
+    void drawLists(int32_t baseVertex, std::vector<int32_t> & firsts, std::vector<int32_t> & counts) const;
+    /** Append the first vertex and count of the slot, if its count is > 0.
+      * @return whether the slot was appended */
+    bool appendDraw(uint32_t slot, int32_t baseVertex, std::vector<int32_t> & firsts, std::vector<int32_t> & counts) const;
+
+protected:
+    struct Slot {
+        uint32_t offset;
+        uint32_t maxCount;
+        uint32_t count;
+        bool used;
+    };
+
+    /** add the range to the free ranges, merging it with its neighbors */
+    void addFreeRange(uint32_t begin, uint32_t end);
+
+    uint32_t m_capacity;
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    /** begin -> end (exclusive) of the unused vertex ranges, disjoint and not adjacent */
+    std::map<uint32_t, uint32_t> m_freeRanges;
+
+public:
+    ParticleArena(ParticleArena&) = delete;
+    void operator=(ParticleArena&) = delete;
+};
@@ -1,6 +1,7 @@
 #include "particledrawable.h"
 
 #include <cassert>
+#include <cstddef>
 
 #include <glow/logging.h>
 #include <glow/VertexArrayObject.h>
@@ -10,15 +11,30 @@
 #include <glowutils/global.h>
 #include "utils/cameraex.h"
 
-#include "utils/pxcompilerfix.h"
-#include <foundation/PxVec3.h>
-#include <particles/PxParticleReadData.h>
-
+#include "culling.h"
+#include "glstreamingstorage.h"
+#include "streamingring.h"
 #include "world.h"
+#include "particles/particlesnapshot.h"
 
-using namespace physx;
+namespace {
+    /** vertices of the arena before the first group is created, grows with the groups */
+    const uint32_t initialArenaCapacity = 1 << 16;
+    const GLuint cameraBlockBinding = 0;
+}
 
 std::list<ParticleDrawable*> ParticleDrawable::s_instances;
+ParticleArena ParticleDrawable::s_arena(initialArenaCapacity);
+const unsigned int ParticleDrawable::s_numVertexRegions = 3;
+std::unique_ptr<StreamingRing> ParticleDrawable::s_vertexRing;
+uint32_t ParticleDrawable::s_vertexRegionSize = 0;
+ParticleDrawable::ParticleVertex * ParticleDrawable::s_vertices = nullptr;
+glow::ref_ptr<glow::VertexArrayObject> ParticleDrawable::s_vao;
+glow::ref_ptr<glow::Buffer> ParticleDrawable::s_vbo;
+glow::ref_ptr<glow::Buffer> ParticleDrawable::s_cameraBuffer;
+glow::ref_ptr<glow::Program> ParticleDrawable::s_program;
+std::vector<int32_t> ParticleDrawable::s_firsts;
+std::vector<int32_t> ParticleDrawable::s_counts;
 
 uint8_t ParticleDrawable::elementIndex(const std::string & elementName)
 {
@@ -44,139 +60,273 @@ ParticleDrawable::ParticleDrawable(const std::string & elementName, unsigned int
 , m_maxParticleCount(maxParticleCount)
 , m_currentNumParticles(0)
 , m_particleSize(1.0f)
-, m_needBufferUpdate(true)
-, m_program(nullptr)
+, m_arenaSlot(0)
 {
     s_instances.push_back(this);
-    m_vertices.resize(m_maxParticleCount);
+    if (!World::instance()->headless())
+        m_arenaSlot = s_arena.allocate(m_maxParticleCount);
 }
 
 void ParticleDrawable::setElement(const std::string & elementName)
 {
     m_elementName = elementName;
     m_elementIndex = elementIndex(elementName);
-    if (m_program)
-        m_program->setUniform("elementIndex", m_elementIndex);
 }
 
 ParticleDrawable::~ParticleDrawable()
 {
     s_instances.remove(this);
+    if (!World::instance()->headless())
+        s_arena.release(m_arenaSlot);
+
+    if (s_instances.empty())
+        releaseShared();
 }
 
 void ParticleDrawable::setParticleSize(float particleSize)
 {
     assert(particleSize > 0);
     m_particleSize = particleSize;
-    if (m_program)
-        m_program->setUniform("particleSize", m_particleSize);
+}
+
+void ParticleDrawable::clear()
+{
+    m_bbox = glowutils::AxisAlignedBoundingBox();
+    m_currentNumParticles = 0;
+    if (!World::instance()->headless())
+        s_arena.setCount(m_arenaSlot, 0);
 }
 
 void ParticleDrawable::drawParticles(const CameraEx & camera)
 {
-    for (auto & instance : s_instances)
-        instance->draw(camera);
+    if (!s_vertexRing)
+        return;
+
+    endVertexWrite();
+    if (!s_vertexRing->hasData())
+        return;
+
+    const Frustum frustum(camera.viewProjectionEx());
+    const int32_t baseVertex = static_cast<int32_t>(s_vertexRing->readRegion() * s_vertexRegionSize);
+
+    s_firsts.clear();
+    s_counts.clear();
+    for (const ParticleDrawable * instance : s_instances) {
+        if (s_arena.count(instance->m_arenaSlot) == 0)
+            continue;
+        const bool visible = frustum.intersects(instance->m_bbox.llf(), instance->m_bbox.urb());
+        CullingStatistics::count(CullingPass::Particles, visible);
+        if (visible)
+            s_arena.appendDraw(instance->m_arenaSlot, baseVertex, s_firsts, s_counts);
+    }
+    if (s_firsts.empty())
+        return;
+
+    s_vao->bind();
+    drawPass(camera, s_firsts, s_counts);
+    s_vao->unbind();
 }
 
-void ParticleDrawable::drawImplementation(const CameraEx & camera)
+void ParticleDrawable::draw(const CameraEx & camera)
 {
-    if (m_needBufferUpdate)
-        updateBuffers();
+    if (!s_vertexRing)
+        return;
+
+    endVertexWrite();
+    if (!s_vertexRing->hasData())
+        return;
 
-    m_program->use();
-    m_program->setUniform("viewProjection", camera.viewProjectionEx());
-    m_program->setUniform("projection", camera.projectionEx());
-    m_program->setUniform("view", camera.view());
-    glm::vec3 viewDir = camera.center() - camera.eye();
-    glm::vec3 lookAtRight = glm::normalize(glm::cross(viewDir, camera.up()));
-    glm::vec3 lookAtUp = glm::normalize(glm::cross(lookAtRight, viewDir));
-    m_program->setUniform("lookAtUp", lookAtUp);
-    m_program->setUniform("lookAtRight", lookAtRight);
-    m_program->setUniform("lookAtFront", glm::normalize(viewDir));
-    m_program->setUniform("znear", camera.zNearEx());
-    m_program->setUniform("zfar", camera.zFarEx());
+    s_vao->bind();
+    drawImplementation(camera);
+    s_vao->unbind();
+}
+
+void ParticleDrawable::drawImplementation(const CameraEx & camera)
+{
+    const uint32_t count = s_arena.count(m_arenaSlot);
+    if (count == 0)
+        return;
 
-    m_vao->drawArrays(GL_POINTS, 0, m_currentNumParticles);
+    const std::vector<int32_t> firsts = { static_cast<int32_t>(s_vertexRing->readRegion() * s_vertexRegionSize + s_arena.offset(m_arenaSlot)) };
+    const std::vector<int32_t> counts = { static_cast<int32_t>(count) };
+    drawPass(camera, firsts, counts);
+}
 
-    m_program->release();
+void ParticleDrawable::drawPass(const CameraEx & camera, const std::vector<int32_t> & firsts, const std::vector<int32_t> & counts)
+{
+    assert(firsts.size() == counts.size());
+
+    const glm::vec3 viewDir = camera.center() - camera.eye();
+    const glm::vec3 lookAtRight = glm::normalize(glm::cross(viewDir, camera.up()));
+    const glm::vec3 lookAtUp = glm::normalize(glm::cross(lookAtRight, viewDir));
+
+    CameraBlock cameraBlock;
+    cameraBlock.viewProjection = camera.viewProjectionEx();
+    cameraBlock.view = camera.view();
+    cameraBlock.projection = camera.projectionEx();
+    cameraBlock.lookAtUp = glm::vec4(lookAtUp, 0.0f);
+    cameraBlock.lookAtRight = glm::vec4(lookAtRight, 0.0f);
+    cameraBlock.lookAtFront = glm::vec4(glm::normalize(viewDir), 0.0f);
+    s_cameraBuffer->setData(sizeof(CameraBlock), &cameraBlock, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, cameraBlockBinding, s_cameraBuffer->id());
+
+    s_program->use();
+    // used by the shared depth utilities, which are not part of the camera block
+    s_program->setUniform("znear", camera.zNearEx());
+    s_program->setUniform("zfar", camera.zFarEx());
+
+    glMultiDrawArrays(GL_POINTS, firsts.data(), counts.data(), static_cast<GLsizei>(firsts.size()));
+
+    s_program->release();
 }
 
 void ParticleDrawable::initialize()
 {
-    m_vao = new glow::VertexArrayObject;
-
-    m_vao->bind();
-    
-    m_vbo = new glow::Buffer(GL_ARRAY_BUFFER);
-    m_vbo->setData(m_maxParticleCount * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+    createShared();
+}
 
-    m_needBufferUpdate = true;
+void ParticleDrawable::createShared()
+{
+    if (!s_vertexRing || s_vertexRegionSize != s_arena.capacity())
+        createVertexBuffer();
 
-    glow::VertexAttributeBinding * vertexBinding = m_vao->binding(0);
-    vertexBinding->setAttribute(0);
-    vertexBinding->setBuffer(m_vbo, 0, sizeof(glm::vec3));
-    vertexBinding->setFormat(3, GL_FLOAT, GL_FALSE, 0);
-    m_vao->enable(0);
+    if (s_program)
+        return;
 
-    m_vao->unbind();
+    s_cameraBuffer = new glow::Buffer(GL_UNIFORM_BUFFER);
 
-    m_program = new glow::Program();
-    m_program->attach(
+    s_program = new glow::Program();
+    s_program->attach(
         glowutils::createShaderFromFile(GL_VERTEX_SHADER, "shader/particles/particle.vert"),
         glowutils::createShaderFromFile(GL_GEOMETRY_SHADER, "shader/particles/particle.geo"),
         World::instance()->sharedShader(GL_FRAGMENT_SHADER, "shader/utils/depth_util.frag"),
         glowutils::createShaderFromFile(GL_FRAGMENT_SHADER, "shader/particles/particle.frag"));
 
-    m_program->setUniform("particleSize", m_particleSize);
-    m_program->setUniform("elementIndex", m_elementIndex);
+    const GLuint blockIndex = glGetUniformBlockIndex(s_program->id(), "ParticleCamera");
+    assert(blockIndex != GL_INVALID_INDEX);
+    glUniformBlockBinding(s_program->id(), blockIndex, cameraBlockBinding);
 }
 
-void ParticleDrawable::updateBuffers()
+void ParticleDrawable::createVertexBuffer()
 {
-    assert(m_vertices.size() <= m_maxParticleCount * sizeof(glm::vec3));
-    
-    glm::vec3 * particleGpuDest = reinterpret_cast<glm::vec3*>(
-        m_vbo->mapRange(0, m_vertices.size() * sizeof(glm::vec3), GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
-    assert(particleGpuDest);
-    memcpy(particleGpuDest, static_cast<void*>(m_vertices.data()), m_vertices.size() * sizeof(glm::vec3));
-    m_vbo->unmap();
+    assert(!s_vertices);
+
+    // unmaps the old buffer
+    s_vertexRing.reset();
+
+    s_vertexRegionSize = s_arena.capacity();
+
+    s_vao = new glow::VertexArrayObject;
+    s_vao->bind();
 
-    m_needBufferUpdate = false;
+    s_vbo = new glow::Buffer(GL_ARRAY_BUFFER);
+    const size_t regionSize = s_vertexRegionSize * sizeof(ParticleVertex);
+    std::unique_ptr<StreamingStorage> storage;
+    if (PersistentStreamingStorage::isSupported())
+        storage.reset(new PersistentStreamingStorage(*s_vbo, GL_ARRAY_BUFFER, regionSize, s_numVertexRegions));
+    else
+        storage.reset(new StagedStreamingStorage(*s_vbo, regionSize, s_numVertexRegions));
+    s_vertexRing.reset(new StreamingRing(std::move(storage), s_numVertexRegions));
+
+    glow::VertexAttributeBinding * vertexBinding = s_vao->binding(0);
+    vertexBinding->setAttribute(0);
+    vertexBinding->setBuffer(s_vbo, 0, sizeof(ParticleVertex));
+    // xyz: position, w: particle size
+    vertexBinding->setFormat(4, GL_FLOAT, GL_FALSE, offsetof(ParticleVertex, position));
+    s_vao->enable(0);
+
+    glow::VertexAttributeBinding * elementBinding = s_vao->binding(1);
+    elementBinding->setAttribute(1);
+    elementBinding->setBuffer(s_vbo, 0, sizeof(ParticleVertex));
+    elementBinding->setIFormat(1, GL_UNSIGNED_INT, offsetof(ParticleVertex, elementIndex));
+    s_vao->enable(1);
+
+    s_vao->unbind();
 }
 
-void ParticleDrawable::updateParticles(const PxParticleReadData * readData)
+void ParticleDrawable::releaseShared()
 {
-    assert(readData);
-    unsigned numParticles = readData->nbValidParticles;
+    s_vertices = nullptr;
+    s_vertexRing.reset();
+    s_vertexRegionSize = 0;
+    s_vao = nullptr;
+    s_vbo = nullptr;
+    s_cameraBuffer = nullptr;
+    s_program = nullptr;
+}
+
+void ParticleDrawable::beginVertexWrite()
+{
+    if (s_vertices)
+        return;
+
+    // new drawables may have grown the arena since the last frame
+    createShared();
+
+    // the new region is empty until the drawables wrote their vertices
+    s_arena.clearCounts();
+    s_vertices = static_cast<ParticleVertex*>(s_vertexRing->beginWrite());
+}
+
+void ParticleDrawable::endVertexWrite()
+{
+    if (!s_vertices)
+        return;
+
+    s_vertexRing->endWrite(s_arena.liveEnd() * sizeof(ParticleVertex));
+    s_vertices = nullptr;
+}
+
+void ParticleDrawable::updateParticles(const ParticleSnapshot & snapshot)
+{
+    unsigned numParticles = snapshot.size();
 
     m_bbox = glowutils::AxisAlignedBoundingBox();
 
     if (numParticles == 0 && m_currentNumParticles == 0)
         return;
 
+    // nothing will be drawn, only the bounding box is used by the simulation
+    if (World::instance()->headless()) {
+        m_bbox = snapshot.bounds;
+        return;
+    }
+
     assert(numParticles <= m_maxParticleCount);
     if (numParticles > m_maxParticleCount) {
         glow::warning("ParticleDrawable::updateParticles: receiving more valid new particles than expected (%;)", numParticles);
         numParticles = m_maxParticleCount;
     }
 
-    PxStrideIterator<const PxVec3> pxPositionIt = readData->positionBuffer;
-    PxStrideIterator<const PxParticleFlags> pxFlagIt = readData->flagsBuffer;
-    unsigned int nextPointIndex = 0;
+    // the OpenGL context is current while updating the visuals
+    beginVertexWrite();
 
-    for (unsigned i = 0; i < readData->validParticleRange; ++i, ++pxPositionIt, ++pxFlagIt) {
-        assert(pxPositionIt.ptr());
-        if (*pxFlagIt & PxParticleFlag::eVALID) {
-            const glm::vec3 & vertex = reinterpret_cast<const glm::vec3&>(*pxPositionIt.ptr());
-            m_vertices.at(nextPointIndex) = vertex;
-            m_bbox.extend(vertex);
-            ++nextPointIndex;
-        }
+    // a group created after the region was mapped may have grown the arena beyond it, the buffer grows with the next region
+    const uint32_t offset = s_arena.offset(m_arenaSlot);
+    if (offset + s_arena.maxCount(m_arenaSlot) > s_vertexRegionSize) {
+        s_arena.setCount(m_arenaSlot, 0);
+        m_currentNumParticles = 0;
+        m_bbox = snapshot.bounds;
+        return;
     }
+    assert(offset + numParticles <= s_vertexRegionSize);
 
-    assert((m_bbox.llf().x != std::numeric_limits<float>::max()) == (numParticles > 0));
+    // write-only: the region may be mapped write-combined memory
+    ParticleVertex * vertices = s_vertices + offset;
+    unsigned int nextPointIndex = 0;
 
-    m_currentNumParticles = nextPointIndex;
+    for (unsigned i = 0; i < numParticles; ++i) {
+        if (!snapshot.isValid(i))
+            continue;
+        const glm::vec3 position = snapshot.position(i);
+        ParticleVertex & vertex = vertices[nextPointIndex];
+        vertex.position = position;
+        vertex.particleSize = m_particleSize;
+        vertex.elementIndex = m_elementIndex;
+        m_bbox.extend(position);
+        ++nextPointIndex;
+    }
 
-    m_needBufferUpdate = true;
+    s_arena.setCount(m_arenaSlot, nextPointIndex);
+    m_currentNumParticles = nextPointIndex;
 }
@@ -2,22 +2,26 @@
 
 #include "drawable.h"
 
+#include <cstdint>
 #include <list>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <glow/ref_ptr.h>
 
 #include <glm/glm.hpp>
 
+#include "particlearena.h"
+
 namespace glow {
     class Program;
 }
-namespace physx {
-    class PxParticleReadData;
-}
 class CameraEx;
+class ParticleSnapshot;
+class StreamingRing;
 
+/** @brief Particles of one particle group. The vertices of all groups are placed in a shared ParticleArena and drawn at once by drawParticles(). */
 class ParticleDrawable : public Drawable
 {
 public:
@@ -32,27 +36,49 @@ public:
     /** Specify in the groups constructor if it is emitting or down. Used to emit a dynamic_cast on subclasses */
     bool isDown;
 
-    /** fetches the number of valid particles and the particle positions from readData and updates the vertex buffers data */
-    void updateParticles(const physx::PxParticleReadData * readData);
+    /** writes the valid particle positions from the snapshot into the drawable's range of the current vertex region */
+    void updateParticles(const ParticleSnapshot & snapshot);
 
     /** set the particles size used for shading */
     void setParticleSize(float particleSize);
 
-    /** draw all instances of this drawable */
+    /** draws only the particles of this drawable */
+    virtual void draw(const CameraEx & camera) override;
+
+    /** draw all instances of this drawable that intersect the camera's frustum, with a single draw call */
     static void drawParticles(const CameraEx & camera);
 
 protected:
     /** The ParticleGroup may directly set the bounding box of the drawable to omit to frequent reading of PhysX data structures. */
     friend class ParticleGroup;
-
-    /** list of all particle drawables, allowing to draw all instances in the drawParticles call. */
-    static std::list<ParticleDrawable*> s_instances;
-
-    /** initialize the vertex buffer, array object and program  */
+    /** The pool resets drawables of released groups. */
+    friend class ParticleSystemPool;
+
+    /** per vertex: position, particle size and element index. The particle size follows the position, both are read as one vec4. */
+    struct ParticleVertex {
+        glm::vec3 position;
+        float particleSize;
+        uint32_t elementIndex;
+    };
+
+    /** camera uniform block of the particle shaders, std140 layout */
+    struct CameraBlock {
+        glm::mat4 viewProjection;
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 lookAtUp;
+        glm::vec4 lookAtRight;
+        glm::vec4 lookAtFront;
+    };
+
+    /** initialize the shared vertex buffer, array object and program */
     virtual void initialize() override;
 
     virtual void drawImplementation(const CameraEx & camera) override;
 
+    /** remove all particles from the drawable, until the next updateParticles() */
+    void clear();
+
     std::string m_elementName;
     uint8_t m_elementIndex;
 
@@ -64,11 +90,42 @@ protected:
 
     float m_particleSize;
 
-    bool m_needBufferUpdate;
-    void updateBuffers();
+    /** range of the drawable in the arena, not used in headless mode */
+    uint32_t m_arenaSlot;
+
+    /** list of all particle drawables, the shared OpenGL objects are released with the last one */
+    static std::list<ParticleDrawable*> s_instances;
 
-    std::vector<glm::vec3> m_vertices;
-    glow::ref_ptr<glow::Program> m_program;
+    /** vertex ranges of all drawables, one region of the vertex ring has the arena's capacity */
+    static ParticleArena s_arena;
+    /** regions of the vertex buffer, so that writing the positions doesn't wait for drawing the last ones */
+    static const unsigned int s_numVertexRegions;
+    static std::unique_ptr<StreamingRing> s_vertexRing;
+    /** arena capacity the vertex buffer was created for */
+    static uint32_t s_vertexRegionSize;
+    /** current region while drawables write their vertices, nullptr otherwise */
+    static ParticleVertex * s_vertices;
+
+    static glow::ref_ptr<glow::VertexArrayObject> s_vao;
+    static glow::ref_ptr<glow::Buffer> s_vbo;
+    static glow::ref_ptr<glow::Buffer> s_cameraBuffer;
+    static glow::ref_ptr<glow::Program> s_program;
+
+    /** create the program and camera buffer, and the vertex buffer for the current arena capacity */
+    static void createShared();
+    /** start writing the next vertex region, recreating the buffer if the arena grew */
+    static void beginVertexWrite();
+    /** make the written vertices available for drawing */
+    static void endVertexWrite();
+    static void createVertexBuffer();
+    static void releaseShared();
+
+    /** bind the program and camera uniforms, call draw and release the program */
+    static void drawPass(const CameraEx & camera, const std::vector<int32_t> & firsts, const std::vector<int32_t> & counts);
+
+    /** reused draw lists of drawParticles */
+    static std::vector<int32_t> s_firsts;
+    static std::vector<int32_t> s_counts;
 
 public:
     ParticleDrawable() = delete;
@@ -18,12 +18,14 @@
 #include "terrain/terrain.h"
 #include "ui/hand.h"
 #include "ui/userinterface.h"
+#include "culling.h"
 #include "particledrawable.h"
 #include "particlestep.h"
 #include "shadowmappingstep.h"
 #include "debugstep.h"
 #include "texturemanager.h"
 #include "io/imagereader.h"
+#include "utils/profiler.h"
 
 Renderer::Renderer()
 : m_drawDebugStep(false)
@@ -151,11 +153,35 @@ void Renderer::initialize()
 
 void Renderer::render(const CameraEx & camera)
 {
-    sceneStep(camera);
-    handStep(camera);
-    m_particleStep->draw(camera);
-    m_shadowMappingStep->draw(camera);
-    flushStep(camera);
+    // measures the time to issue the draw calls, the GPU may still be busy afterwards
+    ELEMATE_PROFILE_ZONE("Renderer::render");
+
+    World::instance()->terrain->beginFrame();
+    CullingStatistics::beginFrame();
+
+    {
+        ELEMATE_PROFILE_ZONE("Renderer::sceneStep");
+        sceneStep(camera);
+    }
+    {
+        ELEMATE_PROFILE_ZONE("Renderer::handStep");
+        handStep(camera);
+    }
+    {
+        ELEMATE_PROFILE_ZONE("ParticleStep::draw");
+        m_particleStep->draw(camera);
+    }
+    {
+        ELEMATE_PROFILE_ZONE("ShadowMappingStep::draw");
+        m_shadowMappingStep->draw(camera);
+    }
+    {
+        ELEMATE_PROFILE_ZONE("Renderer::flushStep");
+        flushStep(camera);
+    }
+
+    if (m_drawDebugStep)
+        m_debugStep->drawStatistics(m_shadowMappingStep->lightMapCacheCounters());
 }
 
 void Renderer::takeScreenShot()
@@ -279,6 +305,11 @@ void Renderer::toggleDrawHeatMap()
     World::instance()->terrain->setDrawHeatMap(m_drawHeatMap);
 }
 
+void Renderer::toggleCacheLightMap()
+{
+    m_shadowMappingStep->setCacheLightMap(!m_shadowMappingStep->cacheLightMap());
+}
+
 void Renderer::resize(int width, int height)
 {
     m_viewport.x = width; m_viewport.y = height;
@@ -46,6 +46,7 @@ public:
     void toggleDrawDebugInfo();
     void setDrawDebugInfo(bool doDraw);
     void toggleDrawHeatMap();
+    void toggleCacheLightMap();
 
     void takeScreenShot();
     void writeScreenShot();
@@ -0,0 +1,108 @@
+#include "shadowmapcache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const float ShadowMapCache::s_fullUpdateRatio = 0.5f;
+
+ShadowMapCache::ShadowMapCache(const glm::ivec2 & size)
+: m_size(size)
+, m_hasView(false)
+, m_viewProjection(1.0f)
+, m_invalidAll(true)
+, m_invalidRect(0, 0, 0, 0)
+{
+}
+
+void ShadowMapCache::setLightView(const glm::mat4 & viewProjection)
+{
+    if (m_hasView && viewProjection == m_viewProjection)
+        return;
+
+    if (m_hasView)
+        ++m_counters.viewChanges;
+    m_hasView = true;
+    m_viewProjection = viewProjection;
+    invalidateAll();
+}
+
+void ShadowMapCache::invalidateAll()
+{
+    m_invalidAll = true;
+}
+
+void ShadowMapCache::invalidate(const glm::vec3 & llf, const glm::vec3 & urb, Source source)
+{
+    if (source == Source::Terrain)
+        ++m_counters.terrainRegions;
+    else
+        ++m_counters.handRegions;
+
+    float minX = std::numeric_limits<float>::max(), minY = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest(), maxY = std::numeric_limits<float>::lowest();
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec4 clip = m_viewProjection * glm::vec4(
+            corner & 1 ? urb.x : llf.x,
+            corner & 2 ? urb.y : llf.y,
+            corner & 4 ? urb.z : llf.z,
+            1.0f);
+        const float x = (clip.x / clip.w * 0.5f + 0.5f) * m_size.x;
+        const float y = (clip.y / clip.w * 0.5f + 0.5f) * m_size.y;
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+    }
+
+    // one texel more on each side, for the rasterization of the border triangles
+    const glm::ivec4 rect(
+        std::max(0, static_cast<int>(std::floor(minX)) - 1),
+        std::max(0, static_cast<int>(std::floor(minY)) - 1),
+        std::min(m_size.x, static_cast<int>(std::ceil(maxX)) + 1),
+        std::min(m_size.y, static_cast<int>(std::ceil(maxY)) + 1));
+
+    if (rect.x >= rect.z || rect.y >= rect.w) {
+        ++m_counters.ignoredRegions;
+        return;
+    }
+
+    if (m_invalidRect.x >= m_invalidRect.z || m_invalidRect.y >= m_invalidRect.w) {
+        m_invalidRect = rect;
+        return;
+    }
+    m_invalidRect = glm::ivec4(
+        std::min(m_invalidRect.x, rect.x), std::min(m_invalidRect.y, rect.y),
+        std::max(m_invalidRect.z, rect.z), std::max(m_invalidRect.w, rect.w));
+}
+
+ShadowMapCache::Update ShadowMapCache::update(glm::ivec4 & rect)
+{
+    const int width = m_invalidRect.z - m_invalidRect.x;
+    const int height = m_invalidRect.w - m_invalidRect.y;
+    const bool hasRect = width > 0 && height > 0;
+    const uint64_t mapTexels = static_cast<uint64_t>(m_size.x) * m_size.y;
+
+    Update result = Update::None;
+    if (m_invalidAll || (hasRect && static_cast<uint64_t>(width) * height >= s_fullUpdateRatio * mapTexels)) {
+        result = Update::Full;
+        rect = glm::ivec4(0, 0, m_size.x, m_size.y);
+        ++m_counters.fullUpdates;
+        m_counters.updatedTexels += mapTexels;
+    }
+    else if (hasRect) {
+        result = Update::Partial;
+        rect = glm::ivec4(m_invalidRect.x, m_invalidRect.y, width, height);
+        ++m_counters.partialUpdates;
+        m_counters.updatedTexels += static_cast<uint64_t>(width) * height;
+    }
+    else
+        ++m_counters.reuses;
+
+    m_invalidAll = false;
+    m_invalidRect = glm::ivec4(0, 0, 0, 0);
+    return result;
+}
+
+const ShadowMapCache::Counters & ShadowMapCache::counters() const
+{
+    return m_counters;
+}
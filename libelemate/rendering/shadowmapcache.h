@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/** @brief Decides which texels of a cached depth map have to be drawn again.
+
+    The whole map is invalid when the light's view projection changes. Changed geometry invalidates the texels
+    its world space bounding box projects to, which are collected into one rectangle per update. */
+class ShadowMapCache
+{
+public:
+    /** @param size width and height of the depth map in texels */
+    ShadowMapCache(const glm::ivec2 & size);
+
+    /** what invalidated a region of the map */
+    enum class Source {
+        Terrain,
+        Hand
+    };
+
+    enum class Update {
+        /** the cached map is still valid */
+        None,
+        /** draw within the rectangle */
+        Partial,
+        Full
+    };
+
+    /** invalidation decisions since the creation of the cache */
+    struct Counters {
+        unsigned int fullUpdates = 0;
+        unsigned int partialUpdates = 0;
+        unsigned int reuses = 0;
+        /** full updates because the light moved or changed its projection */
+        unsigned int viewChanges = 0;
+        unsigned int terrainRegions = 0;
+        unsigned int handRegions = 0;
+        /** regions that don't project into the map */
+        unsigned int ignoredRegions = 0;
+        uint64_t updatedTexels = 0;
+    };
+
+    /** Set the view projection the map is drawn with. Invalidates the whole map if it differs from the previous one. */
+    void setLightView(const glm::mat4 & viewProjection);
+    void invalidateAll();
+    /** invalidate the texels the box between llf and urb covers */
+    void invalidate(const glm::vec3 & llf, const glm::vec3 & urb, Source source);
+
+    /** Get the update for the collected invalidations and mark the map as valid.
+      * @param rect lowest x/y texel and width/height of the partial update */
+    Update update(glm::ivec4 & rect);
+
+    const Counters & counters() const;
+
+    /** Partial updates that cover at least this part of the map draw the whole map instead. */
+    static const float s_fullUpdateRatio;
+
+protected:
+    const glm::ivec2 m_size;
+
+    bool m_hasView;
+    glm::mat4 m_viewProjection;
+
+    bool m_invalidAll;
+    /** min x/y and max x/y of the invalid texels, exclusive, empty if min >= max */
+    glm::ivec4 m_invalidRect;
+
+    Counters m_counters;
+};
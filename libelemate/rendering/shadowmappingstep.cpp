@@ -1,5 +1,7 @@
 #include "shadowmappingstep.h"
 
+#include <cmath>
+
 namespace glow {
     class Buffer; // missing forward declaration in FrameBufferObject.h
 }
@@ -36,15 +38,36 @@ std::vector<glm::vec2> * ShadowMappingStep::s_depthSamples = nullptr;
 static const float earlyBailDistance = 3.0f;
 std::vector<glm::vec2> * ShadowMappingStep::s_earlyBailSamples = nullptr;
 
+const float ShadowMappingStep::s_lightStepRatio = 0.125f;
+
+namespace {
+
+glowutils::AxisAlignedBoundingBox transformedBox(const glowutils::AxisAlignedBoundingBox & box, const glm::mat4 & transform)
+{
+    glowutils::AxisAlignedBoundingBox result;
+    for (int corner = 0; corner < 8; ++corner)
+        result.extend(glm::vec3(transform * glm::vec4(
+            corner & 1 ? box.urb().x : box.llf().x,
+            corner & 2 ? box.urb().y : box.llf().y,
+            corner & 4 ? box.urb().z : box.llf().z,
+            1.0f)));
+    return result;
+}
+
+}
+
 
 ShadowMappingStep::ShadowMappingStep()
 : m_lightCam(new CameraEx(ProjectionType::orthographic))
+, m_cacheLightMap(true)
 {
     m_lightCam->setUp(glm::vec3(0, 1, 0));
     m_lightCam->setTop(World::instance()->terrain->settings.maxHeight);
     m_lightCam->setBottom(-World::instance()->terrain->settings.maxHeight);
     m_lightCam->setViewport(2048, 2048);
 
+    m_lightMapCache.reset(new ShadowMapCache(m_lightCam->viewport()));
+
     m_lightTex = new glow::Texture(GL_TEXTURE_2D);
     m_lightTex->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     m_lightTex->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -83,15 +106,46 @@ ShadowMappingStep::ShadowMappingStep()
 
 void ShadowMappingStep::calculateLightMatrix(const CameraEx & camera)
 {
-    m_lightCam->setEye(glm::vec3(camera.eye().x, 0.0f, camera.eye().z));
-    m_lightCam->setCenter(m_lightCam->eye() - World::instance()->sunPosition());
     const float shadowWidth = camera.zFarEx();
-    m_lightCam->setLeft(-shadowWidth*1.5f);
-    m_lightCam->setRight(shadowWidth*1.5f);
+    glm::vec3 eye(camera.eye().x, 0.0f, camera.eye().z);
+    float halfWidth = shadowWidth * 1.5f;
+
+    if (m_cacheLightMap) {
+        // the cached map stays valid while the camera moves within one step, which the map is extended by
+        const float step = shadowWidth * s_lightStepRatio;
+        eye.x = std::round(eye.x / step) * step;
+        eye.z = std::round(eye.z / step) * step;
+        halfWidth += step;
+    }
+
+    m_lightCam->setEye(eye);
+    m_lightCam->setCenter(m_lightCam->eye() - World::instance()->sunPosition());
+    m_lightCam->setLeft(-halfWidth);
+    m_lightCam->setRight(halfWidth);
     m_lightCam->setZFarEx(shadowWidth);
     m_lightCam->setZNearEx(-shadowWidth);
 }
 
+void ShadowMappingStep::invalidateLightMap()
+{
+    m_lightMapCache->setLightView(m_lightCam->viewProjectionEx());
+
+    for (const auto & pair : World::instance()->terrain->lastFrameChanges()) {
+        if (pair.first.level != TerrainLevel::BaseLevel)    // only the bedrock is drawn into the light map
+            continue;
+        m_lightMapCache->invalidate(pair.second.llf(), pair.second.urb(), ShadowMapCache::Source::Terrain);
+    }
+
+    const Hand & hand = *World::instance()->hand;
+    if (hand.transform() != m_lightMapHandTransform) {
+        const glowutils::AxisAlignedBoundingBox previous = transformedBox(hand.boundingBox(), m_lightMapHandTransform);
+        const glowutils::AxisAlignedBoundingBox current = transformedBox(hand.boundingBox(), hand.transform());
+        m_lightMapCache->invalidate(previous.llf(), previous.urb(), ShadowMapCache::Source::Hand);
+        m_lightMapCache->invalidate(current.llf(), current.urb(), ShadowMapCache::Source::Hand);
+        m_lightMapHandTransform = hand.transform();
+    }
+}
+
 void ShadowMappingStep::drawLightMap(const CameraEx & camera)
 {
     glEnable(GL_DEPTH_TEST);
@@ -99,15 +153,29 @@ void ShadowMappingStep::drawLightMap(const CameraEx & camera)
 
     calculateLightMatrix(camera);
 
+    glm::ivec4 rect;
+    ShadowMapCache::Update update = ShadowMapCache::Update::Full;
+    if (m_cacheLightMap) {
+        invalidateLightMap();
+        update = m_lightMapCache->update(rect);
+        if (update == ShadowMapCache::Update::None)
+            return;
+    }
+
     glViewport(0, 0, m_lightCam->viewport().x, m_lightCam->viewport().y);
 
-    // draw the scene into the light map
+    // draw the scene into the light map, partial updates clear and draw only the invalid texels
     m_lightFbo->bind();
+    if (update == ShadowMapCache::Update::Partial) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(rect.x, rect.y, rect.z, rect.w);
+    }
     glClear(GL_DEPTH_BUFFER_BIT);
 
     World::instance()->terrain->drawDepthMap(*m_lightCam, { "bedrock" });
     World::instance()->hand->drawDepthMap(*m_lightCam);
 
+    glDisable(GL_SCISSOR_TEST);
     m_lightFbo->unbind();
 
     glViewport(0, 0, camera.viewport().x, camera.viewport().y);
@@ -146,6 +214,23 @@ glow::Texture * ShadowMappingStep::result()
     return m_shadowTex.get();
 }
 
+void ShadowMappingStep::setCacheLightMap(bool cache)
+{
+    m_cacheLightMap = cache;
+    // the light's position differs between both modes
+    m_lightMapCache->invalidateAll();
+}
+
+bool ShadowMappingStep::cacheLightMap() const
+{
+    return m_cacheLightMap;
+}
+
+const ShadowMapCache::Counters & ShadowMappingStep::lightMapCacheCounters() const
+{
+    return m_lightMapCache->counters();
+}
+
 void ShadowMappingStep::setUniforms(glow::Program & program)
 {
     if (!s_depthSamples)
@@ -2,12 +2,15 @@
 
 #include "renderingstep.h"
 
+#include <memory>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 #include <glow/ref_ptr.h>
 
+#include "shadowmapcache.h"
+
 namespace glow {
     class Texture;
     class FrameBufferObject;
@@ -28,6 +31,12 @@ public:
     glow::Texture * lightMap();
     glow::Texture * result();
 
+    /** Keep the light map between frames and only draw the regions where the terrain changed or the hand moved.
+      * The light is then moved in steps, instead of following the camera continuously. Enabled by default. */
+    void setCacheLightMap(bool cache);
+    bool cacheLightMap() const;
+    const ShadowMapCache::Counters & lightMapCacheCounters() const;
+
     static void setUniforms(glow::Program & program);
 
     static const glm::mat4 s_biasMatrix;
@@ -39,6 +48,16 @@ protected:
 
     virtual void calculateLightMatrix(const CameraEx & camera);
 
+    /** invalidate the regions of the cached light map that changed since the last frame */
+    void invalidateLightMap();
+
+    bool m_cacheLightMap;
+    std::unique_ptr<ShadowMapCache> m_lightMapCache;
+    /** the hand's transform when it was last drawn into the light map */
+    glm::mat4 m_lightMapHandTransform;
+    /** the light moves in steps of this part of the shadow width, when the light map is cached */
+    static const float s_lightStepRatio;
+
     glow::ref_ptr<glow::FrameBufferObject> m_lightFbo;
     glow::ref_ptr<glow::Texture> m_lightTex;
 
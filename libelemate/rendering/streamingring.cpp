@@ -0,0 +1,50 @@
+#include "streamingring.h"
+
+#include <cassert>
+
+StreamingRing::StreamingRing(std::unique_ptr<StreamingStorage> storage, unsigned int numRegions)
+: m_storage(std::move(storage))
+, m_numRegions(numRegions)
+, m_readRegion(numRegions)
+, m_writing(false)
+{
+    assert(m_storage);
+    assert(numRegions > 0);
+}
+
+void * StreamingRing::beginWrite()
+{
+    assert(!m_writing);
+    m_writing = true;
+
+    if (!hasData())
+        return m_storage->beginWrite(0);
+
+    m_storage->retire(m_readRegion);
+    return m_storage->beginWrite((m_readRegion + 1) % m_numRegions);
+}
+
+void StreamingRing::endWrite(size_t numBytes)
+{
+    assert(m_writing);
+    m_writing = false;
+
+    m_readRegion = hasData() ? (m_readRegion + 1) % m_numRegions : 0;
+    m_storage->endWrite(m_readRegion, numBytes);
+}
+
+bool StreamingRing::hasData() const
+{
+    return m_readRegion < m_numRegions;
+}
+
+unsigned int StreamingRing::readRegion() const
+{
+    assert(hasData());
+    return m_readRegion;
+}
+
+unsigned int StreamingRing::numRegions() const
+{
+    return m_numRegions;
+}
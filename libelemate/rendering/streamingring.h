@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+/** @brief Memory of a StreamingRing, split into regions of equal size.
+  * Implementations must not hand out a region for writing while the GPU may still read it. */
+class StreamingStorage
+{
+public:
+    virtual ~StreamingStorage() = default;
+
+    /** @return pointer to the start of the region, after the GPU finished the commands of its last retire() */
+    virtual void * beginWrite(unsigned int region) = 0;
+    /** the first numBytes of the region were written and are read by the following GPU commands */
+    virtual void endWrite(unsigned int region, size_t numBytes) = 0;
+    /** the GPU commands issued so far are the last ones reading the region */
+    virtual void retire(unsigned int region) = 0;
+};
+
+/** @brief Cycles through the regions of a storage for data the CPU writes each frame and the GPU reads in the same frame.
+  * While one region is drawn, the next ones are written, so that the CPU doesn't wait for the GPU to finish drawing. */
+class StreamingRing
+{
+public:
+    StreamingRing(std::unique_ptr<StreamingStorage> storage, unsigned int numRegions);
+
+    /** retire the region read so far and get the next one for writing
+      * @return pointer to the region, valid until endWrite() */
+    void * beginWrite();
+    /** the written region is read by following GPU commands */
+    void endWrite(size_t numBytes);
+
+    /** true after the first endWrite() */
+    bool hasData() const;
+    /** region of the last endWrite() */
+    unsigned int readRegion() const;
+
+    unsigned int numRegions() const;
+
+protected:
+    std::unique_ptr<StreamingStorage> m_storage;
+    const unsigned int m_numRegions;
+
+    /** m_numRegions while there is no data yet */
+    unsigned int m_readRegion;
+    bool m_writing;
+
+public:
+    StreamingRing(StreamingRing&) = delete;
+    void operator=(StreamingRing&) = delete;
+};
@@ -39,7 +39,7 @@ void BaseTile::bind(const CameraEx & camera)
     m_program->setUniform("modelViewProjection", modelViewProjection);
     m_program->setUniform("znear", camera.zNearEx());
     m_program->setUniform("zfar", camera.zFarEx());
-    m_terrain.setDrawGridOffsetUniform(*m_program, camera.eye());
+    m_terrain.setLodUniforms(*m_program, camera.eye(), *this);
     m_program->setUniform("heightField", TextureManager::getTextureUnit(tileName, "values"));
     std::string temperatureTileName = generateName(TileID(TerrainLevel::TemperatureLevel, m_tileID.x, m_tileID.z));
     m_program->setUniform("temperatures", TextureManager::getTextureUnit(temperatureTileName, "values"));
@@ -55,6 +55,11 @@ void BaseTile::unbind()
     PhysicalTile::unbind();
 }
 
+glow::Program * BaseTile::program()
+{
+    return m_program;
+}
+
 void BaseTile::initialize()
 {
     PhysicalTile::initialize();
@@ -71,6 +76,7 @@ void BaseTile::initializeProgram()
         glowutils::createShaderFromFile(GL_VERTEX_SHADER, "shader/terrain_base.vert"),
         glowutils::createShaderFromFile(GL_GEOMETRY_SHADER, "shader/terrain_base.geo"),
         glowutils::createShaderFromFile(GL_FRAGMENT_SHADER, "shader/terrain_base.frag"),
+        World::instance()->sharedShader(GL_VERTEX_SHADER, "shader/utils/terrain_lod.vert"),
         World::instance()->sharedShader(GL_FRAGMENT_SHADER, "shader/utils/phongLighting.frag"));
 
     m_program->setUniform("terrainTypeID", TextureManager::getTextureUnit(tileName, "terrainType"));
@@ -120,5 +126,5 @@ void BaseTile::setElement(unsigned int tileValueIndex, uint8_t elementIndex)
 {
     assert(elementIndex < m_elementNames.size());
     assert(tileValueIndex < samplesPerAxis * samplesPerAxis);
-    m_terrainTypeData.at(tileValueIndex) = elementIndex;
+    m_terrainTypeData.write().at(tileValueIndex) = elementIndex;
 }
@@ -15,6 +15,7 @@ public:
 
     virtual void bind(const CameraEx & camera) override;
     virtual void unbind() override;
+    virtual glow::Program * program() override;
 
 protected:
     virtual void initialize() override;
@@ -0,0 +1,123 @@
+#include "heatdiffusion.h"
+
+#if defined(__AVX__)
+#define HEATDIFFUSION_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEATDIFFUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+void diffuseHeatRowScalar(const float * north, const float * row, const float * south,
+    const float * northHeights, const float * heights, const float * southHeights,
+    const float * rates, const HeatRelaxation & relaxation, float * out, uint32_t count)
+{
+    const float * west = row - 1;
+    const float * east = row + 1;
+    const float * westHeights = heights - 1;
+    const float * eastHeights = heights + 1;
+    for (uint32_t i = 0; i < count; ++i)
+        out[i] = diffuseHeat(row[i], north[i], south[i], west[i], east[i],
+            heights[i], northHeights[i], southHeights[i], westHeights[i], eastHeights[i],
+            rates[i], relaxation);
+}
+
+namespace {
+
+#if defined(HEATDIFFUSION_AVX)
+struct Relaxation8
+{
+    __m256 zero;
+    __m256 baseTemperature;
+    __m256 slopeAbove;
+    __m256 slopeBelow;
+
+    __m256 target(__m256 height) const
+    {
+        const __m256 above = _mm256_cmp_ps(height, zero, _CMP_GT_OQ);
+        const __m256 slope = _mm256_or_ps(_mm256_and_ps(above, slopeAbove), _mm256_andnot_ps(above, slopeBelow));
+        return _mm256_add_ps(baseTemperature, _mm256_mul_ps(slope, height));
+    }
+
+    /** deviation from the target temperature */
+    __m256 deviation(const float * temperatures, const float * heights) const
+    {
+        return _mm256_sub_ps(_mm256_loadu_ps(temperatures), target(_mm256_loadu_ps(heights)));
+    }
+};
+#elif defined(HEATDIFFUSION_SSE2)
+struct Relaxation4
+{
+    __m128 zero;
+    __m128 baseTemperature;
+    __m128 slopeAbove;
+    __m128 slopeBelow;
+
+    __m128 target(__m128 height) const
+    {
+        const __m128 above = _mm_cmpgt_ps(height, zero);
+        const __m128 slope = _mm_or_ps(_mm_and_ps(above, slopeAbove), _mm_andnot_ps(above, slopeBelow));
+        return _mm_add_ps(baseTemperature, _mm_mul_ps(slope, height));
+    }
+
+    /** deviation from the target temperature */
+    __m128 deviation(const float * temperatures, const float * heights) const
+    {
+        return _mm_sub_ps(_mm_loadu_ps(temperatures), target(_mm_loadu_ps(heights)));
+    }
+};
+#endif
+
+}
+
+void diffuseHeatRow(const float * north, const float * row, const float * south,
+    const float * northHeights, const float * heights, const float * southHeights,
+    const float * rates, const HeatRelaxation & relaxation, float * out, uint32_t count)
+{
+    uint32_t i = 0;
+
+#if defined(HEATDIFFUSION_AVX)
+    const Relaxation8 relax8 = { _mm256_setzero_ps(), _mm256_set1_ps(relaxation.baseTemperature),
+        _mm256_set1_ps(relaxation.slopeAboveZero), _mm256_set1_ps(relaxation.slopeBelowZero) };
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 maxStep = _mm256_set1_ps(relaxation.maxStep);
+    const __m256 minStep = _mm256_set1_ps(-relaxation.maxStep);
+
+    for (; i + 8 <= count; i += 8) {
+        const __m256 center = _mm256_loadu_ps(row + i);
+        const __m256 target = relax8.target(_mm256_loadu_ps(heights + i));
+
+        __m256 neighbors = _mm256_add_ps(relax8.deviation(north + i, northHeights + i), relax8.deviation(south + i, southHeights + i));
+        neighbors = _mm256_add_ps(neighbors, relax8.deviation(row + i - 1, heights + i - 1));
+        neighbors = _mm256_add_ps(neighbors, relax8.deviation(row + i + 1, heights + i + 1));
+        const __m256 laplacian = _mm256_sub_ps(neighbors, _mm256_mul_ps(four, _mm256_sub_ps(center, target)));
+        const __m256 diffused = _mm256_add_ps(center, _mm256_mul_ps(_mm256_loadu_ps(rates + i), laplacian));
+
+        const __m256 delta = _mm256_max_ps(_mm256_min_ps(_mm256_sub_ps(target, diffused), maxStep), minStep);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(diffused, delta));
+    }
+#elif defined(HEATDIFFUSION_SSE2)
+    const Relaxation4 relax4 = { _mm_setzero_ps(), _mm_set1_ps(relaxation.baseTemperature),
+        _mm_set1_ps(relaxation.slopeAboveZero), _mm_set1_ps(relaxation.slopeBelowZero) };
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 maxStep = _mm_set1_ps(relaxation.maxStep);
+    const __m128 minStep = _mm_set1_ps(-relaxation.maxStep);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128 center = _mm_loadu_ps(row + i);
+        const __m128 target = relax4.target(_mm_loadu_ps(heights + i));
+
+        __m128 neighbors = _mm_add_ps(relax4.deviation(north + i, northHeights + i), relax4.deviation(south + i, southHeights + i));
+        neighbors = _mm_add_ps(neighbors, relax4.deviation(row + i - 1, heights + i - 1));
+        neighbors = _mm_add_ps(neighbors, relax4.deviation(row + i + 1, heights + i + 1));
+        const __m128 laplacian = _mm_sub_ps(neighbors, _mm_mul_ps(four, _mm_sub_ps(center, target)));
+        const __m128 diffused = _mm_add_ps(center, _mm_mul_ps(_mm_loadu_ps(rates + i), laplacian));
+
+        const __m128 delta = _mm_max_ps(_mm_min_ps(_mm_sub_ps(target, diffused), maxStep), minStep);
+        _mm_storeu_ps(out + i, _mm_add_ps(diffused, delta));
+    }
+#endif
+
+    diffuseHeatRowScalar(north + i, row + i, south + i, northHeights + i, heights + i, southHeights + i,
+        rates + i, relaxation, out + i, count - i);
+}
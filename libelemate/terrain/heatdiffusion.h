@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+/** Temperature a terrain sample relaxes to: baseTemperature + slope * height, with different slopes above and below zero height. */
+struct HeatRelaxation
+{
+    float baseTemperature;
+    float slopeAboveZero;
+    float slopeBelowZero;
+    /** maximal temperature change per step towards the target temperature */
+    float maxStep;
+
+    float targetTemperature(float height) const
+    {
+        return baseTemperature + (height > 0.0f ? slopeAboveZero : slopeBelowZero) * height;
+    }
+};
+
+/** One explicit time step for a single sample. The deviations from the height dependent target temperatures diffuse with
+  * the 5-point stencil, weighted by rate (diffusivity * dt / dx^2, at most 0.25). Then the sample relaxes towards its target temperature.
+  * Samples at their target temperatures are a steady state, independent of the terrain heights. */
+inline float diffuseHeat(float center, float north, float south, float west, float east,
+    float centerHeight, float northHeight, float southHeight, float westHeight, float eastHeight,
+    float rate, const HeatRelaxation & relaxation)
+{
+    const float target = relaxation.targetTemperature(centerHeight);
+    const float neighbors = (((north - relaxation.targetTemperature(northHeight))
+        + (south - relaxation.targetTemperature(southHeight)))
+        + (west - relaxation.targetTemperature(westHeight)))
+        + (east - relaxation.targetTemperature(eastHeight));
+    const float diffused = center + rate * (neighbors - 4.0f * (center - target));
+
+    float delta = target - diffused;
+    if (delta > relaxation.maxStep)
+        delta = relaxation.maxStep;
+    if (delta < -relaxation.maxStep)
+        delta = -relaxation.maxStep;
+    return diffused + delta;
+}
+
+/** Apply diffuseHeat to count samples of a row and write the results to out, which must not overlap the input rows.
+  * The temperatures and heights are given as rows north, center and south of the output row.
+  * row[-1] and row[count] are read as west and east neighbors of the first and last sample, the same for the center heights.
+  * Uses AVX or SSE2 if the compiler targets them, and a scalar loop otherwise. */
+void diffuseHeatRow(const float * north, const float * row, const float * south,
+    const float * northHeights, const float * heights, const float * southHeights,
+    const float * rates, const HeatRelaxation & relaxation, float * out, uint32_t count);
+
+/** Scalar reference implementation of diffuseHeatRow. */
+void diffuseHeatRowScalar(const float * north, const float * row, const float * south,
+    const float * northHeights, const float * heights, const float * southHeights,
+    const float * rates, const HeatRelaxation & relaxation, float * out, uint32_t count);
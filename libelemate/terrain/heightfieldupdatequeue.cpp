@@ -0,0 +1,134 @@
+#include "heightfieldupdatequeue.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "utils/pxcompilerfix.h"
+#include <PxScene.h>
+
+#include "physicswrapper.h"
+#include "physicaltile.h"
+#include "utils/profiler.h"
+
+using namespace physx;
+
+const unsigned int HeightFieldUpdateQueue::s_mergeSlack = 256;
+
+unsigned int HeightFieldUpdateQueue::Rect::numSamples() const
+{
+    return (maxRow - minRow + 1) * (maxColumn - minColumn + 1);
+}
+
+HeightFieldUpdateQueue::HeightFieldUpdateQueue(unsigned int maxSamplesPerStep)
+: m_maxSamplesPerStep(maxSamplesPerStep)
+{
+}
+
+void HeightFieldUpdateQueue::add(PhysicalTile & tile, unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn)
+{
+    assert(minRow <= maxRow && minColumn <= maxColumn);
+
+    Rect rect = { &tile, minRow, maxRow, minColumn, maxColumn };
+    // the merged rectangle takes the place of the oldest one it contains
+    size_t position = m_rects.size();
+
+    // a grown rectangle may be merged with rectangles that were too far away before
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < m_rects.size(); ++i) {
+            const Rect & other = m_rects.at(i);
+            if (other.tile != rect.tile)
+                continue;
+
+            const Rect united = { rect.tile,
+                std::min(rect.minRow, other.minRow), std::max(rect.maxRow, other.maxRow),
+                std::min(rect.minColumn, other.minColumn), std::max(rect.maxColumn, other.maxColumn) };
+            if (united.numSamples() > rect.numSamples() + other.numSamples() + s_mergeSlack)
+                continue;
+
+            rect = united;
+            m_rects.erase(m_rects.begin() + i);
+            position = std::min(position, i);
+            merged = true;
+            break;
+        }
+    }
+
+    m_rects.insert(m_rects.begin() + std::min(position, m_rects.size()), rect);
+}
+
+void HeightFieldUpdateQueue::remove(const PhysicalTile & tile)
+{
+    m_rects.erase(std::remove_if(m_rects.begin(), m_rects.end(),
+        [&tile](const Rect & rect) { return rect.tile == &tile; }),
+        m_rects.end());
+}
+
+unsigned int HeightFieldUpdateQueue::apply()
+{
+    if (m_rects.empty())
+        return 0;
+
+    ELEMATE_PROFILE_ZONE("HeightFieldUpdateQueue::apply");
+
+    PhysicsWrapper * physicsWrapper = PhysicsWrapper::getInstance();
+    PxScene * pxScene = physicsWrapper->scene();
+
+    physicsWrapper->pauseGPUAcceleration();
+    pxScene->lockWrite();
+
+    m_modifiedTiles.clear();
+    unsigned int numWritten = 0;
+    while (!m_rects.empty()) {
+        Rect & rect = m_rects.front();
+        const unsigned int numColumns = rect.maxColumn - rect.minColumn + 1;
+        const unsigned int budget = numWritten < m_maxSamplesPerStep ? m_maxSamplesPerStep - numWritten : 0;
+
+        unsigned int numRows = std::min(rect.maxRow - rect.minRow + 1, budget / numColumns);
+        if (numRows == 0) {
+            if (numWritten > 0)
+                break;
+            numRows = 1;    // rows wider than the budget must be written anyway
+        }
+
+        const unsigned int maxRow = rect.minRow + numRows - 1;
+        rect.tile->writePxSamples(rect.minRow, maxRow, rect.minColumn, rect.maxColumn, m_samples);
+        numWritten += numRows * numColumns;
+
+        if (std::find(m_modifiedTiles.begin(), m_modifiedTiles.end(), rect.tile) == m_modifiedTiles.end())
+            m_modifiedTiles.push_back(rect.tile);
+
+        if (maxRow == rect.maxRow)
+            m_rects.pop_front();
+        else
+            rect.minRow = maxRow + 1;
+    }
+
+    // once per tile, not per rectangle
+    for (PhysicalTile * tile : m_modifiedTiles)
+        tile->updatePxGeometry();
+
+    pxScene->unlockWrite();
+    physicsWrapper->restoreGPUAccelerated();
+
+    return numWritten;
+}
+
+unsigned int HeightFieldUpdateQueue::maxSamplesPerStep() const
+{
+    return m_maxSamplesPerStep;
+}
+
+void HeightFieldUpdateQueue::setMaxSamplesPerStep(unsigned int maxSamplesPerStep)
+{
+    m_maxSamplesPerStep = maxSamplesPerStep;
+}
+
+size_t HeightFieldUpdateQueue::pendingSamples() const
+{
+    size_t numSamples = 0;
+    for (const Rect & rect : m_rects)
+        numSamples += rect.numSamples();
+    return numSamples;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "utils/pxcompilerfix.h"
+#include <geometry/PxHeightFieldSample.h>
+
+class PhysicalTile;
+
+/** @brief Collects the changed samples of the physx height fields and writes at most a number of samples per simulation step.
+  * Changes are stored as rectangles per tile. Overlapping and nearby rectangles of a tile are merged, so that
+  * dragging the terrain doesn't write the same samples each frame. */
+class HeightFieldUpdateQueue
+{
+public:
+    /** @param maxSamplesPerStep number of samples apply() writes at most */
+    HeightFieldUpdateQueue(unsigned int maxSamplesPerStep);
+
+    /** mark the samples in the rows/columns of the tile as changed, including the max row/column */
+    void add(PhysicalTile & tile, unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn);
+    /** discard the changes of the tile, before it is unloaded */
+    void remove(const PhysicalTile & tile);
+
+    /** Write the oldest changes to the height fields, up to maxSamplesPerStep samples. Rectangles that don't fit are split into rows,
+      * at least one row is written per call. Must be called while the physx scene is not simulating.
+      * @return the number of written samples */
+    unsigned int apply();
+
+    unsigned int maxSamplesPerStep() const;
+    void setMaxSamplesPerStep(unsigned int maxSamplesPerStep);
+
+    /** number of changed samples that are not written yet */
+    size_t pendingSamples() const;
+
+protected:
+    struct Rect {
+        PhysicalTile * tile;
+        unsigned int minRow;
+        unsigned int maxRow;
+        unsigned int minColumn;
+        unsigned int maxColumn;
+
+        unsigned int numSamples() const;
+    };
+
+    /** Rectangles are merged if that writes at most this many samples more than writing them separately,
+      * which is cheaper than a separate modifySamples call. */
+    static const unsigned int s_mergeSlack;
+
+    unsigned int m_maxSamplesPerStep;
+    /** oldest first */
+    std::deque<Rect> m_rects;
+
+    /** reused for the converted samples and modified tiles of each apply() */
+    std::vector<physx::PxHeightFieldSample> m_samples;
+    std::vector<PhysicalTile *> m_modifiedTiles;
+
+public:
+    HeightFieldUpdateQueue(HeightFieldUpdateQueue&) = delete;
+    void operator=(HeightFieldUpdateQueue&) = delete;
+};
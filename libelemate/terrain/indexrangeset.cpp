@@ -0,0 +1,51 @@
+#include "indexrangeset.h"
+
+#include <algorithm>
+
+void IndexRangeSet::insert(unsigned int begin, unsigned int end)
+{
+    if (begin >= end)
+        return;
+
+    // the first range that overlaps or touches [begin, end), if it starts at or before end
+    auto first = std::lower_bound(m_ranges.begin(), m_ranges.end(), begin,
+        [](const Range & range, unsigned int index) { return range.end < index; });
+
+    auto last = first;
+    while (last != m_ranges.end() && last->begin <= end) {
+        begin = std::min(begin, last->begin);
+        end = std::max(end, last->end);
+        ++last;
+    }
+
+    if (first == last) {
+        m_ranges.insert(first, { begin, end });
+        return;
+    }
+
+    *first = { begin, end };
+    m_ranges.erase(first + 1, last);
+}
+
+void IndexRangeSet::clear()
+{
+    m_ranges.clear();
+}
+
+bool IndexRangeSet::empty() const
+{
+    return m_ranges.empty();
+}
+
+const std::vector<IndexRangeSet::Range> & IndexRangeSet::ranges() const
+{
+    return m_ranges;
+}
+
+unsigned int IndexRangeSet::numIndices() const
+{
+    unsigned int numIndices = 0;
+    for (const Range & range : m_ranges)
+        numIndices += range.end - range.begin;
+    return numIndices;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+/** @brief Sorted set of disjoint index ranges. Overlapping and adjacent ranges are merged on insert,
+  * so that repeated edits of the same samples don't accumulate. */
+class IndexRangeSet
+{
+public:
+    /** the indices [begin, end) */
+    struct Range {
+        unsigned int begin;
+        unsigned int end;
+    };
+
+    /** add the indices [begin, end) */
+    void insert(unsigned int begin, unsigned int end);
+    void clear();
+
+    bool empty() const;
+    /** disjoint, non-adjacent ranges, sorted by their begin */
+    const std::vector<Range> & ranges() const;
+    /** number of indices in all ranges */
+    unsigned int numIndices() const;
+
+protected:
+    std::vector<Range> m_ranges;
+};
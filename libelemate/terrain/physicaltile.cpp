@@ -28,13 +28,14 @@
 #include "terrain.h"
 #include "elements.h"
 #include "texturemanager.h"
+#include "utils/profiler.h"
 
 PhysicalTile::PhysicalTile(Terrain & terrain, const TileID & tileID, const std::initializer_list<std::string> & elementNames)
 : TerrainTile(terrain, tileID, -terrain.settings.maxHeight, terrain.settings.maxHeight, 7)
 , m_elementNames(elementNames)
 , m_pxShape(nullptr)
 {
-    m_terrainTypeData.resize(samplesPerAxis * samplesPerAxis);
+    m_terrainTypeData = SharedArray<uint8_t>(samplesPerAxis * samplesPerAxis);
 }
 
 const std::string & PhysicalTile::elementAt(unsigned int row, unsigned int column) const
@@ -59,7 +60,7 @@ void PhysicalTile::initialize()
 void PhysicalTile::createTerrainTypeTexture()
 {
     m_terrainTypeBuffer = new glow::Buffer(GL_TEXTURE_BUFFER);
-    m_terrainTypeBuffer->setData(m_terrainTypeData, GL_DYNAMIC_DRAW);
+    m_terrainTypeBuffer->setData(m_terrainTypeData.values(), GL_DYNAMIC_DRAW);
 
     m_terrainTypeTex = new glow::Texture(GL_TEXTURE_BUFFER);
     m_terrainTypeTex->bind();
@@ -84,28 +85,7 @@ void PhysicalTile::setElement(unsigned int row, unsigned int column, uint8_t ele
 
 void PhysicalTile::updateBuffers()
 {
-    assert(m_updateRangeMinMaxIndex.x < m_updateRangeMinMaxIndex.y);
-
-    uint8_t * bufferDest = reinterpret_cast<uint8_t*>(m_terrainTypeBuffer->mapRange(
-        m_updateRangeMinMaxIndex.x,
-        m_updateRangeMinMaxIndex.y - m_updateRangeMinMaxIndex.x,
-        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
-    assert(bufferDest);
-
-    unsigned int indexOffset = m_updateRangeMinMaxIndex.x;
-
-    for (const UpdateRange & range : m_bufferUpdateList) {
-        assert(indexOffset <= range.startIndex);
-        assert(range.startIndex - indexOffset >= 0);
-        assert(range.startIndex - indexOffset + range.nbElements < m_terrainTypeData.size());
-        memcpy(bufferDest + (range.startIndex - indexOffset),
-            reinterpret_cast<uint8_t*>(m_terrainTypeData.data()) + range.startIndex,
-            range.nbElements);
-    }
-
-    m_terrainTypeBuffer->unmap();
-
-    updatePxHeight();
+    uploadUpdateRanges(*m_terrainTypeBuffer, m_terrainTypeData.data(), sizeof(uint8_t));
 
     TerrainTile::updateBuffers();
 }
@@ -176,91 +156,60 @@ void PhysicalTile::createPxObjects(PxRigidStatic & pxActor)
     delete[] materials;
 }
 
-void PhysicalTile::clearPxBufferUpdateRange()
-{
-    m_pxUpdateBox = UIntBoundingBox();
-}
-
-PhysicalTile::UIntBoundingBox::UIntBoundingBox()
-: minRow(std::numeric_limits<unsigned int>::max())
-, maxRow(std::numeric_limits<unsigned int>::min())
-, minColumn(std::numeric_limits<unsigned int>::max())
-, maxColumn(std::numeric_limits<unsigned int>::min())
-{
-}
-
-void PhysicalTile::addToPxUpdateBox(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn)
-{
-    if (m_pxUpdateBox.minRow > minRow)
-        m_pxUpdateBox.minRow = minRow;
-    if (m_pxUpdateBox.maxRow < maxRow)
-        m_pxUpdateBox.maxRow = maxRow;
-    if (m_pxUpdateBox.minColumn > minColumn)
-        m_pxUpdateBox.minColumn = minColumn;
-    if (m_pxUpdateBox.maxColumn < maxColumn)
-        m_pxUpdateBox.maxColumn = maxColumn;
-}
-
-void PhysicalTile::updatePxHeight()
+void PhysicalTile::writePxSamples(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn, std::vector<PxHeightFieldSample> & samples)
 {
-    // do the physx update only when needed
-    if (m_pxUpdateBox.maxColumn < m_pxUpdateBox.minColumn)
-        return;
+    assert(minRow <= maxRow && maxRow < samplesPerAxis && minColumn <= maxColumn && maxColumn < samplesPerAxis);
 
     PxHeightFieldGeometry geometry;
     bool result = m_pxShape->getHeightFieldGeometry(geometry);
     assert(result);
     if (!result) {
-        glow::warning("TerrainInteractor::setPxHeight could not get height field geometry from physx shape");
+        glow::warning("PhysicalTile::writePxSamples could not get height field geometry from physx shape");
         return;
     }
     PxHeightField * hf = geometry.heightField;
 
-    assert(m_pxUpdateBox.minRow <= m_pxUpdateBox.maxRow && m_pxUpdateBox.minColumn <= m_pxUpdateBox.maxColumn);
-    unsigned int nbRows = m_pxUpdateBox.maxRow - m_pxUpdateBox.minRow + 1;
-    unsigned int nbColumns = m_pxUpdateBox.maxColumn - m_pxUpdateBox.minColumn + 1;
-    unsigned int fieldSize = nbRows * nbColumns;
+    const unsigned int nbRows = maxRow - minRow + 1;
+    const unsigned int nbColumns = maxColumn - minColumn + 1;
+    if (samples.size() < nbRows * nbColumns)
+        samples.resize(nbRows * nbColumns);
 
-    PxHeightFieldSample * samplesM = new PxHeightFieldSample[fieldSize];
+    const float heightScaleToPx = 1.0f / geometry.heightScale;
     for (unsigned int r = 0; r < nbRows; ++r) {
-        unsigned int rowOffset = r * nbColumns;
+        PxHeightFieldSample * sampleRow = samples.data() + r * nbColumns;
+        const unsigned int rowOffset = minColumn + (r + minRow) * samplesPerAxis;
+        const float * heights = m_values.data() + rowOffset;
         for (unsigned int c = 0; c < nbColumns; ++c) {
-            const unsigned int index = c + rowOffset;
-            const unsigned int tileValueIndex = (c + m_pxUpdateBox.minColumn) + (r + m_pxUpdateBox.minRow) * samplesPerAxis;
-            const float terrainHeight = valueAt(tileValueIndex);
-            samplesM[index].height = static_cast<PxI16>(terrainHeight / geometry.heightScale);
-            samplesM[index].materialIndex0 = samplesM[index].materialIndex1 = elementIndexAt(tileValueIndex);
+            sampleRow[c].height = static_cast<PxI16>(heights[c] * heightScaleToPx);
+            sampleRow[c].materialIndex0 = sampleRow[c].materialIndex1 = elementIndexAt(rowOffset + c);
         }
     }
 
     PxHeightFieldDesc descM;
     descM.nbColumns = nbColumns;
     descM.nbRows = nbRows;
-    descM.samples.data = samplesM;
+    descM.samples.data = samples.data();
     descM.format = hf->getFormat();
     descM.samples.stride = hf->getSampleStride();
     descM.thickness = hf->getThickness();
     descM.convexEdgeThreshold = hf->getConvexEdgeThreshold();
     descM.flags = hf->getFlags();
 
-    PhysicsWrapper::getInstance()->pauseGPUAcceleration();
-
-    bool success = hf->modifySamples(m_pxUpdateBox.minColumn, m_pxUpdateBox.minRow, descM);
+    bool success = hf->modifySamples(minColumn, minRow, descM);
     assert(success);
-    if (!success) {
-        glow::warning("TerrainInteractor::setPxHeight could not modify height field.");
+    if (!success)
+        glow::warning("PhysicalTile::writePxSamples could not modify height field.");
+}
+
+void PhysicalTile::updatePxGeometry()
+{
+    PxHeightFieldGeometry geometry;
+    if (!m_pxShape->getHeightFieldGeometry(geometry))
         return;
-    }
+    PxHeightField * hf = geometry.heightField;
 
     PxHeightFieldGeometry newGeometry(hf, PxMeshGeometryFlags(), geometry.heightScale, geometry.rowScale, geometry.columnScale);
-    assert(PxGetPhysics().getNbScenes() == 1);
-    PxScene * pxScenePtrs[1];
-    PxGetPhysics().getScenes(pxScenePtrs, 1);
-    pxScenePtrs[0]->lockWrite();
     m_pxShape->setGeometry(newGeometry);
-    pxScenePtrs[0]->unlockWrite();
-
-    PhysicsWrapper::getInstance()->restoreGPUAccelerated();
 
 #ifdef PX_WINDOWS
     if (PhysicsWrapper::getInstance()->physxGpuAvailable()) {
@@ -268,6 +217,4 @@ void PhysicalTile::updatePxHeight()
         PxParticleGpu::createHeightFieldMirror(*hf, *PhysicsWrapper::getInstance()->cudaContextManager());
     }
 #endif
-
-    clearPxBufferUpdateRange();
 }
@@ -5,6 +5,7 @@
 namespace physx {
     class PxShape;
     class PxRigidStatic;
+    struct PxHeightFieldSample;
 }
 
 /** Base class for tiles which can be rendered, with a representation as physx shape.
@@ -46,19 +47,18 @@ protected:
     virtual void createTerrainTypeTexture();
     glow::ref_ptr<glow::Texture> m_terrainTypeTex;
     glow::ref_ptr<glow::Buffer> m_terrainTypeBuffer;
-    std::vector<uint8_t> m_terrainTypeData;
+    /** shared with snapshots of the tile until the next edit */
+    SharedArray<uint8_t> m_terrainTypeData;
 
     virtual void updateBuffers() override;
 
-    void updatePxHeight();
-    void addToPxUpdateBox(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn);
-    struct UIntBoundingBox {
-        UIntBoundingBox();
-        unsigned int minRow; unsigned int maxRow; unsigned int minColumn; unsigned int maxColumn;
-    };
-    UIntBoundingBox m_pxUpdateBox;
-    void clearPxBufferUpdateRange();
+    /** Convert the heights and elements in the rows/columns to height field samples and write them to the physx height field.
+      * @param samples buffer for the conversion, resized if needed */
+    void writePxSamples(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn, std::vector<physx::PxHeightFieldSample> & samples);
+    /** apply the written samples to the shape, call this after writePxSamples */
+    void updatePxGeometry();
 
     friend class TerrainInteraction;
     friend class TemperatureTile;
+    friend class HeightFieldUpdateQueue;
 };
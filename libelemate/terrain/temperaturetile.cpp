@@ -1,5 +1,8 @@
 #include "temperaturetile.h"
 
+#include <algorithm>
+#include <cassert>
+#include <functional>
 #include <limits>
 #include <cmath>
 
@@ -8,6 +11,9 @@
 #include <glm/glm.hpp>
 
 #include "physicaltile.h"
+#include "terrain.h"
+#include "elements.h"
+#include "utils/workerpool.h"
 
 // these values also influent the effect range of the TerrainInteraction (using a std deviation)
 const celsius TemperatureTile::minTemperature = -273.15f;
@@ -17,21 +23,42 @@ const celsius TemperatureTile::minLavaTemperature = 700.0f;
 const celsius TemperatureTile::maxGrassTemperature = 300.0f;
 
 namespace {
-    template<typename T>
-    struct Bounds {
-        Bounds(T min = std::numeric_limits<T>::max(), T max = std::numeric_limits<T>::lowest())
-            : min(min), max(max)
-        {}
-        T min;
-        T max;
-        void extend(T value)
-        {
-            if (min > value)
-                min = value;
-            if (max < value)
-                max = value;
-        }
+    const double timeStep = 0.1;
+    /** steps that didn't fit into long frames are dropped */
+    const unsigned int maxStepsPerUpdate = 5;
+    /** the explicit scheme is stable for rates up to 0.25 */
+    const float maxDiffusionRate = 0.2f;
+    const celsius relaxationPerSecond = 1.0f;
+    /** smaller changes don't keep a block dirty */
+    const celsius minChange = 0.001f;
+
+    /** heat capacity of a sample, relative to one particle */
+    const float sampleHeatCapacity = 20.0f;
+    /** fraction of the temperature difference that is exchanged between particles and samples per exchangeHeat() */
+    const float heatExchangeRate = 0.1f;
+
+    enum BlockChange : uint8_t {
+        NorthEdge = 1,
+        SouthEdge = 2,
+        WestEdge = 4,
+        EastEdge = 8,
+        ChangedBlock = 16
     };
+
+    /** a stripe is only worth running in parallel for this many dirty blocks */
+    const unsigned int minBlocksPerStripe = 8;
+
+    /** Call function(stripe, blockRowsBegin, blockRowsEnd) for each stripe of the block rows, on the threads of the worker pool. */
+    void forEachStripe(const std::vector<unsigned int> & blockRows, unsigned int numStripes,
+        const std::function<void(unsigned int, const unsigned int *, const unsigned int *)> & function)
+    {
+        const unsigned int * begin = blockRows.data();
+        const unsigned int numBlockRows = static_cast<unsigned int>(blockRows.size());
+
+        WorkerPool::instance().forEach(numStripes, [&function, begin, numBlockRows, numStripes](unsigned int stripe) {
+            function(stripe, begin + numBlockRows * stripe / numStripes, begin + numBlockRows * (stripe + 1) / numStripes);
+        });
+    }
 }
 
 TemperatureTile::TemperatureTile(Terrain & terrain, const TileID & tileID, PhysicalTile & baseTile, PhysicalTile & liquidTile)
@@ -41,114 +68,363 @@ TemperatureTile::TemperatureTile(Terrain & terrain, const TileID & tileID, Physi
 , m_deltaTime(0.0f)
 , m_baseBedrockIndex(baseTile.elementIndex("bedrock"))
 , m_baseGrassIndex(baseTile.elementIndex("grassland"))
+, m_nextValues(samplesPerAxis * samplesPerAxis)
+, m_rowChanges(samplesPerAxis)
+, m_blocksPerAxis((samplesPerAxis + s_blockSize - 1) / s_blockSize)
+, m_dirtyBlocks(m_blocksPerAxis * m_blocksPerAxis, 0)
+, m_blockEdgeChanges(m_blocksPerAxis * m_blocksPerAxis, 0)
+, m_particleCounts(samplesPerAxis * samplesPerAxis, 0)
+, m_stripeScratch(WorkerPool::instance().numThreads())
 {
+    static const celsius baseTemp = 20.0f;
+    static const celsius baseWaterTemp = 4.0f;
+    m_relaxation.baseTemperature = baseTemp;
+    m_relaxation.slopeAboveZero = -baseTemp / (m_baseTile.maxValidValue * 0.75f);
+    m_relaxation.slopeBelowZero = (baseTemp - baseWaterTemp) / m_baseTile.maxValidValue;
+    m_relaxation.maxStep = static_cast<celsius>(relaxationPerSecond * timeStep);
+
+    for (StripeScratch & scratch : m_stripeScratch) {
+        scratch.rates.resize(samplesPerAxis);
+        scratch.blockChanges.resize(m_blocksPerAxis);
+    }
+
+    for (const std::string & elementName : m_baseTile.m_elementNames) {
+        const float rate = static_cast<float>(Elements::thermalDiffusivity(elementName) * timeStep / (sampleInterval * sampleInterval));
+        m_ratesByElement.push_back(std::min(rate, maxDiffusionRate));
+    }
+
+    std::vector<float> & temperatures = m_values.write();
     for (unsigned int r = 0; r < samplesPerAxis; ++r) {
         unsigned int rowOffset = r*samplesPerAxis;
         for (unsigned int c = 0; c < samplesPerAxis; ++c) {
-            m_values.at(c + rowOffset) = temperatureByHeight(m_baseTile.valueAt(r, c));
+            temperatures.at(c + rowOffset) = temperatureByHeight(m_baseTile.valueAt(r, c));
         }
     }
 }
 
 celsius TemperatureTile::temperatureByHeight(meter height)
 {
-    static const celsius baseTemp = 20.0f;
-    static const celsius baseWaterTemp = 4.0f;
-    if (height > 0)
-        return (-baseTemp / (m_baseTile.maxValidValue * 0.75f)) * height + baseTemp;
-    else
-        return ((baseTemp - baseWaterTemp) / m_baseTile.maxValidValue) * height + baseTemp;
+    return m_relaxation.targetTemperature(height);
 }
 
 void TemperatureTile::updatePhysics(double delta)
 {
     m_deltaTime += delta;
 
-    if (m_deltaTime < 0.5)
-        return;
-    else
+    unsigned int numSteps = 0;
+    for (; m_deltaTime >= timeStep && numSteps < maxStepsPerUpdate; ++numSteps) {
+        diffusionStep();
+        m_deltaTime -= timeStep;
+    }
+
+    if (m_deltaTime >= timeStep)
         m_deltaTime = 0.0;
+}
 
-    for (unsigned int r = 0; r < samplesPerAxis; ++r) {
-        unsigned int rowOffset = r*samplesPerAxis;
+void TemperatureTile::diffusionStep()
+{
+    m_dirtyBlockRows.clear();
+    unsigned int numDirtyBlocks = 0;
+    for (unsigned int blockRow = 0; blockRow < m_blocksPerAxis; ++blockRow) {
+        const auto rowBegin = m_dirtyBlocks.cbegin() + blockRow * m_blocksPerAxis;
+        const unsigned int numDirty = static_cast<unsigned int>(std::count(rowBegin, rowBegin + m_blocksPerAxis, 1));
+        if (numDirty == 0)
+            continue;
+        m_dirtyBlockRows.push_back(blockRow);
+        numDirtyBlocks += numDirty;
+    }
 
-        Bounds<unsigned int> activeIndex;
-        Bounds<unsigned int> activeHeightIndex;
-        bool temperaturesChanged = false;
-        bool physicalTilesChanged = false;
+    if (m_dirtyBlockRows.empty())
+        return;
 
-        for (unsigned int c = 0; c < samplesPerAxis; ++c) {
-            const unsigned int index = c + rowOffset;
+    // each stripe of block rows is updated by one thread. The stencil reads the current temperatures of neighboring stripes,
+    // so they are only written in the second pass.
+    const unsigned int numStripes = std::max(1u, std::min({ static_cast<unsigned int>(m_stripeScratch.size()),
+        numDirtyBlocks / minBlocksPerStripe,
+        static_cast<unsigned int>(m_dirtyBlockRows.size()) }));
+
+    using namespace std::placeholders;
+    forEachStripe(m_dirtyBlockRows, numStripes, std::bind(&TemperatureTile::diffuseStripe, this, _1, _2, _3));
+    // the stripes write all levels of the tile, copy the values still shared with a snapshot before the threads write them
+    m_values.write();
+    m_baseTile.m_values.write();
+    m_baseTile.m_terrainTypeData.write();
+    m_liquidTile.m_values.write();
+    forEachStripe(m_dirtyBlockRows, numStripes, std::bind(&TemperatureTile::applyStripe, this, _1, _2, _3));
+
+    // heat flows into the neighbor blocks of changed border samples
+    for (const unsigned int blockRow : m_dirtyBlockRows) {
+        for (unsigned int blockColumn = 0; blockColumn < m_blocksPerAxis; ++blockColumn) {
+            uint8_t & edges = m_blockEdgeChanges.at(blockRow * m_blocksPerAxis + blockColumn);
+            if ((edges & NorthEdge) && blockRow > 0)
+                m_dirtyBlocks.at((blockRow - 1) * m_blocksPerAxis + blockColumn) = 1;
+            if ((edges & SouthEdge) && blockRow + 1 < m_blocksPerAxis)
+                m_dirtyBlocks.at((blockRow + 1) * m_blocksPerAxis + blockColumn) = 1;
+            if ((edges & WestEdge) && blockColumn > 0)
+                m_dirtyBlocks.at(blockRow * m_blocksPerAxis + blockColumn - 1) = 1;
+            if ((edges & EastEdge) && blockColumn + 1 < m_blocksPerAxis)
+                m_dirtyBlocks.at(blockRow * m_blocksPerAxis + blockColumn + 1) = 1;
+            edges = 0;
+        }
+    }
 
-            // update temperature at current position, continue if it didn't change
-            if (!updateTemperature(index))
-                continue;
+    // the buffer update lists are not thread safe
+    for (const unsigned int blockRow : m_dirtyBlockRows) {
+        const unsigned int rowEnd = std::min((blockRow + 1) * s_blockSize, samplesPerAxis);
+        for (unsigned int r = blockRow * s_blockSize; r < rowEnd; ++r) {
+            const RowChanges & changes = m_rowChanges.at(r);
+
+            if (!changes.temperatures.empty())
+                addBufferUpdateRange(changes.temperatures.min, changes.temperatures.max - changes.temperatures.min + 1);
+            if (!changes.heights.empty()) {
+                m_baseTile.addBufferUpdateRange(changes.heights.min, changes.heights.max - changes.heights.min + 1);
+                m_liquidTile.addBufferUpdateRange(changes.heights.min, changes.heights.max - changes.heights.min + 1);
+            }
+        }
+    }
+}
 
-            temperaturesChanged = true;
-            activeIndex.extend(index);
+unsigned int TemperatureTile::dirtyRunEnd(unsigned int blockRow, unsigned int & blockColumn) const
+{
+    const uint8_t * dirty = m_dirtyBlocks.data() + blockRow * m_blocksPerAxis;
+    while (blockColumn < m_blocksPerAxis && !dirty[blockColumn])
+        ++blockColumn;
+
+    unsigned int runEnd = blockColumn;
+    while (runEnd < m_blocksPerAxis && dirty[runEnd])
+        ++runEnd;
+    return runEnd;
+}
 
-            if (updateTerrainType(index)) {
-                physicalTilesChanged = true;
-                activeHeightIndex.extend(index);
+void TemperatureTile::diffuseStripe(unsigned int stripe, const unsigned int * blockRowsBegin, const unsigned int * blockRowsEnd)
+{
+    const unsigned int n = samplesPerAxis;
+    const float * temperatures = m_values.data();
+    const float * heights = m_baseTile.m_values.data();
+    const uint8_t * elements = m_baseTile.m_terrainTypeData.data();
+    std::vector<float> & rates = m_stripeScratch[stripe].rates;
+
+    for (const unsigned int * blockRow = blockRowsBegin; blockRow != blockRowsEnd; ++blockRow) {
+        const unsigned int rowEnd = std::min((*blockRow + 1) * s_blockSize, n);
+
+        // row by row over runs of neighboring dirty blocks, so that the rows are read sequentially
+        for (unsigned int r = *blockRow * s_blockSize; r < rowEnd; ++r) {
+            const unsigned int rowOffset = r * n;
+            // no heat flows over the tile border
+            const unsigned int northOffset = r > 0 ? rowOffset - n : rowOffset;
+            const unsigned int southOffset = r + 1 < n ? rowOffset + n : rowOffset;
+            const float * north = temperatures + northOffset;
+            const float * row = temperatures + rowOffset;
+            const float * south = temperatures + southOffset;
+            const float * northHeights = heights + northOffset;
+            const float * rowHeights = heights + rowOffset;
+            const float * southHeights = heights + southOffset;
+            float * out = m_nextValues.data() + rowOffset;
+
+            unsigned int blockColumn = 0;
+            for (unsigned int runEnd = dirtyRunEnd(*blockRow, blockColumn); blockColumn < runEnd; blockColumn = runEnd, runEnd = dirtyRunEnd(*blockRow, blockColumn)) {
+                const unsigned int columnBegin = blockColumn * s_blockSize;
+                const unsigned int columnEnd = std::min(runEnd * s_blockSize, n);
+                // the kernel reads the west and east neighbors, the samples at the tile border are handled separately
+                const unsigned int kernelBegin = std::max(columnBegin, 1u);
+                const unsigned int kernelEnd = std::max(kernelBegin, std::min(columnEnd, n - 1));
+
+                for (unsigned int c = columnBegin; c < columnEnd; ++c)
+                    rates[c] = m_ratesByElement[elements[rowOffset + c]];
+
+                if (columnBegin < kernelBegin)
+                    out[0] = diffuseHeat(row[0], north[0], south[0], row[0], row[1],
+                        rowHeights[0], northHeights[0], southHeights[0], rowHeights[0], rowHeights[1],
+                        rates[0], m_relaxation);
+
+                diffuseHeatRow(north + kernelBegin, row + kernelBegin, south + kernelBegin,
+                    northHeights + kernelBegin, rowHeights + kernelBegin, southHeights + kernelBegin,
+                    rates.data() + kernelBegin, m_relaxation, out + kernelBegin, kernelEnd - kernelBegin);
+
+                if (kernelEnd < columnEnd) {
+                    const unsigned int c = n - 1;
+                    out[c] = diffuseHeat(row[c], north[c], south[c], row[c - 1], row[c],
+                        rowHeights[c], northHeights[c], southHeights[c], rowHeights[c - 1], rowHeights[c],
+                        rates[c], m_relaxation);
+                }
             }
+        }
+    }
+}
 
-            if (!updateSolidLiquid(index))
-                continue;
-
-            physicalTilesChanged = true;
-            activeHeightIndex.extend(index);
+void TemperatureTile::applyStripe(unsigned int stripe, const unsigned int * blockRowsBegin, const unsigned int * blockRowsEnd)
+{
+    const unsigned int n = samplesPerAxis;
+    std::vector<float> & temperatures = m_values.write();
+    std::vector<uint8_t> & blockChanges = m_stripeScratch[stripe].blockChanges;
+
+    for (const unsigned int * blockRow = blockRowsBegin; blockRow != blockRowsEnd; ++blockRow) {
+        const unsigned int rowBegin = *blockRow * s_blockSize;
+        const unsigned int rowEnd = std::min(rowBegin + s_blockSize, n);
+        // per block of the row: ChangedBlock and the edges at which samples changed
+        std::fill(blockChanges.begin(), blockChanges.end(), 0);
+
+        for (unsigned int r = rowBegin; r < rowEnd; ++r) {
+            const unsigned int rowOffset = r * n;
+            const uint8_t rowEdges = (r == rowBegin ? NorthEdge : 0) | (r + 1 == rowEnd ? SouthEdge : 0);
+            RowChanges & changes = m_rowChanges[r];
+            changes.temperatures.reset();
+            changes.heights.reset();
+
+            unsigned int blockColumn = 0;
+            for (unsigned int runEnd = dirtyRunEnd(*blockRow, blockColumn); blockColumn < runEnd; blockColumn = runEnd, runEnd = dirtyRunEnd(*blockRow, blockColumn)) {
+                const unsigned int columnEnd = std::min(runEnd * s_blockSize, n);
+
+                for (unsigned int c = blockColumn * s_blockSize; c < columnEnd; ++c) {
+                    const unsigned int index = c + rowOffset;
+
+                    const celsius next = m_nextValues[index];
+                    const bool changed = std::abs(next - temperatures[index]) >= minChange;
+                    temperatures[index] = next;
+
+                    if (!changed)
+                        continue;
+
+                    const unsigned int column = c % s_blockSize;
+                    blockChanges[c / s_blockSize] |= ChangedBlock | rowEdges
+                        | (column == 0 ? WestEdge : 0) | (column + 1 == s_blockSize || c + 1 == n ? EastEdge : 0);
+                    changes.temperatures.extend(index);
+
+                    if (next >= maxGrassTemperature && updateTerrainType(index))
+                        changes.heights.extend(index);
+
+                    if (updateSolidLiquid(index))
+                        changes.heights.extend(index);
+                }
+            }
         }
 
-        if (temperaturesChanged)
-            addBufferUpdateRange(activeIndex.min, activeIndex.max - activeIndex.max + 1);
-        if (physicalTilesChanged) {
-            m_baseTile.addBufferUpdateRange(activeHeightIndex.min, activeHeightIndex.max - activeHeightIndex.min + 1);
-            m_liquidTile.addBufferUpdateRange(activeHeightIndex.min, activeHeightIndex.max - activeHeightIndex.min + 1);
+        for (unsigned int blockColumn = 0; blockColumn < m_blocksPerAxis; ++blockColumn) {
+            const unsigned int block = *blockRow * m_blocksPerAxis + blockColumn;
+            if (!m_dirtyBlocks[block])
+                continue;
+            // the block is clean when all its temperatures reached a steady state
+            m_dirtyBlocks[block] = (blockChanges[blockColumn] & ChangedBlock) ? 1 : 0;
+            m_blockEdgeChanges[block] = blockChanges[blockColumn] & ~ChangedBlock;
         }
     }
 }
 
-bool TemperatureTile::updateTemperature(unsigned int index)
+void TemperatureTile::markDirty(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn)
 {
-    static const celsius tempStep = 0.5f;
-    static const celsius minStep = 0.001f;
+    assert(minRow <= maxRow && maxRow < samplesPerAxis);
+    assert(minColumn <= maxColumn && maxColumn < samplesPerAxis);
 
-    celsius currentTemp = m_values.at(index);
-    celsius reverend = temperatureByHeight(m_baseTile.valueAt(index));
-    celsius tempDelta = currentTemp - reverend;
+    for (unsigned int blockRow = minRow / s_blockSize; blockRow <= maxRow / s_blockSize; ++blockRow)
+        for (unsigned int blockColumn = minColumn / s_blockSize; blockColumn <= maxColumn / s_blockSize; ++blockColumn)
+            m_dirtyBlocks.at(blockRow * m_blocksPerAxis + blockColumn) = 1;
+}
 
-    // ignore small differences
-    if (std::abs(tempDelta) < minStep)
-        return false;
+void TemperatureTile::exchangeHeat(const float * x, const float * z, const uint16_t * validMask, uint32_t count, celsius & particleTemperature)
+{
+    // same sample mapping as Terrain::worldToTileRowColumn, particles on other tiles are skipped
+    const float rowScale = samplesPerAxis / m_terrain.settings.tileBorderLength();
+    const float columnScale = rowScale;
+    const float rowOffset = (0.5f - m_tileID.x) * samplesPerAxis;
+    const float columnOffset = (0.5f - m_tileID.z) * samplesPerAxis;
+    const float maxCoord = static_cast<float>(samplesPerAxis);
+
+    // scatter the particles to their samples
+    m_heatSamples.clear();
+    uint32_t numParticles = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (validMask && validMask[i] == 0)
+            continue;
+
+        const float row = x[i] * rowScale + rowOffset;
+        const float column = z[i] * columnScale + columnOffset;
+        if (!(row >= 0.0f && row < maxCoord && column >= 0.0f && column < maxCoord))
+            continue;
+
+        const unsigned int index = static_cast<unsigned int>(column) + static_cast<unsigned int>(row) * samplesPerAxis;
+        uint16_t & particles = m_particleCounts[index];
+        if (particles == 0)
+            m_heatSamples.push_back(index);
+        if (particles < std::numeric_limits<uint16_t>::max())
+            ++particles;
+        ++numParticles;
+    }
 
-    if (std::abs(tempDelta) < tempStep)
-        m_values.at(index) = reverend;
-    else
-        m_values.at(index) = currentTemp - glm::sign(tempDelta) * tempStep;
+    if (m_heatSamples.empty())
+        return;
 
-    return true;
+    // each sample moves towards the mixed temperature of itself and its particles, the particles receive the opposite amount of heat
+    std::sort(m_heatSamples.begin(), m_heatSamples.end());
+    float exchangedHeat = 0.0f;
+    std::vector<float> & temperatures = m_values.write();
+    IndexBounds rowBounds;
+    rowBounds.reset();
+
+    for (const unsigned int index : m_heatSamples) {
+        const float particles = m_particleCounts[index];
+        m_particleCounts[index] = 0;
+
+        const celsius current = temperatures[index];
+        const celsius mixed = (sampleHeatCapacity * current + particles * particleTemperature) / (sampleHeatCapacity + particles);
+        const celsius change = heatExchangeRate * (mixed - current);
+        temperatures[index] = current + change;
+        exchangedHeat += sampleHeatCapacity * change;
+
+        const unsigned int row = index / samplesPerAxis;
+        markDirty(row, row, index % samplesPerAxis, index % samplesPerAxis);
+
+        if (!rowBounds.empty() && rowBounds.min / samplesPerAxis != row) {
+            addBufferUpdateRange(rowBounds.min, rowBounds.max - rowBounds.min + 1);
+            rowBounds.reset();
+        }
+        rowBounds.extend(index);
+    }
+    addBufferUpdateRange(rowBounds.min, rowBounds.max - rowBounds.min + 1);
+
+    particleTemperature = glm::clamp(particleTemperature - exchangedHeat / numParticles, minTemperature, maxTemperature);
+}
+
+void TemperatureTile::IndexBounds::reset()
+{
+    min = std::numeric_limits<unsigned int>::max();
+    max = 0;
+}
+
+void TemperatureTile::IndexBounds::extend(unsigned int index)
+{
+    if (min > index)
+        min = index;
+    if (max < index)
+        max = index;
+}
+
+bool TemperatureTile::IndexBounds::empty() const
+{
+    return min > max;
 }
 
 bool TemperatureTile::updateSolidLiquid(unsigned int index)
 {
     // change base terrain / lava terrain heights depending on temperature at current position
     // as the terrain type of the liquid tile depends only on the height for now: ignore heights below 0
-    if (m_baseTile.valueAt(index) <= 0.0f)
+    const meter baseHeight = m_baseTile.m_values[index];
+    if (baseHeight <= 0.0f)
         return false;
 
-    bool lavaUp = m_values.at(index) >= minLavaTemperature;
+    bool lavaUp = m_values[index] >= minLavaTemperature;
+    const meter liquidHeight = m_liquidTile.m_values[index];
     // don't change the heights if they already represent the current temperature
-    if (lavaUp == (m_liquidTile.valueAt(index) > m_baseTile.valueAt(index)))
+    if (lavaUp == (liquidHeight > baseHeight))
         return false;
 
     if (lavaUp) {
-        m_liquidTile.setValue(index, m_baseTile.valueAt(index));
-        m_baseTile.setValue(index, m_baseTile.valueAt(index) - 0.1f);
+        m_liquidTile.setValue(index, baseHeight);
+        m_baseTile.setValue(index, baseHeight - 0.1f);
         m_baseTile.setElement(index, m_baseBedrockIndex);
     }
     else {
-        m_baseTile.setValue(index, m_liquidTile.valueAt(index));
-        m_liquidTile.setValue(index, m_baseTile.valueAt(index) - 0.1f);
+        m_baseTile.setValue(index, liquidHeight);
+        m_liquidTile.setValue(index, liquidHeight - 0.1f);
     }
 
     return true;
@@ -157,7 +433,7 @@ bool TemperatureTile::updateSolidLiquid(unsigned int index)
 bool TemperatureTile::updateTerrainType(unsigned int index)
 {
     // don't need to remove grass if temperature below the limit
-    if (m_values.at(index) < maxGrassTemperature)
+    if (m_values[index] < maxGrassTemperature)
         return false;
 
     // don't need to remove grass that isn't there
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <vector>
+
 #include "terraintile.h"
+#include "heatdiffusion.h"
 
 class PhysicalTile;
 
 typedef float celsius;
 typedef float meter;
 
+/** Heat diffuses through the terrain with a conductivity depending on the base element, and relaxes towards a height dependent
+  * temperature, melting the base terrain to lava and back. The simulation runs in fixed steps of 0.1 seconds.
+  * Only blocks of samples that were edited or are still changing are updated, in row stripes on the worker pool. */
 class TemperatureTile : public TerrainTile
 {
 public:
@@ -21,6 +27,16 @@ public:
 
     virtual void updatePhysics(double delta) override;
 
+    /** Update the samples in the row/column range on the next updates, as their temperature or base height changed. */
+    void markDirty(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn);
+
+    /** Exchange heat between the particles and the samples below them. All particles share one temperature.
+      * x and z are world coordinates, particles with a zero entry in validMask are skipped. */
+    void exchangeHeat(const float * x, const float * z, const uint16_t * validMask, uint32_t count, celsius & particleTemperature);
+
+    /** samples per block axis, blocks are marked dirty as a whole */
+    static const unsigned int s_blockSize = 32;
+
 protected:
     PhysicalTile & m_baseTile;
     PhysicalTile & m_liquidTile;
@@ -30,10 +46,62 @@ protected:
     const uint8_t m_baseBedrockIndex;
     const uint8_t m_baseGrassIndex;
 
-    bool updateTemperature(unsigned int index);
+    HeatRelaxation m_relaxation;
+    /** diffusion rate per step (diffusivity * dt / dx^2) for each element index of the base tile */
+    std::vector<float> m_ratesByElement;
+
     bool updateSolidLiquid(unsigned int index);
     bool updateTerrainType(unsigned int index);
 
+    /** One fixed time step: diffuse the dirty blocks into m_nextValues, then apply the changes. */
+    void diffusionStep();
+    /** Find the next run of dirty blocks in the block row, starting at blockColumn.
+      * blockColumn is set to the first dirty block. @return the block column behind the run */
+    unsigned int dirtyRunEnd(unsigned int blockRow, unsigned int & blockColumn) const;
+    /** Write the next temperatures of the dirty blocks in the block rows to m_nextValues. */
+    void diffuseStripe(unsigned int stripe, const unsigned int * blockRowsBegin, const unsigned int * blockRowsEnd);
+    /** Copy the next temperatures of the dirty blocks in the block rows and update the base and liquid tiles where they changed. */
+    void applyStripe(unsigned int stripe, const unsigned int * blockRowsBegin, const unsigned int * blockRowsEnd);
+
+    /** temperatures after the current step, only valid in dirty blocks */
+    std::vector<float> m_nextValues;
+
+    struct IndexBounds {
+        unsigned int min;
+        unsigned int max;
+        void reset();
+        void extend(unsigned int index);
+        bool empty() const;
+    };
+    /** changed sample indices per row, in the last update */
+    struct RowChanges {
+        IndexBounds temperatures;
+        IndexBounds heights;
+    };
+    std::vector<RowChanges> m_rowChanges;
+
+    const unsigned int m_blocksPerAxis;
+    /** one flag per block, set while it may contain samples that don't have their target temperature.
+      * One byte per block, so that stripes can clear their flags concurrently. */
+    std::vector<uint8_t> m_dirtyBlocks;
+    std::vector<unsigned int> m_dirtyBlockRows;
+    /** per block: the borders at which samples changed in the current step, their neighbor blocks have to be updated next */
+    std::vector<uint8_t> m_blockEdgeChanges;
+
+    /** number of particles per sample while exchanging heat, zero outside of exchangeHeat() */
+    std::vector<uint16_t> m_particleCounts;
+    std::vector<unsigned int> m_heatSamples;
+
+    /** buffers of one stripe, kept between the updates */
+    struct StripeScratch {
+        /** diffusion rate per sample of the current row */
+        std::vector<float> rates;
+        /** per block of the current block row: ChangedBlock and the edges at which samples changed */
+        std::vector<uint8_t> blockChanges;
+    };
+    /** one per thread of the worker pool, indexed by the stripe */
+    std::vector<StripeScratch> m_stripeScratch;
+
 public:
     void operator=(TemperatureTile&) = delete;
 };
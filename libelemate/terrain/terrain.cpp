@@ -14,6 +14,15 @@
 #include <glm/gtc/random.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "utils/pxcompilerfix.h"
+#include <PxRigidStatic.h>
+#include <PxScene.h>
+#include <PxShape.h>
+#include <geometry/PxHeightField.h>
+#include <geometry/PxHeightFieldGeometry.h>
+
+#include "rendering/culling.h"
+#include "heightfieldupdatequeue.h"
 #include "physicaltile.h"
 #include "terraininteraction.h"
 
@@ -21,7 +30,11 @@ Terrain::Terrain(const TerrainSettings & settings)
 : ShadowingDrawable()
 , settings(settings)
 , m_drawLevels(PhysicalLevels)
+, m_pxUpdateQueue(std::make_shared<HeightFieldUpdateQueue>(settings.maxPxSamplesPerStep))
+, minTileXID(0)
+, minTileZID(0)
 , m_viewRange(0.0f)
+, m_lod(settings.maxTileSamplesPerAxis - 1)
 {
     TerrainInteraction::setDefaultTerrain(*this);
     m_bbox.extend(glm::vec3(settings.sizeX * 0.5f, settings.maxHeight, settings.sizeZ * 0.5f));
@@ -48,20 +61,15 @@ void Terrain::setDrawElements(const std::initializer_list<std::string> & element
         m_drawLevels.insert(levelForElement->at(name));
 }
 
-const GLuint Terrain::s_restartIndex = std::numeric_limits<GLuint>::max();
-
 void Terrain::drawImplementation(const CameraEx & camera)
 {
     // we probably don't want to draw an empty terrain
     assert(m_physicalTiles.size() > 0);
 
-    if (!m_renderGridRadius.isValid())
-        generateDrawGrid();
-
     assert(m_indexBuffer);
 
     glEnable(GL_PRIMITIVE_RESTART);
-    glPrimitiveRestartIndex(s_restartIndex);
+    glPrimitiveRestartIndex(TerrainLod::s_restartIndex);
 
     glFrontFace(GL_CW);
     glCullFace(GL_BACK);
@@ -70,11 +78,17 @@ void Terrain::drawImplementation(const CameraEx & camera)
     for (auto & pair : m_attributeTiles)
         pair.second->prepareDraw();
 
+    const Frustum frustum(camera.viewProjectionEx());
+
     for (auto & pair : m_physicalTiles) {
         if (m_drawLevels.find(pair.first.level) == m_drawLevels.end())
             continue;   // only draw elements that are listed for drawing
+        if (!tileVisible(pair.first, camera.eye(), frustum, CullingPass::TerrainScene))
+            continue;
+        selectLodNodes(*pair.second, camera.eye(), frustum, 0);
         pair.second->bind(camera);
-        m_vao->drawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
+        if (pair.second->program())
+            drawLodNodes(*pair.second->program());
         pair.second->unbind();
     }
 
@@ -87,6 +101,9 @@ void Terrain::updatePhysics(double delta)
 {
     for (auto & pair : m_attributeTiles)
         pair.second->updatePhysics(delta);
+
+    // between the last fetchResults and the next simulate
+    m_pxUpdateQueue->apply();
 }
 
 void Terrain::setDrawHeatMap(bool drawHeatMap)
@@ -95,6 +112,32 @@ void Terrain::setDrawHeatMap(bool drawHeatMap)
         pair.second->m_drawHeatMap = drawHeatMap;
 }
 
+void Terrain::beginFrame()
+{
+    m_lastFrameUploads = m_frameUploads;
+    m_frameUploads = BufferUploads();
+    m_lastFrameChanges.swap(m_frameChanges);
+    m_frameChanges.clear();
+}
+
+const Terrain::BufferUploads & Terrain::lastFrameUploads() const
+{
+    return m_lastFrameUploads;
+}
+
+const std::map<TileID, glowutils::AxisAlignedBoundingBox> & Terrain::lastFrameChanges() const
+{
+    return m_lastFrameChanges;
+}
+
+void Terrain::addTileChange(const TileID & tileID)
+{
+    const float tileBorderLength = settings.tileBorderLength();
+    glowutils::AxisAlignedBoundingBox & box = m_frameChanges[tileID];
+    box.extend(glm::vec3(tileBorderLength * (tileID.x - 0.5f), -settings.maxHeight, tileBorderLength * (tileID.z - 0.5f)));
+    box.extend(glm::vec3(tileBorderLength * (tileID.x + 0.5f), settings.maxHeight, tileBorderLength * (tileID.z + 0.5f)));
+}
+
 void Terrain::setViewRange(float zfar)
 {
     assert(zfar > 0);
@@ -106,7 +149,7 @@ void Terrain::setViewRange(float zfar)
     
     m_viewRange = zfar;
     m_validBoudingBox.invalidate();
-    m_renderGridRadius.invalidate();
+    m_lod.setViewRange(m_viewRange / settings.minSampleInterval());
 }
 
 const glowutils::AxisAlignedBoundingBox & Terrain::validBoundingBox() const
@@ -131,15 +174,14 @@ const glowutils::AxisAlignedBoundingBox & Terrain::validBoundingBox() const
 
 void Terrain::initialize()
 {
-    generateDrawGrid();
-
     m_vao = new glow::VertexArrayObject();
 
+    // the grid doesn't depend on the view range, the nodes are scaled and moved in the vertex shader
     m_indexBuffer = new glow::Buffer(GL_ELEMENT_ARRAY_BUFFER);
-    m_indexBuffer->setData(m_indices, GL_STATIC_DRAW);
+    m_indexBuffer->setData(m_lod.indices(), GL_STATIC_DRAW);
 
     m_vbo = new glow::Buffer(GL_ARRAY_BUFFER);
-    m_vbo->setData(m_vertices, GL_STATIC_DRAW);
+    m_vbo->setData(m_lod.vertices(), GL_STATIC_DRAW);
 
     m_vao->bind();
 
@@ -154,53 +196,69 @@ void Terrain::initialize()
     m_vao->unbind();
 }
 
-void Terrain::setDrawGridOffsetUniform(glow::Program & program, const glm::vec3 & cameraposition) const
+void Terrain::setLodUniforms(glow::Program & program, const glm::vec3 & cameraposition, const TerrainTile & tile) const
 {
-    const float terrainMaxCoord = settings.sizeX * 0.5f;
-
-    unsigned int offsetX = static_cast<unsigned int>(std::floor((cameraposition.x + terrainMaxCoord) / settings.sizeX * settings.maxTileSamplesPerAxis - m_renderGridRadius.value()));
-    unsigned int offsetZ = static_cast<unsigned int>(std::floor((cameraposition.z + terrainMaxCoord) / settings.sizeZ * settings.maxTileSamplesPerAxis - m_renderGridRadius.value()));
-
-    program.setUniform("rowColumnOffset", glm::ivec2(offsetX, offsetZ));
+    const float tileBorderLength = settings.tileBorderLength();
+    const float tileMinX = tileBorderLength * (tile.m_tileID.x - 0.5f);
+    const float tileMinZ = tileBorderLength * (tile.m_tileID.z - 0.5f);
+
+    // negative or beyond the last row/column for tiles that don't contain the camera
+    program.setUniform("cameraRowColumn", glm::vec2(
+        (cameraposition.x - tileMinX) / tile.sampleInterval,
+        (cameraposition.z - tileMinZ) / tile.sampleInterval));
 }
 
-void Terrain::generateDrawGrid()
+void Terrain::selectLodNodes(const TerrainTile & tile, const glm::vec3 & cameraposition, const Frustum & frustum, unsigned int minLevel)
 {
-    m_renderGridRadius.setValue(static_cast<unsigned int>(std::ceil(m_viewRange * settings.maxSamplesPerWorldCoord())));
-    unsigned int diameter = m_renderGridRadius.value() * 2;
-    unsigned int numSamples = diameter * diameter;
-
-    m_vertices.resize(numSamples);
+    assert(tile.samplesPerAxis == m_lod.tileCells() + 1);
+
+    const float tileBorderLength = settings.tileBorderLength();
+    const float tileMinX = tileBorderLength * (tile.m_tileID.x - 0.5f);
+    const float tileMinZ = tileBorderLength * (tile.m_tileID.z - 0.5f);
+    const float sampleInterval = tile.sampleInterval;
+    const float maxHeight = settings.maxHeight;
+
+    m_lodNodes.clear();
+    m_lod.select(
+        glm::vec2((cameraposition.x - tileMinX) / sampleInterval, (cameraposition.z - tileMinZ) / sampleInterval),
+        minLevel,
+        [&frustum, tileMinX, tileMinZ, sampleInterval, maxHeight] (const glm::vec2 & minRowColumn, const glm::vec2 & maxRowColumn) {
+            return frustum.intersects(
+                glm::vec3(tileMinX + minRowColumn.x * sampleInterval, -maxHeight, tileMinZ + minRowColumn.y * sampleInterval),
+                glm::vec3(tileMinX + maxRowColumn.x * sampleInterval, maxHeight, tileMinZ + maxRowColumn.y * sampleInterval));
+        },
+        m_lodNodes);
+}
 
-    for (unsigned row = 0; row < diameter; ++row) {
-        const unsigned rowOffset = row * diameter;
-        for (unsigned column = 0; column < diameter; ++column) {
-            unsigned int index = column + rowOffset;
+void Terrain::drawLodNodes(glow::Program & program)
+{
+    for (const TerrainLod::Node & node : m_lodNodes) {
+        program.setUniform("nodeOffset", glm::ivec2(node.row, node.column));
+        program.setUniform("nodeSpacing", static_cast<int>(node.spacing));
+        program.setUniform("morphRange", m_lod.morphRange(node.level));
 
-            // simply use the row/column position as vertex position, scaling with the transform matrix
-            m_vertices.at(index) = glm::vec2(row, column);
-        }
+        m_vao->drawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(m_lod.indexCount(node)), GL_UNSIGNED_INT,
+            reinterpret_cast<const void *>(m_lod.indexOffset(node) * sizeof(uint32_t)));
     }
+}
 
+bool Terrain::tileInViewRange(const TileID & tileID, const glm::vec3 & cameraposition) const
+{
+    const float tileBorderLength = settings.tileBorderLength();
+    const float distanceX = std::abs(cameraposition.x - tileBorderLength * tileID.x) - 0.5f * tileBorderLength;
+    const float distanceZ = std::abs(cameraposition.z - tileBorderLength * tileID.z) - 0.5f * tileBorderLength;
+    return distanceX < m_viewRange && distanceZ < m_viewRange;
+}
 
-    // create a quad for all vertices, except for the last row and column (covered by the second last)
-    // see PxHeightFieldDesc::samples documentation: "...(nbRows - 1) * (nbColumns - 1) cells are actually used."
-    unsigned numIndices = (diameter - 1) * ((diameter) * 2 + 1);
-    m_indices.clear();
-    m_indices.reserve(numIndices);
-    for (unsigned int row = 0; row < diameter - 1; ++row) {
-        const unsigned rowOffset = row * diameter;
-        for (unsigned int column = 0; column < diameter; ++column) {
-            // "origin" is the left front vertex in a terrain quad
-            const unsigned int origin = column + rowOffset;
-
-            m_indices.push_back(origin);
-            m_indices.push_back(origin + diameter);
-        }
-        m_indices.push_back(s_restartIndex);
-    }
+bool Terrain::tileVisible(const TileID & tileID, const glm::vec3 & cameraposition, const Frustum & frustum, CullingPass pass) const
+{
+    const float tileBorderLength = settings.tileBorderLength();
+    const glm::vec3 llf(tileBorderLength * (tileID.x - 0.5f), -settings.maxHeight, tileBorderLength * (tileID.z - 0.5f));
+    const glm::vec3 urb(tileBorderLength * (tileID.x + 0.5f), settings.maxHeight, tileBorderLength * (tileID.z + 0.5f));
 
-    assert(m_indices.size() == numIndices);
+    const bool visible = tileInViewRange(tileID, cameraposition) && frustum.intersects(llf, urb);
+    CullingStatistics::count(pass, visible);
+    return visible;
 }
 
 void Terrain::registerTile(const TileID & tileID, TerrainTile & tile)
@@ -208,12 +266,75 @@ void Terrain::registerTile(const TileID & tileID, TerrainTile & tile)
     assert(m_physicalTiles.find(tileID) == m_physicalTiles.end());
     assert(m_attributeTiles.find(tileID) == m_attributeTiles.end());
 
-    if (levelIsPhysical(tileID.level))
+    if (levelIsPhysical(tileID.level)) {
         m_physicalTiles.emplace(tileID, std::shared_ptr<TerrainTile>(&tile));
+        addTileChange(tileID);
+    }
     else if (levelIsAttribute(tileID.level))
         m_attributeTiles.emplace(tileID, std::shared_ptr<TerrainTile>(&tile));
     else
         glow::fatal("Terrain: Trying to register a terrain tile with unknown level (%;)", int(tileID.level));
+
+    if (tileID.level == TerrainLevel::BaseLevel)
+        updateBoundingBox();
+}
+
+void Terrain::unregisterTiles(int xID, int zID)
+{
+    using namespace physx;
+
+    const TileID baseID(TerrainLevel::BaseLevel, xID, zID);
+    auto actorIt = m_pxActors.find(baseID);
+    assert(actorIt != m_pxActors.end());
+
+    // the height fields are not released with their shapes
+    std::vector<PxHeightField *> heightFields;
+    for (TerrainLevel level : PhysicalLevels) {
+        auto it = m_physicalTiles.find(TileID(level, xID, zID));
+        if (it == m_physicalTiles.end())
+            continue;
+        m_pxUpdateQueue->remove(static_cast<const PhysicalTile &>(*it->second));
+        PxHeightFieldGeometry geometry;
+        if (std::static_pointer_cast<PhysicalTile>(it->second)->pxShape()->getHeightFieldGeometry(geometry))
+            heightFields.push_back(geometry.heightField);
+    }
+
+    if (actorIt != m_pxActors.end()) {
+        PxScene * pxScene = actorIt->second->getScene();
+        if (pxScene) {
+            pxScene->lockWrite();
+            pxScene->removeActor(*actorIt->second);
+            pxScene->unlockWrite();
+        }
+        actorIt->second->release();
+        m_pxActors.erase(actorIt);
+    }
+    for (PxHeightField * heightField : heightFields)
+        heightField->release();
+
+    // attribute tiles reference the physical tiles, so remove them first
+    for (TerrainLevel level : AttributeLevels)
+        m_attributeTiles.erase(TileID(level, xID, zID));
+    for (TerrainLevel level : PhysicalLevels) {
+        if (m_physicalTiles.erase(TileID(level, xID, zID)))
+            addTileChange(TileID(level, xID, zID));
+    }
+
+    updateBoundingBox();
+}
+
+void Terrain::updateBoundingBox()
+{
+    const float tileBorderLength = settings.tileBorderLength();
+
+    m_bbox = glowutils::AxisAlignedBoundingBox();
+    for (const auto & pair : m_physicalTiles) {
+        if (pair.first.level != TerrainLevel::BaseLevel)
+            continue;
+        m_bbox.extend(glm::vec3(tileBorderLength * (pair.first.x - 0.5f), -settings.maxHeight, tileBorderLength * (pair.first.z - 0.5f)));
+        m_bbox.extend(glm::vec3(tileBorderLength * (pair.first.x + 0.5f), settings.maxHeight, tileBorderLength * (pair.first.z + 0.5f)));
+    }
+    m_validBoudingBox.invalidate();
 }
 
 std::shared_ptr<TerrainTile> Terrain::getTile(TileID tileID) const
@@ -228,6 +349,13 @@ std::shared_ptr<TerrainTile> Terrain::getTile(TileID tileID) const
     return nullptr;
 }
 
+std::shared_ptr<TerrainTile> Terrain::findTile(TileID tileID) const
+{
+    const auto & tiles = levelIsPhysical(tileID.level) ? m_physicalTiles : m_attributeTiles;
+    auto it = tiles.find(tileID);
+    return it == tiles.end() ? nullptr : it->second;
+}
+
 void Terrain::heighestLevelHeightAt(float x, float z, TerrainLevel & maxLevel, float & maxHeight) const
 {
     maxHeight = std::numeric_limits<float>::lowest();
@@ -265,16 +393,11 @@ float Terrain::heightAt(float x, float z, TerrainLevel level) const
 
     tileID.level = level;
 
-    auto it = m_physicalTiles.find(tileID);
-    if (it != m_physicalTiles.end()) {
-        return it->second->interpolatedValueAt(normX, normZ);
-    }
-    auto attrIt = m_attributeTiles.find(tileID);
-    if (attrIt != m_attributeTiles.end()) {
-        return attrIt->second->interpolatedValueAt(normX, normZ);
-    }
-    assert(false);
-    return 0.0f;
+    std::shared_ptr<TerrainTile> tile = findTile(tileID);
+    assert(tile);
+    if (!tile)
+        return 0.0f;
+    return tile->interpolatedValueAt(normX, normZ);
 }
 
 bool Terrain::worldToPhysicalTileRowColumn(float x, float z, TerrainLevel level, std::shared_ptr<PhysicalTile> & physicalTile, unsigned int & row, unsigned int & column, float & row_fract, float & column_fract) const
@@ -309,16 +432,15 @@ bool Terrain::worldToTileRowColumn(float x, float z, TerrainLevel level, std::sh
 
 bool Terrain::worldToTileRowColumn(float x, float z, TerrainLevel level, std::shared_ptr<TerrainTile> & terrainTile, unsigned int & row, unsigned int & column, float & row_fract, float & column_fract) const
 {
-    // only implemented for 1 tile
-    assert(settings.tilesX == 1 && settings.tilesZ == 1);
+    TileID tileID(level);
+    float normX = 0.0f, normZ = 0.0f;
+    if (!normalizePosition(x, z, tileID, normX, normZ))
+        return false;
 
-    TileID tileID(level, 0, 0);
-    terrainTile = getTile(tileID);
+    terrainTile = findTile(tileID);
     assert(terrainTile);
-
-    float normX = (x / settings.sizeX + 0.5f);
-    float normZ = (z / settings.sizeZ + 0.5f);
-    bool valid = normX >= 0 && normX <= 1 && normZ >= 0 && normZ <= 1;
+    if (!terrainTile)
+        return false;
 
     float row_int = 0.0f, column_int = 0.0f;
     row_fract = std::modf(normX * terrainTile->samplesPerAxis, &row_int);
@@ -328,19 +450,30 @@ bool Terrain::worldToTileRowColumn(float x, float z, TerrainLevel level, std::sh
     row = static_cast<unsigned int>(row_int) % terrainTile->samplesPerAxis;
     column = static_cast<unsigned int>(column_int) % terrainTile->samplesPerAxis;
 
-    return valid;
+    return true;
 }
 
 bool Terrain::normalizePosition(float x, float z, TileID & tileID, float & normX, float & normZ) const
 {
-    // currently for one tile only
-    assert(settings.tilesX == 1 && settings.tilesZ == 1);
-    tileID.x = 0;
-    tileID.z = 0;
+    // tile (0, 0) is centered at the origin
+    const float tileX = x / settings.tileBorderLength() + 0.5f;
+    const float tileZ = z / settings.tileBorderLength() + 0.5f;
+
+    tileID.x = static_cast<int>(std::floor(tileX));
+    tileID.z = static_cast<int>(std::floor(tileZ));
 
-    normX = x / settings.sizeX + 0.5f;
-    normZ = z / settings.sizeZ + 0.5f;
+    if (!settings.streaming) {
+        // positions on the outer borders belong to the last tiles
+        tileID.x = std::max(minTileXID, std::min(tileID.x, minTileXID + int(settings.tilesX) - 1));
+        tileID.z = std::max(minTileZID, std::min(tileID.z, minTileZID + int(settings.tilesZ) - 1));
+    }
+
+    normX = tileX - tileID.x;
+    normZ = tileZ - tileID.z;
+
+    if (!(normX >= 0.0f && normX <= 1.0f && normZ >= 0.0f && normZ <= 1.0f))
+        return false;
 
-    return normX >= 0.0f && normX <= 1.0f
-        && normZ >= 0.0f && normZ <= 1.0f;
+    return !settings.streaming
+        || m_physicalTiles.find(TileID(TerrainLevel::BaseLevel, tileID.x, tileID.z)) != m_physicalTiles.end();
 }
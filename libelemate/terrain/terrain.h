@@ -2,6 +2,7 @@
 
 #include "rendering/shadowingdrawable.h"
 
+#include <cstdint>
 #include <map>
 #include <set>
 #include <memory>
@@ -12,6 +13,7 @@
 #include <glowutils/AxisAlignedBoundingBox.h>
 #include <glowutils/CachedValue.h>
 
+#include "terrainlod.h"
 #include "terrainsettings.h"
 
 namespace physx {
@@ -19,6 +21,9 @@ namespace physx {
 }
 class TerrainTile;
 class PhysicalTile;
+class HeightFieldUpdateQueue;
+class Frustum;
+enum class CullingPass;
 
 /** @brief base terrain object containing multiple tiles in different terrain levels.
 
@@ -50,9 +55,25 @@ public:
 
     void setDrawHeatMap(bool drawHeatMap);
 
-    void setDrawGridOffsetUniform(glow::Program & program, const glm::vec3 & cameraposition) const;
+    /** uploads of changed tile values to the OpenGL buffers */
+    struct BufferUploads {
+        uint64_t bytes = 0;
+        unsigned int subDataCalls = 0;
+        unsigned int mapRangeCalls = 0;
+    };
+    /** Start counting the uploads of a new frame, call this once per frame before drawing. */
+    void beginFrame();
+    /** uploads between the last two calls of beginFrame */
+    const BufferUploads & lastFrameUploads() const;
+    /** World space boxes around the changed values of the physical tiles between the last two calls of beginFrame,
+      * including loaded and removed tiles. The boxes span the whole height range of the terrain. */
+    const std::map<TileID, glowutils::AxisAlignedBoundingBox> & lastFrameChanges() const;
+
+    /** set the camera position in the rows/columns of the tile, used for the LOD morph */
+    void setLodUniforms(glow::Program & program, const glm::vec3 & cameraposition, const TerrainTile & tile) const;
 
     friend class TerrainGenerator;
+    friend class TerrainStreamer;
     friend class TerrainTile;
     friend class TerrainInteraction;
 
@@ -70,36 +91,60 @@ protected:
 
     /** register terrain tile to be part of this terrain with unique tileID */
     void registerTile(const TileID & tileID, TerrainTile & tile);
+    /** remove the tiles of all levels at the tile x/z-ID and release their physx actor */
+    void unregisterTiles(int xID, int zID);
+
+    /** @return whether the tile may be visible from the camera position, with the current view range */
+    bool tileInViewRange(const TileID & tileID, const glm::vec3 & cameraposition) const;
+    /** @return whether the tile is in the view range and intersects the frustum, counting the result for the pass */
+    bool tileVisible(const TileID & tileID, const glm::vec3 & cameraposition, const Frustum & frustum, CullingPass pass) const;
+    /** extend the bounding box to all base level tiles */
+    void updateBoundingBox();
 
     std::map<TileID, std::shared_ptr<TerrainTile>> m_physicalTiles;
     std::map<TileID, std::shared_ptr<TerrainTile>> m_attributeTiles;
     std::shared_ptr<TerrainTile> getTile(TileID tileID) const;
+    /** @return the tile or nullptr, if it is not loaded */
+    std::shared_ptr<TerrainTile> findTile(TileID tileID) const;
 
     /** holds one physx actor per tile x/z-ID. TileId.level is always BaseLevel */
     std::map<TileID, physx::PxRigidStatic*> m_pxActors;
+    /** counted by the tiles when they upload their values, they only have a const reference to the terrain */
+    mutable BufferUploads m_frameUploads;
+    BufferUploads m_lastFrameUploads;
+    /** extended by the tiles when their values change */
+    mutable std::map<TileID, glowutils::AxisAlignedBoundingBox> m_frameChanges;
+    std::map<TileID, glowutils::AxisAlignedBoundingBox> m_lastFrameChanges;
+    /** add the whole tile to the changes of this frame */
+    void addTileChange(const TileID & tileID);
+
+    /** changes of the physx height fields, written in updatePhysics */
+    std::shared_ptr<HeightFieldUpdateQueue> m_pxUpdateQueue;
 
     /** lowest tile id in x direction */
-    unsigned minTileXID;
+    int minTileXID;
     /** lowest tile id in z direction */
-    unsigned minTileZID;
+    int minTileZID;
 
     /** Distance from camera to farthest visible point. The rendered terrain size depends on this parameter. */
     float m_viewRange;
     glowutils::CachedValue<glowutils::AxisAlignedBoundingBox> m_validBoudingBox;
 
     virtual void initialize() override;
-    void generateDrawGrid();
 
-    glowutils::CachedValue<unsigned int> m_renderGridRadius;
-    std::vector<glm::vec2> m_vertices;
-    std::vector<uint32_t> m_indices;
+    /** grid and node selection of the tiles, all tiles use the same grid */
+    TerrainLod m_lod;
+    /** nodes of the tile that is currently drawn */
+    std::vector<TerrainLod::Node> m_lodNodes;
+    /** select the LOD nodes of the tile that intersect the frustum, with at least the minimum level */
+    void selectLodNodes(const TerrainTile & tile, const glm::vec3 & cameraposition, const Frustum & frustum, unsigned int minLevel);
+    /** draw the selected LOD nodes with the program, which links shader/utils/terrain_lod.vert */
+    void drawLodNodes(glow::Program & program);
 
     /** light map and shadow mapping */
     virtual void initDepthMapProgram() override;
     virtual void initShadowMappingProgram() override;
 
-    static const GLuint s_restartIndex;
-
 protected:
     /** Fetch the tile corresponding to the xz world coordinates and the terrain level and sets the row/column position in this tile.
     * @param terrainTile if world x/z position are in range, this pointer will be set to a valid terrain tile.
@@ -111,7 +156,8 @@ protected:
     /** transform world position into tileID and normalized coordinates in this tile.
     * @param tileID this will set the x, y values of the id, but will not change the level
     * @param normX normZ these parameter will be set the normalized position in the tile, referenced with tileID
-    * @return whether the world position is in range of the terrain. The tileID does only reference a valid tile if the function returns true. */
+    * @return whether the world position is in range of the terrain. The tileID does only reference a valid tile if the function returns true.
+    * When streaming, positions are only in range on loaded tiles. */
     bool normalizePosition(float x, float z, TileID & tileID, float & normX, float & normZ) const;
 
 public:
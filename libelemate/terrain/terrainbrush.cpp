@@ -0,0 +1,97 @@
+#include "terrainbrush.h"
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX__)
+#define TERRAINBRUSH_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAINBRUSH_SSE2
+#include <emmintrin.h>
+#endif
+
+TerrainBrush::TerrainBrush(float stddev, float sampleInterval, float samplesPerWorldCoord)
+{
+    assert(stddev > 0);
+
+    const float radiusWorld = stddev * 3;
+    radius = static_cast<uint32_t>(std::ceil(radiusWorld * samplesPerWorldCoord)); // = 0 means to change only the center sample
+
+    const int size = 2 * static_cast<int>(radius) + 1;
+    halfWidths.assign(radius + 1, -1);
+    weights.assign(size * size, 0.0f);
+
+    for (int r = -static_cast<int>(radius); r <= static_cast<int>(radius); ++r) {
+        const float relWorldX = r * sampleInterval;
+        for (int c = -static_cast<int>(radius); c <= static_cast<int>(radius); ++c) {
+            const float relWorldZ = c * sampleInterval;
+            const float distanceSquared = relWorldX * relWorldX + relWorldZ * relWorldZ;
+
+            if (std::sqrt(distanceSquared) > radiusWorld)  // interaction in a circle, not square
+                continue;
+
+            weights.at((r + radius) * size + c + radius) = std::exp(-distanceSquared / (2.0f * stddev * stddev));
+            if (c > halfWidths.at(std::abs(r)))
+                halfWidths.at(std::abs(r)) = c;
+        }
+    }
+}
+
+void applyBrushRowScalar(float * heights, const float * weights, uint32_t count, float base, float depth, bool moveUp, uint8_t * changed)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const float target = base + depth * weights[i];
+        // don't pull up heights that are already above the brush, and vice versa
+        const bool change = (target > heights[i]) == moveUp;
+        if (change)
+            heights[i] = target;
+        if (changed)
+            changed[i] = change ? 1 : 0;
+    }
+}
+
+void applyBrushRow(float * heights, const float * weights, uint32_t count, float base, float depth, bool moveUp, uint8_t * changed)
+{
+    uint32_t i = 0;
+
+#if defined(TERRAINBRUSH_AVX)
+    const __m256 base8 = _mm256_set1_ps(base);
+    const __m256 depth8 = _mm256_set1_ps(depth);
+    // flips the comparison result if moving down
+    const __m256 flip = moveUp ? _mm256_setzero_ps() : _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (; i + 8 <= count; i += 8) {
+        const __m256 current = _mm256_loadu_ps(heights + i);
+        const __m256 target = _mm256_add_ps(base8, _mm256_mul_ps(depth8, _mm256_loadu_ps(weights + i)));
+        const __m256 change = _mm256_xor_ps(_mm256_cmp_ps(target, current, _CMP_GT_OQ), flip);
+        _mm256_storeu_ps(heights + i, _mm256_or_ps(_mm256_and_ps(change, target), _mm256_andnot_ps(change, current)));
+
+        if (changed) {
+            const int mask = _mm256_movemask_ps(change);
+            for (uint32_t j = 0; j < 8; ++j)
+                changed[i + j] = static_cast<uint8_t>((mask >> j) & 1);
+        }
+    }
+#elif defined(TERRAINBRUSH_SSE2)
+    const __m128 base4 = _mm_set1_ps(base);
+    const __m128 depth4 = _mm_set1_ps(depth);
+    // flips the comparison result if moving down
+    const __m128 flip = moveUp ? _mm_setzero_ps() : _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128 current = _mm_loadu_ps(heights + i);
+        const __m128 target = _mm_add_ps(base4, _mm_mul_ps(depth4, _mm_loadu_ps(weights + i)));
+        const __m128 change = _mm_xor_ps(_mm_cmpgt_ps(target, current), flip);
+        _mm_storeu_ps(heights + i, _mm_or_ps(_mm_and_ps(change, target), _mm_andnot_ps(change, current)));
+
+        if (changed) {
+            const int mask = _mm_movemask_ps(change);
+            for (uint32_t j = 0; j < 4; ++j)
+                changed[i + j] = static_cast<uint8_t>((mask >> j) & 1);
+        }
+    }
+#endif
+
+    applyBrushRowScalar(heights + i, weights + i, count - i, base, depth, moveUp, changed ? changed + i : nullptr);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/** @brief Radial falloff of the TerrainInteraction brush, precomputed for the sample offsets from the brush center.
+  * The falloff is a gaussian normalized to 1 at the center. Samples farther than 3 standard deviations from the center are not affected. */
+struct TerrainBrush
+{
+    /** @param stddev standard deviation of the gaussian, in world coordinates
+      * @param sampleInterval distance between two samples of the tile
+      * @param samplesPerWorldCoord used for the brush radius in samples */
+    TerrainBrush(float stddev, float sampleInterval, float samplesPerWorldCoord);
+
+    /** number of rows/columns from the center to the border of the brush */
+    uint32_t radius;
+    /** for each absolute row offset up to the radius: number of columns left and right of the center that are within the brush circle,
+      * negative if the row is outside of the circle */
+    std::vector<int> halfWidths;
+    /** falloff of all offsets in the square around the circle, row major, (2 * radius + 1)^2 values */
+    std::vector<float> weights;
+
+    /** falloff of the row at the row offset, indexed by the column offset */
+    const float * row(int rowOffset) const
+    {
+        return weights.data() + (rowOffset + static_cast<int>(radius)) * (2 * radius + 1) + radius;
+    }
+};
+
+/** Move count heights of a row towards the brush: target = base + depth * weight. If moveUp, only heights below their target are set,
+  * all others otherwise. changed[i] is set to 1 for set heights and to 0 for all others, if changed is not null.
+  * Uses AVX or SSE2 if the compiler targets them, and a scalar loop otherwise. */
+void applyBrushRow(float * heights, const float * weights, uint32_t count, float base, float depth, bool moveUp, uint8_t * changed);
+
+/** Scalar reference implementation of applyBrushRow. */
+void applyBrushRowScalar(float * heights, const float * weights, uint32_t count, float base, float depth, bool moveUp, uint8_t * changed);
@@ -1,6 +1,5 @@
 #include "terraingenerator.h"
 
-#include <random>
 #include <cmath>
 #include <ctime>
 #include <functional>
@@ -17,21 +16,58 @@
 #include "basetile.h"
 #include "liquidtile.h"
 #include "temperaturetile.h"
-
-// Mersenne Twister, preconfigured
-namespace {
-    std::mt19937 rng;
-}
+#include "tilefile.h"
+#include "utils/workerpool.h"
 
 using namespace physx;
 
 namespace {// 1, 3, 8 for 513, 5(look around!) for 1025
-    uint32_t seed_val = 5u;
-    bool initRng() {
-        rng.seed(seed_val);
-        return true;
+    const uint32_t seed_val = 5u;
+
+    const uint64_t goldenGamma = 0x9E3779B97F4A7C15ull;
+
+    /** finalizer of SplitMix64 */
+    uint64_t mix64(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    /** key of the counter based random numbers of a tile */
+    uint64_t tileKey(int xID, int zID)
+    {
+        const uint64_t id = (uint64_t(uint32_t(xID)) << 32) | uint32_t(zID);
+        return mix64(mix64(id + goldenGamma) ^ seed_val);
+    }
+
+    /** Random value in [-1, 1) for a sample of a tile. Every sample is set exactly once,
+      * so its index is the counter and the value does not depend on the order the samples are generated in. */
+    float sampleRandom(uint64_t tileKey, uint32_t sampleIndex)
+    {
+        const uint64_t bits = mix64(tileKey + (uint64_t(sampleIndex) + 1u) * goldenGamma);
+        return static_cast<float>(bits >> 40) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    /** a stripe is only worth running in parallel for this many samples of a diamond square pass */
+    const unsigned int minSamplesPerStripe = 16384;
+
+    /** Call function(beginRow, endRow) for stripes of the rows, on the threads of the worker pool. */
+    template <typename Function>
+    void forEachRowStripe(unsigned int numRows, unsigned int numStripes, const Function & function)
+    {
+        WorkerPool::instance().forEach(numStripes, [numRows, numStripes, &function](unsigned int stripe) {
+            function(numRows * stripe / numStripes, numRows * (stripe + 1) / numStripes);
+        });
+    }
+
+    uint8_t baseElementIndex(const std::string & elementName)
+    {
+        const std::initializer_list<std::string> & elements = TerrainGenerator::baseElements();
+        const size_t index = std::find(elements.begin(), elements.end(), elementName) - elements.begin();
+        assert(index < elements.size());
+        return static_cast<uint8_t>(index);
     }
-    bool didRngInit = initRng();
 }
 
 namespace {
@@ -53,6 +89,49 @@ namespace {
 
 }
 
+TerrainGenerator::TerrainGenerator(const TerrainSettings & settings)
+: m_settings(settings)
+{
+    setSnapshotFile(m_settings.snapshotFile);
+
+    if (!m_settings.streaming)
+        return;
+
+    // all streamed tiles share the edges of tile (0, 0), so that any two tiles fit together
+    const TileData origin = generateTileData(0, 0);
+    const uint32_t samplesPerAxis = origin.samplesPerAxis;
+    m_borderHeights.resize(2 * samplesPerAxis);
+    for (uint32_t i = 0; i < samplesPerAxis; ++i) {
+        m_borderHeights.at(i) = origin.baseHeights.at(i);
+        m_borderHeights.at(samplesPerAxis + i) = origin.baseHeights.at(i * samplesPerAxis);
+    }
+}
+
+const TerrainSettings & TerrainGenerator::settings() const
+{
+    return m_settings;
+}
+
+void TerrainGenerator::setSnapshotFile(const std::string & snapshotFile)
+{
+    m_settings.snapshotFile = snapshotFile;
+    m_snapshot.reset();
+    if (snapshotFile.empty())
+        return;
+
+    m_snapshot = std::make_shared<const TileFile>(snapshotFile);
+    if (!m_snapshot->isValid()) {
+        glow::warning("TerrainGenerator: cannot load the snapshot %;, generating the terrain", snapshotFile);
+        m_snapshot.reset();
+    }
+}
+
+const std::initializer_list<std::string> & TerrainGenerator::baseElements()
+{
+    static const std::initializer_list<std::string> elements = { "bedrock", "sand", "grassland" };
+    return elements;
+}
+
 std::shared_ptr<Terrain> TerrainGenerator::generate() const
 {
     if (!levelForElement)
@@ -60,10 +139,6 @@ std::shared_ptr<Terrain> TerrainGenerator::generate() const
 
     std::shared_ptr<Terrain> terrain = std::make_shared<Terrain>(m_settings);
 
-    assert(PxGetPhysics().getNbScenes() == 1);
-    PxScene * pxScene;
-    PxGetPhysics().getScenes(&pxScene, 1);
-
     // The tileID determines the position of the current tile in the grid of tiles.
     // Tiles get shifted by -(numTilesPerAxis + 1)/2 so that we have the Tile(0,0,0) in the origin.
     
@@ -72,181 +147,316 @@ std::shared_ptr<Terrain> TerrainGenerator::generate() const
     int maxzID = m_settings.tilesZ - int((m_settings.tilesZ + 1) * 0.5);
     int minzID = maxzID - m_settings.tilesZ + 1;
 
+    if (m_settings.streaming) {
+        // start with the tiles the streamer would load for a focus in the origin
+        maxxID = maxzID = static_cast<int>(m_settings.streamingRadius);
+        minxID = minzID = -maxxID;
+    }
+
     terrain->minTileXID = minxID;
     terrain->minTileZID = minzID;
 
     for (int xID = minxID; xID <= maxxID; ++xID)
     for (int zID = minzID; zID <= maxzID; ++zID)
     {
-        TileID tileIDBase(TerrainLevel::BaseLevel, xID, zID);
+        TileData data = loadTileData(xID, zID);
+        createTile(*terrain, data);
+    }
+
+    return terrain;
+}
+
+TileData TerrainGenerator::generateTileData(int xID, int zID) const
+{
+    TileData data;
+    data.xID = xID;
+    data.zID = zID;
+    data.samplesPerAxis = m_settings.maxTileSamplesPerAxis;
+
+    const size_t numSamples = data.samplesPerAxis * data.samplesPerAxis;
+    data.baseHeights = SharedArray<float>(numSamples, 0.0f);
+    data.baseElements = SharedArray<uint8_t>(numSamples, 0);
+    data.liquidHeights = SharedArray<float>(numSamples, 0.0f);
+
+    std::vector<float> & heights = data.baseHeights.write();
+    if (!m_borderHeights.empty()) {
+        assert(m_borderHeights.size() == 2 * data.samplesPerAxis);
+        const uint32_t last = data.samplesPerAxis - 1;
+        for (uint32_t i = 0; i < data.samplesPerAxis; ++i) {
+            heights.at(i) = heights.at(last * data.samplesPerAxis + i) = m_borderHeights.at(i);
+            heights.at(i * data.samplesPerAxis) = heights.at(i * data.samplesPerAxis + last) = m_borderHeights.at(data.samplesPerAxis + i);
+        }
+    }
 
-        std::initializer_list<std::string> baseElements = { "bedrock", "sand", "grassland" };
+    // create the terrain using diamond square algorithm
+    diamondSquare(heights, data.samplesPerAxis, tileKey(xID, zID));
+    // and apply the elements to the landscape
+    applyElementsByHeight(heights, data.baseElements.write(), data.samplesPerAxis);
 
-        /** create terrain object and pass terrain data */
-        BaseTile * baseTile = new BaseTile(*terrain, tileIDBase, baseElements);
+    return data;
+}
 
-        // create the terrain using diamond square algorithm
-        diamondSquare(*baseTile);
-        // and apply the elements to the landscape
-        applyElementsByHeight(*baseTile);
+TileData TerrainGenerator::loadTileData(int xID, int zID) const
+{
+    TileData data;
+    if (m_snapshot && m_snapshot->readTile(xID, zID, m_settings.maxTileSamplesPerAxis, data))
+        return data;
 
-        /** same thing for the liquid level, just that we do not add a terrain type texture */
-        TileID tileIDLiquid(TerrainLevel::WaterLevel, xID, zID);
-        LiquidTile * liquidTile = new LiquidTile(*terrain, tileIDLiquid);
+    if (m_snapshot && m_snapshot->contains(xID, zID))
+        glow::warning("TerrainGenerator: tile %;x%; in %; does not match the settings, generating it", xID, zID, m_settings.snapshotFile);
 
-        /** Create physx objects: an actor with its transformed shapes
-          * move tile according to its id, and by one half tile size, so the center of Tile(0,0,0) is in the origin */
-        PxTransform pxTerrainTransform = PxTransform(PxVec3(m_settings.tileBorderLength() * (xID - 0.5f), 0.0f, m_settings.tileBorderLength() * (zID - 0.5f)));
-        PxRigidStatic * actor = PxGetPhysics().createRigidStatic(pxTerrainTransform);
-        terrain->m_pxActors.emplace(tileIDBase, actor);
+    return generateTileData(xID, zID);
+}
 
-        baseTile->createPxObjects(*actor);
-        liquidTile->createPxObjects(*actor);
+void TerrainGenerator::createTile(Terrain & terrain, TileData & data) const
+{
+    assert(data.samplesPerAxis == m_settings.maxTileSamplesPerAxis);
 
-        pxScene->addActor(*actor);
+    assert(PxGetPhysics().getNbScenes() == 1);
+    PxScene * pxScene;
+    PxGetPhysics().getScenes(&pxScene, 1);
 
-        TileID temperatureID(TerrainLevel::TemperatureLevel, xID, zID);
-        // the tile registers itself in the terrain
-        new TemperatureTile(*terrain, temperatureID, *baseTile, *liquidTile);
+    TileID tileIDBase(TerrainLevel::BaseLevel, data.xID, data.zID);
+
+    /** create terrain object and pass terrain data */
+    BaseTile * baseTile = new BaseTile(terrain, tileIDBase, baseElements());
+    assert(baseTile->m_values.size() == data.baseHeights.size());
+    baseTile->m_values.swap(data.baseHeights);
+    baseTile->m_terrainTypeData.swap(data.baseElements);
+
+    /** same thing for the liquid level, just that we do not add a terrain type texture */
+    TileID tileIDLiquid(TerrainLevel::WaterLevel, data.xID, data.zID);
+    LiquidTile * liquidTile = new LiquidTile(terrain, tileIDLiquid);
+    liquidTile->m_values.swap(data.liquidHeights);
+
+    /** Create physx objects: an actor with its transformed shapes
+      * move tile according to its id, and by one half tile size, so the center of Tile(0,0,0) is in the origin */
+    PxTransform pxTerrainTransform = PxTransform(PxVec3(m_settings.tileBorderLength() * (data.xID - 0.5f), 0.0f, m_settings.tileBorderLength() * (data.zID - 0.5f)));
+    PxRigidStatic * actor = PxGetPhysics().createRigidStatic(pxTerrainTransform);
+    terrain.m_pxActors.emplace(tileIDBase, actor);
+
+    baseTile->createPxObjects(*actor);
+    liquidTile->createPxObjects(*actor);
+
+    pxScene->lockWrite();
+    pxScene->addActor(*actor);
+    pxScene->unlockWrite();
+
+    TileID temperatureID(TerrainLevel::TemperatureLevel, data.xID, data.zID);
+    // the tile registers itself in the terrain
+    TemperatureTile * temperatureTile = new TemperatureTile(terrain, temperatureID, *baseTile, *liquidTile);
+    if (!data.temperatures.empty()) {
+        assert(temperatureTile->m_values.size() == data.temperatures.size());
+        temperatureTile->m_values.swap(data.temperatures);
+        // loaded tiles may not be in their steady state
+        temperatureTile->markDirty(0, data.samplesPerAxis - 1, 0, data.samplesPerAxis - 1);
     }
+}
 
-    return terrain;
+TileData TerrainGenerator::copyTileData(const Terrain & terrain, int xID, int zID)
+{
+    const auto & baseTile = static_cast<const BaseTile &>(*terrain.getTile(TileID(TerrainLevel::BaseLevel, xID, zID)));
+    const TerrainTile & liquidTile = *terrain.getTile(TileID(TerrainLevel::WaterLevel, xID, zID));
+    const TerrainTile & temperatureTile = *terrain.getTile(TileID(TerrainLevel::TemperatureLevel, xID, zID));
+
+    TileData data;
+    data.xID = xID;
+    data.zID = zID;
+    data.samplesPerAxis = baseTile.samplesPerAxis;
+    data.baseHeights = baseTile.m_values;
+    data.baseElements = baseTile.m_terrainTypeData;
+    data.liquidHeights = liquidTile.m_values;
+    data.temperatures = temperatureTile.m_values;
+
+    return data;
 }
 
-void TerrainGenerator::diamondSquare(TerrainTile & tile) const
+TerrainSnapshot TerrainGenerator::snapshot(const Terrain & terrain)
+{
+    TerrainSnapshot snapshot;
+    snapshot.samplesPerAxis = terrain.settings.maxTileSamplesPerAxis;
+    for (const auto & pair : terrain.m_pxActors)
+        snapshot.tiles.push_back(copyTileData(terrain, pair.first.x, pair.first.z));
+    return snapshot;
+}
+
+void TerrainGenerator::reload(Terrain & terrain) const
+{
+    std::vector<TileID> tileIDs;
+    for (const auto & pair : terrain.m_pxActors)
+        tileIDs.push_back(pair.first);
+
+    for (const TileID & tileID : tileIDs) {
+        TileData data = loadTileData(tileID.x, tileID.z);
+        terrain.unregisterTiles(tileID.x, tileID.z);
+        createTile(terrain, data);
+    }
+}
+
+void TerrainGenerator::diamondSquare(std::vector<float> & heights, uint32_t samplesPerAxis, uint64_t tileKey) const
 {
     // assuming the edge length of the field is a power of 2, + 1
     // assuming the field is square
 
-    const unsigned fieldEdgeLength = tile.samplesPerAxis;
-    const float maxHeight = m_settings.maxHeight;
+    struct Field {
+        float * heights;
+        unsigned int edgeLength;
+        float maxHeight;
+        /** streamed tiles keep the shared edges that are already set */
+        bool fixedBorders;
+        uint64_t tileKey;
+
+        float valueAt(unsigned int row, unsigned int column) const
+        {
+            assert(row < edgeLength && column < edgeLength);
+            return heights[column + row * edgeLength];
+        }
+        void setValue(unsigned int row, unsigned int column, float value)
+        {
+            assert(row < edgeLength && column < edgeLength);
+            if (fixedBorders && (row == 0 || column == 0 || row == edgeLength - 1 || column == edgeLength - 1))
+                return;
+            heights[column + row * edgeLength] = value;
+        }
+        float clampHeight(float value) const
+        {
+            return std::max(-maxHeight, std::min(value, maxHeight));
+        }
+        /** random offset, growing with the distance to the field center */
+        float heightRnd(unsigned int row, unsigned int column, float randomMax) const
+        {
+            const float x = row / (edgeLength - 1.0f) * 2.0f - 1.0f;
+            const float z = column / (edgeLength - 1.0f) * 2.0f - 1.0f;
+            return std::sqrt(x * x + z * z) * randomMax * sampleRandom(tileKey, column + row * edgeLength);
+        }
+
+        void diamondStep(unsigned int squareEdgeLength, unsigned int row, unsigned int column, float randomMax)
+        {
+            const unsigned int midpointRow = row + (squareEdgeLength - 1) / 2; // this is always divisible, because of the edge length 2^n + 1
+            const unsigned int midpointColumn = column + (squareEdgeLength - 1) / 2;
+            float heightValue =
+                (valueAt(row, column)
+                + valueAt(row + squareEdgeLength - 1, column)
+                + valueAt(row, column + squareEdgeLength - 1)
+                + valueAt(row + squareEdgeLength - 1, column + squareEdgeLength - 1))
+                * 0.25f
+                + heightRnd(midpointRow, midpointColumn, randomMax);
+
+            setValue(midpointRow, midpointColumn, clampHeight(heightValue));
+        }
+
+        void squareStep(unsigned int diamondRadius, unsigned int diamondCenterRow, unsigned int diamondCenterColumn, float randomMax)
+        {
+            // get the existing data values first: if we get out of the valid range, wrap around, to the next existing value on the other field side
+            int upperRow = signed(diamondCenterRow) - signed(diamondRadius);
+            if (upperRow < 0)
+                upperRow = edgeLength - 1 - diamondRadius; // example: nbRows=5, centerRow=0, upperRow gets -1, we want the second last row (with existing value), so it's 3
+            int lowerRow = signed(diamondCenterRow) + signed(diamondRadius);
+            if (lowerRow >= signed(edgeLength))
+                lowerRow = diamondRadius; // this is easier: use the first row in our column, that is already set
+            int leftColumn = signed(diamondCenterColumn) - signed(diamondRadius);
+            if (leftColumn < 0)
+                leftColumn = edgeLength - 1 - diamondRadius;
+            int rightColumn = signed(diamondCenterColumn) + signed(diamondRadius);
+            if (rightColumn >= signed(edgeLength))
+                rightColumn = diamondRadius;
+            float value =
+                (valueAt(upperRow, diamondCenterColumn)
+                + valueAt(lowerRow, diamondCenterColumn)
+                + valueAt(diamondCenterRow, leftColumn)
+                + valueAt(diamondCenterRow, rightColumn))
+                * 0.25f
+                + heightRnd(diamondCenterRow, diamondCenterColumn, randomMax);
+
+            float clampedHeight = clampHeight(value);
+            setValue(diamondCenterRow, diamondCenterColumn, clampedHeight);
+
+            // in case we are at the borders of the tile: also set the value at the opposite border, to allow seamless tile wrapping
+            if (upperRow > signed(diamondCenterRow))
+                setValue(edgeLength - 1, diamondCenterColumn, clampedHeight);
+            if (leftColumn > signed(diamondCenterColumn))
+                setValue(diamondCenterRow, edgeLength - 1, clampedHeight);
+        }
+    } field = { heights.data(), samplesPerAxis, m_settings.maxHeight, !m_borderHeights.empty(), tileKey };
+
+    assert(heights.size() == size_t(samplesPerAxis) * samplesPerAxis);
 
     float randomMax = 50.0f;
-    std::function<float(float)> clampHeight = [maxHeight](float value) {
-        if (value > maxHeight)
-            value = maxHeight;
-        if (value < -maxHeight)
-            value = -maxHeight;
-        return value;
-    };
-
-    std::function<void(unsigned int, unsigned int, unsigned int, std::function<float(unsigned int, unsigned int)>&)> squareStep =
-        [&tile, fieldEdgeLength, &clampHeight](unsigned int diamondRadius, unsigned int diamondCenterRow, unsigned int diamondCenterColumn, std::function<float(unsigned int, unsigned int)>& heightRnd)
-    {
-        // get the existing data values first: if we get out of the valid range, wrap around, to the next existing value on the other field side
-        int upperRow = signed(diamondCenterRow) - signed(diamondRadius);
-        if (upperRow < 0)
-            upperRow = fieldEdgeLength - 1 - diamondRadius; // example: nbRows=5, centerRow=0, upperRow gets -1, we want the second last row (with existing value), so it's 3
-        int lowerRow = signed(diamondCenterRow) + signed(diamondRadius);
-        if (lowerRow >= signed(fieldEdgeLength))
-            lowerRow = diamondRadius; // this is easier: use the first row in our column, that is already set
-        int leftColumn = signed(diamondCenterColumn) - signed(diamondRadius);
-        if (leftColumn < 0)
-            leftColumn = fieldEdgeLength - 1 - diamondRadius;
-        int rightColumn = signed(diamondCenterColumn) + signed(diamondRadius);
-        if (rightColumn >= signed(fieldEdgeLength))
-            rightColumn = diamondRadius;
-        float value =
-            (tile.valueAt(upperRow, diamondCenterColumn)
-            + tile.valueAt(lowerRow, diamondCenterColumn)
-            + tile.valueAt(diamondCenterRow, leftColumn)
-            + tile.valueAt(diamondCenterRow, rightColumn))
-            * 0.25f
-            + heightRnd(diamondCenterRow, diamondCenterColumn);
-
-        float clampedHeight = clampHeight(value);
-        tile.setValue(diamondCenterRow, diamondCenterColumn, clampedHeight);
-
-        // in case we are at the borders of the tile: also set the value at the opposite border, to allow seamless tile wrapping
-        if (upperRow > signed(diamondCenterRow))
-            tile.setValue(fieldEdgeLength - 1, diamondCenterColumn, clampedHeight);
-        if (leftColumn > signed(diamondCenterColumn))
-            tile.setValue(diamondCenterRow, fieldEdgeLength - 1, clampedHeight);
-    };
-    
     unsigned nbSquareRows = 1; // number of squares in a row, doubles each time the current edge length increases [same for the columns]
 
-    for (unsigned int len = fieldEdgeLength; len > 2; len = (len / 2) + 1) // length: 9, 5, 3, finished
+    // Within each pass, all samples only read values of the previous passes and are written once, with a random value
+    // that depends on the sample index only. So the rows of squares are split between threads and the result
+    // is the same for any number of threads.
+    for (unsigned int len = samplesPerAxis; len > 2; len = (len / 2) + 1) // length: 9, 5, 3, finished
     {
         const unsigned int currentEdgeLength = len;
-        std::uniform_real_distribution<float> dist(-randomMax, randomMax);
-        std::function<float(unsigned int, unsigned int)> heightRndPos =
-            [fieldEdgeLength, &dist](unsigned int row, unsigned int column) {
-            glm::vec2 pos(row, column);
-            pos = pos / (fieldEdgeLength - 1.0f) * 2.0f - 1.0f;
-            return float(glm::length(pos)) * dist(rng);
-            //return std::abs(float(row + column) / float(2 * fieldEdgeLength - 2) * 2.0f - 1.0f) * dist(rng);
-        };
+        unsigned int numStripes = m_settings.generatorStripes;
+        if (numStripes == 0)
+            numStripes = std::min(WorkerPool::instance().numThreads(), nbSquareRows * nbSquareRows / minSamplesPerStripe);
+        numStripes = std::max(1u, std::min(numStripes, nbSquareRows));
+
         // create diamonds
-        for (unsigned int rowN = 0; rowN < nbSquareRows; ++rowN) {
-            const unsigned int row = rowN * (currentEdgeLength - 1);
-            const unsigned int midpointRow = row + (currentEdgeLength - 1) / 2; // this is always divisible, because of the edge length 2^n + 1
-            for (unsigned int columnN = 0; columnN < nbSquareRows; ++columnN) {
-                const unsigned int column = columnN * (currentEdgeLength - 1);
-                const unsigned int midpointColumn = column + (currentEdgeLength - 1) / 2;
-                float heightValue =
-                    (tile.valueAt(row, column)
-                    + tile.valueAt(row + currentEdgeLength - 1, column)
-                    + tile.valueAt(row, column + currentEdgeLength - 1)
-                    + tile.valueAt(row + currentEdgeLength - 1, column + currentEdgeLength - 1))
-                    * 0.25f
-                    + heightRndPos(midpointRow, midpointColumn);
-
-                tile.setValue(midpointRow, midpointColumn, clampHeight(heightValue));
+        forEachRowStripe(nbSquareRows, numStripes, [&field, currentEdgeLength, nbSquareRows, randomMax](unsigned int beginRowN, unsigned int endRowN) {
+            for (unsigned int rowN = beginRowN; rowN < endRowN; ++rowN) {
+                const unsigned int row = rowN * (currentEdgeLength - 1);
+                for (unsigned int columnN = 0; columnN < nbSquareRows; ++columnN)
+                    field.diamondStep(currentEdgeLength, row, columnN * (currentEdgeLength - 1), randomMax);
             }
-        }
+        });
 
         // create squares
-        unsigned int diamondRadius = (currentEdgeLength - 1) / 2;
+        const unsigned int diamondRadius = (currentEdgeLength - 1) / 2;
         // don't iterate over the last row/column here. These values are set with the first row/column, to allow seamless tile wrapping
-        for (unsigned int rowN = 0; rowN < nbSquareRows; ++rowN) {
-            const unsigned int seedpointRow = rowN * (currentEdgeLength - 1);
-            for (unsigned int columnN = 0; columnN < nbSquareRows; ++columnN) {
-                const unsigned int seedpointColumn = columnN * (currentEdgeLength - 1);
-
-                unsigned int rightDiamondColumn = seedpointColumn + currentEdgeLength / 2;
-                if (rightDiamondColumn < tile.samplesPerAxis)
-                    squareStep(diamondRadius, seedpointRow, rightDiamondColumn, heightRndPos);
-
-                unsigned int bottomDiamondRow = seedpointRow + currentEdgeLength / 2;
-                if (bottomDiamondRow < tile.samplesPerAxis)
-                    squareStep(diamondRadius, bottomDiamondRow, seedpointColumn, heightRndPos);
+        forEachRowStripe(nbSquareRows, numStripes, [&field, currentEdgeLength, nbSquareRows, diamondRadius, randomMax](unsigned int beginRowN, unsigned int endRowN) {
+            for (unsigned int rowN = beginRowN; rowN < endRowN; ++rowN) {
+                const unsigned int seedpointRow = rowN * (currentEdgeLength - 1);
+                for (unsigned int columnN = 0; columnN < nbSquareRows; ++columnN) {
+                    const unsigned int seedpointColumn = columnN * (currentEdgeLength - 1);
+
+                    unsigned int rightDiamondColumn = seedpointColumn + currentEdgeLength / 2;
+                    if (rightDiamondColumn < field.edgeLength)
+                        field.squareStep(diamondRadius, seedpointRow, rightDiamondColumn, randomMax);
+
+                    unsigned int bottomDiamondRow = seedpointRow + currentEdgeLength / 2;
+                    if (bottomDiamondRow < field.edgeLength)
+                        field.squareStep(diamondRadius, bottomDiamondRow, seedpointColumn, randomMax);
+                }
             }
-        }
+        });
 
         nbSquareRows *= 2;
         randomMax *= 0.5;
     }
 }
 
-void TerrainGenerator::applyElementsByHeight(BaseTile & tile) const
+void TerrainGenerator::applyElementsByHeight(const std::vector<float> & heights, std::vector<uint8_t> & elements, uint32_t samplesPerAxis) const
 {
-    uint8_t sand = tile.elementIndex("sand");
-    uint8_t grassland = tile.elementIndex("grassland");
-    uint8_t bedrock = tile.elementIndex("bedrock");
+    uint8_t sand = baseElementIndex("sand");
+    uint8_t grassland = baseElementIndex("grassland");
+    uint8_t bedrock = baseElementIndex("bedrock");
 
     float sandMaxHeight = 2.5f;     // under water + shore
     float grasslandMaxHeight = m_settings.maxHeight * 0.2f;
 
-    for (unsigned int row = 0; row < tile.samplesPerAxis - 1; ++row) {
-        const unsigned int rowOffset = row * tile.samplesPerAxis;
-        for (unsigned int column = 0; column < tile.samplesPerAxis - 1; ++column) {
+    for (unsigned int row = 0; row < samplesPerAxis - 1; ++row) {
+        const unsigned int rowOffset = row * samplesPerAxis;
+        for (unsigned int column = 0; column < samplesPerAxis - 1; ++column) {
             const unsigned int index = rowOffset + column;
 
             float height = 0.25f * (
-                tile.valueAt(index)
-                + tile.valueAt(row + 1, column)
-                + tile.valueAt(row, column + 1)
-                + tile.valueAt(row + 1, column + 1));
+                heights.at(index)
+                + heights.at(index + samplesPerAxis)
+                + heights.at(index + 1)
+                + heights.at(index + samplesPerAxis + 1));
             if (height < sandMaxHeight) {
-                tile.setElement(index, sand);
+                elements.at(index) = sand;
                 continue;
             }
             if (height < grasslandMaxHeight) {
-                tile.setElement(index, grassland);
+                elements.at(index) = grassland;
                 continue;
             }
-            tile.setElement(index, bedrock);
+            elements.at(index) = bedrock;
         }
     }
 }
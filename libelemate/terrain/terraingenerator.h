@@ -1,12 +1,34 @@
 #pragma once
 
+#include <cstdint>
+#include <initializer_list>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "terrainsettings.h"
+#include "utils/sharedarray.h"
 
 class Terrain;
 class TerrainTile;
 class BaseTile;
+class TileFile;
+struct TerrainSnapshot;
+
+/** @brief Values of all levels of one tile, without OpenGL or PhysX objects.
+  * Can be created on any thread and is turned into tiles with TerrainGenerator::createTile.
+  * Copies share the arrays with each other and with the tiles until one of them is edited. */
+struct TileData {
+    int xID = 0;
+    int zID = 0;
+    uint32_t samplesPerAxis = 0;
+    SharedArray<float> baseHeights;
+    /** element index per sample, in the order of TerrainGenerator::baseElements() */
+    SharedArray<uint8_t> baseElements;
+    SharedArray<float> liquidHeights;
+    /** empty for new tiles, which get the temperatures depending on their heights */
+    SharedArray<float> temperatures;
+};
 
 /** Generator for height field terrains
   * Terrains are oriented in the xz-plane, using the default PhysX coordinate system for height fields.
@@ -14,14 +36,47 @@ class BaseTile;
   * rows = x axis, height = y axis, columns = z axis */
 class TerrainGenerator {
 public:
-    /** applies all settings and creates the height field landscape */
+    TerrainGenerator(const TerrainSettings & settings = TerrainSettings());
+
+    /** applies all settings and creates the height field landscape.
+      * When streaming, only the tiles within the streaming radius of the origin are created. */
     std::shared_ptr<Terrain> generate() const;
 
+    const TerrainSettings & settings() const;
+    /** Map another snapshot file, see TerrainSettings::snapshotFile */
+    void setSnapshotFile(const std::string & snapshotFile);
+
+    /** Generate the values of the tile at the tile x/z-ID. The random numbers are keyed by the tile ID and sample,
+      * so this is thread safe and creates the same tile for the same ID, for any number of threads. */
+    TileData generateTileData(int xID, int zID) const;
+    /** Read the tile from the snapshot file of the settings if it contains the tile, generate it otherwise. Thread safe. */
+    TileData loadTileData(int xID, int zID) const;
+    /** Create the tiles of all levels and their physx actor from the data and register them in the terrain.
+      * The data is moved into the tiles. Must be called on the thread that owns the physx scene. */
+    void createTile(Terrain & terrain, TileData & data) const;
+    /** Copy the current values of all levels of a loaded tile, including all edits. Only copies the handles of the arrays,
+      * the tile copies its values on the next edit. */
+    static TileData copyTileData(const Terrain & terrain, int xID, int zID);
+    /** Copy all loaded tiles of the terrain, see copyTileData. Written to a tile file, they can be used as snapshot file in the settings. */
+    static TerrainSnapshot snapshot(const Terrain & terrain);
+    /** Replace all loaded tiles of the terrain by the tiles of the snapshot file, or by newly generated tiles if it doesn't contain them.
+      * Must be called on the thread that owns the physx scene, while it is not simulating. */
+    void reload(Terrain & terrain) const;
+
+    /** elements of the base level, their index in this list is used in TileData::baseElements */
+    static const std::initializer_list<std::string> & baseElements();
+
 private:
     TerrainSettings m_settings;
+    /** mapped snapshot file, shared by all copies of the generator */
+    std::shared_ptr<const TileFile> m_snapshot;
+    /** when streaming: first row, then first column of tile (0, 0), shared by all tiles */
+    std::vector<float> m_borderHeights;
 
-    /** http://www.gameprogrammer.com/fractal.html#diamond algorithm for terrain creation */
-    void diamondSquare(TerrainTile & tile) const;
+    /** http://www.gameprogrammer.com/fractal.html#diamond algorithm for terrain creation.
+      * The edges wrap around: the last row/column equals the first one, so that tiles can be placed next to each other.
+      * The squares of each level are processed in parallel. */
+    void diamondSquare(std::vector<float> & heights, uint32_t samplesPerAxis, uint64_t tileKey) const;
     /** apply sand, grassland and bedrock terrain elements depending on the height values */
-    void applyElementsByHeight(BaseTile & tile) const;
+    void applyElementsByHeight(const std::vector<float> & heights, std::vector<uint8_t> & elements, uint32_t samplesPerAxis) const;
 };
@@ -2,6 +2,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <map>
+#include <memory>
+#include <tuple>
 
 #include <glow/logging.h>
 
@@ -20,6 +23,9 @@
 
 #include "terrain.h"
 #include "physicaltile.h"
+#include "heightfieldupdatequeue.h"
+#include "terrainbrush.h"
+#include "temperaturetile.h"
 #include "physicswrapper.h"
 #include "lua/luawrapper.h"
 
@@ -178,83 +184,127 @@ float TerrainInteraction::changeLevelHeight(float worldX, float worldZ, TerrainL
     return setValue(*tile.get(), row, column, height + delta, setToInteractionElement);
 }
 
+namespace {
+
+/** division rounding towards negative infinity */
+int floorDiv(int numerator, int denominator)
+{
+    assert(denominator > 0);
+    return numerator >= 0 ? numerator / denominator : -((-numerator + denominator - 1) / denominator);
+}
+
+}
+
 float TerrainInteraction::setValue(TerrainTile & tile, unsigned row, unsigned column, float value, bool setToInteractionElement)
 {
-    float stddev = tile.interactStdDeviation;
-    assert(stddev > 0);
+    assert(tile.interactStdDeviation > 0);
 
     /** clamp value */
     if (value < tile.minValidValue) value = tile.minValidValue;
     if (value > tile.maxValidValue) value = tile.maxValidValue;
 
-    // define the size of the affected interaction area, in grid coords
-    const float effectRadiusWorld = stddev * 3;
-    const uint32_t effectRadius = static_cast<uint32_t>(std::ceil(effectRadiusWorld * tile.samplesPerWorldCoord)); // = 0 means to change only the value at (row,column)
-
-    bool moveUp = (value - tile.valueAt(row, column)) > 0;
-    int invert = moveUp ? 1 : -1;   // invert the curve if moving downwards
-
-    float norm0Inv = 1.0f / normalDist(0, 0, stddev);
-    float valueRange = std::abs(tile.maxValidValue - tile.minValidValue);
-    std::function<float(float)> interactHeight = [stddev, norm0Inv, value, valueRange, invert](float x) {
-        return normalDist(x, 0, stddev)     // - normalize normDist to
-                   * norm0Inv               //    normDist value at interaction center
-               * (valueRange + 10)          // - scale to value range + offset to omit norm values near 0
-               * invert                     // - mirror the curve along the y axis if moving downward
-               + value                      // - move along y so that value==0 => y==0
-               - (valueRange + 10) * invert;
-    };
-
-    unsigned int minRow, maxRow, minColumn, maxColumn;
-    {
-        // unchecked signed min/max values, possibly < 0 or > numRows/Column
-        int iMinRow = row - effectRadius, iMaxRow = row + effectRadius, iMinColumn = column - effectRadius, iMaxColumn = column + effectRadius;
-        // work on rows and column that are in range of the terrain tile settings and larger than 0
-        minRow = iMinRow < 0 ? 0 : (iMinRow >= static_cast<signed>(tile.samplesPerAxis) ? tile.samplesPerAxis - 1 : static_cast<unsigned int>(iMinRow));
-        maxRow = iMaxRow < 0 ? 0 : (iMaxRow >= static_cast<signed>(tile.samplesPerAxis) ? tile.samplesPerAxis - 1 : static_cast<unsigned int>(iMaxRow));
-        minColumn = iMinColumn < 0 ? 0 : (iMinColumn >= static_cast<signed>(tile.samplesPerAxis) ? tile.samplesPerAxis - 1 : static_cast<unsigned int>(iMinColumn));
-        maxColumn = iMaxColumn < 0 ? 0 : (iMaxColumn >= static_cast<signed>(tile.samplesPerAxis) ? tile.samplesPerAxis - 1 : static_cast<unsigned int>(iMaxColumn));
-    }
+    const bool moveUp = (value - tile.valueAt(row, column)) > 0;
+    const float valueRange = std::abs(tile.maxValidValue - tile.minValidValue);
+
+    BrushStroke stroke;
+    stroke.brush = &brush(tile);
+    // scale to value range + offset to omit falloff values near 0, mirror the falloff if moving downward
+    stroke.depth = (valueRange + 10) * (moveUp ? 1 : -1);
+    stroke.base = value - stroke.depth;
+    stroke.moveUp = moveUp;
+    stroke.setElement = setToInteractionElement;
+    stroke.elementIndex = 0;
 
     // also change element id's if requested and the tile supports it
-    PhysicalTile * physicalTile = dynamic_cast<PhysicalTile*>(&tile);
-    
     if (setToInteractionElement) {
-        assert(physicalTile);
+        assert(levelIsPhysical(tile.m_tileID.level));
+        stroke.elementIndex = static_cast<PhysicalTile &>(tile).elementIndex(m_interactElement);
     }
 
-    uint8_t elementIndex = 0;
-    if (physicalTile)
-        elementIndex = physicalTile->elementIndex(m_interactElement);
-
-    for (unsigned int r = minRow; r <= maxRow; ++r) {
-        float relWorldX = (signed(r) - signed(row)) * tile.sampleInterval;
-        for (unsigned int c = minColumn; c <= maxColumn; ++c) {
-            float relWorldZ = (signed(c) - signed(column)) * tile.sampleInterval;
+    // Neighbor tiles share their border samples, so the rows/columns of all tiles of a level form a grid with this stride.
+    // The brush is applied to all loaded tiles it overlaps, so that there are no seams at the tile borders.
+    const int stride = static_cast<int>(tile.samplesPerAxis) - 1;
+    const int radius = static_cast<int>(stroke.brush->radius);
+    const int gridRow = tile.m_tileID.x * stride + static_cast<int>(row);
+    const int gridColumn = tile.m_tileID.z * stride + static_cast<int>(column);
+
+    for (int xID = floorDiv(gridRow - radius - 1, stride); xID <= floorDiv(gridRow + radius, stride); ++xID) {
+        for (int zID = floorDiv(gridColumn - radius - 1, stride); zID <= floorDiv(gridColumn + radius, stride); ++zID) {
+            TerrainTile * neighbor = &tile;
+            if (xID != tile.m_tileID.x || zID != tile.m_tileID.z) {
+                neighbor = m_terrain.findTile(TileID(tile.m_tileID.level, xID, zID)).get();
+                if (!neighbor)
+                    continue;
+            }
+            applyBrush(*neighbor, gridRow - xID * stride, gridColumn - zID * stride, stroke);
+        }
+    }
 
-            float localRadius = std::sqrt(relWorldX*relWorldX + relWorldZ*relWorldZ);
+    return value;
+}
 
-            if (localRadius > effectRadiusWorld)  // interaction in a circle, not square
-                continue;
+void TerrainInteraction::applyBrush(TerrainTile & tile, int centerRow, int centerColumn, const BrushStroke & stroke)
+{
+    const TerrainBrush & brush = *stroke.brush;
+    const int radius = static_cast<int>(brush.radius);
+    const int lastSample = static_cast<int>(tile.samplesPerAxis) - 1;
+
+    const int minRow = std::max(0, centerRow - radius);
+    const int maxRow = std::min(lastSample, centerRow + radius);
+    const int minColumn = std::max(0, centerColumn - radius);
+    const int maxColumn = std::min(lastSample, centerColumn + radius);
+    if (minRow > maxRow || minColumn > maxColumn)
+        return;
+
+    PhysicalTile * physicalTile = levelIsPhysical(tile.m_tileID.level) ? static_cast<PhysicalTile *>(&tile) : nullptr;
+    assert(physicalTile || !stroke.setElement);
+    if (stroke.setElement && m_changedSamples.size() < 2 * brush.radius + 1)
+        m_changedSamples.resize(2 * brush.radius + 1);
+
+    float * values = tile.m_values.write().data();
+    for (int r = minRow; r <= maxRow; ++r) {
+        const int rowOffset = r - centerRow;
+        const int halfWidth = brush.halfWidths.at(std::abs(rowOffset));
+        const int begin = std::max(minColumn, centerColumn - halfWidth);
+        const int end = std::min(maxColumn, centerColumn + halfWidth);
+        if (begin > end)
+            continue;
 
-            float newLocalHeight = interactHeight(localRadius);
+        const unsigned int rowStart = static_cast<unsigned int>(r) * tile.samplesPerAxis + begin;
+        const uint32_t count = static_cast<uint32_t>(end - begin + 1);
+        uint8_t * changed = stroke.setElement ? m_changedSamples.data() : nullptr;
 
-            bool localMoveUp = newLocalHeight > tile.valueAt(r, c);
-            // don't do anything if we pull up the terrain but the local height point is already higher than its calculated height. (vice versa)
-            if (localMoveUp != moveUp)
-                continue;
+        applyBrushRow(values + rowStart, brush.row(rowOffset) + (begin - centerColumn), count,
+            stroke.base, stroke.depth, stroke.moveUp, changed);
 
-            tile.setValue(r, c, newLocalHeight);
-            if (setToInteractionElement)
-                physicalTile->setElement(r, c, elementIndex);
+        if (changed) {
+            for (uint32_t i = 0; i < count; ++i)
+                if (changed[i])
+                    physicalTile->setElement(rowStart + i, stroke.elementIndex);
         }
-        tile.addBufferUpdateRange(minColumn + r * tile.samplesPerAxis, 1u + effectRadius * 2u);
     }
 
+    tile.addBufferUpdateRect(minRow, maxRow, minColumn, maxColumn);
+
     if (physicalTile)
-        physicalTile->addToPxUpdateBox(minRow, maxRow, minColumn, maxColumn);
+        m_terrain.m_pxUpdateQueue->add(*physicalTile, minRow, maxRow, minColumn, maxColumn);
 
-    return value;
+    // the target temperatures depend on the base heights
+    if (tile.m_tileID.level == TerrainLevel::BaseLevel || tile.m_tileID.level == TerrainLevel::TemperatureLevel) {
+        TileID temperatureID(TerrainLevel::TemperatureLevel, tile.m_tileID.x, tile.m_tileID.z);
+        std::static_pointer_cast<TemperatureTile>(m_terrain.getTile(temperatureID))->markDirty(minRow, maxRow, minColumn, maxColumn);
+    }
+}
+
+const TerrainBrush & TerrainInteraction::brush(const TerrainTile & tile)
+{
+    // tiles of the same level share their brush
+    static std::map<std::tuple<float, float, float>, std::unique_ptr<TerrainBrush>> s_brushes;
+
+    std::unique_ptr<TerrainBrush> & brush = s_brushes[std::make_tuple(tile.interactStdDeviation, tile.sampleInterval, tile.samplesPerWorldCoord)];
+    if (!brush)
+        brush.reset(new TerrainBrush(tile.interactStdDeviation, tile.sampleInterval, tile.samplesPerWorldCoord));
+    return *brush;
 }
 
 float TerrainInteraction::heightGrab(float worldX, float worldZ)
@@ -269,6 +319,15 @@ void TerrainInteraction::heightPull(float worldX, float worldZ)
     setLevelHeight(worldX, worldZ, m_grabbedLevel, m_grabbedHeight, true);
 }
 
+void TerrainInteraction::exchangeHeat(const float * x, const float * z, const uint16_t * validMask, uint32_t count, float & temperature)
+{
+    // each tile skips the particles outside of it
+    for (const auto & pair : m_terrain.m_attributeTiles) {
+        if (pair.first.level == TerrainLevel::TemperatureLevel)
+            std::static_pointer_cast<TemperatureTile>(pair.second)->exchangeHeat(x, z, validMask, count, temperature);
+    }
+}
+
 const Terrain & TerrainInteraction::terrain() const
 {
     return m_terrain;
@@ -276,28 +335,28 @@ const Terrain & TerrainInteraction::terrain() const
 
 void TerrainInteraction::registerLuaFunctions(LuaWrapper & lua)
 {
-    std::function<float(float, float)> func0 = [=](float worldX, float worldZ)
+    auto func0 = [=](float worldX, float worldZ)
     { return heightAt(worldX, worldZ); };
 
-    std::function<bool(float, float)> func1 = [=](float worldX, float worldZ)
+    auto func1 = [=](float worldX, float worldZ)
     { return isHeighestAt(worldX, worldZ); };
 
-    std::function<float(float, float, float)> func2 = [=](float worldX, float worldZ, float delta)
+    auto func2 = [=](float worldX, float worldZ, float delta)
     { return changeHeight(worldX, worldZ, delta); };
 
-    std::function<float(float, float, float)> func3 = [=](float worldX, float worldZ, float heightDelta)
+    auto func3 = [=](float worldX, float worldZ, float heightDelta)
     { return dropElement(worldX, worldZ, heightDelta); };
 
-    std::function<float(float, float, float)> func4 = [=](float worldX, float worldZ, float heightDelta)
+    auto func4 = [=](float worldX, float worldZ, float heightDelta)
     { return gatherElement(worldX, worldZ, heightDelta); };
 
-    std::function<float(float, float)> func5 = [=](float worldX, float worldZ)
+    auto func5 = [=](float worldX, float worldZ)
     { return terrainHeightAt(worldX, worldZ); };
 
-    std::function<float(float, float)> func6 = [=](float worldX, float worldZ)
+    auto func6 = [=](float worldX, float worldZ)
     { return heightGrab(worldX, worldZ); };
 
-    std::function<int(std::string)> func7 = [=](std::string elementName)
+    auto func7 = [=](std::string elementName)
     { setInteractElement(elementName); return 0; };
 
     std::function<float()> func8 = std::bind(&TerrainSettings::minSampleInterval, m_terrain.settings);
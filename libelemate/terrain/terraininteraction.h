@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "terrainsettings.h"
 
 class Terrain;
 class TerrainTile;
+struct TerrainBrush;
 class LuaWrapper;
 
 class TerrainInteraction
@@ -70,6 +73,11 @@ public:
     /** pulls the terrain at worldXZ, setting the height to the grabbed value */
     void heightPull(float worldX, float worldZ);
 
+    /** Exchange heat between the particles at the world positions x/z and the temperature level below them.
+      * @param validMask particles with zero mask are skipped
+      * @param temperature the particles' common temperature, updated by the exchanged heat */
+    void exchangeHeat(const float * x, const float * z, const uint16_t * validMask, uint32_t count, float & temperature);
+
     const Terrain & terrain() const;
 
     static float normalDist(float x, float mean, float stddev);
@@ -88,8 +96,26 @@ private:
     /** for internal usage: the terrain level that hold the configured interact element */
     TerrainLevel m_interactLevel;
 
+    /** Move the samples around row/column towards value, on the tile and its neighbors that the brush overlaps. */
     float setValue(TerrainTile & tile, unsigned row, unsigned column, float value, bool setToInteractionElement);
 
+    struct BrushStroke {
+        const TerrainBrush * brush;
+        /** height at the border of the brush */
+        float base;
+        /** height difference between the brush center and border */
+        float depth;
+        bool moveUp;
+        bool setElement;
+        uint8_t elementIndex;
+    };
+    /** apply the stroke to one tile. centerRow/centerColumn are relative to the tile and may be outside of it. */
+    void applyBrush(TerrainTile & tile, int centerRow, int centerColumn, const BrushStroke & stroke);
+    /** the brush for the interactStdDeviation and sample interval of the tile, created on first use */
+    static const TerrainBrush & brush(const TerrainTile & tile);
+    /** reused for the changed samples of a brush row */
+    std::vector<uint8_t> m_changedSamples;
+
     TerrainLevel m_grabbedLevel;
     float m_grabbedHeight;
 
@@ -0,0 +1,170 @@
+#include "terrainlod.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+const uint32_t TerrainLod::s_restartIndex = std::numeric_limits<uint32_t>::max();
+
+TerrainLod::TerrainLod(unsigned int tileCells, unsigned int leafCells, float lodDistance)
+: m_tileCells(tileCells)
+, m_leafCells(leafCells)
+, m_lodDistance(lodDistance > 0.0f ? lodDistance : 4.0f * leafCells)
+, m_numLevels(1)
+, m_viewRange(std::numeric_limits<float>::max())
+{
+    assert(leafCells >= 2 && leafCells % 2 == 0);
+    assert(tileCells >= leafCells && tileCells % leafCells == 0);
+    assert(m_lodDistance >= 2.0f * leafCells);
+
+    for (unsigned int nodeCells = leafCells; nodeCells < tileCells; nodeCells *= 2)
+        ++m_numLevels;
+    assert(leafCells << (m_numLevels - 1) == tileCells);
+
+    buildGrid(leafCells, m_vertices);
+    buildGridIndices(leafCells, leafCells, m_indices);
+    m_quarterIndexOffset = m_indices.size();
+    buildGridIndices(leafCells, leafCells / 2, m_indices);
+}
+
+void TerrainLod::buildGrid(unsigned int cells, std::vector<glm::vec2> & vertices)
+{
+    vertices.reserve(vertices.size() + (cells + 1) * (cells + 1));
+    for (unsigned int row = 0; row <= cells; ++row)
+        for (unsigned int column = 0; column <= cells; ++column)
+            vertices.push_back(glm::vec2(row, column));
+}
+
+void TerrainLod::buildGridIndices(unsigned int cells, unsigned int drawnCells, std::vector<uint32_t> & indices)
+{
+    assert(drawnCells <= cells);
+    const unsigned int verticesPerRow = cells + 1;
+
+    indices.reserve(indices.size() + drawnCells * (2 * (drawnCells + 1) + 1));
+    for (unsigned int row = 0; row < drawnCells; ++row) {
+        for (unsigned int column = 0; column <= drawnCells; ++column) {
+            // "origin" is the left front vertex in a terrain quad
+            const uint32_t origin = column + row * verticesPerRow;
+            indices.push_back(origin);
+            indices.push_back(origin + verticesPerRow);
+        }
+        indices.push_back(s_restartIndex);
+    }
+}
+
+void TerrainLod::select(const glm::vec2 & cameraRowColumn, unsigned int minLevel, const VisibilityTest & visible, std::vector<Node> & nodes) const
+{
+    minLevel = std::min(minLevel, m_numLevels - 1);
+    selectNode(cameraRowColumn, 0, 0, m_numLevels - 1, minLevel, visible, nodes);
+}
+
+bool TerrainLod::selectNode(const glm::vec2 & cameraRowColumn, uint32_t row, uint32_t column, unsigned int level, unsigned int minLevel,
+    const VisibilityTest & visible, std::vector<Node> & nodes) const
+{
+    const uint32_t spacing = 1u << level;
+    const uint32_t size = m_leafCells * spacing;
+    const float nodeDistance = distance(cameraRowColumn, row, column, size);
+
+    if (nodeDistance > m_viewRange)
+        return true;
+    if (visible && !visible(glm::vec2(row, column), glm::vec2(row + size, column + size)))
+        return true;
+    if (nodeDistance > range(level))
+        return false;
+
+    if (level == minLevel || nodeDistance > range(level - 1)) {
+        nodes.push_back({ row, column, spacing, level, false });
+        return true;
+    }
+
+    const uint32_t half = size / 2;
+    for (uint32_t childRow = row; childRow < row + size; childRow += half) {
+        for (uint32_t childColumn = column; childColumn < column + size; childColumn += half) {
+            if (!selectNode(cameraRowColumn, childRow, childColumn, level - 1, minLevel, visible, nodes))
+                nodes.push_back({ childRow, childColumn, spacing, level, true });
+        }
+    }
+    return true;
+}
+
+float TerrainLod::distance(const glm::vec2 & point, uint32_t row, uint32_t column, uint32_t size)
+{
+    const float dx = std::max(0.0f, std::max(row - point.x, point.x - (row + size)));
+    const float dz = std::max(0.0f, std::max(column - point.y, point.y - (column + size)));
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+void TerrainLod::setViewRange(float viewRange)
+{
+    m_viewRange = viewRange;
+}
+
+float TerrainLod::viewRange() const
+{
+    return m_viewRange;
+}
+
+unsigned int TerrainLod::tileCells() const
+{
+    return m_tileCells;
+}
+
+unsigned int TerrainLod::leafCells() const
+{
+    return m_leafCells;
+}
+
+unsigned int TerrainLod::numLevels() const
+{
+    return m_numLevels;
+}
+
+float TerrainLod::range(unsigned int level) const
+{
+    if (level + 1 >= m_numLevels)
+        return std::numeric_limits<float>::max();
+    return m_lodDistance * static_cast<float>(1u << level);
+}
+
+glm::vec2 TerrainLod::morphRange(unsigned int level) const
+{
+    if (level + 1 >= m_numLevels)
+        return glm::vec2(0.5f * std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+
+    // Morph in the last quarter between the previous range and this one. The nodes of the next finer level reach at most
+    // their range plus their diagonal, which is closer than the morph start, so the border to them doesn't morph.
+    const float end = range(level);
+    const float previous = 0.5f * end;
+    return glm::vec2(end - 0.25f * (end - previous), end);
+}
+
+const std::vector<glm::vec2> & TerrainLod::vertices() const
+{
+    return m_vertices;
+}
+
+const std::vector<uint32_t> & TerrainLod::indices() const
+{
+    return m_indices;
+}
+
+size_t TerrainLod::indexOffset(const Node & node) const
+{
+    return node.quarter ? m_quarterIndexOffset : 0;
+}
+
+size_t TerrainLod::indexCount(const Node & node) const
+{
+    return node.quarter ? m_indices.size() - m_quarterIndexOffset : m_quarterIndexOffset;
+}
+
+unsigned int TerrainLod::numTriangles(const std::vector<Node> & nodes) const
+{
+    unsigned int triangles = 0;
+    for (const Node & node : nodes) {
+        const unsigned int cells = node.quarter ? m_leafCells / 2 : m_leafCells;
+        triangles += 2 * cells * cells;
+    }
+    return triangles;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/** @brief Continuous distance-dependent level of detail (CDLOD) for the terrain tiles.
+
+    A tile is divided into a quadtree of nodes. All nodes are drawn with the same grid of leafCells x leafCells cells,
+    the samples between two grid vertices double with each level. Level 0 uses every sample of the tile.
+    Nodes of level k are selected up to the distance range(k) from the camera. Near the end of their range, the vertex
+    shader morphs the odd grid vertices onto the even ones, so that the node matches the next coarser level at its border.
+    All positions and distances are in rows/columns of the tile, only the x/z distance to the camera is used. */
+class TerrainLod
+{
+public:
+    /** @param tileCells number of cells per tile axis (samples per axis - 1), leafCells * 2^n
+      * @param leafCells number of grid cells per node axis, even
+      * @param lodDistance range of level 0, at least 2 * leafCells so that a node only borders the next finer or coarser level.
+      *     Uses 4 * leafCells if 0. */
+    TerrainLod(unsigned int tileCells, unsigned int leafCells = 32, float lodDistance = 0.0f);
+
+    struct Node {
+        /** lowest row/column of the node */
+        uint32_t row;
+        uint32_t column;
+        /** samples between two grid vertices, 2^level */
+        uint32_t spacing;
+        uint32_t level;
+        /** Whether only the first leafCells / 2 cells per axis of the grid are drawn, which covers one child node.
+          * Used for the children that are out of their range, while their siblings are drawn at the finer level. */
+        bool quarter;
+    };
+
+    /** @return whether the rows/columns from minRowColumn to maxRowColumn can be visible */
+    typedef std::function<bool(const glm::vec2 & minRowColumn, const glm::vec2 & maxRowColumn)> VisibilityTest;
+
+    /** Append the nodes that cover the tile within the view range from the camera position.
+      * @param minLevel finest level to select, coarser levels are used for all closer areas
+      * @param visible skips nodes that are not visible, may be empty */
+    void select(const glm::vec2 & cameraRowColumn, unsigned int minLevel, const VisibilityTest & visible, std::vector<Node> & nodes) const;
+
+    /** Nodes farther away than the view range are not selected. The top level is used up to the view range. */
+    void setViewRange(float viewRange);
+    float viewRange() const;
+
+    unsigned int tileCells() const;
+    unsigned int leafCells() const;
+    unsigned int numLevels() const;
+    /** distance up to which nodes of the level are selected */
+    float range(unsigned int level) const;
+    /** start and end distance of the morph to the next coarser level, the top level doesn't morph */
+    glm::vec2 morphRange(unsigned int level) const;
+
+    /** grid vertices in grid cells, drawn as triangle strips with one strip per row of cells */
+    const std::vector<glm::vec2> & vertices() const;
+    /** the indices of the full grid, followed by the indices of the quarter grid, which use the same vertices */
+    const std::vector<uint32_t> & indices() const;
+    /** first index and number of indices to draw for the node */
+    size_t indexOffset(const Node & node) const;
+    size_t indexCount(const Node & node) const;
+
+    unsigned int numTriangles(const std::vector<Node> & nodes) const;
+
+    static const uint32_t s_restartIndex;
+
+    /** append the row major vertices of a grid of cells x cells cells */
+    static void buildGrid(unsigned int cells, std::vector<glm::vec2> & vertices);
+    /** Append the triangle strip indices of the first drawnCells x drawnCells cells of the grid,
+      * one strip per row of cells, each followed by the restart index. */
+    static void buildGridIndices(unsigned int cells, unsigned int drawnCells, std::vector<uint32_t> & indices);
+
+protected:
+    /** @return whether the area of the node is handled, false if the parent has to draw it */
+    bool selectNode(const glm::vec2 & cameraRowColumn, uint32_t row, uint32_t column, unsigned int level, unsigned int minLevel,
+        const VisibilityTest & visible, std::vector<Node> & nodes) const;
+
+    /** x/z distance from the point to the square of the node */
+    static float distance(const glm::vec2 & point, uint32_t row, uint32_t column, uint32_t size);
+
+    const unsigned int m_tileCells;
+    const unsigned int m_leafCells;
+    const float m_lodDistance;
+    unsigned int m_numLevels;
+    float m_viewRange;
+
+    std::vector<glm::vec2> m_vertices;
+    std::vector<uint32_t> m_indices;
+    size_t m_quarterIndexOffset;
+};
@@ -32,6 +32,13 @@ TerrainSettings::TerrainSettings()
 , maxTileSamplesPerAxis(1025)
 , tilesX(1)
 , tilesZ(1)
+, streaming(false)
+, streamingRadius(1)
+, streamingMemoryBudget(256u * 1024u * 1024u)
+, tileCacheDirectory("tilecache")
+, snapshotFile("")
+, maxPxSamplesPerStep(128u * 128u)
+, generatorStripes(0u)
 {
 }
 
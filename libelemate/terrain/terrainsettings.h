@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <initializer_list>
 #include <limits>
@@ -28,8 +29,8 @@ extern  std::unordered_map<const std::string, TerrainLevel, std::hash<std::strin
 struct TileID {
     TileID(TerrainLevel level = TerrainLevel::BaseLevel, int xID = 0, int zID = 0);
     TerrainLevel level;
-    unsigned int x;
-    unsigned int z;
+    int x;
+    int z;
 };
 
 namespace std {
@@ -51,6 +52,23 @@ struct TerrainSettings {
     unsigned tilesX;
     /** number of tiles along the z axis */
     unsigned tilesZ;
+    /** Generate tiles on demand around the streaming focus instead of tilesX * tilesZ tiles up front.
+      * sizeX/tilesX is the size of one tile then, the terrain has no fixed extent. */
+    bool streaming;
+    /** tiles within this distance (in tiles) of the focus tile are loaded */
+    unsigned streamingRadius;
+    /** loaded tiles outside of the streaming radius are evicted when their memory exceeds this number of bytes */
+    size_t streamingMemoryBudget;
+    /** evicted tiles are written to this directory, so that edits persist when they are loaded again */
+    std::string tileCacheDirectory;
+    /** Tile file with pre-baked or saved tiles. Tiles it contains are loaded from it instead of being generated. Empty for none. */
+    std::string snapshotFile;
+    /** Edits of the terrain are written to the physx height fields with at most this many samples per simulation step,
+      * the remaining ones are written in the next steps. */
+    unsigned maxPxSamplesPerStep;
+    /** Each diamond square pass of the generator is split into this many row stripes, which run on the worker pool.
+      * 0 chooses the number by the size of the pass and the number of hardware threads. The tiles are the same for any number. */
+    unsigned generatorStripes;
     /** size of one tile along the x/z axes */
     inline float tileBorderLength() const {
         assert(tilesX >= 1 && tilesZ >= 1);
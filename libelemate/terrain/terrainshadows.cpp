@@ -11,6 +11,7 @@
 
 
 #include "terraintile.h"
+#include "rendering/culling.h"
 #include "rendering/shadowmappingstep.h"
 #include "world.h"
 #include "texturemanager.h"
@@ -35,9 +36,6 @@ void Terrain::drawDepthMapImpl(const CameraEx & camera)
     // we probably don't want to draw an empty terrain
     assert(m_physicalTiles.size() > 0);
 
-    if (!m_renderGridRadius.isValid())
-        generateDrawGrid();
-
     glow::Program * program = nullptr;
 
     // linearize the depth values for perspective projections
@@ -50,34 +48,41 @@ void Terrain::drawDepthMapImpl(const CameraEx & camera)
         program = m_depthMapProgram; 
     }
 
-    setDrawGridOffsetUniform(*program, camera.eye());
-
-    TerrainTile & baseTile = *m_physicalTiles.at(TileID(TerrainLevel::BaseLevel));
-
-    program->setUniform("depthMVP", camera.viewProjectionEx() * baseTile.m_transform);
-
-    // TODO: generalize for more tiles...
-
     program->use();
 
     glEnable(GL_PRIMITIVE_RESTART);
-    glPrimitiveRestartIndex(s_restartIndex);
+    glPrimitiveRestartIndex(TerrainLod::s_restartIndex);
 
     glFrontFace(GL_CW);
     glCullFace(GL_BACK);
     glEnable(GL_CULL_FACE);
 
-    for (TerrainLevel level : m_drawLevels) {
-        TerrainTile & tile = *m_physicalTiles.at(TileID(level));
+    const Frustum frustum(camera.viewProjectionEx());
+    // the light's depth map doesn't need the full resolution, but the depth of the perspective projection is compared to the scene
+    const unsigned int minLodLevel = camera.projectionType() == ProjectionType::perspective ? 0 : 1;
 
-        // for water/fluid drawing: discard samples below the solid terrain
-        program->setUniform("baseTileCompare", level == TerrainLevel::WaterLevel);
+    for (auto & basePair : m_physicalTiles) {
+        if (basePair.first.level != TerrainLevel::BaseLevel || !tileVisible(basePair.first, camera.eye(), frustum, CullingPass::TerrainDepthMap))
+            continue;
+        TerrainTile & baseTile = *basePair.second;
+        baseTile.prepareDraw();
 
-        tile.prepareDraw();
-        program->setUniform("heightField", TextureManager::getTextureUnit(tile.tileName, "values"));
+        selectLodNodes(baseTile, camera.eye(), frustum, minLodLevel);
+        setLodUniforms(*program, camera.eye(), baseTile);
+        program->setUniform("depthMVP", camera.viewProjectionEx() * baseTile.m_transform);
         program->setUniform("baseHeightField", TextureManager::getTextureUnit(baseTile.tileName, "values"));
 
-        m_vao->drawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
+        for (TerrainLevel level : m_drawLevels) {
+            TerrainTile & tile = *m_physicalTiles.at(TileID(level, basePair.first.x, basePair.first.z));
+
+            // for water/fluid drawing: discard samples below the solid terrain
+            program->setUniform("baseTileCompare", level == TerrainLevel::WaterLevel);
+
+            tile.prepareDraw();
+            program->setUniform("heightField", TextureManager::getTextureUnit(tile.tileName, "values"));
+
+            drawLodNodes(*program);
+        }
     }
 
     glDisable(GL_CULL_FACE);
@@ -89,31 +94,33 @@ void Terrain::drawDepthMapImpl(const CameraEx & camera)
 
 void Terrain::drawShadowMappingImpl(const CameraEx & camera, const CameraEx & lightSource)
 {
-    // TODO: generalize for more tiles...
-
-    if (!m_renderGridRadius.isValid())
-        generateDrawGrid();
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(TerrainLod::s_restartIndex);
 
-    auto baseTile = m_physicalTiles.at(TileID(TerrainLevel::BaseLevel));
+    const Frustum frustum(camera.viewProjectionEx());
 
-    glm::mat4 lightBiasMVP = ShadowMappingStep::s_biasMatrix * lightSource.viewProjectionEx() * baseTile->transform();
+    for (auto & basePair : m_physicalTiles) {
+        if (basePair.first.level != TerrainLevel::BaseLevel || !tileVisible(basePair.first, camera.eye(), frustum, CullingPass::TerrainShadowMapping))
+            continue;
+        const TerrainTile & baseTile = *basePair.second;
 
-    m_shadowMappingProgram->setUniform("modelTransform", baseTile->transform());
-    m_shadowMappingProgram->setUniform("modelViewProjection", camera.viewProjectionEx() * m_physicalTiles.at(TileID(TerrainLevel::BaseLevel))->m_transform);
-    m_shadowMappingProgram->setUniform("lightBiasMVP", lightBiasMVP);
+        glm::mat4 lightBiasMVP = ShadowMappingStep::s_biasMatrix * lightSource.viewProjectionEx() * baseTile.transform();
 
-    setDrawGridOffsetUniform(*m_shadowMappingProgram, camera.eye());
+        m_shadowMappingProgram->setUniform("modelTransform", baseTile.transform());
+        m_shadowMappingProgram->setUniform("modelViewProjection", camera.viewProjectionEx() * baseTile.transform());
+        m_shadowMappingProgram->setUniform("lightBiasMVP", lightBiasMVP);
 
-    glEnable(GL_PRIMITIVE_RESTART);
-    glPrimitiveRestartIndex(s_restartIndex);
+        selectLodNodes(baseTile, camera.eye(), frustum, 0);
+        setLodUniforms(*m_shadowMappingProgram, camera.eye(), baseTile);
 
-    for (TerrainLevel level : m_drawLevels) {
-        TerrainTile & tile = *m_physicalTiles.at(TileID(level));
+        for (TerrainLevel level : m_drawLevels) {
+            TerrainTile & tile = *m_physicalTiles.at(TileID(level, basePair.first.x, basePair.first.z));
 
-        tile.prepareDraw();
-        m_shadowMappingProgram->setUniform("heightField", TextureManager::getTextureUnit(tile.tileName, "values"));
+            tile.prepareDraw();
+            m_shadowMappingProgram->setUniform("heightField", TextureManager::getTextureUnit(tile.tileName, "values"));
 
-        m_vao->drawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(m_indices.size()), GL_UNSIGNED_INT, nullptr);
+            drawLodNodes(*m_shadowMappingProgram);
+        }
     }
 
     glDisable(GL_PRIMITIVE_RESTART);
@@ -124,6 +131,7 @@ void Terrain::initDepthMapProgram()
     m_depthMapProgram = new glow::Program();
     m_depthMapProgram->attach(
         World::instance()->sharedShader(GL_VERTEX_SHADER, "shader/shadows/depthmap_terrain.vert"),
+        World::instance()->sharedShader(GL_VERTEX_SHADER, "shader/utils/terrain_lod.vert"),
         World::instance()->sharedShader(GL_GEOMETRY_SHADER, "shader/shadows/depthmap_terrain.geo"),
         World::instance()->sharedShader(GL_FRAGMENT_SHADER, "shader/utils/passthrough.frag"));
     m_depthMapProgram->setUniform("tileSamplesPerAxis", int(settings.maxTileSamplesPerAxis));
@@ -132,6 +140,7 @@ void Terrain::initDepthMapProgram()
     m_depthMapLinearizedProgram = new glow::Program();
     m_depthMapLinearizedProgram->attach(
         World::instance()->sharedShader(GL_VERTEX_SHADER, "shader/shadows/depthmap_terrain.vert"),
+        World::instance()->sharedShader(GL_VERTEX_SHADER, "shader/utils/terrain_lod.vert"),
         World::instance()->sharedShader(GL_GEOMETRY_SHADER, "shader/shadows/depthmap_terrain.geo"),
         World::instance()->sharedShader(GL_FRAGMENT_SHADER, "shader/utils/depth_util.frag"),
         World::instance()->sharedShader(GL_FRAGMENT_SHADER, "shader/shadows/depthmapLinearized.frag"));
@@ -143,6 +152,7 @@ void Terrain::initShadowMappingProgram()
     m_shadowMappingProgram = new glow::Program();
     m_shadowMappingProgram->attach(
         glowutils::createShaderFromFile(GL_VERTEX_SHADER, "shader/shadows/shadowmapping_terrain.vert"),
+        World::instance()->sharedShader(GL_VERTEX_SHADER, "shader/utils/terrain_lod.vert"),
         World::instance()->sharedShader(GL_FRAGMENT_SHADER, "shader/shadows/shadowmapping.frag"));
 
     m_shadowMappingProgram->setUniform("tileSamplesPerAxis", int(settings.maxTileSamplesPerAxis));
@@ -0,0 +1,283 @@
+#include "terrainstreamer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <glow/logging.h>
+
+#include "terrain.h"
+#include "tilefile.h"
+#include "utils/profiler.h"
+
+namespace {
+
+void makeDirectory(const std::string & path)
+{
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+template <typename T>
+bool isReady(const T & future)
+{
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+}
+
+TerrainStreamer::TerrainStreamer(Terrain & terrain, const TerrainGenerator & generator)
+: m_terrain(terrain)
+, m_generator(generator)
+, m_maxPendingTiles(std::max(1u, std::thread::hardware_concurrency() / 2))
+{
+    assert(generator.settings().streaming);
+
+    makeDirectory(generator.settings().tileCacheDirectory);
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+    for (auto & pair : m_pendingTiles)
+        pair.second.wait();
+    for (auto & pair : m_pendingWrites)
+        pair.second.wait();
+}
+
+size_t TerrainStreamer::tileBytes(uint32_t samplesPerAxis)
+{
+    // heights of the base and liquid level and temperatures, current and next temperatures,
+    // terrain types of the base and liquid level, particle counts of the temperature level
+    const size_t bytesPerSample = 4 * sizeof(float) + 2 * sizeof(uint8_t) + sizeof(uint16_t);
+    return bytesPerSample * samplesPerAxis * samplesPerAxis;
+}
+
+size_t TerrainStreamer::numLoadedTiles() const
+{
+    return m_terrain.m_pxActors.size();
+}
+
+size_t TerrainStreamer::numPendingTiles() const
+{
+    return m_pendingTiles.size();
+}
+
+size_t TerrainStreamer::loadedBytes() const
+{
+    return numLoadedTiles() * tileBytes(m_generator.settings().maxTileSamplesPerAxis);
+}
+
+TerrainStreamer::TileXZ TerrainStreamer::tileAt(const glm::vec3 & position) const
+{
+    // tile (0, 0) is centered at the origin
+    const float tileBorderLength = m_generator.settings().tileBorderLength();
+    return TileXZ(
+        static_cast<int>(std::floor(position.x / tileBorderLength + 0.5f)),
+        static_cast<int>(std::floor(position.z / tileBorderLength + 0.5f)));
+}
+
+int TerrainStreamer::tileDistance(const TileXZ & lhs, const TileXZ & rhs)
+{
+    return std::max(std::abs(lhs.first - rhs.first), std::abs(lhs.second - rhs.second));
+}
+
+std::string TerrainStreamer::cachePath(const TileXZ & tile) const
+{
+    return m_generator.settings().tileCacheDirectory + "/tile_" + std::to_string(tile.first) + "_" + std::to_string(tile.second) + ".bin";
+}
+
+void TerrainStreamer::update(const glm::vec3 & focus)
+{
+    ELEMATE_PROFILE_ZONE("TerrainStreamer::update");
+
+    addLoadedTiles();
+
+    for (auto it = m_pendingWrites.begin(); it != m_pendingWrites.end();) {
+        if (isReady(it->second))
+            it = m_pendingWrites.erase(it);
+        else
+            ++it;
+    }
+
+    const TileXZ focusTile = tileAt(focus);
+    const int radius = static_cast<int>(m_generator.settings().streamingRadius);
+
+    // load the missing tiles nearest to the focus first
+    std::vector<TileXZ> missingTiles;
+    for (int x = focusTile.first - radius; x <= focusTile.first + radius; ++x)
+    for (int z = focusTile.second - radius; z <= focusTile.second + radius; ++z) {
+        const TileXZ tile(x, z);
+        if (m_terrain.m_pxActors.count(TileID(TerrainLevel::BaseLevel, x, z)) == 0 && m_pendingTiles.count(tile) == 0)
+            missingTiles.push_back(tile);
+    }
+    std::sort(missingTiles.begin(), missingTiles.end(), [&focusTile](const TileXZ & lhs, const TileXZ & rhs) {
+        return tileDistance(lhs, focusTile) < tileDistance(rhs, focusTile);
+    });
+
+    for (const TileXZ & tile : missingTiles) {
+        if (m_pendingTiles.size() >= m_maxPendingTiles)
+            break;
+        startLoading(tile);
+    }
+
+    evictTiles(focusTile);
+}
+
+void TerrainStreamer::startLoading(const TileXZ & tile)
+{
+    const bool cached = m_cachedTiles.count(tile) > 0;
+    const std::string path = cachePath(tile);
+    const uint32_t samplesPerAxis = m_generator.settings().maxTileSamplesPerAxis;
+
+    std::shared_future<void> write;
+    auto writeIt = m_pendingWrites.find(tile);
+    if (writeIt != m_pendingWrites.end())
+        write = writeIt->second;
+
+    const TerrainGenerator * generator = &m_generator;
+
+    m_pendingTiles.emplace(tile, std::async(std::launch::async, [generator, tile, cached, path, samplesPerAxis, write]() -> TileData {
+        if (write.valid())
+            write.wait();
+
+        if (cached) {
+            TileData data;
+            if (TileFile(path).readTile(tile.first, tile.second, samplesPerAxis, data))
+                return data;
+            glow::warning("TerrainStreamer: could not read %;, loading the tile again", path);
+        }
+
+        return generator->loadTileData(tile.first, tile.second);
+    }));
+}
+
+void TerrainStreamer::addLoadedTiles()
+{
+    for (auto it = m_pendingTiles.begin(); it != m_pendingTiles.end();) {
+        if (!isReady(it->second)) {
+            ++it;
+            continue;
+        }
+
+        TileData data = it->second.get();
+        m_generator.createTile(m_terrain, data);
+        it = m_pendingTiles.erase(it);
+    }
+}
+
+void TerrainStreamer::evictTiles(const TileXZ & focusTile)
+{
+    const size_t budget = m_generator.settings().streamingMemoryBudget;
+    const int radius = static_cast<int>(m_generator.settings().streamingRadius);
+
+    while (loadedBytes() > budget) {
+        // the farthest tile outside of the streaming radius
+        TileXZ farthest;
+        int maxDistance = radius;
+        for (const auto & pair : m_terrain.m_pxActors) {
+            const TileXZ tile(pair.first.x, pair.first.z);
+            const int distance = tileDistance(tile, focusTile);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                farthest = tile;
+            }
+        }
+
+        if (maxDistance == radius)
+            break;  // the tiles in the radius alone exceed the budget
+
+        evict(farthest);
+    }
+}
+
+void TerrainStreamer::evict(const TileXZ & tile)
+{
+    ELEMATE_PROFILE_ZONE("TerrainStreamer::evict");
+
+    std::shared_ptr<TileData> data = std::make_shared<TileData>(m_generator.copyTileData(m_terrain, tile.first, tile.second));
+    m_terrain.unregisterTiles(tile.first, tile.second);
+
+    m_cachedTiles.insert(tile);
+
+    const std::string path = cachePath(tile);
+    m_pendingWrites[tile] = std::async(std::launch::async, [data, path]() {
+        if (!TileFile::write(path, 1, [&data](size_t, TileData & tile) { tile = std::move(*data); return true; }))
+            glow::warning("TerrainStreamer: could not write %;, edits of the tile are lost", path);
+    }).share();
+}
+
+TerrainSnapshot TerrainStreamer::snapshot()
+{
+    ELEMATE_PROFILE_ZONE("TerrainStreamer::snapshot");
+
+    TerrainSnapshot snapshot = TerrainGenerator::snapshot(m_terrain);
+
+    // evicted tiles are copied from their cache files, writing the snapshot waits for the files that are still written
+    for (const auto & pair : m_pendingWrites)
+        snapshot.pendingWrites.push_back(pair.second);
+
+    std::set<TileXZ> tiles;
+    for (const auto & pair : m_terrain.m_pxActors)
+        tiles.insert(TileXZ(pair.first.x, pair.first.z));
+
+    for (const TileXZ & tile : m_cachedTiles)
+        if (tiles.insert(tile).second)
+            snapshot.fileTiles.emplace_back(tile, cachePath(tile));
+
+    // and the tiles of the snapshot file that were never loaded from it
+    const std::string & snapshotFile = m_generator.settings().snapshotFile;
+    if (!snapshotFile.empty()) {
+        const TileFile file(snapshotFile);
+        for (const TileXZ & tile : file.tiles())
+            if (tiles.insert(tile).second)
+                snapshot.fileTiles.emplace_back(tile, snapshotFile);
+    }
+
+    return snapshot;
+}
+
+void TerrainStreamer::reload(const std::string & snapshotFile, const glm::vec3 & focus)
+{
+    ELEMATE_PROFILE_ZONE("TerrainStreamer::reload");
+
+    for (auto & pair : m_pendingTiles)
+        pair.second.wait();
+    m_pendingTiles.clear();
+    for (auto & pair : m_pendingWrites)
+        pair.second.wait();
+    m_pendingWrites.clear();
+
+    // the cached tiles belong to the terrain that is replaced
+    m_cachedTiles.clear();
+    m_generator.setSnapshotFile(snapshotFile);
+
+    std::vector<TileID> tileIDs;
+    for (const auto & pair : m_terrain.m_pxActors)
+        tileIDs.push_back(pair.first);
+    for (const TileID & tileID : tileIDs)
+        m_terrain.unregisterTiles(tileID.x, tileID.z);
+
+    // load all tiles around the focus before returning, the terrain must not have holes there
+    const TileXZ focusTile = tileAt(focus);
+    const int radius = static_cast<int>(m_generator.settings().streamingRadius);
+    for (int x = focusTile.first - radius; x <= focusTile.first + radius; ++x)
+    for (int z = focusTile.second - radius; z <= focusTile.second + radius; ++z)
+        startLoading(TileXZ(x, z));
+
+    for (auto & pair : m_pendingTiles)
+        pair.second.wait();
+    addLoadedTiles();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "terraingenerator.h"
+#include "tilefile.h"
+
+class Terrain;
+
+/** @brief Loads and evicts the tiles of a streaming terrain around a focus position.
+  * Missing tiles within the streaming radius are generated, or read from the tile cache if they were evicted before, on worker threads.
+  * Tiles outside of the radius stay loaded until the memory budget is exceeded, then the farthest ones are written to the cache and removed. */
+class TerrainStreamer
+{
+public:
+    /** @param generator the generator that created the terrain, with streaming enabled */
+    TerrainStreamer(Terrain & terrain, const TerrainGenerator & generator);
+    /** waits for all tiles that are loaded or written */
+    ~TerrainStreamer();
+
+    /** Start loading the missing tiles around the focus, add finished tiles to the terrain and evict tiles if needed.
+      * Must be called on the thread that owns the physx scene, while it is not simulating. */
+    void update(const glm::vec3 & focus);
+
+    size_t numLoadedTiles() const;
+    size_t numPendingTiles() const;
+    /** estimated memory of all loaded tiles, in bytes */
+    size_t loadedBytes() const;
+
+    /** All tiles of the terrain: copies of the loaded ones, and the evicted ones and the tiles of the snapshot file that were never loaded
+      * as references to their files. Doesn't wait for the cache files that are still written, TerrainSnapshot::write does.
+      * Must be called on the same thread as update. */
+    TerrainSnapshot snapshot();
+    /** Replace all tiles by the tiles of the snapshot file, or by newly generated tiles if it doesn't contain them.
+      * Evicted tiles are discarded. Returns when the tiles around the focus are loaded. */
+    void reload(const std::string & snapshotFile, const glm::vec3 & focus);
+
+    /** estimated memory of one tile with all its levels, in bytes */
+    static size_t tileBytes(uint32_t samplesPerAxis);
+
+protected:
+    typedef std::pair<int, int> TileXZ;
+
+    TileXZ tileAt(const glm::vec3 & position) const;
+    /** distance in tiles, along the axis where it is larger */
+    static int tileDistance(const TileXZ & lhs, const TileXZ & rhs);
+
+    void startLoading(const TileXZ & tile);
+    void addLoadedTiles();
+    void evictTiles(const TileXZ & focusTile);
+    void evict(const TileXZ & tile);
+
+    std::string cachePath(const TileXZ & tile) const;
+
+    Terrain & m_terrain;
+    TerrainGenerator m_generator;
+
+    std::map<TileXZ, std::future<TileData>> m_pendingTiles;
+    /** writes of evicted tiles, loading the tile again waits for them */
+    std::map<TileXZ, std::shared_future<void>> m_pendingWrites;
+    /** tiles evicted in this session. Only these are read from the cache, older files are overwritten on eviction. */
+    std::set<TileXZ> m_cachedTiles;
+
+    const unsigned int m_maxPendingTiles;
+
+public:
+    TerrainStreamer(TerrainStreamer&) = delete;
+    void operator=(TerrainStreamer&) = delete;
+};
@@ -1,5 +1,6 @@
 #include "terraintile.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -12,6 +13,7 @@
 #include "elements.h"
 #include "world.h"
 #include "texturemanager.h"
+#include "utils/profiler.h"
 
 TerrainTile::TerrainTile(Terrain & terrain, const TileID & tileID, float minValidValue, float maxValidValue, float interactStdDeviation)
 : tileName(generateName(tileID))
@@ -40,11 +42,13 @@ TerrainTile::TerrainTile(Terrain & terrain, const TileID & tileID, float minVali
 
     clearBufferUpdateRange();
 
-    m_values.resize(samplesPerAxis * samplesPerAxis);
+    m_values = SharedArray<float>(samplesPerAxis * samplesPerAxis);
 }
 
 TerrainTile::~TerrainTile()
 {
+    // the tile may be evicted by the TerrainStreamer while the game is running
+    TextureManager::releaseTextureUnits(tileName);
 }
 
 std::string TerrainTile::generateName(const TileID & tileID)
@@ -56,7 +60,7 @@ void TerrainTile::prepareDraw()
 {
     if (!m_isInitialized)
         initialize();
-    if (!m_bufferUpdateList.empty())
+    if (!m_bufferUpdateRanges.empty())
         updateBuffers();
 }
 
@@ -71,12 +75,17 @@ void TerrainTile::unbind()
 {
 }
 
+glow::Program * TerrainTile::program()
+{
+    return nullptr;
+}
+
 void TerrainTile::initialize()
 {
     clearBufferUpdateRange();
 
     m_valueBuffer = new glow::Buffer(GL_TEXTURE_BUFFER);
-    m_valueBuffer->setData(m_values, GL_DYNAMIC_DRAW);
+    m_valueBuffer->setData(m_values.values(), GL_DYNAMIC_DRAW);
 
     m_valueTex = new glow::Texture(GL_TEXTURE_BUFFER);
     m_valueTex->bind();
@@ -120,13 +129,13 @@ void TerrainTile::setValue(unsigned int row, unsigned int column, float value)
 {
     assert(row < samplesPerAxis && column < samplesPerAxis);
     assert(isValueInRange(value));
-    m_values.at(column + row * samplesPerAxis) = value;
+    m_values.write().at(column + row * samplesPerAxis) = value;
 }
 
 void TerrainTile::setValue(unsigned int index, float value)
 {
     assert(index < samplesPerAxis * samplesPerAxis);
-    m_values.at(index) = value;
+    m_values.write().at(index) = value;
 }
 
 // mostly from OpenSceneGraph: osgTerrain/Layer
@@ -187,46 +196,88 @@ const glm::mat4 & TerrainTile::transform() const
 
 void TerrainTile::updateBuffers()
 {
-    assert(m_updateRangeMinMaxIndex.x < m_updateRangeMinMaxIndex.y);
+    ELEMATE_PROFILE_ZONE("TerrainTile::updateBuffers");
 
-    float * bufferDest = reinterpret_cast<float*>(m_valueBuffer->mapRange(
-        sizeof(float) * m_updateRangeMinMaxIndex.x,
-        sizeof(float) * (m_updateRangeMinMaxIndex.y - m_updateRangeMinMaxIndex.x),
-        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    uploadUpdateRanges(*m_valueBuffer, m_values.data(), sizeof(float));
 
-    assert(bufferDest);
+    clearBufferUpdateRange();
+}
 
-    unsigned int indexOffset = m_updateRangeMinMaxIndex.x;
+void TerrainTile::uploadUpdateRanges(glow::Buffer & buffer, const void * data, size_t elementSize) const
+{
+    assert(!m_bufferUpdateRanges.empty());
+
+    // a driver call costs about as much as transferring this many bytes
+    static const size_t callOverheadBytes = 4096;
+
+    const std::vector<IndexRangeSet::Range> & ranges = m_bufferUpdateRanges.ranges();
+    const size_t spanBegin = ranges.front().begin * elementSize;
+    const size_t spanBytes = ranges.back().end * elementSize - spanBegin;
+    const size_t rangeBytes = m_bufferUpdateRanges.numIndices() * elementSize;
 
-    for (const UpdateRange & range : m_bufferUpdateList) {
-        assert(indexOffset <= range.startIndex);
-        assert(range.startIndex - indexOffset >= 0);
-        assert(range.startIndex - indexOffset + range.nbElements <= m_values.size());
-        memcpy(bufferDest + (range.startIndex - indexOffset),
-            reinterpret_cast<float*>(m_values.data()) + range.startIndex,
-            range.nbElements * sizeof(float));
+    Terrain::BufferUploads & uploads = m_terrain.m_frameUploads;
+    const char * source = reinterpret_cast<const char *>(data);
+
+    if (ranges.size() * callOverheadBytes + rangeBytes <= callOverheadBytes + spanBytes) {
+        buffer.bind();
+        for (const IndexRangeSet::Range & range : ranges)
+            glBufferSubData(GL_TEXTURE_BUFFER, range.begin * elementSize, (range.end - range.begin) * elementSize, source + range.begin * elementSize);
+        buffer.unbind();
+
+        uploads.subDataCalls += static_cast<unsigned int>(ranges.size());
+        uploads.bytes += rangeBytes;
+        return;
     }
 
-    m_valueBuffer->unmap();
+    char * bufferDest = reinterpret_cast<char*>(buffer.mapRange(spanBegin, spanBytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    assert(bufferDest);
+
+    for (const IndexRangeSet::Range & range : ranges)
+        memcpy(bufferDest + range.begin * elementSize - spanBegin, source + range.begin * elementSize, (range.end - range.begin) * elementSize);
 
-    clearBufferUpdateRange();
+    buffer.unmap();
+
+    ++uploads.mapRangeCalls;
+    uploads.bytes += spanBytes;
 }
 
 void TerrainTile::addBufferUpdateRange(unsigned int startIndex, unsigned int nbElements)
 {
-    if (m_updateRangeMinMaxIndex.x > startIndex)
-        m_updateRangeMinMaxIndex.x = startIndex;
-    if (m_updateRangeMinMaxIndex.y < startIndex + nbElements)
-        m_updateRangeMinMaxIndex.y = startIndex + nbElements;
-    const uint32_t maxIndex = samplesPerAxis * samplesPerAxis - 1;
-    if (m_updateRangeMinMaxIndex.y > maxIndex)
-        m_updateRangeMinMaxIndex.y = maxIndex;
+    const unsigned int numValues = samplesPerAxis * samplesPerAxis;
+    if (nbElements > 0 && startIndex < numValues && levelIsPhysical(m_tileID.level))
+        addChangedArea(startIndex, std::min(startIndex + nbElements, numValues) - 1);
+
+    // initialize() uploads all values
+    if (!m_isInitialized)
+        return;
+
+    m_bufferUpdateRanges.insert(std::min(startIndex, numValues), std::min(startIndex + nbElements, numValues));
+}
+
+void TerrainTile::addBufferUpdateRect(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn)
+{
+    assert(minRow <= maxRow && maxRow < samplesPerAxis && minColumn <= maxColumn && maxColumn < samplesPerAxis);
 
-    m_bufferUpdateList.push_front({ startIndex, nbElements });
+    for (unsigned int row = minRow; row <= maxRow; ++row)
+        addBufferUpdateRange(minColumn + row * samplesPerAxis, maxColumn - minColumn + 1);
+}
+
+void TerrainTile::addChangedArea(unsigned int firstIndex, unsigned int lastIndex) const
+{
+    const unsigned int minRow = firstIndex / samplesPerAxis;
+    const unsigned int maxRow = lastIndex / samplesPerAxis;
+    // ranges over multiple rows change all columns in between
+    const unsigned int minColumn = minRow == maxRow ? firstIndex % samplesPerAxis : 0;
+    const unsigned int maxColumn = minRow == maxRow ? lastIndex % samplesPerAxis : samplesPerAxis - 1;
+
+    // the cells around the changed samples change their shape
+    const float maxHeight = m_terrain.settings.maxHeight;
+    glowutils::AxisAlignedBoundingBox & box = m_terrain.m_frameChanges[m_tileID];
+    box.extend(glm::vec3(m_transform * glm::vec4(minRow - 1.0f, -maxHeight, minColumn - 1.0f, 1.0f)));
+    box.extend(glm::vec3(m_transform * glm::vec4(maxRow + 1.0f, maxHeight, maxColumn + 1.0f, 1.0f)));
 }
 
 void TerrainTile::clearBufferUpdateRange()
 {
-    m_bufferUpdateList.clear();
-    m_updateRangeMinMaxIndex = glm::detail::tvec2<unsigned int>(std::numeric_limits<unsigned int>::max(), 0);
+    m_bufferUpdateRanges.clear();
 }
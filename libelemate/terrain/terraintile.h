@@ -1,6 +1,6 @@
 #pragma once
 
-#include <forward_list>
+#include <cstddef>
 #include <cstdint>
 #include <tuple>
 #include <vector>
@@ -11,10 +11,13 @@
 #include <glm/glm.hpp>
 
 #include "terrainsettings.h"
+#include "indexrangeset.h"
+#include "utils/sharedarray.h"
 
 namespace glow {
     class Texture;
     class Buffer;
+    class Program;
 }
 class Terrain;
 class CameraEx;
@@ -40,6 +43,8 @@ public:
 
     virtual void bind(const CameraEx & camera);
     virtual void unbind();
+    /** @return the program that is used between bind and unbind, or nullptr if the tile is not drawn itself */
+    virtual glow::Program * program();
 
     /** timed update function that subclasses can implement */
     virtual void updatePhysics(double delta);
@@ -92,8 +97,8 @@ protected:
     glow::ref_ptr<glow::Texture> m_valueTex;
     glow::ref_ptr<glow::Buffer>  m_valueBuffer;
 
-    /** Contains the tile values in row major order. */
-    std::vector<float> m_values;
+    /** Contains the tile values in row major order. Shared with snapshots of the tile until the next edit. */
+    SharedArray<float> m_values;
 
     glm::mat4 m_transform;
 
@@ -103,14 +108,17 @@ protected:
 protected:
     virtual void updateBuffers();
 
-    struct UpdateRange {
-        unsigned int startIndex;
-        unsigned int nbElements;
-    };
-
     void addBufferUpdateRange(unsigned int startIndex, unsigned int nbElements);
-    glm::detail::tvec2<unsigned int> m_updateRangeMinMaxIndex;
-    std::forward_list<UpdateRange> m_bufferUpdateList;
+    /** add the ranges of the rows/columns, including the max row/column */
+    void addBufferUpdateRect(unsigned int minRow, unsigned int maxRow, unsigned int minColumn, unsigned int maxColumn);
+    /** indices of the values that changed since the last updateBuffers */
+    IndexRangeSet m_bufferUpdateRanges;
+    /** add the world space area of the values from first to last index to the terrain's changes of this frame */
+    void addChangedArea(unsigned int firstIndex, unsigned int lastIndex) const;
+
+    /** Upload the values of the update ranges from data to buffer, with one bufferSubData call per range or with one mapRange
+      * over all ranges, whichever transfers less. The uploaded bytes are counted in the terrain. */
+    void uploadUpdateRanges(glow::Buffer & buffer, const void * data, size_t elementSize) const;
 
 private:
     void clearBufferUpdateRange();
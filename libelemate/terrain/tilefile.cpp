@@ -0,0 +1,311 @@
+#include "tilefile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <glow/logging.h>
+
+namespace {
+
+const char fileMagic[4] = { 'E', 'T', 'I', 'L' };
+/** version 1 was the cache file of a single tile, without chunk table */
+const uint32_t fileVersion = 2;
+/** chunk data starts at multiples of this, a cache line */
+const size_t chunkAlignment = 64;
+
+const char baseHeightsChunk[4] = { 'B', 'H', 'G', 'T' };
+const char baseElementsChunk[4] = { 'B', 'E', 'L', 'M' };
+const char liquidHeightsChunk[4] = { 'L', 'H', 'G', 'T' };
+const char temperaturesChunk[4] = { 'T', 'E', 'M', 'P' };
+const unsigned int maxChunksPerTile = 4;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t numChunks;
+    uint32_t reserved;
+};
+
+size_t alignedOffset(size_t offset)
+{
+    return (offset + chunkAlignment - 1) / chunkAlignment * chunkAlignment;
+}
+
+void writePadding(std::ofstream & file, size_t offset)
+{
+    static const char zeros[chunkAlignment] = {};
+    const size_t position = static_cast<size_t>(file.tellp());
+    assert(position <= offset);
+    for (size_t remaining = offset - position; remaining > 0;) {
+        const size_t size = std::min(remaining, chunkAlignment);
+        file.write(zeros, size);
+        remaining -= size;
+    }
+}
+
+}
+
+struct TileFile::Chunk {
+    char type[4];
+    int32_t xID;
+    int32_t zID;
+    uint32_t samplesPerAxis;
+    uint64_t offset;
+    /** in bytes */
+    uint64_t size;
+};
+
+TileFile::TileFile(const std::string & path)
+: m_data(nullptr)
+, m_size(0)
+, m_chunks(nullptr)
+, m_numChunks(0)
+{
+    static_assert(sizeof(Chunk) == 32 && sizeof(FileHeader) == 16, "the file layout must not depend on the compiler");
+
+#ifdef _WIN32
+    std::ifstream file(path, std::ios_base::binary | std::ios_base::in | std::ios_base::ate);
+    if (!file.good())
+        return;
+    m_buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(m_buffer.data(), m_buffer.size());
+    if (!file.good() || m_buffer.empty()) {
+        m_buffer.clear();
+        return;
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#else
+    const int fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return;
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0) {
+        void * mapping = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping != MAP_FAILED) {
+            m_data = static_cast<const char *>(mapping);
+            m_size = static_cast<size_t>(fileStatus.st_size);
+        }
+    }
+    // the mapping stays valid without the file descriptor
+    close(fileDescriptor);
+    if (!m_data)
+        return;
+#endif
+
+    FileHeader header;
+    bool valid = m_size >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, m_data, sizeof(header));
+        valid = std::equal(header.magic, header.magic + sizeof(header.magic), fileMagic)
+            && header.version == fileVersion
+            && header.numChunks <= (m_size - sizeof(header)) / sizeof(Chunk);
+    }
+
+    const Chunk * chunks = reinterpret_cast<const Chunk *>(m_data + sizeof(header));
+    for (uint32_t i = 0; valid && i < header.numChunks; ++i)
+        valid = chunks[i].offset % chunkAlignment == 0
+            && chunks[i].offset <= m_size
+            && chunks[i].size <= m_size - chunks[i].offset;
+
+    if (!valid) {
+        glow::warning("TileFile: %; is not a valid tile file of version %;", path, fileVersion);
+        unmap();
+        return;
+    }
+
+    m_chunks = chunks;
+    m_numChunks = header.numChunks;
+}
+
+TileFile::~TileFile()
+{
+    unmap();
+}
+
+void TileFile::unmap()
+{
+#ifdef _WIN32
+    m_buffer.clear();
+#else
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_chunks = nullptr;
+    m_numChunks = 0;
+}
+
+bool TileFile::write(const std::string & path, size_t numTiles, const std::function<bool(size_t, TileData &)> & tile)
+{
+    const std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios_base::binary | std::ios_base::trunc | std::ios_base::out);
+    if (!file.good())
+        return false;
+
+    // the chunk table is written last, when the offsets and sizes of the chunks are known
+    std::vector<Chunk> chunks;
+    chunks.reserve(numTiles * maxChunksPerTile);
+    size_t offset = alignedOffset(sizeof(FileHeader) + numTiles * maxChunksPerTile * sizeof(Chunk));
+
+    auto writeChunk = [&file, &chunks, &offset](const char type[4], const TileData & data, const char * values, size_t size) {
+        Chunk chunk;
+        std::copy(type, type + sizeof(chunk.type), chunk.type);
+        chunk.xID = data.xID;
+        chunk.zID = data.zID;
+        chunk.samplesPerAxis = data.samplesPerAxis;
+        chunk.offset = offset;
+        chunk.size = size;
+        chunks.push_back(chunk);
+
+        writePadding(file, offset);
+        file.write(values, size);
+        offset = alignedOffset(offset + size);
+    };
+
+    TileData data;
+    for (size_t i = 0; i < numTiles; ++i) {
+        if (!tile(i, data))
+            continue;
+        const size_t numSamples = size_t(data.samplesPerAxis) * data.samplesPerAxis;
+        assert(data.baseHeights.size() == numSamples && data.baseElements.size() == numSamples && data.liquidHeights.size() == numSamples);
+        assert(data.temperatures.empty() || data.temperatures.size() == numSamples);
+
+        writeChunk(baseHeightsChunk, data, reinterpret_cast<const char *>(data.baseHeights.data()), data.baseHeights.size() * sizeof(float));
+        writeChunk(baseElementsChunk, data, reinterpret_cast<const char *>(data.baseElements.data()), data.baseElements.size() * sizeof(uint8_t));
+        writeChunk(liquidHeightsChunk, data, reinterpret_cast<const char *>(data.liquidHeights.data()), data.liquidHeights.size() * sizeof(float));
+        if (!data.temperatures.empty())
+            writeChunk(temperaturesChunk, data, reinterpret_cast<const char *>(data.temperatures.data()), data.temperatures.size() * sizeof(float));
+    }
+
+    FileHeader header;
+    std::copy(fileMagic, fileMagic + sizeof(fileMagic), header.magic);
+    header.version = fileVersion;
+    header.numChunks = static_cast<uint32_t>(chunks.size());
+    header.reserved = 0;
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(chunks.data()), chunks.size() * sizeof(Chunk));
+
+    const bool written = file.good();
+    file.close();
+    if (!written) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    // rename does not replace existing files on all platforms
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TileFile::isValid() const
+{
+    return m_chunks != nullptr;
+}
+
+std::vector<std::pair<int, int>> TileFile::tiles() const
+{
+    std::vector<std::pair<int, int>> tileIDs;
+    for (uint32_t i = 0; i < m_numChunks; ++i)
+        if (std::equal(m_chunks[i].type, m_chunks[i].type + sizeof(m_chunks[i].type), baseHeightsChunk))
+            tileIDs.emplace_back(m_chunks[i].xID, m_chunks[i].zID);
+    return tileIDs;
+}
+
+bool TileFile::contains(int xID, int zID) const
+{
+    return findChunk(baseHeightsChunk, xID, zID) != nullptr;
+}
+
+const TileFile::Chunk * TileFile::findChunk(const char type[4], int xID, int zID) const
+{
+    for (uint32_t i = 0; i < m_numChunks; ++i) {
+        const Chunk & chunk = m_chunks[i];
+        if (chunk.xID == xID && chunk.zID == zID && std::equal(chunk.type, chunk.type + sizeof(chunk.type), type))
+            return &chunk;
+    }
+    return nullptr;
+}
+
+template <typename T>
+bool TileFile::readChunk(const char type[4], int xID, int zID, size_t numValues, SharedArray<T> & values) const
+{
+    const Chunk * chunk = findChunk(type, xID, zID);
+    if (!chunk || chunk->size != numValues * sizeof(T))
+        return false;
+
+    values = SharedArray<T>(numValues);
+    std::memcpy(values.write().data(), m_data + chunk->offset, chunk->size);
+    return true;
+}
+
+bool TileFile::readTile(int xID, int zID, uint32_t samplesPerAxis, TileData & data) const
+{
+    const Chunk * baseHeights = findChunk(baseHeightsChunk, xID, zID);
+    if (!baseHeights || baseHeights->samplesPerAxis != samplesPerAxis)
+        return false;
+
+    data.xID = xID;
+    data.zID = zID;
+    data.samplesPerAxis = samplesPerAxis;
+
+    const size_t numSamples = size_t(samplesPerAxis) * samplesPerAxis;
+    if (!readChunk(baseHeightsChunk, xID, zID, numSamples, data.baseHeights)
+        || !readChunk(baseElementsChunk, xID, zID, numSamples, data.baseElements)
+        || !readChunk(liquidHeightsChunk, xID, zID, numSamples, data.liquidHeights))
+        return false;
+
+    // tiles without temperatures get them from their heights
+    if (!readChunk(temperaturesChunk, xID, zID, numSamples, data.temperatures))
+        data.temperatures = SharedArray<float>();
+
+    return true;
+}
+
+bool TerrainSnapshot::write(const std::string & path) const
+{
+    for (const std::shared_future<void> & pendingWrite : pendingWrites)
+        pendingWrite.wait();
+
+    // each file is mapped once
+    std::map<std::string, std::shared_ptr<const TileFile>> files;
+    for (const auto & fileTile : fileTiles)
+        if (files.find(fileTile.second) == files.end())
+            files.emplace(fileTile.second, std::make_shared<const TileFile>(fileTile.second));
+
+    return TileFile::write(path, tiles.size() + fileTiles.size(), [this, &files](size_t i, TileData & data) {
+        if (i < tiles.size()) {
+            data = tiles.at(i);
+            return true;
+        }
+
+        const auto & fileTile = fileTiles.at(i - tiles.size());
+        if (files.at(fileTile.second)->readTile(fileTile.first.first, fileTile.first.second, samplesPerAxis, data))
+            return true;
+
+        glow::warning("TerrainSnapshot: cannot read tile %;x%; from %;, skipping it", fileTile.first.first, fileTile.first.second, fileTile.second);
+        return false;
+    });
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "terraingenerator.h"
+
+/** @brief Versioned binary file of terrain tiles, used for terrain snapshots and the tile cache of the streamer.
+  * The file starts with a header and a table of chunks. Each chunk holds one array of one tile (base heights,
+  * base elements, liquid heights or temperatures) and is aligned, so that it can be copied from the memory mapped file directly.
+  * The file is mapped on construction and unmapped on destruction. Reading tiles is thread safe. */
+class TileFile
+{
+public:
+    TileFile(const std::string & path);
+    ~TileFile();
+
+    /** Write up to numTiles tiles to path. tile(i, data) is called once for each tile, so that not all tiles have to be in memory,
+      * and returns false to skip the tile. The file is written next to path first and replaces it when complete,
+      * so that mapped files stay valid and readers never see a partially written file. */
+    static bool write(const std::string & path, size_t numTiles, const std::function<bool(size_t, TileData &)> & tile);
+
+    /** @return whether the file could be mapped and has a valid header and chunk table */
+    bool isValid() const;
+
+    /** x/z-IDs of all tiles in the file */
+    std::vector<std::pair<int, int>> tiles() const;
+    bool contains(int xID, int zID) const;
+
+    /** Copy the arrays of the tile into data. Fails if the file doesn't contain the tile with this number of samples. */
+    bool readTile(int xID, int zID, uint32_t samplesPerAxis, TileData & data) const;
+
+protected:
+    struct Chunk;
+
+    const Chunk * findChunk(const char type[4], int xID, int zID) const;
+    template <typename T>
+    bool readChunk(const char type[4], int xID, int zID, size_t numValues, SharedArray<T> & values) const;
+
+    void unmap();
+
+    const char * m_data;
+    size_t m_size;
+    const Chunk * m_chunks;
+    uint32_t m_numChunks;
+#ifdef _WIN32
+    /** the file contents, there is no mmap */
+    std::vector<char> m_buffer;
+#endif
+
+public:
+    TileFile(TileFile&) = delete;
+    void operator=(TileFile&) = delete;
+};
+
+/** @brief Tiles of a terrain at one point in time, independent of the terrain, so that they can be written on another thread. */
+struct TerrainSnapshot
+{
+    /** tiles copied from the terrain, they share their arrays with the tiles until these are edited */
+    std::vector<TileData> tiles;
+    /** tiles that are copied from other tile files when writing: x/z-ID and path of the file */
+    std::vector<std::pair<std::pair<int, int>, std::string>> fileTiles;
+    /** writes of the files in fileTiles that were not finished when the snapshot was taken */
+    std::vector<std::shared_future<void>> pendingWrites;
+    uint32_t samplesPerAxis = 0;
+
+    /** Wait for the pending writes, then write all tiles to a tile file. Tiles that cannot be read from their files are skipped with a warning. */
+    bool write(const std::string & path) const;
+};
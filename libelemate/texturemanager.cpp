@@ -23,9 +23,8 @@ void TextureManager::release()
 
 TextureManager::TextureManager()
 : m_nextFreeUnit(1)
+, m_maxUnits(0)
 {
-    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &m_maxUnits);
-    CheckGLError();
 }
 
 int TextureManager::reserveTextureUnit(const string & owner, const string & name)
@@ -40,9 +39,28 @@ int TextureManager::getTextureUnit(const string & owner, const string & name)
     return s_instance->m_getTextureUnit(owner, name);
 }
 
+void TextureManager::releaseTextureUnits(const string & owner)
+{
+    if (!s_instance)
+        return;
+    s_instance->m_releaseTextureUnits(owner);
+}
+
 int TextureManager::m_reserveTextureUnit(const string & owner, const string & name)
 {
-    int unit = m_nextFreeUnit++;
+    // queried lazily, there is no OpenGL context when running headless
+    if (m_maxUnits == 0) {
+        glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &m_maxUnits);
+        CheckGLError();
+    }
+
+    int unit;
+    if (!m_releasedUnits.empty()) {
+        unit = m_releasedUnits.back();
+        m_releasedUnits.pop_back();
+    }
+    else
+        unit = m_nextFreeUnit++;
     assert(unit < m_maxUnits);
     if (unit >= m_maxUnits) {
         glow::fatal("Requesting more texture units than available: current hardware/driver is limited to %; units", m_maxUnits);
@@ -75,3 +93,15 @@ int TextureManager::m_getTextureUnit(const string & owner, const string & name)
 
     return unitIt->second;
 }
+
+void TextureManager::m_releaseTextureUnits(const string & owner)
+{
+    auto ownerMapIt = m_assignedTextures.find(owner);
+    if (ownerMapIt == m_assignedTextures.end())
+        return;
+
+    for (const auto & pair : ownerMapIt->second)
+        m_releasedUnits.push_back(pair.second);
+
+    m_assignedTextures.erase(ownerMapIt);
+}
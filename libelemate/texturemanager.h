@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <glow/global.h>
 
@@ -15,6 +16,8 @@ public:
     static int reserveTextureUnit(const std::string & owner, const std::string & name);
     /** get an already reserve texture unit, mapped to the owner and name */
     static int getTextureUnit(const std::string & owner, const std::string & name);
+    /** make all texture units reserved for the owner available again. Does nothing if the manager was already released. */
+    static void releaseTextureUnits(const std::string & owner);
 
 private:
     TextureManager();
@@ -22,8 +25,11 @@ private:
 
     int m_reserveTextureUnit(const std::string & owner, const std::string & name);
     int m_getTextureUnit(const std::string & owner, const std::string & name) const;
+    void m_releaseTextureUnits(const std::string & owner);
 
     int m_nextFreeUnit;
+    /** units below m_nextFreeUnit that were released again */
+    std::vector<int> m_releasedUnits;
     GLint m_maxUnits;
     /** mapping from texture owner to the named textures, from textures to the reserved texture unit. */
     std::unordered_map<std::string, std::unordered_map<std::string, GLenum>> m_assignedTextures;
@@ -21,7 +21,12 @@ m_title(title)
 , m_unlocked(unlocked)
 , m_drawn(false)
 , m_timeMod(0)
-{   
+, m_picture(picture)
+{
+}
+
+void Achievement::initialize()
+{
     const int TEXTURE_SIZE_X = 160;
     const int TEXTURE_SIZE_Y = 120;
 
@@ -61,7 +66,7 @@ m_title(title)
     m_texture->setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     m_texture->setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    RawImage image("data/textures/achievements/" + picture + ".raw", TEXTURE_SIZE_X, TEXTURE_SIZE_Y);
+    RawImage image("data/textures/achievements/" + m_picture + ".raw", TEXTURE_SIZE_X, TEXTURE_SIZE_Y);
 
     m_texture->bind();
     m_texture->image2D(0, GL_RGB8, TEXTURE_SIZE_X, TEXTURE_SIZE_Y, 0, GL_RGB, GL_UNSIGNED_BYTE, image.rawData());
@@ -70,6 +75,9 @@ m_title(title)
 
 void Achievement::draw(float x, float y, bool popup, float scale)
 {
+    if (!m_vao)
+        initialize();
+
     if (popup)
         update();
     else
@@ -54,6 +54,10 @@ protected:
 
     std::unordered_map<std::string, std::pair<std::string, float>> m_properties;
 
+    /** create the OpenGL objects when drawing the first time, so that achievements can exist without a context */
+    void initialize();
+    std::string m_picture;
+
     glow::ref_ptr<glow::VertexArrayObject>  m_vao;
     glow::ref_ptr<glow::Program>            m_program;
     glm::vec2                               m_viewport;
@@ -91,31 +91,31 @@ void AchievementManager::resizeAchievements(int width, int height)
 
 void AchievementManager::registerLuaFunctions(LuaWrapper * lua)
 {
-    std::function<int(std::string)> unlock = [=](std::string title)
+    auto unlock = [=](std::string title)
     { 
         unlockAchievement(title);
         return 0; 
     };
 
-    std::function<int(std::string, std::string, std::string)> add = [=](std::string title, std::string text, std::string picture)
+    auto add = [=](std::string title, std::string text, std::string picture)
     {
         addAchievement(title, text, picture);
         return 0;
     };
     
-    std::function<int(std::string, std::string, std::string, float)> condition = [=](std::string title, std::string property_name, std::string relation, float value)
+    auto condition = [=](std::string title, std::string property_name, std::string relation, float value)
     {
         m_locked.at(title)->setUnlockProperty(property_name, relation, value);
         return 0;
     };
 
-    std::function<int(std::string, float)> setProperty = [=](std::string property_name, float property_value)
+    auto setProperty = [=](std::string property_name, float property_value)
     {
         AchievementManager::setProperty(property_name, property_value);
         return 0;
     };
 
-    std::function<float(std::string)> getProperty = [=](std::string property_name)
+    auto getProperty = [=](std::string property_name)
     {
         return m_properties.at(property_name);
     };
@@ -141,6 +141,16 @@ float AchievementManager::getProperty(const std::string& name) const
     return m_properties.at(name);
 }
 
+const std::unordered_map<std::string, float> & AchievementManager::properties() const
+{
+    return m_properties;
+}
+
+void AchievementManager::setProperties(const std::unordered_map<std::string, float> & properties)
+{
+    m_properties = properties;
+}
+
 
 std::unordered_map<std::string, Achievement*>* AchievementManager::getLocked()
 {
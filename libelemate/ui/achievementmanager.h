@@ -25,6 +25,10 @@ public:
     void setProperty(const std::string& name, float value);
     /** Get current property used for achievement unlocking. */
     float getProperty(const std::string& name) const;
+    /** All properties, to save the world state. */
+    const std::unordered_map<std::string, float> & properties() const;
+    /** Replace all properties, when loading a world. Achievements unlocked before stay unlocked. */
+    void setProperties(const std::unordered_map<std::string, float> & properties);
 
     /** Draws newly unlocked achievements onto the screen. */
     void drawAchievements();
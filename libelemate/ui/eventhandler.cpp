@@ -9,6 +9,7 @@
 #include "rendering/renderer.h"
 #include "physicswrapper.h"
 #include "lua/luawrapper.h"
+#include "utils/profiler.h"
 
 EventHandler::EventHandler(GLFWwindow & window, Game & game)
 : m_window(window)
@@ -69,6 +70,12 @@ void EventHandler::handleKeyEvent(int key, int scancode, int action, int mods)
         case GLFW_KEY_F2:
             m_game.renderer()->toggleDrawHeatMap();
             break;
+        case GLFW_KEY_F3:
+            m_game.renderer()->toggleCacheLightMap();
+            break;
+        case GLFW_KEY_F9:
+            Profiler::dump();
+            break;
         case GLFW_KEY_F10:
             m_game.renderer()->takeScreenShot();
             break;
@@ -13,7 +13,6 @@
 #include "terrain/terraininteraction.h"
 #include "particles/particlescriptaccess.h"
 #include "particles/particlegroup.h"
-#include "lua/luawrapper.h"
 #include "ui/achievementmanager.h"
 
 Manipulator::Manipulator(GLFWwindow & window, const Navigation & navigation, World & world) :
@@ -36,6 +35,8 @@ m_lua(new LuaWrapper())
     m_lua->loadScript("scripts/manipulator.lua");
 
     m_lua->loadScript("scripts/achievements.lua");
+
+    m_updateHandPosition = m_lua->function("updateHandPosition");
 }
 
 Manipulator::~Manipulator()
@@ -114,7 +115,7 @@ void Manipulator::updateHandPosition()
     if (m_grabbedTerrain)
         m_terrainInteractor->heightPull(handPosition.x, handPosition.z);
 
-    m_lua->call("updateHandPosition", handPosition.x, m_hand.position().y, handPosition.z);
+    m_lua->call(m_updateHandPosition, handPosition.x, m_hand.position().y, handPosition.z);
 }
 
 LuaWrapper * Manipulator::lua()
@@ -124,10 +125,10 @@ LuaWrapper * Manipulator::lua()
 
 void Manipulator::registerLuaFunctions(LuaWrapper * lua)
 {
-    std::function<int(bool)> func0 = [=] (bool grabbed)
+    auto func0 = [=] (bool grabbed)
     { setGrabbedTerrain(grabbed); return 0; };
 
-    std::function<int(int)> func1 = [=] (int key)
+    auto func1 = [=] (int key)
     { return glfwGetKey(&m_window, key); };
 
     lua->Register("manipulator_setGrabbedTerrain", func0);
@@ -8,12 +8,13 @@
 
 #include <glm/glm.hpp>
 
+#include "lua/luawrapper.h"
+
 
 class World;
 class Navigation;
 class Hand;
 class TerrainInteraction;
-class LuaWrapper;
 class CameraEx;
 
 
@@ -46,6 +47,8 @@ protected:
     std::shared_ptr<TerrainInteraction> m_terrainInteractor;
     bool m_grabbedTerrain;
     LuaWrapper * m_lua;
+    /** called once per frame */
+    LuaWrapper::FunctionRef m_updateHandPosition;
 
     glm::dvec2 m_lastCursorPos;
 
@@ -101,8 +101,9 @@ void UserInterface::initialize()
     m_menus["Help"]->addEntry("Pull and drag terrain with the mouse while holding ALT");
     m_menus["Help"]->addEntry("");
     m_menus["Help"]->addEntry("For Debugging:");
-    m_menus["Help"]->addEntry("- F1 - show particle group bounding boxes");
+    m_menus["Help"]->addEntry("- F1 - show particle group bounding boxes and culling statistics");
     m_menus["Help"]->addEntry("- F2 - show the terrain heat map");
+    m_menus["Help"]->addEntry("- F3 - toggle the cached light map of the shadows");
     m_menus["Help"]->addEntry("- F10 - capture screen shot");
     m_menus.emplace("Achievements", new MenuPage("Achievements"));
     m_menus["Achievements"]->setTopOffset(-0.3f);
@@ -0,0 +1,186 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glow/logging.h>
+
+#include "ChronoTimer.h"
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define ELEMATE_THREAD_LOCAL __declspec(thread)
+#else
+#define ELEMATE_THREAD_LOCAL thread_local
+#endif
+
+namespace {
+
+/** Zone in the ring buffer. Atomic, as the thread writing the trace may read it while it is overwritten. */
+struct Slot
+{
+    std::atomic<const char *> name;
+    std::atomic<int64_t> begin;
+    std::atomic<int64_t> end;
+};
+
+/** Written only by its thread, read by the thread writing the trace. */
+struct ThreadBuffer
+{
+    ThreadBuffer(uint32_t threadIndex, long double timeOffset)
+    : threadIndex(threadIndex)
+    , timeOffset(timeOffset)
+    , head(0)
+    , slots(new Slot[Profiler::s_ringBufferSize])
+    {
+    }
+
+    const uint32_t threadIndex;
+    /** time of the reference timer when this thread's timer was started */
+    const long double timeOffset;
+    ChronoTimer timer;
+
+    /** number of zones ever recorded, the next zone is written to head % s_ringBufferSize */
+    std::atomic<uint64_t> head;
+    std::unique_ptr<Slot[]> slots;
+};
+
+std::mutex s_registryMutex;
+/** thread buffers are kept until the process exits, so that zones of finished threads can still be written */
+std::vector<ThreadBuffer *> s_threadBuffers;
+ChronoTimer s_referenceTimer;
+
+ELEMATE_THREAD_LOCAL ThreadBuffer * t_threadBuffer = nullptr;
+
+ThreadBuffer & threadBuffer()
+{
+    if (!t_threadBuffer) {
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        t_threadBuffer = new ThreadBuffer(static_cast<uint32_t>(s_threadBuffers.size()), s_referenceTimer.elapsed());
+        s_threadBuffers.push_back(t_threadBuffer);
+    }
+    return *t_threadBuffer;
+}
+
+void writeEscaped(std::ostream & stream, const char * string)
+{
+    for (const char * c = string; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            stream << '\\';
+        stream << *c;
+    }
+}
+
+}
+
+int64_t Profiler::now()
+{
+    const ThreadBuffer & buffer = threadBuffer();
+    return static_cast<int64_t>(buffer.timeOffset + buffer.timer.elapsed());
+}
+
+void Profiler::record(const char * name, int64_t begin, int64_t end)
+{
+    ThreadBuffer & buffer = threadBuffer();
+
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    // a reader seeing any part of this zone will also see the head that announced it
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Slot & slot = buffer.slots[head % s_ringBufferSize];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::enabled()
+{
+#ifdef ELEMATE_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Profiler::writeChromeTrace(const std::string & fileName)
+{
+    std::ofstream file(fileName, std::ios_base::trunc | std::ios_base::out);
+    if (!file.good()) {
+        glow::warning("Profiler: cannot write trace to %;", fileName);
+        return false;
+    }
+
+    std::vector<ThreadBuffer *> threadBuffers;
+    {
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        threadBuffers = s_threadBuffers;
+    }
+
+    std::vector<Zone> zones;
+    size_t numZones = 0;
+    bool first = true;
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[";
+
+    for (ThreadBuffer * buffer : threadBuffers) {
+        // other threads keep recording: copy the zones, then drop those that may have been overwritten while copying
+        const uint64_t headBefore = buffer->head.load(std::memory_order_acquire);
+        const uint64_t begin = headBefore > s_ringBufferSize ? headBefore - s_ringBufferSize : 0;
+
+        zones.clear();
+        for (uint64_t i = begin; i < headBefore; ++i) {
+            const Slot & slot = buffer->slots[i % s_ringBufferSize];
+            zones.push_back({ slot.name.load(std::memory_order_relaxed), slot.begin.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed) });
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t headAfter = buffer->head.load(std::memory_order_relaxed);
+        // the zone headAfter may be in progress, overwriting zone headAfter - s_ringBufferSize
+        const uint64_t firstValid = headAfter >= s_ringBufferSize ? headAfter - s_ringBufferSize + 1 : 0;
+        const size_t numValid = static_cast<size_t>(headBefore - std::max(begin, std::min(firstValid, headBefore)));
+
+        for (auto zone = zones.end() - numValid; zone != zones.end(); ++zone) {
+            file << (first ? "\n" : ",\n");
+            first = false;
+
+            // trace event timestamps are in microseconds
+            file << "{\"name\":\"";
+            writeEscaped(file, zone->name);
+            file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadIndex
+                << ",\"ts\":" << zone->begin / 1000.0
+                << ",\"dur\":" << (zone->end - zone->begin) / 1000.0 << "}";
+        }
+        numZones += numValid;
+    }
+
+    file << "\n]}\n";
+
+    glow::info("Profiler: wrote %; zones of %; threads to %;", numZones, threadBuffers.size(), fileName);
+
+    return file.good();
+}
+
+void Profiler::dump()
+{
+    if (!enabled()) {
+        glow::info("Profiler: profiling is disabled in this build (ELEMATE_PROFILING)");
+        return;
+    }
+
+    static time_t lastTime = 0;
+    static int n = 0;
+
+    const time_t now = std::time(0);
+    n = now == lastTime ? n + 1 : 0;
+    lastTime = now;
+
+    writeChromeTrace("profile_" + std::to_string(now) + "_" + std::to_string(n) + ".json");
+}
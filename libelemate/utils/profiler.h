@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/** @brief Records scoped zones into per-thread ring buffers, to be viewed in chrome://tracing.
+  * Use ELEMATE_PROFILE_ZONE("name") at the beginning of a scope, with a string literal as name.
+  * Zones are only recorded if ELEMATE_PROFILING is defined, otherwise the macro expands to nothing. */
+class Profiler
+{
+public:
+    /** Write the recorded zones of all threads in the Chrome trace event format.
+      * @return whether the file could be written */
+    static bool writeChromeTrace(const std::string & fileName);
+    /** Write the trace to a new file named profile_<time>_<n>.json in the working directory. */
+    static void dump();
+
+    /** @return whether zones are recorded in this build */
+    static bool enabled();
+
+    /** Zones recorded per thread, older zones are overwritten. */
+    static const uint32_t s_ringBufferSize = 1 << 16;
+
+    struct Zone {
+        const char * name;
+        /** nanoseconds since the profiler's time reference */
+        int64_t begin;
+        int64_t end;
+    };
+
+    /** nanoseconds since the profiler's time reference, as measured by the calling thread */
+    static int64_t now();
+    static void record(const char * name, int64_t begin, int64_t end);
+};
+
+/** @brief Records a zone from its construction to its destruction. */
+class ProfilerZone
+{
+public:
+    explicit ProfilerZone(const char * name)
+    : m_name(name)
+    , m_begin(Profiler::now())
+    {
+    }
+
+    ~ProfilerZone()
+    {
+        Profiler::record(m_name, m_begin, Profiler::now());
+    }
+
+protected:
+    const char * m_name;
+    const int64_t m_begin;
+
+public:
+    ProfilerZone(ProfilerZone&) = delete;
+    void operator=(ProfilerZone&) = delete;
+};
+
+#define ELEMATE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ELEMATE_PROFILE_CONCAT(a, b) ELEMATE_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef ELEMATE_PROFILING
+#define ELEMATE_PROFILE_ZONE(name) ProfilerZone ELEMATE_PROFILE_CONCAT(profilerZone, __LINE__)(name)
+#else
+#define ELEMATE_PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** @brief Array whose copies share the values until one of them is written to.
+  * Reading works like on a const std::vector. Writing goes through write(), which copies the values first if another copy
+  * still uses them. So a copy only costs a handle and can be read on another thread while the original is edited.
+  * write() must not be called while another thread copies this array. Concurrent write() calls are fine once the values are not shared. */
+template <typename T>
+class SharedArray
+{
+public:
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    SharedArray(size_t size = 0, const T & value = T())
+    : m_values(std::make_shared<std::vector<T>>(size, value))
+    {
+    }
+
+    SharedArray(const SharedArray & other)
+    : m_values(other.m_values)
+    {
+    }
+
+    SharedArray & operator=(const SharedArray & other)
+    {
+        m_values = other.m_values;
+        return *this;
+    }
+
+    size_t size() const { return m_values->size(); }
+    bool empty() const { return m_values->empty(); }
+    const T * data() const { return m_values->data(); }
+    const T & operator[](size_t index) const { return (*m_values)[index]; }
+    const T & at(size_t index) const { return m_values->at(index); }
+    const_iterator begin() const { return m_values->begin(); }
+    const_iterator end() const { return m_values->end(); }
+    const std::vector<T> & values() const { return *m_values; }
+
+    /** @return the values for writing, copied first if they are shared */
+    std::vector<T> & write()
+    {
+        if (m_values.use_count() > 1)
+            m_values = std::make_shared<std::vector<T>>(*m_values);
+        else
+            // the last other owner may have released the values on another thread, its reads happen before our writes
+            std::atomic_thread_fence(std::memory_order_acquire);
+        return *m_values;
+    }
+
+    /** exchange the values with other without copying them */
+    void swap(SharedArray & other)
+    {
+        m_values.swap(other.m_values);
+    }
+
+    bool operator==(const SharedArray & other) const { return m_values == other.m_values || *m_values == *other.m_values; }
+    bool operator!=(const SharedArray & other) const { return !(*this == other); }
+
+protected:
+    /** never null */
+    std::shared_ptr<std::vector<T>> m_values;
+};
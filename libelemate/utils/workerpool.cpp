@@ -0,0 +1,92 @@
+#include "workerpool.h"
+
+#include <algorithm>
+#include <cassert>
+
+WorkerPool & WorkerPool::instance()
+{
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+WorkerPool::WorkerPool(unsigned int numThreads)
+: m_busy(false)
+, m_function(nullptr)
+, m_numTasks(0)
+, m_nextTask(0)
+, m_finishedTasks(0)
+, m_quit(false)
+{
+    assert(numThreads >= 1);
+
+    for (unsigned int i = 1; i < numThreads; ++i)
+        m_workers.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_taskAvailable.notify_all();
+
+    for (std::thread & worker : m_workers)
+        worker.join();
+}
+
+unsigned int WorkerPool::numThreads() const
+{
+    return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+void WorkerPool::forEach(unsigned int numTasks, const std::function<void(unsigned int)> & function)
+{
+    bool idle = false;
+    if (numTasks < 2 || m_workers.empty() || !m_busy.compare_exchange_strong(idle, true)) {
+        for (unsigned int task = 0; task < numTasks; ++task)
+            function(task);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_function = &function;
+    m_numTasks = numTasks;
+    m_nextTask = 0;
+    m_finishedTasks = 0;
+    m_taskAvailable.notify_all();
+
+    while (m_nextTask < m_numTasks) {
+        const unsigned int task = m_nextTask++;
+        lock.unlock();
+        function(task);
+        lock.lock();
+        ++m_finishedTasks;
+    }
+
+    m_jobFinished.wait(lock, [this]() { return m_finishedTasks == m_numTasks; });
+    m_function = nullptr;
+    m_numTasks = m_nextTask = m_finishedTasks = 0;
+    lock.unlock();
+
+    m_busy = false;
+}
+
+void WorkerPool::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_taskAvailable.wait(lock, [this]() { return m_quit || m_nextTask < m_numTasks; });
+        if (m_quit)
+            return;
+
+        const unsigned int task = m_nextTask++;
+        const std::function<void(unsigned int)> & function = *m_function;
+        lock.unlock();
+        function(task);
+        lock.lock();
+
+        if (++m_finishedTasks == m_numTasks)
+            m_jobFinished.notify_one();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** @brief Persistent worker threads, shared by all parallel loops of the game.
+  * forEach() runs one job at a time: if the pool is busy, e.g. while a terrain streaming thread generates a tile,
+  * the tasks of other callers run on their calling thread. So the number of threads never exceeds the hardware threads. */
+class WorkerPool
+{
+public:
+    /** pool with one thread per hardware thread, the calling thread of forEach() included */
+    static WorkerPool & instance();
+
+    /** @param numThreads threads that work on a job, including the calling thread of forEach() */
+    explicit WorkerPool(unsigned int numThreads);
+    ~WorkerPool();
+
+    unsigned int numThreads() const;
+
+    /** Call function(task) for each task in [0, numTasks), on the calling thread and the worker threads, and return when all are done.
+      * Tasks may call forEach() again, these calls run on their thread. */
+    void forEach(unsigned int numTasks, const std::function<void(unsigned int)> & function);
+
+protected:
+    std::vector<std::thread> m_workers;
+
+    /** set while a job is running */
+    std::atomic<bool> m_busy;
+
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_jobFinished;
+    const std::function<void(unsigned int)> * m_function;
+    unsigned int m_numTasks;
+    unsigned int m_nextTask;
+    unsigned int m_finishedTasks;
+    bool m_quit;
+
+    void work();
+
+public:
+    void operator=(WorkerPool&) = delete;
+};
@@ -1,6 +1,7 @@
 #include "world.h"
 
 #include <algorithm>
+#include <chrono>
 
 #include <glow/logging.h>
 #include <glow/Program.h>
@@ -11,12 +12,17 @@
 #include <glm/glm.hpp>
 
 #include "utils/CyclicTime.h"
+#include "utils/ChronoTimer.h"
+#include "utils/profiler.h"
 #include "physicswrapper.h"
 #include "io/soundmanager.h"
+#include "io/worldfile.h"
 #include "ui/navigation.h"
 #include "ui/hand.h"
 #include "terrain/terraingenerator.h"
 #include "terrain/terrain.h"
+#include "terrain/terrainstreamer.h"
+#include "terrain/tilefile.h"
 #include "particles/particlegrouptycoon.h"
 #include "particles/particlescriptaccess.h"
 #include "particles/particlegroup.h"
@@ -26,11 +32,13 @@
 
 World * World::s_instance = nullptr;
 
-World::World(PhysicsWrapper & physicsWrapper)
+World::World(PhysicsWrapper & physicsWrapper, bool headless, const TerrainSettings & terrainSettings)
 : hand(nullptr)
 , terrain(nullptr)
 , humidityFactor(-0.2f)
 , m_physicsWrapper(physicsWrapper)
+, m_headless(headless)
+, m_streamingFocus()
 , m_time(std::make_shared<CyclicTime>(0.0L, 1.0L))
 , m_sharedShaders()
 , m_sounds()
@@ -39,6 +47,8 @@ World::World(PhysicsWrapper & physicsWrapper)
 , m_airHumidity(0)
 , m_rainStrength(0.f)
 , m_isRaining(false)
+, m_autosaveInterval(0.0)
+, m_timeSinceAutosave(0.0)
 {
     assert(s_instance == nullptr);
     s_instance = this;
@@ -56,8 +66,10 @@ World::World(PhysicsWrapper & physicsWrapper)
 
     TextureManager::initialize();
 
-    TerrainGenerator terrainGen;
+    TerrainGenerator terrainGen(terrainSettings);
     terrain = std::shared_ptr<Terrain>(terrainGen.generate());
+    if (terrainSettings.streaming)
+        m_terrainStreamer = std::make_shared<TerrainStreamer>(*terrain, terrainGen);
 
     hand = std::make_shared<Hand>();
 
@@ -71,6 +83,8 @@ World::World(PhysicsWrapper & physicsWrapper)
 
 World::~World()
 {
+    if (m_autosave.valid())
+        m_autosave.wait();
     TextureManager::release();
     ParticleGroupTycoon::release();
     SoundManager::release();
@@ -110,12 +124,50 @@ void World::updatePhysics()
     if (delta == 0.0f)
         return;
 
-    terrain->updatePhysics(delta);
+    stepPhysics(delta);
+}
+
+void World::stepPhysics(double delta)
+{
+    ChronoTimer timer;
+    long double lastElapsed = 0.0L;
+    auto lap = [&timer, &lastElapsed]() {
+        timer.update();
+        const long double elapsed = timer.elapsed();
+        const double lapTime = static_cast<double>(elapsed - lastElapsed) * 1e-9;
+        lastElapsed = elapsed;
+        return lapTime;
+    };
+
+    ELEMATE_PROFILE_ZONE("World::stepPhysics");
+
+    {
+        ELEMATE_PROFILE_ZONE("terrain");
+        if (m_terrainStreamer)
+            m_terrainStreamer->update(m_streamingFocus);
+        terrain->updatePhysics(delta);
+    }
+    m_physicsTimings.terrain += lap();
 
-    ParticleGroupTycoon::instance().updatePhysics(delta);
+    {
+        ELEMATE_PROFILE_ZONE("ParticleGroupTycoon::updatePhysics");
+        ParticleGroupTycoon::instance().updatePhysics(delta);
+    }
+    m_physicsTimings.particles += lap();
 
     // simulate physx
-    m_physicsWrapper.step(static_cast<float>(delta));
+    {
+        ELEMATE_PROFILE_ZONE("PhysX step");
+        m_physicsWrapper.step(static_cast<float>(delta));
+    }
+    m_physicsTimings.physx += lap();
+
+    {
+        ELEMATE_PROFILE_ZONE("ParticleGroupTycoon::updateSnapshots");
+        ParticleGroupTycoon::instance().updateSnapshots();
+    }
+    m_physicsTimings.snapshots += lap();
+    ++m_physicsTimings.numSteps;
 
     if (m_isRaining)
     {
@@ -130,12 +182,136 @@ void World::updatePhysics()
             if (m_airHumidity == 0) m_isRaining = false;
         }
     }
+
+    autosave(delta);
+}
+
+void World::autosave(double delta)
+{
+    if (m_autosaveInterval <= 0.0)
+        return;
+
+    m_timeSinceAutosave += delta;
+    if (m_timeSinceAutosave < m_autosaveInterval)
+        return;
+
+    // try again after the next step
+    if (m_autosave.valid() && m_autosave.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    if (m_autosave.valid() && !m_autosave.get())
+        glow::warning("World: autosave to %; failed", m_autosavePath);
+
+    ELEMATE_PROFILE_ZONE("World::autosave");
+
+    // the state shares the particle snapshots and tile arrays, serializing and writing them runs in the background.
+    // The writer releases them when it is done, so that the next edits don't copy them.
+    auto state = std::make_shared<WorldState>();
+    captureState(*state);
+    const std::string path = m_autosavePath;
+    m_autosave = std::async(std::launch::async, [state, path]() mutable {
+        const bool written = WorldFile::write(path, *state);
+        state.reset();
+        return written;
+    });
+    m_timeSinceAutosave = 0.0;
+}
+
+const World::PhysicsTimings & World::physicsTimings() const
+{
+    return m_physicsTimings;
+}
+
+bool World::headless() const
+{
+    return m_headless;
+}
+
+bool World::saveTerrain(const std::string & path)
+{
+    if (m_terrainStreamer)
+        return m_terrainStreamer->snapshot().write(path);
+    return TerrainGenerator::snapshot(*terrain).write(path);
+}
+
+void World::captureState(WorldState & state)
+{
+    state.dayTime = static_cast<double>(m_time->getf(true));
+    state.timeRunning = m_time->isRunning();
+
+    state.airHumidity = m_airHumidity;
+    state.humidityFactor = humidityFactor;
+    state.rainStrength = m_rainStrength;
+    state.isRaining = m_isRaining;
+
+    state.achievementProperties = AchievementManager::instance()->properties();
+    ParticleGroupTycoon::instance().saveState(state.particleGroups);
+
+    state.terrain = m_terrainStreamer ? m_terrainStreamer->snapshot() : TerrainGenerator::snapshot(*terrain);
+}
+
+bool World::save(const std::string & path)
+{
+    // an autosave to the same files must not write at the same time
+    if (m_autosave.valid())
+        m_autosave.wait();
+
+    WorldState state;
+    captureState(state);
+    return WorldFile::write(path, state);
+}
+
+bool World::load(const std::string & path)
+{
+    // the terrain may be loaded from the tile file of the autosave
+    if (m_autosave.valid())
+        m_autosave.wait();
+
+    WorldState state;
+    if (!WorldFile::read(path, state)) {
+        glow::warning("World: could not load %;", path);
+        return false;
+    }
+
+    const std::string terrainPath = WorldFile::terrainPath(path);
+    if (m_terrainStreamer)
+        m_terrainStreamer->reload(terrainPath, m_streamingFocus);
+    else {
+        TerrainSettings settings = terrain->settings;
+        settings.snapshotFile = terrainPath;
+        TerrainGenerator(settings).reload(*terrain);
+    }
+
+    ParticleGroupTycoon::instance().restoreState(state.particleGroups);
+    AchievementManager::instance()->setProperties(state.achievementProperties);
+
+    // after the particles, creating steam particles changes the humidity
+    m_airHumidity = state.airHumidity;
+    humidityFactor = state.humidityFactor;
+    m_rainStrength = state.rainStrength;
+    m_isRaining = state.isRaining;
+    fadeRainSound(rainStrength());
+
+    m_time->setf(static_cast<t_longf>(state.dayTime), true);
+    if (m_time->isRunning() != state.timeRunning)
+        togglePause();
+
+    m_timeSinceAutosave = 0.0;
+    return true;
+}
+
+void World::setAutosave(const std::string & path, double interval)
+{
+    m_autosavePath = path;
+    m_autosaveInterval = interval;
+    m_timeSinceAutosave = 0.0;
 }
 
 void World::updateVisuals(CameraEx & camera)
 {
     updateListener(camera);
 
+    m_streamingFocus = camera.center();
+
     ParticleGroupTycoon::instance().updateVisuals();
 }
 
@@ -211,8 +387,20 @@ void World::registerLuaFunctions(LuaWrapper * lua)
     std::function<int(int)> func1 = [=] (int id)
     { toggleBackgroundSound(id); return 0; };
 
+    std::function<int(std::string)> func2 = [=] (std::string path)
+    { return save(path) ? 1 : 0; };
+
+    std::function<int(std::string)> func3 = [=] (std::string path)
+    { return load(path) ? 1 : 0; };
+
+    std::function<int(std::string, float)> func4 = [=] (std::string path, float interval)
+    { setAutosave(path, interval); return 0; };
+
     lua->Register("world_togglePause", func0);
     lua->Register("world_toggleBackgroundSound", func1);
+    lua->Register("world_save", func2);
+    lua->Register("world_load", func3);
+    lua->Register("world_setAutosave", func4);
 }
 
 glow::Shader * World::sharedShader(GLenum type, const std::string & filename) const
@@ -3,7 +3,9 @@
 #include <glow/ref_ptr.h>
 #include <GL/glew.h>
 
+#include <future>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -11,6 +13,8 @@
 
 #include <glm/glm.hpp>
 
+#include "terrain/terrainsettings.h"
+
 namespace glow {
     class Shader;
     class Program;
@@ -20,14 +24,18 @@ class PhysicsWrapper;
 class CyclicTime;
 class Hand;
 class Terrain;
+class TerrainStreamer;
 class ParticleGroup;
 class LuaWrapper;
 class CameraEx;
+struct WorldState;
 
 class World
 {
 public:
-    World(PhysicsWrapper & physicsWrapper);
+    /** @param headless don't prepare any data for rendering, there is no OpenGL context
+      * @param terrainSettings settings for the terrain generation, the terrain tiles are streamed around the camera if enabled there */
+    World(PhysicsWrapper & physicsWrapper, bool headless = false, const TerrainSettings & terrainSettings = TerrainSettings());
     ~World();
 
     static World * instance();
@@ -40,6 +48,33 @@ public:
 
     /** updates the physics, depending on the in game time */
     void updatePhysics();
+    /** advance the simulation by delta seconds, independent of the in game time */
+    void stepPhysics(double delta);
+
+    /** accumulated time spent in the subsystems while stepping the physics, in seconds */
+    struct PhysicsTimings {
+        double terrain = 0.0;
+        double particles = 0.0;
+        double physx = 0.0;
+        double snapshots = 0.0;
+        unsigned int numSteps = 0;
+    };
+    const PhysicsTimings & physicsTimings() const;
+
+    bool headless() const;
+
+    /** Write the terrain with all edits to a tile file, which can be loaded with TerrainSettings::snapshotFile.
+      * When streaming, this includes the evicted tiles. */
+    bool saveTerrain(const std::string & path);
+
+    /** Write the terrain, the particle groups, the time, the climate and the achievement properties to a world file and a tile file next to it.
+      * Must be called between simulation steps. */
+    bool save(const std::string & path);
+    /** Replace the state of the world by the state in a world file written by save. Must be called between simulation steps. */
+    bool load(const std::string & path);
+    /** Save the world to path every interval seconds of simulated time. The state is copied after a simulation step
+      * and written on another thread, a save is skipped while the last one is still writing. An interval of 0 disables autosaving. */
+    void setAutosave(const std::string & path, double interval);
 
     /** updates the world as needed for visualization and interaction */
     void updateVisuals(CameraEx & camera);
@@ -72,6 +107,13 @@ protected:
     static World * s_instance;
 
     PhysicsWrapper & m_physicsWrapper;
+    const bool m_headless;
+
+    /** only set if the terrain is streamed */
+    std::shared_ptr<TerrainStreamer> m_terrainStreamer;
+    /** tiles are streamed around this position, the camera center of the last updateVisuals() */
+    glm::vec3 m_streamingFocus;
+    PhysicsTimings m_physicsTimings;
     std::list<std::string> m_currentElements;
 
     std::shared_ptr<CyclicTime> m_time;
@@ -85,6 +127,9 @@ protected:
     void updateListener(const CameraEx & camera);
     void fadeRainSound(float intensity);
 
+    void captureState(WorldState & state);
+    void autosave(double delta);
+
     glm::vec3 m_sunPosition;
     glm::mat4 m_sunlight;
     unsigned int m_airHumidity;
@@ -94,6 +139,12 @@ protected:
 
     std::unordered_set<ParticleGroup *> m_particleGroupObservers;
 
+    std::string m_autosavePath;
+    double m_autosaveInterval;
+    double m_timeSinceAutosave;
+    /** the write of the last autosave */
+    std::future<bool> m_autosave;
+
 public:
     World(World&) = delete;
     void operator=(World&) = delete;
@@ -1,62 +1,68 @@
+-- boxes: {llf1, urb1, llf2, urb2, ...} with one pair per contact of two particle groups
+-- groups: {left1, right1, left2, right2, ...} the groups in contact in each box, the boxes of a group pair are consecutive
+function collisionBatch(boxes, groups)
+    local elements = {}
+    local waterLavaContacts = {}
 
+    for i = 1, #boxes / 2 do
+        local group1id = groups[2 * i - 1]
+        local group2id = groups[2 * i]
+        elements[group1id] = elements[group1id] or psa_elementAtId(group1id)
+        elements[group2id] = elements[group2id] or psa_elementAtId(group2id)
+        local element1 = elements[group1id]
+        local element2 = elements[group2id]
 
-local group1id
-local group2id
-local element1
-local element2
-local collisionLlf
-local collisionUrb
-
-function boundingBoxCollision(_group1id, _group2id, intersectBoxLlf, intersectBoxUrb)
-    group1id = _group1id
-    group2id = _group2id
-
-    element1 = psa_elementAtId(group1id)
-    element2 = psa_elementAtId(group2id)
-
-    if element1 == element2 then
-        return
+        if (element1 == "water" and element2 == "lava") then
+            waterLavaContacts[#waterLavaContacts + 1] = {group1id, group2id, i}
+        elseif (element1 == "lava" and element2 == "water") then
+            waterLavaContacts[#waterLavaContacts + 1] = {group2id, group1id, i}
+        end
     end
-    
-    if (element1 == "water" and element2 == "lava") or (element1 == "lava" and element2 == "water") then
-        pc_checkCollidedParticles(group1id, group2id, intersectBoxLlf, intersectBoxUrb)
+
+    if #waterLavaContacts > 0 then
+        collisionWaterLava(waterLavaContacts, boxes)
     end
 end
 
-function particleCollision(_collisionLlf, _collisionUrb)
-    collisionLlf = _collisionLlf
-    collisionUrb = _collisionUrb
-    
-    if (element1 == "water" and element2 == "lava") then 
-        collisionWaterLava(group1id, group2id);
-        return
-    end
-    if (element1 == "lava" and element2 == "water") then 
-        collisionWaterLava(group2id, group1id);
-        return
-    end
-end    
+-- contacts: {waterGroup, lavaGroup, box index} per box
+function collisionWaterLava(contacts, boxes)
+    local numBoxes = #contacts
+    local collisionCentersXZ = {}
+    local lavaReleases = {}
+    local heightPerParticle = {}
 
-function collisionWaterLava(waterGroup, lavaGroup)
-    collisionCenterXZ = {0.5 * (collisionUrb[1] + collisionLlf[1]), 0.5*(collisionUrb[3] + collisionLlf[3])}
-    enlargeBox(collisionLlf, collisionUrb, 0.2)
-    -- forget the lava particles, but remember how many we have deleted
-    numLavaParticles = pc_releaseForgetParticles(lavaGroup, collisionLlf, collisionUrb)
-    -- remember water to transform it into steam
-    pc_releaseRememberParticles(waterGroup, collisionLlf, collisionUrb)
-    -- and later.. check that ratio between the two particles types, the release functions return a number of particles
-    -- this would create steam particles for water (once we have steam..):
+    for i = 1, numBoxes do
+        local waterGroup = contacts[i][1]
+        local lavaGroup = contacts[i][2]
+        local collisionLlf = boxes[2 * contacts[i][3] - 1]
+        local collisionUrb = boxes[2 * contacts[i][3]]
+        collisionCentersXZ[i] = {0.5 * (collisionUrb[1] + collisionLlf[1]), 0.5*(collisionUrb[3] + collisionLlf[3])}
+        enlargeBox(collisionLlf, collisionUrb, 0.2)
+        -- forget the lava particles, but remember how many we have deleted
+        lavaReleases[i] = pc_queueReleaseForget(lavaGroup, collisionLlf, collisionUrb)
+        -- remember water to transform it into steam
+        pc_queueReleaseRemember(waterGroup, collisionLlf, collisionUrb)
+
+        -- assuming the collision bbox is not "too large"
+        -- calculate a height delta that looks fine =)
+        if heightPerParticle[waterGroup] == nil then
+            heightPerParticle[waterGroup] = psa_restOffset(waterGroup) * terrain_sampleInterval() * 0.2
+        end
+    end
+    
+    -- release the particles of all boxes at once
+    pc_applyReleases()
     pc_createFromRemembered("steam")
-    achievement_setProperty("steam", achievement_getProperty("steam") + 1)
+    achievement_setProperty("steam", achievement_getProperty("steam") + numBoxes)
     
     terrain_setInteractElement("bedrock")
     achievement_setProperty("bedrock", 1)
-    -- assuming the collision bbox is not "too large"
-    -- calculate a height delta that looks fine =)
-    heightDelta = psa_restOffset(waterGroup) * numLavaParticles * terrain_sampleInterval() * 0.2
     
-    if (heightDelta > 0) then
-        terrain_dropElement(collisionCenterXZ[1], collisionCenterXZ[2], heightDelta)
+    for i = 1, numBoxes do
+        local heightDelta = heightPerParticle[contacts[i][1]] * pc_releasedCount(lavaReleases[i])
+        if (heightDelta > 0) then
+            terrain_dropElement(collisionCentersXZ[i][1], collisionCentersXZ[i][2], heightDelta)
+        end
     end
     
     -- discard all remembered particles
@@ -71,24 +77,3 @@ function enlargeBox(llf, urb, delta)
     urb[2] = urb[2] + delta
     urb[3] = urb[3] + delta
 end
-
-function temperatureCheck(id, element, bboxCenter, numParticles)
-    terrain_setInteractElement("temperature")
-    local terrainTemp = terrain_heightAt(bboxCenter[1], bboxCenter[3])
-    local elementTemp = psa_temperature(id)
-    
-    local numberTerrainParticles = 200
-    local tempTarget = ((numberTerrainParticles * terrainTemp) + (numParticles * elementTemp)) / (numberTerrainParticles + numParticles)
-    local minStep = 0.001
-    
-    local terrainDelta = tempTarget - terrainTemp
-    local elementDelta = tempTarget - elementTemp
-    
-    if math.abs(terrainDelta) > minStep then
-        terrain_changeHeight(bboxCenter[1], bboxCenter[3], terrainDelta/10.0)
-    end
-    
-    if math.abs(elementDelta) > minStep then
-        psa_setTemperature(id, psa_temperature(id)+ elementDelta/10.0)
-    end
-end
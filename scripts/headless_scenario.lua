@@ -0,0 +1,38 @@
+-- Scenario for the headless simulation (headless_scenario.lua)
+-- setup() is called once, tick(tickIndex, time) before each simulation step.
+
+local emitters = {}
+
+local function createEmitter( eleType, rate, posX, posZ )
+    local id = psa_createParticleGroup(true, eleType, 10000)
+    local posY = terrain_terrainHeightAt(posX, posZ) + 3.0
+    emitters[#emitters + 1] = { id = id, rate = rate, pos = {posX, posY, posZ} }
+end
+
+function setup()
+    createEmitter("water", 400, -2.0, 0.0)
+    createEmitter("lava", 200, 2.0, 0.0)
+    createEmitter("sand", 200, 0.0, 3.0)
+end
+
+function tick( tickIndex, time )
+    if tickIndex == 0 then
+        for _, emitter in ipairs(emitters) do
+            psa_emit(emitter.id, emitter.rate, emitter.pos[1], emitter.pos[2], emitter.pos[3], 0, -1, 0)
+        end
+    end
+
+    -- dig a trench between the water and lava emitters, then raise a wall
+    if tickIndex >= 100 and tickIndex < 200 then
+        terrain_setInteractElement("bedrock")
+        terrain_changeHeight(0.0, (tickIndex - 150) * 0.05, -0.02)
+    end
+    if tickIndex >= 300 and tickIndex < 400 then
+        terrain_setInteractElement("bedrock")
+        terrain_changeHeight(0.0, (tickIndex - 350) * 0.05, 0.03)
+    end
+
+    if tickIndex == 600 then
+        psa_stopEmit(emitters[1].id)
+    end
+end
@@ -4,11 +4,18 @@ in vec2 g_relPos;
 flat in float g_zDiff;
 in vec4 g_viewPos;
 flat in vec4 g_viewPosCenter;
+flat in float g_particleSize;
+flat in uint g_elementIndex;
 
-uniform float particleSize;
-uniform mat4 projection;
-
-uniform int elementIndex;
+layout(std140) uniform ParticleCamera
+{
+    mat4 viewProjection;
+    mat4 view;
+    mat4 projection;
+    vec3 lookAtUp;
+    vec3 lookAtRight;
+    vec3 lookAtFront;
+};
 
 float linearize(float depth);
 float depthNdcToWindow(float ndcDepth);
@@ -17,7 +24,7 @@ layout(location = 0)out uint f_elementIndex;
 
 void main()
 {
-    f_elementIndex = uint(elementIndex);
+    f_elementIndex = g_elementIndex;
 
     vec3 N;
     N.xy = g_relPos.xy;
@@ -27,7 +34,7 @@ void main()
     
     N.z = sqrt(1.0 - r2);
     
-    vec4 viewFragPos = g_viewPosCenter + vec4(N * particleSize, 0.0);
+    vec4 viewFragPos = g_viewPosCenter + vec4(N * g_particleSize, 0.0);
     vec4 screenFragPos = projection * viewFragPos;
     float ndcDepth = screenFragPos.z / screenFragPos.w;
     
@@ -1,9 +1,14 @@
 #version 330 core
 
-layout(location = 0)in vec3 _vertex;
+layout(location = 0)in vec4 _vertex;    // xyz: position, w: particle size
+layout(location = 1)in uint _elementIndex;
 out vec3 v_vertex;
+out float v_particleSize;
+flat out uint v_elementIndex;
 
 void main()
 {
-    v_vertex = _vertex;
+    v_vertex = _vertex.xyz;
+    v_particleSize = _vertex.w;
+    v_elementIndex = _elementIndex;
 }
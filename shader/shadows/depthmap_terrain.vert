@@ -2,11 +2,28 @@
 
 layout(location = 0)in vec2 _vertex;
 
-out ivec2 v_vertex;
+out vec4 v_position;
+out float v_height;
+out float v_onTop;
 
-uniform ivec2 rowColumnOffset;
+uniform mat4 depthMVP;
+
+uniform samplerBuffer heightField;
+uniform samplerBuffer baseHeightField;
+
+uniform bool baseTileCompare;
+
+vec3 lodVertex(vec2 gridVertex, samplerBuffer heightField, out ivec2 rowColumn);
 
 void main()
 {
-    v_vertex = ivec2(_vertex) + rowColumnOffset;
+    ivec2 rowColumn;
+    vec3 vertex = lodVertex(_vertex, heightField, rowColumn);
+    v_position = depthMVP * vec4(vertex, 1.0);
+    v_height = vertex.y;
+
+    // for water/fluid drawing: samples below the solid terrain are not on top
+    v_onTop = 1.0;
+    if (baseTileCompare)
+        v_onTop = float(vertex.y >= lodVertex(_vertex, baseHeightField, rowColumn).y);
 }
@@ -8,17 +8,14 @@ uniform mat4 lightBiasMVP;
 
 uniform samplerBuffer heightField;
 
-uniform int tileSamplesPerAxis;
-uniform ivec2 rowColumnOffset;
-
 out vec4 v_shadowCoord;
 
+vec3 lodVertex(vec2 gridVertex, samplerBuffer heightField, out ivec2 rowColumn);
+
 void main()
 {
-    ivec2 rowColumn = ivec2(_vertex) + rowColumnOffset;
-    int texIndex = rowColumn.t + rowColumn.s * tileSamplesPerAxis;
-
-    vec4 vertex = vec4(float(rowColumn.x), texelFetch(heightField, texIndex).x, float(rowColumn.y), 1.0);
+    ivec2 rowColumn;
+    vec4 vertex = vec4(lodVertex(_vertex, heightField, rowColumn), 1.0);
     
     gl_Position = modelViewProjection * vertex;
     
@@ -2,7 +2,7 @@
 
 layout(location = 0)in vec2 _vertex;
 
-out ivec2 v_vertex;
+out vec2 v_rowColumn;
 out vec3 v_worldPos;
 out vec3 v_viewPos;
 out vec4 v_projPos;
@@ -16,17 +16,18 @@ uniform samplerBuffer heightField;
 uniform samplerBuffer temperatures;
 
 uniform int tileSamplesPerAxis;
-uniform ivec2 rowColumnOffset;
+
+vec3 lodVertex(vec2 gridVertex, samplerBuffer heightField, out ivec2 rowColumn);
 
 void main()
 {
-    v_vertex = ivec2(_vertex) + rowColumnOffset;
+    ivec2 rowColumn;
+    vec4 vertex = vec4(lodVertex(_vertex, heightField, rowColumn), 1.0);
+    v_rowColumn = vertex.xz;
 
-    int texIndex = v_vertex.t + v_vertex.s * tileSamplesPerAxis; // texelFetch expects an integer position
-    float height = texelFetch(heightField, texIndex).x;
+    int texIndex = rowColumn.t + rowColumn.s * tileSamplesPerAxis; // texelFetch expects an integer position
     v_temperature = texelFetch(temperatures, texIndex).x;
     
-    vec4 vertex = vec4(v_vertex.s, height, v_vertex.t, 1.0);
     v_projPos = modelViewProjection * vertex;
     vec3 normProjPos = v_projPos.xyz / v_projPos.w;
     
@@ -0,0 +1,34 @@
+#version 330 core
+
+// CDLOD node of the terrain, see TerrainLod
+
+uniform int tileSamplesPerAxis;
+
+// lowest row/column of the node and samples between two grid vertices
+uniform ivec2 nodeOffset;
+uniform int nodeSpacing;
+uniform vec2 cameraRowColumn;
+// start and end distance of the morph to the next coarser level
+uniform vec2 morphRange;
+
+float lodMorph(ivec2 rowColumn)
+{
+    float cameraDistance = distance(vec2(rowColumn), cameraRowColumn);
+    return clamp((cameraDistance - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+}
+
+// Row, height and column of the grid vertex in the tile. Odd grid vertices move onto their even neighbor at the end of
+// the node's range, which makes the node look like the next coarser level.
+vec3 lodVertex(vec2 gridVertex, samplerBuffer heightField, out ivec2 rowColumn)
+{
+    ivec2 grid = ivec2(gridVertex);
+    rowColumn = nodeOffset + grid * nodeSpacing;
+    ivec2 coarseRowColumn = nodeOffset + (grid - grid % 2) * nodeSpacing;
+
+    float morph = lodMorph(rowColumn);
+    float height = texelFetch(heightField, rowColumn.t + rowColumn.s * tileSamplesPerAxis).x;
+    float coarseHeight = texelFetch(heightField, coarseRowColumn.t + coarseRowColumn.s * tileSamplesPerAxis).x;
+
+    vec2 morphed = mix(vec2(rowColumn), vec2(coarseRowColumn), morph);
+    return vec3(morphed.x, mix(height, coarseHeight, morph), morphed.y);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <glm/glm.hpp>
+
+#include "rendering/culling.h"
+
+
+namespace {
+
+/** perspective projection with a 90 degree field of view and aspect ratio 1, looking along -z */
+glm::mat4 perspective90(float znear, float zfar)
+{
+    return glm::mat4(
+        glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
+        glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
+        glm::vec4(0.0f, 0.0f, -(zfar + znear) / (zfar - znear), -1.0f),
+        glm::vec4(0.0f, 0.0f, -2.0f * zfar * znear / (zfar - znear), 0.0f));
+}
+
+}
+
+TEST(Frustum_tests, identity_is_the_unit_cube)
+{
+    const Frustum frustum(glm::mat4(1.0f));
+
+    EXPECT_TRUE(frustum.intersects(glm::vec3(-0.5f), glm::vec3(0.5f)));
+    EXPECT_TRUE(frustum.intersects(glm::vec3(0.5f), glm::vec3(2.0f)));     // partially inside
+    EXPECT_TRUE(frustum.intersects(glm::vec3(-5.0f), glm::vec3(5.0f)));    // contains the frustum
+    EXPECT_FALSE(frustum.intersects(glm::vec3(2.0f, -0.5f, -0.5f), glm::vec3(3.0f, 0.5f, 0.5f)));
+    EXPECT_FALSE(frustum.intersects(glm::vec3(-0.5f, -3.0f, -0.5f), glm::vec3(0.5f, -2.0f, 0.5f)));
+    EXPECT_FALSE(frustum.intersects(glm::vec3(-0.5f, -0.5f, 1.5f), glm::vec3(0.5f, 0.5f, 2.0f)));
+}
+
+TEST(Frustum_tests, perspective)
+{
+    const Frustum frustum(perspective90(1.0f, 100.0f));
+
+    EXPECT_TRUE(frustum.intersects(glm::vec3(-1.0f, -1.0f, -51.0f), glm::vec3(1.0f, 1.0f, -49.0f)));
+    // behind the camera, in front of the near plane, behind the far plane
+    EXPECT_FALSE(frustum.intersects(glm::vec3(-1.0f, -1.0f, 4.0f), glm::vec3(1.0f, 1.0f, 6.0f)));
+    EXPECT_FALSE(frustum.intersects(glm::vec3(-0.1f, -0.1f, -0.8f), glm::vec3(0.1f, 0.1f, -0.5f)));
+    EXPECT_FALSE(frustum.intersects(glm::vec3(-1.0f, -1.0f, -151.0f), glm::vec3(1.0f, 1.0f, -149.0f)));
+    // right of the 45 degree side planes, and crossing them
+    EXPECT_FALSE(frustum.intersects(glm::vec3(20.0f, -1.0f, -11.0f), glm::vec3(22.0f, 1.0f, -9.0f)));
+    EXPECT_TRUE(frustum.intersects(glm::vec3(8.0f, -1.0f, -11.0f), glm::vec3(12.0f, 1.0f, -9.0f)));
+    EXPECT_FALSE(frustum.intersects(glm::vec3(-1.0f, 20.0f, -11.0f), glm::vec3(1.0f, 22.0f, -9.0f)));
+}
+
+TEST(CullingStatistics_tests, counts_per_frame)
+{
+    CullingStatistics::beginFrame();
+    CullingStatistics::count(CullingPass::Particles, true);
+    CullingStatistics::count(CullingPass::Particles, false);
+    CullingStatistics::count(CullingPass::Particles, false);
+    CullingStatistics::count(CullingPass::TerrainDepthMap, true);
+    CullingStatistics::beginFrame();
+
+    EXPECT_EQ(1u, CullingStatistics::lastFrame(CullingPass::Particles).drawn);
+    EXPECT_EQ(2u, CullingStatistics::lastFrame(CullingPass::Particles).culled);
+    EXPECT_EQ(1u, CullingStatistics::lastFrame(CullingPass::TerrainDepthMap).drawn);
+    EXPECT_EQ(0u, CullingStatistics::lastFrame(CullingPass::TerrainScene).drawn);
+
+    CullingStatistics::beginFrame();
+    EXPECT_EQ(0u, CullingStatistics::lastFrame(CullingPass::Particles).drawn);
+    EXPECT_EQ(0u, CullingStatistics::lastFrame(CullingPass::Particles).culled);
+}
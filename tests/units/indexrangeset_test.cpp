@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "terrain/indexrangeset.h"
+
+
+TEST(IndexRangeSet_tests, merge_overlapping_and_adjacent)
+{
+    IndexRangeSet ranges;
+    ranges.insert(10, 20);
+    ranges.insert(30, 40);
+    ranges.insert(0, 5);
+    ranges.insert(20, 25);  // adjacent to [10, 20)
+    ranges.insert(12, 18);  // contained
+    ranges.insert(7, 7);    // empty
+
+    ASSERT_EQ(3u, ranges.ranges().size());
+    EXPECT_EQ(0u, ranges.ranges()[0].begin);
+    EXPECT_EQ(5u, ranges.ranges()[0].end);
+    EXPECT_EQ(10u, ranges.ranges()[1].begin);
+    EXPECT_EQ(25u, ranges.ranges()[1].end);
+    EXPECT_EQ(30u, ranges.ranges()[2].begin);
+    EXPECT_EQ(40u, ranges.ranges()[2].end);
+    EXPECT_EQ(30u, ranges.numIndices());
+
+    // spans all ranges
+    ranges.insert(3, 35);
+    ASSERT_EQ(1u, ranges.ranges().size());
+    EXPECT_EQ(0u, ranges.ranges()[0].begin);
+    EXPECT_EQ(40u, ranges.ranges()[0].end);
+
+    ranges.clear();
+    EXPECT_TRUE(ranges.empty());
+}
+
+TEST(IndexRangeSet_tests, random_ranges_match_marked_indices)
+{
+    const unsigned int numIndices = 500;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<unsigned int> indexDistribution(0, numIndices);
+
+    IndexRangeSet ranges;
+    std::vector<bool> marked(numIndices, false);
+    for (int i = 0; i < 200; ++i) {
+        unsigned int begin = indexDistribution(rng), end = begin + indexDistribution(rng) % 8;
+        end = std::min(end, numIndices);
+        ranges.insert(begin, end);
+        for (unsigned int index = begin; index < end; ++index)
+            marked[index] = true;
+    }
+
+    std::vector<bool> covered(numIndices, false);
+    unsigned int lastEnd = 0;
+    for (const IndexRangeSet::Range & range : ranges.ranges()) {
+        // sorted, disjoint and not adjacent
+        EXPECT_LT(range.begin, range.end);
+        if (&range != &ranges.ranges().front()) {
+            EXPECT_LT(lastEnd, range.begin);
+        }
+        lastEnd = range.end;
+        for (unsigned int index = range.begin; index < range.end; ++index)
+            covered[index] = true;
+    }
+    EXPECT_EQ(marked, covered);
+}
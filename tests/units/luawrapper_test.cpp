@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include "lua/luawrapper.h"
+
+namespace {
+
+const std::string testScript = "luawrapper_test.lua";
+
+void writeScript(const std::string & source)
+{
+    std::ofstream(testScript) << source;
+}
+
+}
+
+TEST(LuaWrapper_tests, function_handles_follow_the_scripts)
+{
+    LuaWrapper lua;
+
+    // resolved before the script defines the function
+    const LuaWrapper::FunctionRef value = lua.function("value");
+    EXPECT_EQ(value.ref, lua.function("value").ref);
+
+    writeScript("function value(a, b) return a + b end");
+    lua.loadScript(testScript);
+    EXPECT_EQ(5, lua.call<int>(value, 2, 3));
+    EXPECT_EQ(5, lua.call<int>("value", 2, 3));
+
+    writeScript("function value(a, b) return a * b end");
+    lua.reloadScripts();
+    EXPECT_EQ(6, lua.call<int>(value, 2, 3));
+
+    std::remove(testScript.c_str());
+}
+
+TEST(LuaWrapper_tests, registered_functions)
+{
+    LuaWrapper lua;
+
+    const int offset = 10;
+    lua.Register("lambda", [=](int i, const std::string & text) { return i + offset + static_cast<int>(text.size()); });
+    std::function<float(float)> erased = [](float x) { return 2.0f * x; };
+    lua.Register("erased", erased);
+    lua.Register("both", []() { return std::make_tuple(1, 2.5f); });
+
+    writeScript(
+        "function useLambda() return lambda(1, 'abc') end\n"
+        "function useErased() return erased(1.5) end\n"
+        "function useBoth() local a, b = both() return a + b end\n");
+    lua.loadScript(testScript);
+    std::remove(testScript.c_str());
+
+    EXPECT_EQ(14, lua.call<int>("useLambda"));
+    EXPECT_EQ(3.0f, lua.call<float>("useErased"));
+    EXPECT_EQ(3.5f, lua.call<float>(lua.function("useBoth")));
+}
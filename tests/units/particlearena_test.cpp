@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "rendering/particlearena.h"
+
+
+TEST(ParticleArena_tests, slots_dont_overlap)
+{
+    ParticleArena arena(100);
+    const uint32_t a = arena.allocate(30);
+    const uint32_t b = arena.allocate(50);
+    const uint32_t c = arena.allocate(20);
+
+    EXPECT_EQ(0u, arena.offset(a));
+    EXPECT_EQ(30u, arena.offset(b));
+    EXPECT_EQ(80u, arena.offset(c));
+    EXPECT_EQ(100u, arena.capacity());
+    EXPECT_EQ(50u, arena.maxCount(b));
+}
+
+TEST(ParticleArena_tests, released_ranges_are_merged_and_reused)
+{
+    ParticleArena arena(100);
+    const uint32_t a = arena.allocate(20);
+    const uint32_t b = arena.allocate(20);
+    const uint32_t c = arena.allocate(20);
+    arena.allocate(40);
+
+    arena.release(a);
+    arena.release(c);
+    arena.release(b);
+
+    // the released ranges form one free range of 60 vertices at the start
+    const uint32_t d = arena.allocate(60);
+    EXPECT_EQ(0u, arena.offset(d));
+    EXPECT_EQ(100u, arena.capacity());
+}
+
+TEST(ParticleArena_tests, growing_keeps_offsets)
+{
+    ParticleArena arena(100);
+    const uint32_t a = arena.allocate(60);
+    const uint32_t b = arena.allocate(70);
+
+    EXPECT_EQ(0u, arena.offset(a));
+    EXPECT_EQ(60u, arena.offset(b));   // uses the free tail of the old capacity
+    EXPECT_GE(arena.capacity(), 130u);
+
+    const uint32_t c = arena.allocate(1000);
+    EXPECT_EQ(0u, arena.offset(a));
+    EXPECT_EQ(60u, arena.offset(b));
+    EXPECT_GE(arena.capacity(), arena.offset(c) + 1000);
+    EXPECT_GE(arena.offset(c), 130u);
+}
+
+TEST(ParticleArena_tests, draw_lists_contain_slots_with_particles)
+{
+    ParticleArena arena(100);
+    const uint32_t a = arena.allocate(30);
+    const uint32_t b = arena.allocate(30);
+    const uint32_t c = arena.allocate(30);
+
+    arena.setCount(a, 10);
+    arena.setCount(c, 30);
+    EXPECT_EQ(90u, arena.liveEnd());
+
+    std::vector<int32_t> firsts, counts;
+    arena.drawLists(200, firsts, counts);
+    ASSERT_EQ(2u, firsts.size());
+    ASSERT_EQ(2u, counts.size());
+    EXPECT_EQ(200, firsts.at(0));
+    EXPECT_EQ(10, counts.at(0));
+    EXPECT_EQ(260, firsts.at(1));
+    EXPECT_EQ(30, counts.at(1));
+
+    arena.setCount(b, 5);
+    arena.release(c);
+    EXPECT_EQ(35u, arena.liveEnd());
+
+    arena.clearCounts();
+    firsts.clear();
+    counts.clear();
+    arena.drawLists(0, firsts, counts);
+    EXPECT_TRUE(firsts.empty());
+    EXPECT_EQ(0u, arena.liveEnd());
+}
+
+TEST(ParticleArena_tests, slots_are_reused)
+{
+    ParticleArena arena(100);
+    const uint32_t a = arena.allocate(10);
+    arena.allocate(10);
+    arena.release(a);
+
+    const uint32_t c = arena.allocate(5);
+    EXPECT_EQ(a, c);
+    EXPECT_EQ(0u, arena.count(c));
+    EXPECT_EQ(0u, arena.offset(c));
+}
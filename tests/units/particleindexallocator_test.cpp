@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "particles/particleindexallocator.h"
+
+
+TEST(ParticleIndexAllocator_tests, acquire_until_full)
+{
+    ParticleIndexAllocator allocator(100);
+    std::vector<uint32_t> indices;
+
+    EXPECT_EQ(60u, allocator.acquire(60, indices));
+    EXPECT_EQ(40u, allocator.acquire(60, indices));
+    EXPECT_EQ(0u, allocator.acquire(1, indices));
+
+    ASSERT_EQ(100u, indices.size());
+    EXPECT_EQ(100u, allocator.numUsed());
+
+    std::sort(indices.begin(), indices.end());
+    for (uint32_t i = 0; i < 100; ++i)
+        EXPECT_EQ(i, indices[i]);
+}
+
+TEST(ParticleIndexAllocator_tests, release_and_reacquire)
+{
+    ParticleIndexAllocator allocator(130);
+    std::vector<uint32_t> indices;
+    allocator.acquire(130, indices);
+
+    // release every other index, plus one index twice
+    std::vector<uint32_t> released;
+    for (uint32_t i = 0; i < 130; i += 2)
+        released.push_back(i);
+    released.push_back(4);
+    allocator.release(released);
+
+    EXPECT_EQ(65u, allocator.numUsed());
+    for (uint32_t i = 0; i < 130; ++i)
+        EXPECT_EQ(i % 2 == 1, allocator.isUsed(i));
+
+    indices.clear();
+    EXPECT_EQ(65u, allocator.acquire(100, indices));
+    std::sort(indices.begin(), indices.end());
+    for (uint32_t i = 0; i < 65; ++i)
+        EXPECT_EQ(2 * i, indices[i]);
+}
+
+TEST(ParticleIndexAllocator_tests, release_oldest_in_acquisition_order)
+{
+    ParticleIndexAllocator allocator(100);
+    std::vector<uint32_t> indices;
+    allocator.acquire(50, indices);
+    allocator.acquire(50, indices);
+
+    // the released indices are handed out again, they are the youngest now
+    std::vector<uint32_t> released;
+    for (uint32_t i = 10; i < 20; ++i)
+        released.push_back(i);
+    allocator.release(released);
+    indices.clear();
+    allocator.acquire(10, indices);
+
+    std::vector<uint32_t> oldest;
+    EXPECT_EQ(45u, allocator.releaseOldest(45, oldest));
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < 55; ++i) {
+        if (i < 10 || i >= 20)
+            expected.push_back(i);
+    }
+    EXPECT_EQ(expected, oldest);
+    EXPECT_EQ(55u, allocator.numUsed());
+    for (uint32_t index : oldest)
+        EXPECT_FALSE(allocator.isUsed(index));
+
+    oldest.clear();
+    EXPECT_EQ(55u, allocator.releaseOldest(100, oldest));
+    ASSERT_EQ(55u, oldest.size());
+    for (uint32_t i = 0; i < 45; ++i)
+        EXPECT_EQ(55 + i, oldest[i]);
+    for (uint32_t i = 0; i < 10; ++i)
+        EXPECT_EQ(10 + i, oldest[45 + i]);
+    EXPECT_EQ(0u, allocator.numUsed());
+}
+
+TEST(ParticleIndexAllocator_tests, release_oldest_after_many_batches)
+{
+    ParticleIndexAllocator allocator(1000);
+    std::vector<uint32_t> indices;
+    allocator.acquire(10, indices);
+
+    // short lived particles, their batches are compacted away
+    for (uint32_t i = 0; i < 5000; ++i) {
+        indices.clear();
+        allocator.acquire(3, indices);
+        if (i % 100 != 0)
+            allocator.release(indices);
+    }
+    EXPECT_EQ(10u + 3u * 50u, allocator.numUsed());
+
+    std::vector<uint32_t> oldest;
+    EXPECT_EQ(10u, allocator.releaseOldest(10, oldest));
+    std::sort(oldest.begin(), oldest.end());
+    for (uint32_t i = 0; i < 10; ++i)
+        EXPECT_EQ(i, oldest[i]);
+}
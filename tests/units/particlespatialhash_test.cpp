@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "particles/particlesnapshot.h"
+#include "particles/particlespatialhash.h"
+
+
+TEST(ParticleSpatialHash_tests, contacts_across_cell_borders)
+{
+    ParticleSpatialHash spatialHash(0.3f);
+
+    // closer than the cell size, but in neighbouring cells
+    ParticleSnapshot water(1), lava(1), farLava(1);
+    water.append(0, glm::vec3(0.29f, 0.1f, 0.1f), glm::vec3(0.0f), 1);
+    lava.append(0, glm::vec3(0.31f, 0.1f, 0.1f), glm::vec3(0.0f), 1);
+    farLava.append(0, glm::vec3(1.0f, 0.1f, 0.1f), glm::vec3(0.0f), 1);
+
+    spatialHash.updateGroup(1, "water", water);
+    spatialHash.updateGroup(2, "lava", lava);
+    spatialHash.updateGroup(3, "lava", farLava);
+
+    std::vector<ParticleSpatialHash::Contact> contacts;
+    spatialHash.findContacts(contacts);
+
+    ASSERT_EQ(1u, contacts.size());
+    EXPECT_EQ(1u, contacts[0].leftGroup);
+    EXPECT_EQ(2u, contacts[0].rightGroup);
+    EXPECT_EQ(spatialHash.cellAt(glm::vec3(0.29f, 0.1f, 0.1f)), contacts[0].leftCell);
+    EXPECT_EQ(spatialHash.cellAt(glm::vec3(0.31f, 0.1f, 0.1f)), contacts[0].rightCell);
+
+    // the contact volume contains both particles
+    const glowutils::AxisAlignedBoundingBox bounds = spatialHash.contactBounds(contacts[0]);
+    EXPECT_TRUE(bounds.inside(glm::vec3(0.29f, 0.1f, 0.1f)));
+    EXPECT_TRUE(bounds.inside(glm::vec3(0.31f, 0.1f, 0.1f)));
+}
+
+TEST(ParticleSpatialHash_tests, unchanged_snapshots_are_skipped)
+{
+    ParticleSpatialHash spatialHash(0.3f);
+
+    ParticleSnapshot water(1), lava(1);
+    water.append(0, glm::vec3(0.1f), glm::vec3(0.0f), 1);
+    lava.append(0, glm::vec3(5.0f), glm::vec3(0.0f), 1);
+
+    spatialHash.updateGroup(1, "water", water);
+    spatialHash.updateGroup(2, "lava", lava);
+
+    // moved without a new revision: the hash keeps the old cells
+    lava.positionX[0] = lava.positionY[0] = lava.positionZ[0] = 0.1f;
+    spatialHash.updateGroup(2, "lava", lava);
+
+    std::vector<ParticleSpatialHash::Contact> contacts;
+    spatialHash.findContacts(contacts);
+    EXPECT_TRUE(contacts.empty());
+
+    lava.clear();
+    lava.append(0, glm::vec3(0.1f), glm::vec3(0.0f), 1);
+    spatialHash.updateGroup(2, "lava", lava);
+
+    spatialHash.findContacts(contacts);
+    EXPECT_EQ(1u, contacts.size());
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <glm/glm.hpp>
+
+#include "rendering/shadowmapcache.h"
+
+
+namespace {
+
+/** orthographic projection of x/y in [-100, 100] along -z */
+glm::mat4 orthographic100(float offsetX)
+{
+    return glm::mat4(
+        glm::vec4(0.01f, 0.0f, 0.0f, 0.0f),
+        glm::vec4(0.0f, 0.01f, 0.0f, 0.0f),
+        glm::vec4(0.0f, 0.0f, -0.01f, 0.0f),
+        glm::vec4(-offsetX * 0.01f, 0.0f, 0.0f, 1.0f));
+}
+
+}
+
+TEST(ShadowMapCache_tests, view_changes_update_everything)
+{
+    ShadowMapCache cache(glm::ivec2(200, 200));
+    glm::ivec4 rect;
+
+    cache.setLightView(orthographic100(0.0f));
+    EXPECT_EQ(ShadowMapCache::Update::Full, cache.update(rect));
+    EXPECT_EQ(200, rect.z);
+
+    cache.setLightView(orthographic100(0.0f));
+    EXPECT_EQ(ShadowMapCache::Update::None, cache.update(rect));
+
+    cache.setLightView(orthographic100(10.0f));
+    EXPECT_EQ(ShadowMapCache::Update::Full, cache.update(rect));
+
+    EXPECT_EQ(2u, cache.counters().fullUpdates);
+    EXPECT_EQ(1u, cache.counters().reuses);
+    EXPECT_EQ(1u, cache.counters().viewChanges);
+}
+
+TEST(ShadowMapCache_tests, regions_are_merged)
+{
+    ShadowMapCache cache(glm::ivec2(200, 200));
+    glm::ivec4 rect;
+
+    cache.setLightView(orthographic100(0.0f));
+    cache.update(rect);
+
+    // one texel per world unit, with one texel border
+    cache.invalidate(glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(10.0f, 5.0f, 1.0f), ShadowMapCache::Source::Terrain);
+    cache.invalidate(glm::vec3(20.0f, 0.0f, -1.0f), glm::vec3(30.0f, 5.0f, 1.0f), ShadowMapCache::Source::Hand);
+    ASSERT_EQ(ShadowMapCache::Update::Partial, cache.update(rect));
+    EXPECT_EQ(glm::ivec4(99, 99, 32, 7), rect);
+    EXPECT_EQ(32u * 7u, cache.counters().updatedTexels - 200u * 200u);
+
+    EXPECT_EQ(ShadowMapCache::Update::None, cache.update(rect));
+
+    EXPECT_EQ(1u, cache.counters().terrainRegions);
+    EXPECT_EQ(1u, cache.counters().handRegions);
+}
+
+TEST(ShadowMapCache_tests, outside_and_large_regions)
+{
+    ShadowMapCache cache(glm::ivec2(200, 200));
+    glm::ivec4 rect;
+
+    cache.setLightView(orthographic100(0.0f));
+    cache.update(rect);
+
+    cache.invalidate(glm::vec3(150.0f, 0.0f, 0.0f), glm::vec3(160.0f, 10.0f, 0.0f), ShadowMapCache::Source::Hand);
+    EXPECT_EQ(ShadowMapCache::Update::None, cache.update(rect));
+    EXPECT_EQ(1u, cache.counters().ignoredRegions);
+
+    cache.invalidate(glm::vec3(-90.0f, -90.0f, 0.0f), glm::vec3(90.0f, 90.0f, 0.0f), ShadowMapCache::Source::Terrain);
+    EXPECT_EQ(ShadowMapCache::Update::Full, cache.update(rect));
+}
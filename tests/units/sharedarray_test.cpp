@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "utils/sharedarray.h"
+
+
+TEST(SharedArray_tests, copies_share_until_written)
+{
+    SharedArray<float> values(4, 1.0f);
+    SharedArray<float> copy = values;
+    EXPECT_EQ(values.data(), copy.data());
+
+    values.write().at(2) = 5.0f;
+    EXPECT_NE(values.data(), copy.data());
+    EXPECT_EQ(5.0f, values[2]);
+    EXPECT_EQ(1.0f, copy[2]);
+    EXPECT_NE(values, copy);
+
+    // the last owner writes in place
+    const float * data = values.data();
+    values.write().at(3) = 2.0f;
+    EXPECT_EQ(data, values.data());
+
+    copy = values;
+    EXPECT_EQ(values, copy);
+}
+
+TEST(SharedArray_tests, read_copy_on_another_thread)
+{
+    SharedArray<int> values(1000, 7);
+    SharedArray<int> copy = values;
+
+    int sum = 0;
+    std::thread reader([&copy, &sum]() {
+        for (int value : copy)
+            sum += value;
+        copy = SharedArray<int>();
+    });
+
+    std::vector<int> & written = values.write();
+    for (int & value : written)
+        value = 1;
+    reader.join();
+
+    EXPECT_EQ(7000, sum);
+    EXPECT_EQ(1, values[999]);
+    EXPECT_TRUE(copy.empty());
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "rendering/streamingring.h"
+
+
+namespace {
+
+/** Storage in client memory that simulates a GPU finishing the commands of a frame gpuLag frames after they were issued.
+  * Counts the writes that would wait for the GPU. */
+class MockStreamingStorage : public StreamingStorage
+{
+public:
+    MockStreamingStorage(size_t regionSize, unsigned int numRegions, unsigned int gpuLag)
+    : regionSize(regionSize)
+    , gpuLag(gpuLag)
+    , frame(0)
+    , numWaits(0)
+    , data(regionSize * numRegions)
+    , retiredInFrame(numRegions, -1)
+    , readable(numRegions, false)
+    , writtenBytes(numRegions, 0)
+    {
+    }
+
+    virtual void * beginWrite(unsigned int region) override
+    {
+        // the region may only be written again after retiring it
+        EXPECT_FALSE(readable.at(region));
+        const int retired = retiredInFrame.at(region);
+        if (retired >= 0 && retired > static_cast<int>(frame) - static_cast<int>(gpuLag))
+            ++numWaits;
+        return data.data() + region * regionSize;
+    }
+
+    virtual void endWrite(unsigned int region, size_t numBytes) override
+    {
+        readable.at(region) = true;
+        writtenBytes.at(region) = numBytes;
+    }
+
+    virtual void retire(unsigned int region) override
+    {
+        EXPECT_TRUE(readable.at(region));
+        readable.at(region) = false;
+        retiredInFrame.at(region) = frame;
+    }
+
+    const size_t regionSize;
+    const unsigned int gpuLag;
+    unsigned int frame;
+    unsigned int numWaits;
+    std::vector<char> data;
+    std::vector<int> retiredInFrame;
+    std::vector<bool> readable;
+    std::vector<size_t> writtenBytes;
+};
+
+}
+
+TEST(StreamingRing_tests, cycles_regions)
+{
+    MockStreamingStorage * storage = new MockStreamingStorage(16, 3, 1);
+    StreamingRing ring(std::unique_ptr<StreamingStorage>(storage), 3);
+
+    EXPECT_FALSE(ring.hasData());
+
+    for (unsigned int i = 0; i < 10; ++i) {
+        char * region = static_cast<char*>(ring.beginWrite());
+        EXPECT_EQ(storage->data.data() + (i % 3) * 16, region);
+        ring.endWrite(4);
+
+        ASSERT_TRUE(ring.hasData());
+        EXPECT_EQ(i % 3, ring.readRegion());
+        ++storage->frame;
+    }
+}
+
+TEST(StreamingRing_tests, three_regions_dont_wait_for_the_gpu)
+{
+    MockStreamingStorage * triple = new MockStreamingStorage(16, 3, 2);
+    StreamingRing tripleRing(std::unique_ptr<StreamingStorage>(triple), 3);
+    MockStreamingStorage * single = new MockStreamingStorage(16, 1, 2);
+    StreamingRing singleRing(std::unique_ptr<StreamingStorage>(single), 1);
+
+    for (unsigned int i = 0; i < 10; ++i) {
+        tripleRing.beginWrite();
+        tripleRing.endWrite(16);
+        ++triple->frame;
+
+        singleRing.beginWrite();
+        singleRing.endWrite(16);
+        ++single->frame;
+    }
+
+    EXPECT_EQ(0u, triple->numWaits);
+    EXPECT_EQ(9u, single->numWaits);
+}
+
+TEST(StreamingRing_tests, writes_only_the_live_bytes)
+{
+    MockStreamingStorage * storage = new MockStreamingStorage(8 * sizeof(float), 3, 1);
+    StreamingRing ring(std::unique_ptr<StreamingStorage>(storage), 3);
+
+    // compact the valid values of a sparse source directly into the region
+    const std::vector<float> source = { 1.0f, -1.0f, 2.0f, -1.0f, -1.0f, 3.0f, -1.0f, -1.0f };
+    float * region = static_cast<float*>(ring.beginWrite());
+    unsigned int next = 0;
+    for (float value : source) {
+        if (value >= 0.0f)
+            region[next++] = value;
+    }
+    ring.endWrite(next * sizeof(float));
+
+    EXPECT_EQ(3 * sizeof(float), storage->writtenBytes.at(ring.readRegion()));
+    const float expected[] = { 1.0f, 2.0f, 3.0f };
+    EXPECT_EQ(0, std::memcmp(expected, storage->data.data(), sizeof(expected)));
+}
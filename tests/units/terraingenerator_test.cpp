@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "terrain/terraingenerator.h"
+#include "terrain/terrainsettings.h"
+
+
+namespace {
+
+TileData generateTile(unsigned int stripes, int xID, int zID)
+{
+    TerrainSettings settings;
+    settings.maxTileSamplesPerAxis = 257;
+    settings.generatorStripes = stripes;
+    return TerrainGenerator(settings).generateTileData(xID, zID);
+}
+
+}
+
+TEST(TerrainGenerator_tests, tiles_dont_depend_on_the_number_of_stripes)
+{
+    const TileData single = generateTile(1, 2, -3);
+    ASSERT_EQ(257u * 257u, single.baseHeights.size());
+
+    for (unsigned int stripes : { 2u, 3u, 64u }) {
+        const TileData striped = generateTile(stripes, 2, -3);
+        ASSERT_EQ(single.baseHeights.size(), striped.baseHeights.size());
+        // bit identical, not only equal within a tolerance
+        EXPECT_EQ(0, std::memcmp(single.baseHeights.data(), striped.baseHeights.data(), single.baseHeights.size() * sizeof(float))) << stripes << " stripes";
+        EXPECT_EQ(single.baseElements, striped.baseElements) << stripes << " stripes";
+    }
+}
+
+TEST(TerrainGenerator_tests, tiles_differ_by_id)
+{
+    EXPECT_NE(generateTile(0, 0, 0).baseHeights, generateTile(0, 1, 0).baseHeights);
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "terrain/terrainlod.h"
+
+
+namespace {
+
+/** number of times each cell of the tile is covered by the nodes, within the view range */
+std::vector<unsigned int> coverage(const TerrainLod & lod, const std::vector<TerrainLod::Node> & nodes)
+{
+    const unsigned int cells = lod.tileCells();
+    std::vector<unsigned int> covered(cells * cells, 0);
+    for (const TerrainLod::Node & node : nodes) {
+        const unsigned int size = (node.quarter ? lod.leafCells() / 2 : lod.leafCells()) * node.spacing;
+        for (unsigned int row = node.row; row < node.row + size; ++row)
+            for (unsigned int column = node.column; column < node.column + size; ++column)
+                ++covered.at(row * cells + column);
+    }
+    return covered;
+}
+
+float distance(const glm::vec2 & point, const TerrainLod::Node & node, unsigned int size)
+{
+    const float dx = std::max(0.0f, std::max(node.row - point.x, point.x - (node.row + size)));
+    const float dz = std::max(0.0f, std::max(node.column - point.y, point.y - (node.column + size)));
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+}
+
+TEST(TerrainLod_tests, grid_strips)
+{
+    std::vector<glm::vec2> vertices;
+    TerrainLod::buildGrid(2, vertices);
+    ASSERT_EQ(9u, vertices.size());
+    EXPECT_EQ(1.0f, vertices.at(5).x);  // row major: vertex 5 is row 1, column 2
+    EXPECT_EQ(2.0f, vertices.at(5).y);
+
+    std::vector<uint32_t> indices;
+    TerrainLod::buildGridIndices(2, 2, indices);
+    const std::vector<uint32_t> expected = {
+        0, 3, 1, 4, 2, 5, TerrainLod::s_restartIndex,
+        3, 6, 4, 7, 5, 8, TerrainLod::s_restartIndex };
+    EXPECT_EQ(expected, indices);
+
+    indices.clear();
+    TerrainLod::buildGridIndices(2, 1, indices);
+    const std::vector<uint32_t> expectedQuarter = { 0, 3, 1, 4, TerrainLod::s_restartIndex };
+    EXPECT_EQ(expectedQuarter, indices);
+}
+
+TEST(TerrainLod_tests, index_ranges)
+{
+    const TerrainLod lod(1024, 32);
+
+    EXPECT_EQ(6u, lod.numLevels());
+    EXPECT_EQ(33u * 33u, lod.vertices().size());
+
+    const TerrainLod::Node full = { 0, 0, 1, 0, false };
+    const TerrainLod::Node quarter = { 0, 0, 2, 1, true };
+    EXPECT_EQ(0u, lod.indexOffset(full));
+    EXPECT_EQ(32u * (2u * 33u + 1u), lod.indexCount(full));
+    EXPECT_EQ(lod.indexCount(full), lod.indexOffset(quarter));
+    EXPECT_EQ(16u * (2u * 17u + 1u), lod.indexCount(quarter));
+    EXPECT_EQ(lod.indices().size(), lod.indexOffset(quarter) + lod.indexCount(quarter));
+}
+
+TEST(TerrainLod_tests, selection_covers_the_tile_once)
+{
+    TerrainLod lod(1024, 32);
+
+    for (const glm::vec2 & camera : { glm::vec2(512.0f, 512.0f), glm::vec2(3.0f, 1000.0f), glm::vec2(-300.0f, 200.0f) }) {
+        std::vector<TerrainLod::Node> nodes;
+        lod.select(camera, 0, nullptr, nodes);
+
+        const std::vector<unsigned int> covered = coverage(lod, nodes);
+        EXPECT_TRUE(std::all_of(covered.begin(), covered.end(), [](unsigned int count) { return count == 1; }));
+    }
+}
+
+TEST(TerrainLod_tests, detail_decreases_with_distance)
+{
+    TerrainLod lod(1024, 32);
+    const glm::vec2 camera(100.0f, 100.0f);
+
+    std::vector<TerrainLod::Node> nodes;
+    lod.select(camera, 0, nullptr, nodes);
+
+    bool hasFinest = false;
+    for (const TerrainLod::Node & node : nodes) {
+        hasFinest = hasFinest || (node.level == 0 && node.row <= 100 && node.row + 32 > 100 && node.column <= 100 && node.column + 32 > 100);
+        // only the nodes around the camera use the full tile resolution
+        if (node.level == 0) {
+            EXPECT_LE(distance(camera, node, 32), lod.range(0));
+        }
+    }
+    EXPECT_TRUE(hasFinest);
+
+    // much fewer triangles than the full tile resolution
+    EXPECT_LT(lod.numTriangles(nodes), 2u * 1024u * 1024u / 10u);
+
+    // a coarser minimum level draws fewer triangles
+    std::vector<TerrainLod::Node> coarseNodes;
+    lod.select(camera, 1, nullptr, coarseNodes);
+    EXPECT_LT(lod.numTriangles(coarseNodes), lod.numTriangles(nodes));
+    for (const TerrainLod::Node & node : coarseNodes)
+        EXPECT_GE(node.level, 1u);
+}
+
+TEST(TerrainLod_tests, view_range_and_visibility)
+{
+    TerrainLod lod(1024, 32);
+    lod.setViewRange(100.0f);
+
+    std::vector<TerrainLod::Node> nodes;
+    lod.select(glm::vec2(-500.0f, 0.0f), 0, nullptr, nodes);
+    EXPECT_TRUE(nodes.empty());
+
+    // only the half of the tile with low rows is visible
+    lod.setViewRange(10000.0f);
+    lod.select(glm::vec2(512.0f, 512.0f), 0, [](const glm::vec2 & minRowColumn, const glm::vec2 &) {
+        return minRowColumn.x < 512.0f;
+    }, nodes);
+    ASSERT_FALSE(nodes.empty());
+    for (const TerrainLod::Node & node : nodes)
+        EXPECT_LT(node.row, 512u);
+}
+
+TEST(TerrainLod_tests, morph_ranges)
+{
+    const TerrainLod lod(1024, 32);
+
+    for (unsigned int level = 0; level + 1 < lod.numLevels(); ++level) {
+        const glm::vec2 morph = lod.morphRange(level);
+        EXPECT_EQ(lod.range(level), morph.y);
+        EXPECT_LT(morph.x, morph.y);
+        // the border to the next finer level, at most its range plus the node diagonal away, doesn't morph
+        if (level > 0) {
+            EXPECT_GT(morph.x, lod.range(level - 1) + 1.415f * 32.0f * (1u << (level - 1)));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "terrain/tilefile.h"
+
+namespace {
+
+const std::string testFile = "tilefile_test.bin";
+
+TileData makeTile(int xID, int zID, uint32_t samplesPerAxis, bool withTemperatures)
+{
+    TileData data;
+    data.xID = xID;
+    data.zID = zID;
+    data.samplesPerAxis = samplesPerAxis;
+    const uint32_t numSamples = samplesPerAxis * samplesPerAxis;
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        data.baseHeights.write().push_back(xID + 0.5f * i);
+        data.baseElements.write().push_back(static_cast<uint8_t>((i + zID) % 3));
+        data.liquidHeights.write().push_back(-0.25f * i);
+        if (withTemperatures)
+            data.temperatures.write().push_back(20.0f + i);
+    }
+    return data;
+}
+
+}
+
+TEST(TileFile_tests, write_and_read_tiles)
+{
+    const std::vector<TileData> tiles = { makeTile(0, 0, 17, true), makeTile(-3, 2, 17, false) };
+    ASSERT_TRUE(TileFile::write(testFile, tiles.size(), [&tiles](size_t i, TileData & data) { data = tiles.at(i); return true; }));
+
+    {
+        TileFile file(testFile);
+        ASSERT_TRUE(file.isValid());
+        EXPECT_EQ(2u, file.tiles().size());
+        EXPECT_TRUE(file.contains(-3, 2));
+        EXPECT_FALSE(file.contains(2, -3));
+
+        TileData data;
+        ASSERT_TRUE(file.readTile(0, 0, 17, data));
+        EXPECT_EQ(tiles[0].baseHeights, data.baseHeights);
+        EXPECT_EQ(tiles[0].baseElements, data.baseElements);
+        EXPECT_EQ(tiles[0].liquidHeights, data.liquidHeights);
+        EXPECT_EQ(tiles[0].temperatures, data.temperatures);
+
+        // tiles without temperatures are read with empty temperatures
+        ASSERT_TRUE(file.readTile(-3, 2, 17, data));
+        EXPECT_EQ(-3, data.xID);
+        EXPECT_EQ(2, data.zID);
+        EXPECT_EQ(tiles[1].baseHeights, data.baseHeights);
+        EXPECT_TRUE(data.temperatures.empty());
+
+        EXPECT_FALSE(file.readTile(0, 0, 33, data));
+        EXPECT_FALSE(file.readTile(1, 1, 17, data));
+    }
+
+    std::remove(testFile.c_str());
+}
+
+TEST(TileFile_tests, skip_tiles_and_replace_file)
+{
+    const std::vector<TileData> tiles = { makeTile(0, 0, 9, true), makeTile(1, 0, 9, true), makeTile(2, 0, 9, true) };
+    ASSERT_TRUE(TileFile::write(testFile, tiles.size(), [&tiles](size_t i, TileData & data) { data = tiles.at(i); return true; }));
+
+    {
+        // the mapped file stays valid while it is replaced
+        TileFile file(testFile);
+        ASSERT_TRUE(TileFile::write(testFile, tiles.size(), [&tiles](size_t i, TileData & data) { data = tiles.at(i); return i != 1; }));
+
+        TileData data;
+        EXPECT_TRUE(file.readTile(1, 0, 9, data));
+        EXPECT_EQ(tiles[1].baseHeights, data.baseHeights);
+    }
+
+    TileFile file(testFile);
+    ASSERT_TRUE(file.isValid());
+    EXPECT_EQ(2u, file.tiles().size());
+    EXPECT_FALSE(file.contains(1, 0));
+    EXPECT_TRUE(file.contains(2, 0));
+
+    std::remove(testFile.c_str());
+}
+
+TEST(TileFile_tests, reject_invalid_files)
+{
+    EXPECT_FALSE(TileFile("tilefile_test_missing.bin").isValid());
+
+    std::ofstream(testFile, std::ios_base::binary) << "ETIL, but no tile file";
+    EXPECT_FALSE(TileFile(testFile).isValid());
+
+    std::remove(testFile.c_str());
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "utils/workerpool.h"
+
+
+TEST(WorkerPool_tests, each_task_runs_once)
+{
+    WorkerPool pool(4);
+    EXPECT_EQ(4u, pool.numThreads());
+
+    for (unsigned int numTasks : { 0u, 1u, 3u, 4u, 100u }) {
+        std::vector<std::atomic<int>> calls(numTasks);
+        for (std::atomic<int> & count : calls)
+            count = 0;
+
+        pool.forEach(numTasks, [&calls](unsigned int task) { ++calls[task]; });
+
+        for (unsigned int task = 0; task < numTasks; ++task)
+            EXPECT_EQ(1, calls[task]) << "task " << task << " of " << numTasks;
+    }
+}
+
+TEST(WorkerPool_tests, busy_pool_runs_on_the_calling_thread)
+{
+    WorkerPool pool(3);
+    std::atomic<int> sum(0);
+
+    // nested and concurrent jobs run on the threads that submit them
+    std::thread other([&pool, &sum]() {
+        for (int i = 0; i < 50; ++i)
+            pool.forEach(4, [&sum](unsigned int task) { sum += task; });
+    });
+    for (int i = 0; i < 50; ++i) {
+        pool.forEach(3, [&pool, &sum](unsigned int) {
+            pool.forEach(2, [&sum](unsigned int task) { sum += task; });
+        });
+    }
+    other.join();
+
+    EXPECT_EQ(50 * 6 + 50 * 3, sum);
+}